@@ -0,0 +1,49 @@
+#include "allocations.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocations{0};
+thread_local bool t_counted = false;
+
+}
+
+
+auto bench::count_allocations() -> void
+{
+    t_counted = true;
+}
+
+
+auto bench::allocations() -> std::uint64_t
+{
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+
+auto operator new(std::size_t size) -> void *
+{
+    if (t_counted) {
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (auto * ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+
+auto operator delete(void * ptr) noexcept -> void
+{
+    std::free(ptr);
+}
+
+
+auto operator delete(void * ptr, std::size_t) noexcept -> void
+{
+    std::free(ptr);
+}
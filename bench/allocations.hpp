@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace bench {
+
+/**
+ * @brief Counts heap allocations made by the threads which ask for it
+ *
+ * The benchmark binary replaces the global `operator new`. Server threads
+ * call `count_allocations` before running their IO context, so that what the
+ * benchmark's own client allocates is left out.
+ */
+auto count_allocations() -> void;
+
+/* Allocations made so far by counted threads */
+auto allocations() -> std::uint64_t;
+
+}
@@ -0,0 +1,68 @@
+#include <apsn/ansi.hpp>
+#include <apsn/fmt.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+namespace ansi = apsn::ansi;
+
+
+static auto BM_AnsiC0Cast(benchmark::State & state) -> void
+{
+    auto c = char{0};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ansi::c0_cast(c));
+        c = static_cast<char>((c + 1) & 0x1f);
+    }
+}
+BENCHMARK(BM_AnsiC0Cast);
+
+
+static auto BM_AnsiToString(benchmark::State & state) -> void
+{
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ansi::to_string(ansi::csi_final::SGR));
+    }
+}
+BENCHMARK(BM_AnsiToString);
+
+
+static auto BM_AnsiSgr(benchmark::State & state) -> void
+{
+    for (auto _ : state) {
+        auto seq = ansi::sgr{ansi::bold, ansi::red_fg, ansi::black_bg};
+        benchmark::DoNotOptimize(seq.str());
+    }
+}
+BENCHMARK(BM_AnsiSgr);
+
+
+static auto BM_AnsiSgrFormat(benchmark::State & state) -> void
+{
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            fmt::format("{}{}serial_state:{} {}",
+                ansi::italic, ansi::bold, ansi::reset, "message"));
+    }
+}
+BENCHMARK(BM_AnsiSgrFormat);
+
+
+static auto BM_AnsiSendTo(benchmark::State & state) -> void
+{
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ansi::send_to(24, 80));
+    }
+}
+BENCHMARK(BM_AnsiSendTo);
+
+
+static auto BM_AnsiSendDcs(benchmark::State & state) -> void
+{
+    auto const message = std::string{"serial"};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ansi::send_dcs(message, 'S'));
+    }
+}
+BENCHMARK(BM_AnsiSendDcs);
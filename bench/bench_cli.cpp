@@ -0,0 +1,121 @@
+#include "cli/base_state.hpp"
+#include "context.hpp"
+
+#include <apsn/http/websocket.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+
+namespace {
+
+/* Discards everything written to it */
+class null_streambuf : public std::streambuf
+{
+protected:
+    auto xsputn(char const *, std::streamsize n) -> std::streamsize override
+    { return n; }
+
+    auto overflow(int c) -> int override
+    { return c; }
+};
+
+
+class null_session : public apsn::ws::websocket_base
+{
+public:
+    null_session()
+        : m_out{&m_buf}
+    {}
+
+    auto ostream() -> std::ostream & override
+    { return m_out; }
+
+    auto cancel() -> void override
+    {}
+
+private:
+    null_streambuf m_buf;
+    std::ostream m_out;
+};
+
+
+/* Counts what the parser hands over, without acting on it */
+class counting_state : public smux::cli::base_state
+{
+public:
+    using base_state::base_state;
+
+    auto name() const -> std::string override
+    { return "bench"; }
+
+    std::size_t events = 0;
+
+private:
+    auto on_csi(std::string, apsn::ansi::csi_final)
+        -> std::shared_ptr<base_state> override
+    { ++events; return nullptr; }
+
+    auto on_apc(std::string) -> std::shared_ptr<base_state> override
+    { ++events; return nullptr; }
+
+    auto on_dcs(std::string) -> std::shared_ptr<base_state> override
+    { ++events; return nullptr; }
+
+    auto on_char(char) -> std::shared_ptr<base_state> override
+    { ++events; return nullptr; }
+};
+
+
+auto feed_input(benchmark::State & state, std::string const & input) -> void
+{
+    auto session = null_session{};
+    auto ctx = std::make_shared<smux::context>();
+    auto parser = counting_state{&session, ctx};
+
+    for (auto _ : state) {
+        for (auto c : input) {
+            benchmark::DoNotOptimize(parser.feed(c));
+        }
+    }
+    benchmark::DoNotOptimize(parser.events);
+    state.SetBytesProcessed(
+        static_cast<std::int64_t>(state.iterations() * input.size()));
+}
+
+}
+
+
+/* Typed characters, as most input arrives */
+static auto BM_FeedText(benchmark::State & state) -> void
+{
+    feed_input(state, std::string(4096, 'a'));
+}
+BENCHMARK(BM_FeedText);
+
+
+/* Cursor keys and colour changes */
+static auto BM_FeedCsi(benchmark::State & state) -> void
+{
+    auto input = std::string{};
+    while (input.size() < 4096) {
+        input += "\x1b[A\x1b[1;31m";
+    }
+    feed_input(state, input);
+}
+BENCHMARK(BM_FeedCsi);
+
+
+/* Client commands, such as opening a port */
+static auto BM_FeedApc(benchmark::State & state) -> void
+{
+    auto input = std::string{};
+    while (input.size() < 4096) {
+        input += "\x1b_open_port=1\x1b\\";
+    }
+    feed_input(state, input);
+}
+BENCHMARK(BM_FeedApc);
@@ -0,0 +1,44 @@
+#include <apsn/http/headers.hpp>
+
+#include <benchmark/benchmark.h>
+
+using apsn::http::headers::authorisation;
+
+
+static auto BM_AuthorisationParseDigest(benchmark::State & state) -> void
+{
+    auto const header = std::string_view{"Digest username=\"admin\", "
+            "realm=\"webserial\", "
+            "nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", "
+            "uri=\"/api/ports/1\", algorithm=MD5, "
+            "response=\"6629fae49393a05397450978507c4ef1\", qop=auth, "
+            "nc=00000001, cnonce=\"0a4f113b\", "
+            "opaque=\"5ccc069c403ebaf9f0171e9517f40e41\""};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(authorisation::parse(header));
+    }
+}
+BENCHMARK(BM_AuthorisationParseDigest);
+
+
+static auto BM_AuthorisationParseBasic(benchmark::State & state) -> void
+{
+    /* alice:open sesame */
+    auto const header = std::string_view{"Basic YWxpY2U6b3BlbiBzZXNhbWU="};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(authorisation::parse(header));
+    }
+}
+BENCHMARK(BM_AuthorisationParseBasic);
+
+
+static auto BM_FindCookie(benchmark::State & state) -> void
+{
+    auto const header = std::string_view{
+            "theme=dark; lang=en-GB; webserial_session=abc.def; other=1"};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            apsn::http::headers::find_cookie(header, "webserial_session"));
+    }
+}
+BENCHMARK(BM_FindCookie);
@@ -0,0 +1,68 @@
+#include <apsn/async_logger.hpp>
+#include <apsn/binary_logger.hpp>
+#include <apsn/logging.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+using apsn::log::level;
+
+
+namespace {
+
+class null_logger : public apsn::log::logger
+{
+public:
+    using logger::logger;
+
+    auto do_log(level, std::string const & message) -> void override
+    { benchmark::DoNotOptimize(message.data()); }
+};
+
+}
+
+
+/* A message below the threshold should cost no more than a comparison */
+static auto BM_LogDisabled(benchmark::State & state) -> void
+{
+    auto logger = null_logger{"bench", level::info};
+    for (auto _ : state) {
+        logger.debug("read {} bytes from {}", 42, "/dev/ttyUSB0");
+    }
+}
+BENCHMARK(BM_LogDisabled);
+
+
+static auto BM_LogFormat(benchmark::State & state) -> void
+{
+    auto logger = null_logger{"bench", level::info};
+    for (auto _ : state) {
+        logger.info("read {} bytes from {}", 42, "/dev/ttyUSB0");
+    }
+}
+BENCHMARK(BM_LogFormat);
+
+
+static auto BM_LogAsync(benchmark::State & state) -> void
+{
+    auto logger = apsn::log::async_logger{
+            std::make_shared<null_logger>("bench", level::info),
+            64 * 1024};
+    for (auto _ : state) {
+        logger.info("read {} bytes from {}", 42, "/dev/ttyUSB0");
+    }
+    logger.flush();
+    state.counters["dropped"] = static_cast<double>(logger.dropped());
+}
+BENCHMARK(BM_LogAsync);
+
+
+static auto BM_LogBinary(benchmark::State & state) -> void
+{
+    auto logger = apsn::log::binary_logger{"/dev/null", "bench", level::info};
+    for (auto _ : state) {
+        logger.info("read {} bytes from {}", 42, "/dev/ttyUSB0");
+    }
+}
+BENCHMARK(BM_LogBinary);
@@ -0,0 +1,37 @@
+#include <md5.h>
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <string>
+
+
+/* Digest authentication hashes a few short strings per request */
+static auto BM_Md5Hexdigest(benchmark::State & state) -> void
+{
+    auto const input = std::string(static_cast<std::size_t>(state.range(0)), 'x');
+    for (auto _ : state) {
+        auto hash = MD5{};
+        hash.update(input.data(), static_cast<MD5::size_type>(input.size()));
+        benchmark::DoNotOptimize(hash.finalize().hexdigest());
+    }
+    state.SetBytesProcessed(
+        static_cast<std::int64_t>(state.iterations() * input.size()));
+}
+BENCHMARK(BM_Md5Hexdigest)->Arg(32)->Arg(128)->Arg(4096);
+
+
+static auto BM_Md5HexdigestNoAlloc(benchmark::State & state) -> void
+{
+    auto const input = std::string(static_cast<std::size_t>(state.range(0)), 'x');
+    auto out = std::array<char, 32>{};
+    for (auto _ : state) {
+        auto hash = MD5{};
+        hash.update(input.data(), static_cast<MD5::size_type>(input.size()));
+        hash.finalize().hexdigest(out.data());
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetBytesProcessed(
+        static_cast<std::int64_t>(state.iterations() * input.size()));
+}
+BENCHMARK(BM_Md5HexdigestNoAlloc)->Arg(32)->Arg(128)->Arg(4096);
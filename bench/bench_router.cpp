@@ -0,0 +1,68 @@
+#include <apsn/http/router.hpp>
+
+#include <boost/beast.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <memory>
+#include <string>
+
+namespace http = boost::beast::http;
+
+using apsn::http::router_match;
+
+
+namespace {
+
+struct bench_traits
+{
+    using shared_type = int;
+    using unique_type = int;
+};
+
+
+/* The same shape of routes as the server registers */
+auto make_router() -> apsn::http::router<bench_traits>
+{
+    auto r = apsn::http::router<bench_traits>{std::make_shared<int>(0)};
+    auto ok = [](auto &) { return std::string{"ok"}; };
+    r.get("/", router_match::prefix, ok);
+    r.get("/pages", router_match::prefix, ok);
+    r.get("/assets", router_match::prefix, ok);
+    r.get("/json", router_match::exact, ok);
+    r.get("/api/ports", router_match::exact, ok);
+    r.get("/api/ports/{id}", router_match::exact, ok);
+    r.get("/stats/tls", router_match::exact, ok);
+    r.get("/stats/latency", router_match::exact, ok);
+    r.get("/metrics", router_match::exact, ok);
+    r.get("/logout", router_match::exact, ok);
+    return r;
+}
+
+
+constexpr auto targets = std::array{
+    "/metrics",
+    "/api/ports/3",
+    "/assets/js/main.js?v=1",
+    "/index.html",
+};
+
+}
+
+
+/* Through the router's only entry point, so each iteration also copies the
+   header and wraps it in a request, as a session does */
+static auto BM_RouterHandleGet(benchmark::State & state) -> void
+{
+    auto r = make_router();
+    auto req = http::request<http::empty_body>{
+            http::verb::get, targets[state.range(0)], 11};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(r.handle("127.0.0.1",
+                http::request<http::empty_body>{req}));
+    }
+    state.SetLabel(targets[state.range(0)]);
+}
+BENCHMARK(BM_RouterHandleGet)->DenseRange(0, targets.size() - 1);
@@ -0,0 +1,177 @@
+#include "allocations.hpp"
+
+#include "harness/pty.hpp"
+
+#include "cli/serial_state.hpp"
+#include "context.hpp"
+#include "serial.hpp"
+
+#include <apsn/http/websocket.hpp>
+#include <apsn/metrics.hpp>
+
+#include <boost/asio.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+
+namespace {
+
+/* Stands in for the websocket, counting what the serial state forwards */
+class counting_session : public apsn::ws::websocket_base
+{
+public:
+    counting_session()
+        : m_ostream{&m_streambuf}
+    {}
+
+    auto ostream() -> std::ostream & override
+    { return m_ostream; }
+
+    auto cancel() -> void override
+    {}
+
+    auto received() const -> std::size_t
+    { return m_streambuf.received.load(std::memory_order_acquire); }
+
+private:
+    struct streambuf : std::streambuf
+    {
+        auto xsputn(char const *, std::streamsize n) -> std::streamsize override
+        {
+            received.fetch_add(static_cast<std::size_t>(n),
+                    std::memory_order_release);
+            return n;
+        }
+
+        auto overflow(int) -> int override
+        {
+            received.fetch_add(1, std::memory_order_release);
+            return 1;
+        }
+
+        std::atomic<std::size_t> received{0};
+    };
+
+    streambuf m_streambuf;
+    std::ostream m_ostream;
+};
+
+
+/**
+ * @brief A serial state reading a pseudo terminal
+ *
+ * The serial IO context runs on a thread of its own, as in the server, and
+ * is the only thread whose allocations are counted.
+ */
+class serial_loopback
+{
+public:
+    serial_loopback()
+        : m_work{asio::make_work_guard(m_ctx->ioc)}
+    {
+        auto pty = smux::test::pty_pair::open();
+        if (!pty) {
+            return;
+        }
+        m_pty.emplace(std::move(*pty));
+
+        auto id = smux::test::add_fake_port(m_ctx->ports, *m_pty);
+        auto lock = m_ctx->ports.lock();
+        auto info = m_ctx->ports.get_port(*id);
+        auto port = smux::serial::create(m_ctx->ioc.get_executor(),
+                info->device, info->options);
+        if (!port) {
+            return;
+        }
+        info->in_use = true;
+        m_reads = &apsn::metrics::default_registry().histogram(
+                "serial_read_bytes", "Bytes returned by each serial port read",
+                {{"port", info->device}});
+        m_state = std::make_shared<smux::cli::serial_state>(
+                &m_session, m_ctx, *info, std::move(*port));
+        lock.unlock();
+
+        m_state->run();
+        m_runner = std::thread{[this] {
+            bench::count_allocations();
+            m_ctx->ioc.run();
+        }};
+    }
+
+    ~serial_loopback()
+    {
+        if (m_state) {
+            m_state->cancel();
+        }
+        m_work.reset();
+        if (m_runner.joinable()) {
+            m_runner.join();
+        }
+        m_state.reset();
+    }
+
+    auto ok() const -> bool
+    { return static_cast<bool>(m_state); }
+
+    auto pty() -> smux::test::pty_pair &
+    { return *m_pty; }
+
+    auto session() const -> counting_session const &
+    { return m_session; }
+
+    auto reads() const -> std::uint64_t
+    { return m_reads->snapshot().count; }
+
+private:
+    std::shared_ptr<smux::context> m_ctx = std::make_shared<smux::context>();
+    asio::executor_work_guard<asio::io_context::executor_type> m_work;
+    std::optional<smux::test::pty_pair> m_pty;
+    counting_session m_session;
+    apsn::metrics::histogram * m_reads = nullptr;
+    std::shared_ptr<smux::cli::serial_state> m_state;
+    std::thread m_runner;
+};
+
+}
+
+
+/* Serial output forwarded as it arrives, one write to the adaptor at a time */
+static auto BM_SerialRead(benchmark::State & state) -> void
+{
+    auto serial = serial_loopback{};
+    if (!serial.ok()) {
+        state.SkipWithError("Could not open a pseudo terminal");
+        return;
+    }
+    auto const output = std::string(
+            static_cast<std::size_t>(state.range(0)), 'x');
+
+    auto expected = serial.session().received();
+    auto const reads = serial.reads();
+    auto const before = bench::allocations();
+    for (auto _ : state) {
+        if (serial.pty().write(output)) {
+            state.SkipWithError("Could not write to the pseudo terminal");
+            break;
+        }
+        expected += output.size();
+        while (serial.session().received() < expected) {
+            std::this_thread::yield();
+        }
+    }
+    auto const allocated = static_cast<double>(bench::allocations() - before);
+    auto const read = static_cast<double>(serial.reads() - reads);
+    state.counters["allocs"] = benchmark::Counter(allocated,
+            benchmark::Counter::kAvgIterations);
+    state.counters["allocs_per_read"] = read > 0 ? allocated / read : 0;
+    state.SetBytesProcessed(static_cast<std::int64_t>(
+            state.iterations() * output.size()));
+}
+BENCHMARK(BM_SerialRead)->Arg(16)->Arg(256)->UseRealTime();
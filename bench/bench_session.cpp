@@ -0,0 +1,130 @@
+#include "allocations.hpp"
+
+#include <apsn/http/listener.hpp>
+#include <apsn/http/router.hpp>
+#include <apsn/http/server_traits.hpp>
+#include <apsn/http/timer_wheel.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace http = boost::beast::http;
+
+
+namespace {
+
+/* Sessions need a websocket handler, though only plain requests are made */
+template <typename Traits, apsn::ws::transport Transport>
+class idle_handler
+    : public std::enable_shared_from_this<idle_handler<Traits, Transport>>
+    , public apsn::ws::websocket_handler<idle_handler, Traits, Transport>
+{
+    using base_type = apsn::ws::websocket_handler<idle_handler, Traits, Transport>;
+
+public:
+    using base_type::base_type;
+
+    template <typename Request>
+    auto handle_request(Request &) -> std::optional<apsn::http::response>
+    { return std::nullopt; }
+
+    auto handle_accept() -> void
+    {}
+
+    auto handle_message() -> void
+    {}
+};
+
+
+using bench_traits = apsn::http::server_traits<
+    apsn::http::no_data,
+    apsn::http::no_data,
+    apsn::http::router,
+    idle_handler
+>;
+
+
+/**
+ * @brief A listener and router on a thread of their own
+ *
+ * Allocations are counted on the server's thread only.
+ */
+class server
+{
+public:
+    server()
+        : m_work{asio::make_work_guard(m_ioc)}
+    {
+        auto shared = std::make_shared<apsn::http::no_data>();
+        auto router = std::make_shared<apsn::http::router<bench_traits>>(shared);
+        router->get("/", apsn::http::router_match::exact,
+            [](auto &) { return std::string{"ok"}; });
+
+        auto listener = std::make_shared<apsn::http::listener<bench_traits>>(
+                m_ioc,
+                tcp::endpoint{asio::ip::address_v4::loopback(), 0},
+                shared,
+                router,
+                std::make_shared<apsn::http::timer_wheel>(m_ioc.get_executor()));
+        listener->run();
+        m_endpoint = listener->local_endpoint();
+
+        m_runner = std::thread{[this] {
+            bench::count_allocations();
+            m_ioc.run();
+        }};
+    }
+
+    ~server()
+    {
+        m_work.reset();
+        m_ioc.stop();
+        m_runner.join();
+    }
+
+    auto endpoint() const -> tcp::endpoint
+    { return m_endpoint; }
+
+private:
+    asio::io_context m_ioc;
+    asio::executor_work_guard<asio::io_context::executor_type> m_work;
+    tcp::endpoint m_endpoint;
+    std::thread m_runner;
+};
+
+}
+
+
+/* Requests on one keep-alive connection, each waiting for its response */
+static auto BM_HttpKeepAlive(benchmark::State & state) -> void
+{
+    auto srv = server{};
+    auto ioc = asio::io_context{};
+    auto stream = beast::tcp_stream{ioc};
+    stream.connect(srv.endpoint());
+
+    auto req = http::request<http::empty_body>{http::verb::get, "/", 11};
+    req.set(http::field::host, "localhost");
+    req.keep_alive(true);
+
+    auto buffer = beast::flat_buffer{};
+    auto const before = bench::allocations();
+    for (auto _ : state) {
+        http::write(stream, req);
+        auto res = http::response<http::string_body>{};
+        http::read(stream, buffer, res);
+        benchmark::DoNotOptimize(res.body().data());
+    }
+    state.counters["allocs"] = benchmark::Counter(
+            static_cast<double>(bench::allocations() - before),
+            benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HttpKeepAlive)->UseRealTime();
@@ -0,0 +1,303 @@
+#include "harness/pty.hpp"
+
+#include "cli/serial_state.hpp"
+#include "context.hpp"
+#include "port_server.hpp"
+#include "serial.hpp"
+
+#include <apsn/http/timer_wheel.hpp>
+#include <apsn/http/websocket.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+
+
+namespace {
+
+struct bench_traits
+{
+    using shared_type = int;
+    using unique_type = int;
+};
+
+
+/* A websocket which only writes what it is sent */
+template <typename Traits, apsn::ws::transport Transport>
+class sink_handler
+    : public std::enable_shared_from_this<sink_handler<Traits, Transport>>
+    , public apsn::ws::websocket_handler<sink_handler, Traits, Transport>
+{
+    using base_type = apsn::ws::websocket_handler<sink_handler, Traits, Transport>;
+
+public:
+    using base_type::base_type;
+
+    template <typename Request>
+    auto handle_request(Request &) -> std::optional<apsn::http::response>
+    { return std::nullopt; }
+
+    auto handle_accept() -> void
+    {}
+
+    auto handle_message() -> void
+    {}
+};
+
+
+/**
+ * @brief A pseudo terminal registered as a port, its IO context running
+ *
+ * Serial IO runs on a thread of its own, as on the server's main thread.
+ */
+class port_loopback
+{
+public:
+    port_loopback()
+        : m_work{asio::make_work_guard(m_ctx->ioc)}
+    {
+        if (auto pty = smux::test::pty_pair::open()) {
+            m_pty.emplace(std::move(*pty));
+            if (auto id = smux::test::add_fake_port(m_ctx->ports, *m_pty)) {
+                m_port_id = *id;
+            }
+        }
+    }
+
+    ~port_loopback()
+    {
+        m_work.reset();
+        m_ctx->ioc.stop();
+        if (m_runner.joinable()) {
+            m_runner.join();
+        }
+    }
+
+    auto run() -> void
+    {
+        m_runner = std::thread{[this] { m_ctx->ioc.run(); }};
+    }
+
+    auto ok() const -> bool
+    { return m_pty && m_port_id; }
+
+    auto context() -> std::shared_ptr<smux::context>
+    { return m_ctx; }
+
+    auto port_id() const -> std::size_t
+    { return *m_port_id; }
+
+    auto pty() -> smux::test::pty_pair &
+    { return *m_pty; }
+
+private:
+    std::shared_ptr<smux::context> m_ctx = std::make_shared<smux::context>();
+    asio::executor_work_guard<asio::io_context::executor_type> m_work;
+    std::optional<smux::test::pty_pair> m_pty;
+    std::optional<std::size_t> m_port_id;
+    std::thread m_runner;
+};
+
+
+/**
+ * @brief A port read by a serial state, as after `connect`, into a websocket
+ *
+ * The websocket runs on a network thread of its own and is read by a
+ * client on the benchmark's thread.
+ */
+class websocket_path
+{
+public:
+    websocket_path()
+        : m_acceptor{m_server_ioc, {asio::ip::address_v4::loopback(), 0}}
+        , m_client{m_client_ioc}
+        , m_work{asio::make_work_guard(m_server_ioc)}
+    {
+        if (!m_port.ok()) {
+            return;
+        }
+
+        m_client.next_layer().connect(m_acceptor.local_endpoint());
+        auto socket = m_acceptor.accept();
+        socket.set_option(tcp::no_delay{true});
+
+        auto handshake = std::thread{[this] {
+            m_client.handshake("127.0.0.1", "/");
+        }};
+
+        auto buffer = beast::flat_buffer{};
+        auto req = beast::http::request<beast::http::string_body>{};
+        beast::http::read(socket, buffer, req);
+
+        m_server = std::make_shared<server_type>(
+                beast::tcp_stream{std::move(socket)},
+                std::make_shared<int>(0),
+                std::make_shared<int>(0),
+                std::make_shared<apsn::http::timer_wheel>(
+                    m_server_ioc.get_executor()));
+        m_server->run(std::move(req));
+        m_runner = std::thread{[this] { m_server_ioc.run(); }};
+        handshake.join();
+
+        auto ctx = m_port.context();
+        auto lock = ctx->ports.lock();
+        auto info = ctx->ports.get_port(m_port.port_id());
+        auto port = smux::serial::create(ctx->ioc.get_executor(),
+                info->device, info->options);
+        if (!port) {
+            return;
+        }
+        info->in_use = true;
+        m_state = std::make_shared<smux::cli::serial_state>(
+                m_server.get(), ctx, *info, std::move(*port));
+        lock.unlock();
+
+        m_state->run();
+        m_port.run();
+    }
+
+    ~websocket_path()
+    {
+        if (m_state) {
+            m_state->cancel();
+        }
+        m_work.reset();
+        m_server_ioc.stop();
+        if (m_runner.joinable()) {
+            m_runner.join();
+        }
+    }
+
+    auto ok() const -> bool
+    { return static_cast<bool>(m_state); }
+
+    auto pty() -> smux::test::pty_pair &
+    { return m_port.pty(); }
+
+    auto read() -> std::size_t
+    {
+        auto size = m_client.read(m_buffer);
+        m_buffer.consume(size);
+        return size;
+    }
+
+private:
+    using server_type = sink_handler<bench_traits, apsn::ws::transport::tcp>;
+
+    port_loopback m_port;
+    asio::io_context m_server_ioc;
+    asio::io_context m_client_ioc;
+    tcp::acceptor m_acceptor;
+    websocket::stream<tcp::socket> m_client;
+    asio::executor_work_guard<asio::io_context::executor_type> m_work;
+    std::shared_ptr<server_type> m_server;
+    std::shared_ptr<smux::cli::serial_state> m_state;
+    std::thread m_runner;
+    beast::flat_buffer m_buffer;
+};
+
+
+/* A port served raw by the port server, as with `--raw-base` */
+class tcp_path
+{
+public:
+    tcp_path()
+        : m_client{m_client_ioc}
+    {
+        if (!m_port.ok()) {
+            return;
+        }
+
+        m_listener = std::make_shared<smux::port_listener>(m_port.context(),
+                tcp::endpoint{asio::ip::address_v4::loopback(), 0},
+                smux::port_protocol::raw,
+                m_port.port_id());
+        if (!m_listener->is_open()) {
+            return;
+        }
+        m_listener->run();
+        m_port.run();
+
+        auto ec = boost::system::error_code{};
+        m_client.connect(m_listener->local_endpoint(), ec);
+        if (!ec) {
+            m_client.set_option(tcp::no_delay{true}, ec);
+        }
+        m_connected = !ec;
+    }
+
+    ~tcp_path()
+    {
+        auto ec = boost::system::error_code{};
+        m_client.close(ec);
+    }
+
+    auto ok() const -> bool
+    { return m_connected; }
+
+    auto pty() -> smux::test::pty_pair &
+    { return m_port.pty(); }
+
+    auto read() -> std::size_t
+    { return m_client.read_some(asio::buffer(m_buffer)); }
+
+private:
+    port_loopback m_port;
+    asio::io_context m_client_ioc;
+    std::shared_ptr<smux::port_listener> m_listener;
+    tcp::socket m_client;
+    std::array<char, 4096> m_buffer;
+    bool m_connected = false;
+};
+
+
+/* Each chunk is written to the pseudo terminal and read back by the client
+   before the next, so this measures how long one chunk takes to get through */
+template <typename Path>
+auto round_trip(benchmark::State & state) -> void
+{
+    auto path = Path{};
+    if (!path.ok()) {
+        state.SkipWithError("Could not serve a pseudo terminal");
+        return;
+    }
+    auto const output = std::string(
+            static_cast<std::size_t>(state.range(0)), 'x');
+
+    for (auto _ : state) {
+        if (path.pty().write(output)) {
+            state.SkipWithError("Could not write to the pseudo terminal");
+            break;
+        }
+        for (auto received = std::size_t{0}; received < output.size();) {
+            received += path.read();
+        }
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(
+            state.iterations() * output.size()));
+}
+
+}
+
+
+static auto BM_PortOverWebsocket(benchmark::State & state) -> void
+{
+    round_trip<websocket_path>(state);
+}
+BENCHMARK(BM_PortOverWebsocket)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
+
+
+static auto BM_PortOverTcp(benchmark::State & state) -> void
+{
+    round_trip<tcp_path>(state);
+}
+BENCHMARK(BM_PortOverTcp)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
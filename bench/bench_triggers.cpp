@@ -0,0 +1,94 @@
+#include "triggers.hpp"
+
+#include <fmt/format.h>
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace {
+
+/* Boot and login chatter in which nothing matches, as a console mostly is */
+auto console_output(std::size_t size) -> std::string
+{
+    auto out = std::string{};
+    for (auto i = std::size_t{0}; out.size() < size; ++i) {
+        out += fmt::format("[{:5}.{:06}] ", i / 100, (i * 7919) % 1000000);
+        switch (i % 4) {
+        case 0:
+            out += fmt::format("usb 1-{}: new high-speed USB device number {} "
+                               "using xhci_hcd\r\n", i % 8, i % 128);
+            break;
+        case 1:
+            out += fmt::format("EXT4-fs (mmcblk0p{}): mounted filesystem with "
+                               "ordered data mode. Quota mode: none.\r\n", i % 4);
+            break;
+        case 2:
+            out += fmt::format("systemd[1]: Started Journal Service "
+                               "(pid {}).\r\n", 100 + i);
+            break;
+        default:
+            out += fmt::format("eth0: link up, 1000Mbps, full-duplex, "
+                               "lpa 0x{:04x}\r\n", i & 0xffff);
+            break;
+        }
+    }
+    out.resize(size);
+    return out;
+}
+
+
+auto with_regexes() -> std::vector<smux::trigger>
+{
+    auto triggers = smux::default_triggers();
+    triggers.push_back(smux::parse_trigger("oom=Out of memory: Killed process [0-9]+"));
+    triggers.push_back(smux::parse_trigger("segfault=segfault at [0-9a-f]+ ip"));
+    triggers.push_back(smux::parse_trigger("bug=BUG: (unable to handle|soft lockup)"));
+    triggers.push_back(smux::parse_trigger("fs=EXT4-fs error \\(device \\w+\\)"));
+    return triggers;
+}
+
+
+/* Feeds the output in reads of `state.range(0)` bytes */
+auto feed(benchmark::State & state, std::vector<smux::trigger> triggers) -> void
+{
+    auto set = smux::trigger_set::compile(std::move(triggers));
+    if (!set) {
+        state.SkipWithError("the triggers did not compile");
+        return;
+    }
+
+    auto const output = console_output(1024 * 1024);
+    auto const read = static_cast<std::size_t>(state.range(0));
+    auto matcher = smux::trigger_matcher{*set.value};
+    for (auto _ : state) {
+        for (auto at = std::size_t{0}; at < output.size(); at += read) {
+            benchmark::DoNotOptimize(
+                matcher.feed(std::string_view{output}.substr(at, read)));
+        }
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations())
+            * static_cast<std::int64_t>(output.size()));
+}
+
+}
+
+
+static auto BM_TriggersDefault(benchmark::State & state) -> void
+{
+    feed(state, smux::default_triggers());
+}
+BENCHMARK(BM_TriggersDefault)->Arg(64)->Arg(4096);
+
+
+static auto BM_TriggersWithRegexes(benchmark::State & state) -> void
+{
+    feed(state, with_regexes());
+}
+BENCHMARK(BM_TriggersWithRegexes)->Arg(64)->Arg(4096);
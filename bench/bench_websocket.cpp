@@ -0,0 +1,149 @@
+#include "allocations.hpp"
+
+#include <apsn/http/timer_wheel.hpp>
+#include <apsn/http/websocket.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+
+
+namespace {
+
+struct bench_traits
+{
+    using shared_type = int;
+    using unique_type = int;
+};
+
+
+/* A websocket which only writes what it is sent */
+template <typename Traits, apsn::ws::transport Transport>
+class sink_handler
+    : public std::enable_shared_from_this<sink_handler<Traits, Transport>>
+    , public apsn::ws::websocket_handler<sink_handler, Traits, Transport>
+{
+    using base_type = apsn::ws::websocket_handler<sink_handler, Traits, Transport>;
+
+public:
+    using base_type::base_type;
+
+    template <typename Request>
+    auto handle_request(Request &) -> std::optional<apsn::http::response>
+    { return std::nullopt; }
+
+    auto handle_accept() -> void
+    {}
+
+    auto handle_message() -> void
+    {}
+};
+
+
+/**
+ * @brief A server websocket connected to a client over loopback
+ *
+ * The server side runs on a thread of its own, as it would in the server,
+ * and the client is read synchronously from the benchmark's thread.
+ */
+class loopback
+{
+public:
+    loopback()
+        : m_acceptor{m_server_ioc, {asio::ip::address_v4::loopback(), 0}}
+        , m_client{m_client_ioc}
+        , m_work{asio::make_work_guard(m_server_ioc)}
+    {
+        m_client.next_layer().connect(m_acceptor.local_endpoint());
+        auto socket = m_acceptor.accept();
+        socket.set_option(tcp::no_delay{true});
+
+        auto handshake = std::thread{[this] {
+            m_client.handshake("127.0.0.1", "/");
+        }};
+
+        auto buffer = beast::flat_buffer{};
+        auto req = beast::http::request<beast::http::string_body>{};
+        beast::http::read(socket, buffer, req);
+
+        m_server = std::make_shared<server_type>(
+                beast::tcp_stream{std::move(socket)},
+                std::make_shared<int>(0),
+                std::make_shared<int>(0),
+                std::make_shared<apsn::http::timer_wheel>(
+                    m_server_ioc.get_executor()));
+        m_server->run(std::move(req));
+
+        m_runner = std::thread{[this] {
+            bench::count_allocations();
+            m_server_ioc.run();
+        }};
+        handshake.join();
+    }
+
+    ~loopback()
+    {
+        m_work.reset();
+        m_server_ioc.stop();
+        m_runner.join();
+    }
+
+    auto server() -> std::ostream &
+    { return m_server->ostream(); }
+
+    auto read() -> std::size_t
+    {
+        auto size = m_client.read(m_buffer);
+        m_buffer.consume(size);
+        return size;
+    }
+
+private:
+    asio::io_context m_server_ioc;
+    asio::io_context m_client_ioc;
+    tcp::acceptor m_acceptor;
+    websocket::stream<tcp::socket> m_client;
+    asio::executor_work_guard<asio::io_context::executor_type> m_work;
+    using server_type = sink_handler<bench_traits, apsn::ws::transport::tcp>;
+
+    std::shared_ptr<server_type> m_server;
+    std::thread m_runner;
+    beast::flat_buffer m_buffer;
+};
+
+}
+
+
+/* Messages sent through the websocket's queue and read by a client, in
+   bursts, as serial output arrives */
+static auto BM_WebsocketSend(benchmark::State & state) -> void
+{
+    constexpr auto burst = 64;
+    auto const message = std::string(
+            static_cast<std::size_t>(state.range(0)), 'x');
+    auto ws = loopback{};
+
+    auto const before = bench::allocations();
+    for (auto _ : state) {
+        for (auto ii = 0; ii < burst; ++ii) {
+            ws.server().write(message.data(),
+                    static_cast<std::streamsize>(message.size()));
+        }
+        for (auto ii = 0; ii < burst; ++ii) {
+            benchmark::DoNotOptimize(ws.read());
+        }
+    }
+    state.counters["allocs_per_message"] = benchmark::Counter(
+            static_cast<double>(bench::allocations() - before) / burst,
+            benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * burst);
+    state.SetBytesProcessed(static_cast<std::int64_t>(
+            state.iterations() * burst * message.size()));
+}
+BENCHMARK(BM_WebsocketSend)->Arg(16)->Arg(256)->Arg(4096)->UseRealTime();
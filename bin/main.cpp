@@ -4,17 +4,29 @@
 #include "serial.hpp"
 #include "context.hpp"
 #include "cli_handler.hpp"
-
+#include "handoff.hpp"
+#include "port_server.hpp"
+#include "script.hpp"
+#include "strings.hpp"
+#include "triggers.hpp"
+
+#include <apsn/async_logger.hpp>
+#include <apsn/binary_logger.hpp>
 #include <apsn/logging.hpp>
+#include <apsn/metrics.hpp>
 #include <apsn/result.hpp>
+#include <apsn/thread.hpp>
 #include <apsn/utility.hpp>
 
+#include <apsn/http/credentials.hpp>
 #include <apsn/http/handlers.hpp>
 #include <apsn/http/headers.hpp>
+#include <apsn/http/inherited.hpp>
 #include <apsn/http/middleware.hpp>
 #include <apsn/http/listener.hpp>
 #include <apsn/http/router.hpp>
 #include <apsn/http/ssl.hpp>
+#include <apsn/http/timer_wheel.hpp>
 
 
 #include <apsn/http/request.hpp>
@@ -26,9 +38,22 @@
 #include <boost/beast.hpp>
 #include <nlohmann/json.hpp>
 
+#include <charconv>
+#include <chrono>
+#include <cstring>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <grp.h>
+#include <unistd.h>
 
 
 namespace asio = boost::asio;
@@ -63,8 +88,23 @@ auto main(int argc, char const * argv[]) -> int
     auto opts = get_options(argc, argv);
 
 
-    apsn::log::get_logger().threshold(opts.log_level);
-    apsn::log::get_logger().name("webserial");
+    /* Output happens on a background thread, so that logging does not hold
+       up serial traffic. Binary messages still reach the file unformatted. */
+    if (opts.binary_log) {
+        auto logger = std::make_shared<apsn::log::binary_logger>(
+                *opts.binary_log, "webserial", opts.log_level);
+        if (!logger->is_open()) {
+            apsn::log::fatal("Could not open log file {}",
+                    opts.binary_log->string());
+            return 1;
+        }
+        apsn::log::make_logger<apsn::log::async_logger>(std::move(logger));
+    }
+    else {
+        apsn::log::make_logger<apsn::log::async_logger>(
+            std::make_shared<apsn::log::coloured_cli_logger>(
+                "webserial", opts.log_level));
+    }
     apsn::log::info("Root: {}", opts.root.string());
 
     auto shared = std::make_shared<smux::context>();
@@ -81,6 +121,30 @@ auto main(int argc, char const * argv[]) -> int
         }
     }
 
+    /* Before anything listens, so that sockets handed over are used rather
+       than bound again */
+    if (opts.upgrade_socket) {
+        auto handed = smux::handoff::take_over(*opts.upgrade_socket);
+        if (handed) {
+            apsn::log::info("Took over {} listeners and {} ports",
+                    handed->listeners.size(), handed->ports.size());
+            for (auto fd : handed->listeners) {
+                apsn::http::inherited().add(fd);
+            }
+            smux::handoff::restore_ports(*shared, std::move(handed->ports));
+        }
+        else if (handed.error == std::errc::no_such_file_or_directory
+            || handed.error == std::errc::connection_refused)
+        {
+            apsn::log::info("No server to take over from on {}",
+                    opts.upgrade_socket->string());
+        }
+        else {
+            apsn::log::warn("Could not take over from {}: {}",
+                    opts.upgrade_socket->string(), handed.error_message());
+        }
+    }
+
     auto root = opts.root;
     auto address = ip::make_address(opts.host);
     auto endpoint = tcp::endpoint{address, opts.port};
@@ -91,10 +155,129 @@ auto main(int argc, char const * argv[]) -> int
         return 1;
     }
 
-    auto digest = [&](auto next) {
+    shared->trace_latency = opts.trace_latency;
+
+    auto triggers = smux::default_triggers();
+    for (auto const & spec : opts.triggers) {
+        triggers.push_back(smux::parse_trigger(spec));
+    }
+    auto trigger_set = smux::trigger_set::compile(std::move(triggers));
+    if (!trigger_set) {
+        apsn::log::error("Could not compile triggers: {}",
+                trigger_set.error_message());
+        return 1;
+    }
+    shared->triggers.set = *trigger_set.value;
+
+    for (auto const & spec : opts.port_groups) {
+        auto eq = spec.find('=');
+        auto name = spec.substr(0, eq);
+        auto members = std::vector<std::size_t>{};
+        auto ec = std::error_code{smux::error::bad_value};
+        if (eq != std::string::npos) {
+            auto lock = shared->ports.lock();
+            for (auto const & member : smux::split(spec.substr(eq + 1), ',')) {
+                auto port_id = shared->ports.find_port(member);
+                if (!port_id) {
+                    apsn::log::error("Port group '{}': no port '{}'", name, member);
+                    return 1;
+                }
+                members.push_back(*port_id);
+            }
+            ec = shared->ports.set_group(name, std::move(members));
+        }
+        if (ec) {
+            apsn::log::error("Invalid port group '{}': {}", spec, ec.message());
+            return 1;
+        }
+    }
+
+    auto use_ssl = opts.key_path && opts.cert_path;
+    if (opts.session_lifetime > 0) {
+        shared->tokens = std::make_shared<apsn::http::session_tokens>(
+                std::chrono::minutes{opts.session_lifetime},
+                use_ssl);
+    }
+
+    auto ssl_ctx = std::shared_ptr<asio::ssl::context>{};
+    if (use_ssl) {
+        auto tls = apsn::ssl::tls_options{};
+        tls.session_cache_size = opts.tls_session_cache;
+        tls.ticket_rotation = std::chrono::minutes{opts.tls_ticket_rotation};
+        ssl_ctx = apsn::ssl::make_context(
+                *opts.cert_path,
+                *opts.key_path,
+                opts.dh_path,
+                tls);
+        if (!ssl_ctx) {
+            apsn::log::fatal("Could not create SSL context");
+            return 1;
+        }
+    }
+
+    /* Connections, and so TLS handshakes and digest checks, are served by
+       `net`. Serial ports stay on `shared->ioc`, which is run by the main
+       thread alone. With --reuse-port, each network thread has a context
+       and a listener of its own; otherwise they share one of each. */
+    using apsn::http::acceptor_mode;
+    auto const mode = opts.reuse_port
+        ? acceptor_mode::sharded
+        : acceptor_mode::single;
+    auto net = std::vector<std::unique_ptr<asio::io_context>>{};
+    if (mode == acceptor_mode::sharded) {
+        for (auto ii = 0u; ii < opts.network_threads; ++ii) {
+            net.push_back(std::make_unique<asio::io_context>(1));
+        }
+    }
+    else {
+        net.push_back(std::make_unique<asio::io_context>(
+                static_cast<int>(opts.network_threads)));
+    }
+
+    /* Every connection's deadlines, on one timer */
+    auto timers = std::make_shared<apsn::http::timer_wheel>(
+            asio::make_strand(*net.front()),
+            apsn::http::connection_timeouts{
+                std::chrono::seconds{opts.handshake_timeout},
+                std::chrono::seconds{opts.idle_timeout},
+                std::chrono::seconds{opts.websocket_timeout}});
+    timers->run();
+
+    /* A password file of `user:$scrypt$...` lines selects Basic
+       authentication against scrypt hashes. Anything else is taken to be the
+       HA1 written by `wspasswd --scheme digest`. Key derivation runs on its
+       own threads so that logins never hold up the IO context, and the
+       verifier turns clients away with a 503 once too many wait for them. */
+    auto kdf_pool = asio::thread_pool{2};
+    auto verifier = std::shared_ptr<apsn::http::credential_verifier>{};
+    if (auto users = apsn::http::password_db::parse(*pass);
+        users && users->size() > 0)
+    {
+        apsn::log::info("Loaded {} user(s) with scrypt hashes", users->size());
+        if (!use_ssl) {
+            apsn::log::warn("Basic authentication without TLS sends "
+                            "passwords in the clear");
+        }
+        verifier = std::make_shared<apsn::http::credential_verifier>(
+                std::move(*users),
+                kdf_pool.get_executor());
+    }
+
+    auto nonces = std::make_shared<apsn::http::nonce_cache>();
+    auto digest = [&](auto next) -> std::shared_ptr<
+            apsn::http::middleware::base<server_traits>> {
+            if (verifier) {
+                return apsn::http::middleware::basic_auth<server_traits>(
+                    "webserial"s,
+                    verifier,
+                    shared->tokens,
+                    next);
+            }
             return apsn::http::middleware::digest_auth<server_traits>(
                 "webserial"s,
                 *pass,
+                nonces,
+                shared->tokens,
                 next);
         };
 
@@ -129,49 +312,573 @@ auto main(int argc, char const * argv[]) -> int
             return nlohmann::json{{"pi", 3.14}};
         });
 
-    handler->get("/logout", router_match::exact, 
+    /* The JSON API, behind whatever authenticates its listener's clients */
+    auto add_api = [&](router<server_traits> & routes, auto authenticate) {
+        /* Output as JSON, a line at a time */
+        auto lines = [](std::string const & output) {
+            auto result = nlohmann::json::array();
+            for (auto const & line : smux::split(output, '\n')) {
+                result.push_back(smux::printable(line));
+            }
+            return result;
+        };
+
+        routes.get("/api/ports/{id}", router_match::exact,
+            authenticate(
+                [](auto & req) -> nlohmann::json {
+                    auto id = std::size_t{0};
+                    auto value = *req.param("id");
+                    auto [end, ec] = std::from_chars(
+                            value.data(), value.data() + value.size(), id);
+                    if (ec != std::errc{} || end != value.data() + value.size()) {
+                        return {{"error", "Invalid port ID"}};
+                    }
+
+                    auto & ports = req.shared()->ports;
+                    auto lock = ports.lock();
+                    auto port = ports.get_port(id);
+                    if (!port) {
+                        return {{"error", port.error_message()}};
+                    }
+                    return {
+                        {"id", id},
+                        {"device", port->device},
+                        {"speed", port->options.baud_rate.value()},
+                        {"flow_control", smux::to_string(port->options.flow_control)},
+                        {"parity", smux::to_string(port->options.parity)},
+                        {"stop_bits", smux::to_string(port->options.stop_bits)},
+                        {"character_size", port->options.character_size.value()},
+                        {"in_use", port->in_use}
+                    };
+                }));
+
+        /* Console lines matching a trigger, after the `since` sequence
+           number given by the previous call's `next` */
+        routes.get("/api/triggers", router_match::exact,
+            authenticate(
+                [](auto & req) -> nlohmann::json {
+                    auto since = std::uint64_t{0};
+                    if (auto value = req.query("since")) {
+                        auto [end, ec] = std::from_chars(
+                                value->data(), value->data() + value->size(), since);
+                        if (ec != std::errc{} || end != value->data() + value->size()) {
+                            return {{"error", "Invalid sequence number"}};
+                        }
+                    }
+
+                    auto const & triggers = req.shared()->triggers;
+                    auto patterns = nlohmann::json::array();
+                    for (auto id = std::size_t{0}; id < triggers.set->size(); ++id) {
+                        patterns.push_back({
+                            {"name", triggers.set->name(id)},
+                            {"pattern", triggers.set->pattern(id)},
+                            {"literal", triggers.set->literal(id)}
+                        });
+                    }
+
+                    auto events = nlohmann::json::array();
+                    auto next = since;
+                    for (auto const & ev : triggers.since(since)) {
+                        events.push_back({
+                            {"seq", ev.seq},
+                            {"time", std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    ev.time.time_since_epoch()).count()},
+                            {"port", ev.device},
+                            {"trigger", ev.trigger},
+                            {"line", ev.line}
+                        });
+                        next = ev.seq;
+                    }
+                    return {
+                        {"triggers", patterns},
+                        {"events", events},
+                        {"next", next}
+                    };
+                }));
+
+        /* Send and expect steps, run against a port while the client polls
+           for the result */
+        routes.post("/api/ports/{id}/script", router_match::exact,
+            authenticate(
+                [](auto & req) -> nlohmann::json {
+                    auto id = std::size_t{0};
+                    auto value = *req.param("id");
+                    auto [end, ec] = std::from_chars(
+                            value.data(), value.data() + value.size(), id);
+                    if (ec != std::errc{} || end != value.data() + value.size()) {
+                        return {{"error", "Invalid port ID"}};
+                    }
+
+                    auto body = req.string_body();
+                    auto script = smux::script::parse(
+                            body ? std::string_view{body->get()} : ""sv);
+                    if (!script) {
+                        return {{"error", script.error_message()}};
+                    }
+                    auto job = smux::run_script(req.shared(), id,
+                            std::move(*script.value));
+                    if (!job) {
+                        return {{"error", job.error_message()}};
+                    }
+                    return {
+                        {"id", *job},
+                        {"state", smux::to_string(smux::script_state::running)}
+                    };
+                }));
+
+        routes.get("/api/scripts/{id}", router_match::exact,
+            authenticate(
+                [lines](auto & req) -> nlohmann::json {
+                    auto id = std::size_t{0};
+                    auto value = *req.param("id");
+                    auto [end, ec] = std::from_chars(
+                            value.data(), value.data() + value.size(), id);
+                    if (ec != std::errc{} || end != value.data() + value.size()) {
+                        return {{"error", "Invalid script ID"}};
+                    }
+
+                    auto job = req.shared()->scripts.get(id);
+                    if (!job) {
+                        return {{"error", "Script not found"}};
+                    }
+
+                    auto finished = nlohmann::json::array();
+                    for (auto at : job->finished) {
+                        finished.push_back(at.count());
+                    }
+                    auto result = nlohmann::json{
+                        {"id", job->id},
+                        {"port", job->port_id},
+                        {"device", job->device},
+                        {"state", smux::to_string(job->state)},
+                        {"step", job->step},
+                        {"steps", job->steps},
+                        {"finished_ms", finished},
+                        {"transcript", lines(job->transcript)},
+                        {"truncated", job->truncated}
+                    };
+                    if (!job->error.empty()) {
+                        result["error"] = job->error;
+                    }
+                    return result;
+                }));
+
+        routes.get("/api/groups", router_match::exact,
+            authenticate(
+                [](auto & req) -> nlohmann::json {
+                    auto & ports = req.shared()->ports;
+                    auto lock = ports.lock();
+                    return {{"groups", ports.groups}};
+                }));
+
+        /* `{"ports": [...]}`, each an ID or a device; none removes the group */
+        routes.post("/api/groups/{name}", router_match::exact,
+            authenticate(
+                [](auto & req) -> nlohmann::json {
+                    auto name = std::string{*req.param("name")};
+                    auto body = req.string_body();
+                    auto parsed = nlohmann::json::parse(
+                            body ? std::string_view{body->get()} : ""sv,
+                            nullptr, false);
+                    auto members = parsed.is_object()
+                        ? parsed.find("ports")
+                        : parsed.end();
+                    if (members == parsed.end() || !members->is_array()) {
+                        return {{"error", "Expected a list of ports"}};
+                    }
+
+                    auto & ports = req.shared()->ports;
+                    auto lock = ports.lock();
+                    auto port_ids = std::vector<std::size_t>{};
+                    for (auto const & member : *members) {
+                        auto spec = member.is_string()
+                            ? member.template get<std::string>()
+                            : member.dump();
+                        auto port_id = ports.find_port(spec);
+                        if (!port_id) {
+                            return {{"error", fmt::format("No port '{}'", spec)}};
+                        }
+                        port_ids.push_back(*port_id);
+                    }
+                    if (auto ec = ports.set_group(name, std::move(port_ids))) {
+                        return {{"error", ec.message()}};
+                    }
+                    auto group = ports.get_group(name);
+                    return {
+                        {"name", name},
+                        {"ports", group ? *group : std::vector<std::size_t>{}}
+                    };
+                }));
+
+        /* The same input to every port in the group at once, then what
+           each port printed, collected from `/api/broadcasts/{id}` */
+        routes.post("/api/groups/{name}/broadcast", router_match::exact,
+            authenticate(
+                [](auto & req) -> nlohmann::json {
+                    auto body = req.string_body();
+                    auto script = smux::script::parse_broadcast(
+                            body ? std::string_view{body->get()} : ""sv);
+                    if (!script) {
+                        return {{"error", script.error_message()}};
+                    }
+                    auto id = smux::run_broadcast(req.shared(),
+                            std::string{*req.param("name")},
+                            *script.value);
+                    if (!id) {
+                        return {{"error", id.error_message()}};
+                    }
+                    return {{"id", *id}};
+                }));
+
+        routes.get("/api/broadcasts/{id}", router_match::exact,
+            authenticate(
+                [lines](auto & req) -> nlohmann::json {
+                    auto id = std::size_t{0};
+                    auto value = *req.param("id");
+                    auto [end, ec] = std::from_chars(
+                            value.data(), value.data() + value.size(), id);
+                    if (ec != std::errc{} || end != value.data() + value.size()) {
+                        return {{"error", "Invalid broadcast ID"}};
+                    }
+
+                    auto & scripts = req.shared()->scripts;
+                    auto broadcast = scripts.get_broadcast(id);
+                    if (!broadcast) {
+                        return {{"error", "Broadcast not found"}};
+                    }
+
+                    auto running = false;
+                    auto members = nlohmann::json::array();
+                    for (auto const & member : broadcast->members) {
+                        auto entry = nlohmann::json{{"port", member.port_id}};
+                        auto job = member.job
+                            ? scripts.get(*member.job)
+                            : std::nullopt;
+                        if (job) {
+                            running |= job->state == smux::script_state::running;
+                            entry["device"] = job->device;
+                            entry["state"] = smux::to_string(job->state);
+                            entry["output"] = lines(job->transcript);
+                            entry["truncated"] = job->truncated;
+                            if (!job->error.empty()) {
+                                entry["error"] = job->error;
+                            }
+                        }
+                        else {
+                            entry["state"] = "error";
+                            entry["error"] = member.job
+                                ? "No longer kept"s
+                                : member.error;
+                        }
+                        members.push_back(std::move(entry));
+                    }
+                    return {
+                        {"id", broadcast->id},
+                        {"group", broadcast->group},
+                        {"state", running ? "running" : "done"},
+                        {"ports", members}
+                    };
+                }));
+
+        routes.get("/stats/tls", router_match::exact,
+            authenticate(
+                [&](auto &) -> nlohmann::json {
+                    if (!ssl_ctx) {
+                        return {{"enabled", false}};
+                    }
+                    auto stats = apsn::ssl::stats(*ssl_ctx);
+                    return {
+                        {"enabled", true},
+                        {"handshakes", stats.handshakes},
+                        {"failed", stats.failed},
+                        {"resumed", stats.resumed},
+                        {"resumption_ratio", stats.resumption_ratio()},
+                        {"session_cache", {
+                            {"size", stats.cached},
+                            {"misses", stats.cache_misses},
+                            {"timeouts", stats.cache_timeouts},
+                            {"full", stats.cache_full}
+                        }},
+                        {"tickets", {
+                            {"issued", stats.tickets_issued},
+                            {"renewed", stats.tickets_renewed},
+                            {"unknown", stats.tickets_unknown}
+                        }}
+                    };
+                }));
+
+        routes.get("/stats/latency", router_match::exact,
+            authenticate(
+                [shared](auto &) -> nlohmann::json {
+                    auto summarise = [](apsn::latency_histogram const & hist) {
+                        auto summary = hist.snapshot();
+                        return nlohmann::json{
+                            {"count", summary.count},
+                            {"mean_us", summary.mean().count()},
+                            {"p50_us", summary.percentile(0.5).count()},
+                            {"p99_us", summary.percentile(0.99).count()},
+                            {"max_us", summary.max().count()}
+                        };
+                    };
+                    return {
+                        {"tls_handshake", summarise(apsn::http::handshake_latency())},
+                        {"serial_forward", summarise(shared->serial_forward)}
+                    };
+                }));
+
+        routes.get("/metrics", router_match::exact,
+            authenticate(
+                [](auto & req) -> apsn::http::response {
+                    namespace http = boost::beast::http;
+                    auto res = http::response<http::string_body>{
+                            http::status::ok, req.version()};
+                    res.set(http::field::content_type,
+                            "text/plain; version=0.0.4; charset=utf-8");
+                    res.body() = apsn::metrics::default_registry().render();
+                    res.prepare_payload();
+                    res.keep_alive(req.keep_alive());
+                    return res;
+                }));
+    };
+    add_api(*handler, digest);
+
+    handler->get("/logout", router_match::exact,
         ncsa_logger(
             [&](auto & req){
-                return apsn::http::unauthorised(req, opts.root / "pages/loggedout.html");
+                auto res = apsn::http::unauthorised(req,
+                        opts.root / "pages/loggedout.html");
+                if (shared->tokens) {
+                    res.insert(field::set_cookie, shared->tokens->clear_cookie());
+                }
+                return res;
             }));
 
 
-    if (opts.key_path && opts.cert_path && opts.dh_path) {
-        auto ssl_ctx = apsn::ssl::make_context(
-                *opts.cert_path,
-                *opts.key_path,
-                *opts.dh_path);
-        if (!ssl_ctx) {
-            apsn::log::fatal("Could not create SSL context");
-            return 1;
+    /* Every listening socket, with how to stop accepting on it, for
+       handing over on upgrade */
+    auto listening = std::vector<std::pair<int, std::function<void()>>>{};
+    auto keep = [&](auto listener) {
+        if (auto fd = listener->native_handle(); fd >= 0) {
+            listening.emplace_back(fd, [listener] { listener->close(); });
+        }
+        listener->run();
+    };
+
+    for (auto & ctx : net) {
+        if (use_ssl) {
+            keep(std::make_shared<apsn::http::ssl_listener<server_traits>>(
+                    *ctx,
+                    endpoint,
+                    ssl_ctx,
+                    shared,
+                    handler,
+                    timers,
+                    mode
+                ));
+        }
+        else {
+            keep(std::make_shared<apsn::http::listener<server_traits>>(
+                    *ctx,
+                    endpoint,
+                    shared,
+                    handler,
+                    timers,
+                    mode
+                ));
         }
-        std::make_shared<apsn::http::ssl_listener<server_traits>>(
-                shared->ioc,
-                endpoint,
-                ssl_ctx,
-                shared,
-                handler
-            )->run();
     }
-    else {
-        std::make_shared<apsn::http::listener<server_traits>>(
-                shared->ioc,
-                endpoint,
+    apsn::log::info("Listening on {}:{}{}", opts.host, opts.port,
+            mode == acceptor_mode::sharded
+                ? fmt::format(" with {} acceptors", net.size())
+                : std::string{});
+
+    /* Ports found at start-up, each on a TCP port of its own */
+    auto port_address = ip::make_address(opts.port_host);
+    auto serve_ports = [&](std::uint16_t base, smux::port_protocol protocol) {
+        auto lock = shared->ports.lock();
+        for (auto const & [id, port] : shared->ports.ports) {
+            if (base + id > std::numeric_limits<std::uint16_t>::max()) {
+                apsn::log::fatal("No TCP port for {}: {} + {} is past {}",
+                        port.device, base, id,
+                        std::numeric_limits<std::uint16_t>::max());
+                return false;
+            }
+            auto tcp_port = static_cast<std::uint16_t>(base + id);
+            auto listener = std::make_shared<smux::port_listener>(shared,
+                    tcp::endpoint{port_address, tcp_port},
+                    protocol,
+                    id);
+            if (!listener->is_open()) {
+                apsn::log::error("Not serving {} over {} on {}:{}", port.device,
+                        smux::to_string(protocol), opts.port_host, tcp_port);
+                continue;
+            }
+            keep(listener);
+            apsn::log::info("Serving {} over {} on {}:{}", port.device,
+                    smux::to_string(protocol), opts.port_host, tcp_port);
+        }
+        return true;
+    };
+    if (opts.raw_base && !serve_ports(*opts.raw_base, smux::port_protocol::raw)) {
+        return 1;
+    }
+    if (opts.rfc2217_base
+            && !serve_ports(*opts.rfc2217_base, smux::port_protocol::rfc2217))
+    {
+        return 1;
+    }
+    if (opts.port_select) {
+        keep(std::make_shared<smux::port_listener>(shared,
+                tcp::endpoint{port_address, *opts.port_select},
+                smux::port_protocol::raw));
+        apsn::log::info("Serving ports by ID on {}:{}",
+                opts.port_host, *opts.port_select);
+    }
+
+
+    /* Local tools get the API and the websocket over a Unix socket. The
+       kernel vouches for who they are, so there is no TLS or password. */
+    if (opts.unix_socket) {
+        auto group = std::optional<gid_t>{};
+        if (opts.unix_group) {
+            auto const * entry = ::getgrnam(opts.unix_group->c_str());
+            if (!entry) {
+                apsn::log::fatal("Unknown group '{}'", *opts.unix_group);
+                return 1;
+            }
+            group = entry->gr_gid;
+        }
+
+        auto local_handler = std::make_shared<router<server_traits>>(shared);
+        add_api(*local_handler, ncsa_logger);
+        local_handler->get("/", router_match::exact,
+            ncsa_logger(
+                [](auto &) {
+                    return nlohmann::json{{"server", "webserial"}};
+                }));
+
+        auto owner = ::geteuid();
+        auto authorise = [owner, group](apsn::http::peer_credentials const & peer) {
+            return peer.uid == 0
+                || peer.uid == owner
+                || (group && peer.in_group(*group));
+        };
+        auto permissions = fs::perms::owner_read | fs::perms::owner_write;
+        if (group) {
+            permissions |= fs::perms::group_read | fs::perms::group_write;
+        }
+
+        auto local = std::make_shared<apsn::http::local_listener<server_traits>>(
+                *net.front(),
+                *opts.unix_socket,
+                permissions,
+                authorise,
                 shared,
-                handler
-            )->run();
+                local_handler,
+                timers);
+        if (!local->is_open()) {
+            return 1;
+        }
+        if (group && ::chown(opts.unix_socket->c_str(), static_cast<uid_t>(-1),
+                    *group) != 0)
+        {
+            apsn::log::warn("Could not give {} to group '{}': {}",
+                    opts.unix_socket->string(), *opts.unix_group,
+                    std::strerror(errno));
+        }
+        keep(local);
+        apsn::log::info("Listening on {}", opts.unix_socket->string());
+    }
+
+    if (auto unclaimed = apsn::http::inherited().close_unclaimed()) {
+        apsn::log::warn("Closed {} sockets handed over but no longer listened on",
+                unclaimed);
     }
-    apsn::log::info("Listening on {}:{}", opts.host, opts.port);
 
 
+    auto stop = [shared, &net] {
+        apsn::log::debug("Stopping IO contexts");
+        for (auto & ctx : net) {
+            ctx->stop();
+        }
+        shared->ioc.stop();
+    };
+
     asio::signal_set signals(shared->ioc, SIGINT, SIGTERM);
     signals.async_wait(
-        [shared](sys::error_code const&, int) {
-            apsn::log::debug("Stopping IO context");
-            shared->ioc.stop();
+        [&stop](sys::error_code const&, int) {
+            stop();
+        });
+
+
+    /* Once handed over, stop accepting and wait for those connected to
+       leave; browsers reconnect to the new server */
+    auto drain_timer = asio::steady_timer{shared->ioc};
+    auto drain_until = std::chrono::steady_clock::time_point{};
+    auto drain = std::function<void()>{};
+    drain = [&] {
+        auto connected = std::size_t{0};
+        {
+            auto lock = shared->sessions.lock();
+            connected = shared->sessions.sessions.size();
+        }
+        if (connected == 0) {
+            return stop();
+        }
+        if (std::chrono::steady_clock::now() >= drain_until) {
+            apsn::log::warn("Stopping with {} sessions still connected",
+                    connected);
+            return stop();
+        }
+        drain_timer.expires_after(std::chrono::milliseconds{100});
+        drain_timer.async_wait([&](sys::error_code ec) {
+            if (!ec) {
+                drain();
+            }
         });
+    };
 
+    if (opts.upgrade_socket) {
+        auto upgrades = std::make_shared<smux::handoff::server>(shared,
+                *opts.upgrade_socket,
+                [&] {
+                    auto fds = std::vector<int>{};
+                    for (auto const & [fd, close] : listening) {
+                        fds.push_back(fd);
+                    }
+                    return fds;
+                },
+                [&] {
+                    for (auto const & [fd, close] : listening) {
+                        close();
+                    }
+                    shared->sessions.cancel_all();
+                    drain_until = std::chrono::steady_clock::now()
+                        + std::chrono::seconds{opts.drain_timeout};
+                    drain();
+                });
+        upgrades->run();
+        if (upgrades->is_open()) {
+            apsn::log::info("Waiting for upgrades on {}",
+                    opts.upgrade_socket->string());
+        }
+    }
 
+    auto serial_work = asio::make_work_guard(shared->ioc);
+    auto net_threads = std::vector<std::thread>{};
+    for (auto ii = 0u; ii < opts.network_threads; ++ii) {
+        net_threads.emplace_back([&ctx = *net[ii % net.size()], ii] {
+            apsn::this_thread::set_name(fmt::format("net-{}", ii));
+            ctx.run();
+        });
+    }
+
+    apsn::this_thread::set_name("serial");
     shared->ioc.run();
 
+    for (auto & thread : net_threads) {
+        thread.join();
+    }
+    kdf_pool.stop();
+    kdf_pool.join();
 }
\ No newline at end of file
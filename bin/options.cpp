@@ -4,6 +4,7 @@
 
 #include <boost/program_options.hpp>
 
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <iostream>
@@ -14,6 +15,21 @@ namespace po = boost::program_options;
 namespace fs = std::filesystem;
 
 
+namespace {
+
+/* Rejects 0 for options where it would mean nothing could ever happen */
+auto nonzero(char const * name)
+{
+    return [name](unsigned value) {
+        if (value == 0) {
+            throw po::validation_error(
+                po::validation_error::invalid_option_value, name, "0");
+        }
+    };
+}
+
+}
+
 
 auto get_options(int argc, char const * argv[]) -> options
 {
@@ -37,18 +53,71 @@ auto get_options(int argc, char const * argv[]) -> options
                 [&](auto cert_path){
                     opts.cert_path = fs::canonical(cert_path);
                 }
-        ), "Path to certificate. Must be supplied alongside the --key-path, --dh-path options")
+        ), "Path to certificate. Must be supplied alongside the --key-path option")
         ("key-path", po::value<fs::path>()->notifier(
                 [&](auto key_path){
                     opts.key_path = fs::canonical(key_path);
                 }
-        ), "Path to certificate private key. Must be supplied alingside the --cert-path, --dh-path options")
+        ), "Path to certificate private key. Must be supplied alongside the --cert-path option")
         ("dh-path", po::value<fs::path>()->notifier(
                 [&](auto dh_path){
                     opts.dh_path = fs::canonical(dh_path);
                 }
-        ), "Path to Diffie-Helmann parameters. Must be supplied alingside the --cert-path, --key-path options")
-        ("log-level,l", po::value<apsn::log::level>(&opts.log_level), "Log level");
+        ), "Path to Diffie-Helmann parameters. Optional; enables DHE cipher suites for clients without ECDHE")
+        ("session-lifetime", po::value<unsigned>(&opts.session_lifetime),
+            "Minutes a session cookie remains valid after login. 0 disables session cookies")
+        ("tls-session-cache", po::value<std::size_t>(&opts.tls_session_cache),
+            "Number of TLS sessions cached for resumption. 0 disables the cache")
+        ("tls-ticket-rotation", po::value<unsigned>(&opts.tls_ticket_rotation),
+            "Minutes between TLS session ticket key rotations. 0 disables session tickets")
+        ("network-threads", po::value<unsigned>(&opts.network_threads)
+                ->notifier(nonzero("network-threads")),
+            "Threads serving HTTP, TLS and websockets. Serial ports are always served by their own thread")
+        ("reuse-port", po::bool_switch(&opts.reuse_port),
+            "Give each network thread its own SO_REUSEPORT listener, so that the kernel spreads connections between them")
+        ("handshake-timeout", po::value<unsigned>(&opts.handshake_timeout)
+                ->notifier(nonzero("handshake-timeout")),
+            "Seconds allowed for a TLS handshake or websocket upgrade")
+        ("idle-timeout", po::value<unsigned>(&opts.idle_timeout)
+                ->notifier(nonzero("idle-timeout")),
+            "Seconds allowed to receive a request and send its response, including between requests on a kept alive connection")
+        ("websocket-timeout", po::value<unsigned>(&opts.websocket_timeout)
+                ->notifier(nonzero("websocket-timeout")),
+            "Seconds a websocket may go without hearing from its browser. Quiet browsers are pinged half way")
+        ("trace-latency", po::bool_switch(&opts.trace_latency),
+            "Record per-port serial forwarding latency and browser round trip times in /metrics")
+        ("port-host", po::value<std::string>(&opts.port_host),
+            "Address for the raw and RFC 2217 port listeners. These have no authentication")
+        ("raw-base", po::value<std::uint16_t>()->notifier(
+                [&](auto base){ opts.raw_base = base; }),
+            "Serve each serial port as a raw TCP stream on this port plus the port's ID")
+        ("rfc2217-base", po::value<std::uint16_t>()->notifier(
+                [&](auto base){ opts.rfc2217_base = base; }),
+            "Serve each serial port over RFC 2217 (Telnet COM port control) on this port plus the port's ID")
+        ("port-select", po::value<std::uint16_t>()->notifier(
+                [&](auto port){ opts.port_select = port; }),
+            "Serve raw TCP streams on this port, to clients which first send a port ID and a newline")
+        ("unix-socket", po::value<fs::path>()->notifier(
+                [&](auto path){ opts.unix_socket = fs::weakly_canonical(path); }),
+            "Also serve the API and websocket on this Unix domain socket, to local users allowed by --unix-group, without TLS or passwords")
+        ("unix-group", po::value<std::string>()->notifier(
+                [&](auto group){ opts.unix_group = group; }),
+            "Members of this group may use --unix-socket. Without it, only the server's own user and root may")
+        ("upgrade-socket", po::value<fs::path>()->notifier(
+                [&](auto path){ opts.upgrade_socket = fs::weakly_canonical(path); }),
+            "Take over listening sockets and open serial ports from the server waiting on this Unix socket, if there is one, then wait on it for the next upgrade")
+        ("drain-timeout", po::value<unsigned>(&opts.drain_timeout),
+            "Seconds to wait for connections to close after handing over to an upgrade, before stopping")
+        ("trigger", po::value<std::vector<std::string>>(&opts.triggers)->composing(),
+            "Report console lines matching this regular expression, given as name=regex, at /api/triggers. May be repeated; kernel panics and call traces are always reported")
+        ("port-group", po::value<std::vector<std::string>>(&opts.port_groups)->composing(),
+            "Name a group of ports to broadcast to, as name=port,port,..., each port given by its ID or device. May be repeated")
+        ("log-level,l", po::value<apsn::log::level>(&opts.log_level), "Log level")
+        ("binary-log", po::value<fs::path>()->notifier(
+                [&](auto binary_log){
+                    opts.binary_log = fs::weakly_canonical(binary_log);
+                }
+        ), "Write the log to this file in binary form, instead of to the console. Read it with wslogdump");
     
     auto vars = po::variables_map{};
 
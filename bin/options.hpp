@@ -3,10 +3,12 @@
 #include <apsn/logging.hpp>
 
 
+#include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -19,15 +21,60 @@ struct options
         , port{8080}
         , log_level{apsn::log::level::info}
         , root{fs::current_path()}
+        , session_lifetime{480}
+        , tls_session_cache{1024}
+        , tls_ticket_rotation{720}
+        , network_threads{2}
+        , reuse_port{false}
+        , handshake_timeout{30}
+        , idle_timeout{30}
+        , websocket_timeout{300}
+        , trace_latency{false}
+        , port_host{"127.0.0.1"}
+        , drain_timeout{10}
     {}
     std::string host;
     fs::path pass;
     std::uint16_t port;
     apsn::log::level log_level;
+    std::optional<fs::path> binary_log;
     fs::path root;
     std::optional<fs::path> cert_path;
     std::optional<fs::path> key_path;
     std::optional<fs::path> dh_path;
+    unsigned session_lifetime;
+    std::size_t tls_session_cache;
+    unsigned tls_ticket_rotation;
+    unsigned network_threads;
+    bool reuse_port;
+
+    /* Seconds a connection may stall before it is closed */
+    unsigned handshake_timeout;
+    unsigned idle_timeout;
+    unsigned websocket_timeout;
+
+    bool trace_latency;
+
+    /* Serial ports served over plain TCP, without the web UI */
+    std::string port_host;
+    std::optional<std::uint16_t> raw_base;
+    std::optional<std::uint16_t> rfc2217_base;
+    std::optional<std::uint16_t> port_select;
+
+    /* The API and websocket for local tools, without TLS or passwords */
+    std::optional<fs::path> unix_socket;
+    std::optional<std::string> unix_group;
+
+    /* Where a replacement process finds this one, to take over from it */
+    std::optional<fs::path> upgrade_socket;
+    unsigned drain_timeout;
+
+    /* `name=regex` patterns looked for in console output, as well as
+       kernel panics and call traces */
+    std::vector<std::string> triggers;
+
+    /* `name=port,port,...`, each port an ID or a device */
+    std::vector<std::string> port_groups;
 };
 
 
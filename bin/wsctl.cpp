@@ -0,0 +1,393 @@
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <termios.h>
+#include <unistd.h>
+
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace fs = std::filesystem;
+namespace http = beast::http;
+namespace po = boost::program_options;
+namespace websocket = beast::websocket;
+
+using local = asio::local::stream_protocol;
+
+using namespace std::chrono_literals;
+
+
+namespace {
+
+/* The end of control_state's prompt: `>`, then a reset and a space */
+constexpr auto prompt_end = std::string_view{">\x1b[0m "};
+
+/* Written by serial_state once it is forwarding */
+constexpr auto attached_banner = std::string_view{"Type Ctrl + q to exit\r\n"};
+
+/* Written by control_state when a command fails */
+constexpr auto error_marker = std::string_view{"error:"};
+
+/* Ctrl + ], as telnet uses to get out of a session */
+constexpr auto detach_key = '\x1d';
+
+}
+
+
+struct options
+{
+    options()
+        : linger{500}
+    {}
+    fs::path socket;
+    std::string command;
+    std::vector<std::string> args;
+    unsigned linger;
+};
+
+
+auto get_options(int argc, char const * argv[]) -> options
+{
+    auto opts = options{};
+    auto desc = po::options_description(
+        "Talk to a local webserial over its --unix-socket\n\n"
+        "  wsctl get <path>       Print a JSON or metrics route, e.g. /metrics\n"
+        "  wsctl post <path>      Send stdin to a JSON route and print the reply\n"
+        "  wsctl run <command>    Run a control CLI command, e.g. run list\n"
+        "  wsctl attach <port>    Connect stdin and stdout to a serial port;\n"
+        "                         Ctrl + ] detaches\n\n"
+        "Options");
+    desc.add_options()
+        ("help,h", "Print help message")
+        ("socket,s", po::value<fs::path>(&opts.socket),
+            "Server's Unix socket. Defaults to $WEBSERIAL_SOCKET")
+        ("linger", po::value<unsigned>(&opts.linger)->default_value(opts.linger),
+            "Milliseconds to keep printing a port's output after stdin ends")
+        ("command", po::value<std::string>(&opts.command)->required(),
+            "get, post, run or attach")
+        ("args", po::value<std::vector<std::string>>(&opts.args),
+            "Arguments to the command");
+
+    auto positional = po::positional_options_description{};
+    positional.add("command", 1);
+    positional.add("args", -1);
+
+    auto vars = po::variables_map{};
+    po::store(po::command_line_parser(argc, argv)
+            .options(desc)
+            .positional(positional)
+            .run(), vars);
+    if (vars.count("help")) {
+        std::cout << desc;
+        std::exit(0);
+    }
+    po::notify(vars);
+
+    if (opts.socket.empty()) {
+        if (auto const * env = std::getenv("WEBSERIAL_SOCKET")) {
+            opts.socket = env;
+        }
+    }
+    if (opts.socket.empty() || opts.args.empty()) {
+        std::cerr << desc;
+        std::exit(2);
+    }
+    return opts;
+}
+
+
+/**
+ * @brief Puts a terminal on stdin into raw mode for as long as it lives
+ *
+ * Keystrokes then go to the port as typed, Ctrl + C included, as they would
+ * from the browser.
+ */
+class raw_terminal
+{
+public:
+    raw_terminal()
+    {
+        if (::isatty(STDIN_FILENO) && ::tcgetattr(STDIN_FILENO, &m_saved) == 0) {
+            auto raw = m_saved;
+            ::cfmakeraw(&raw);
+            m_active = ::tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+        }
+    }
+
+    ~raw_terminal()
+    {
+        if (m_active) {
+            ::tcsetattr(STDIN_FILENO, TCSANOW, &m_saved);
+        }
+    }
+
+    raw_terminal(raw_terminal const &) = delete;
+    auto operator=(raw_terminal const &) -> raw_terminal & = delete;
+
+    auto active() const -> bool
+    { return m_active; }
+
+private:
+    termios m_saved{};
+    bool m_active = false;
+};
+
+
+/* A JSON or metrics route; for POST, stdin is sent as the body */
+auto request(options const & opts, http::verb verb) -> int
+{
+    auto ioc = asio::io_context{};
+    auto socket = local::socket{ioc};
+    socket.connect(opts.socket.string());
+
+    auto req = http::request<http::string_body>{verb, opts.args[0], 11};
+    req.set(http::field::host, "localhost");
+    req.set(http::field::user_agent, "wsctl");
+    if (verb == http::verb::post) {
+        req.set(http::field::content_type, "application/json");
+        req.body().assign(std::istreambuf_iterator<char>{std::cin}, {});
+    }
+    req.prepare_payload();
+    http::write(socket, req);
+
+    auto buffer = beast::flat_buffer{};
+    auto res = http::response<http::string_body>{};
+    http::read(socket, buffer, res);
+
+    std::cout << res.body();
+    if (!res.body().empty() && res.body().back() != '\n') {
+        std::cout << '\n';
+    }
+    return res.result_int() < 300 ? 0 : 1;
+}
+
+
+/* The control CLI, over a websocket on the Unix socket */
+class cli_session
+{
+public:
+    explicit cli_session(asio::io_context & ioc, fs::path const & path)
+        : m_stream{ioc}
+    {
+        m_stream.next_layer().connect(path.string());
+        m_stream.set_option(websocket::stream_base::decorator(
+            [](websocket::request_type & req) {
+                req.set(http::field::user_agent, "wsctl");
+            }));
+        m_stream.handshake("localhost", "/");
+        m_stream.binary(true);
+    }
+
+    /* Everything up to and including `marker`, or up to `other` */
+    auto read_until(std::string_view marker,
+            std::optional<std::string_view> other = std::nullopt) -> std::string
+    {
+        while (m_pending.find(marker) == std::string::npos
+            && !(other && m_pending.find(*other) != std::string::npos))
+        {
+            auto buffer = beast::flat_buffer{};
+            m_stream.read(buffer);
+            m_pending += beast::buffers_to_string(buffer.data());
+        }
+
+        auto pos = m_pending.find(marker);
+        auto end = pos == std::string::npos
+                ? m_pending.size()
+                : pos + marker.size();
+        auto result = m_pending.substr(0, end);
+        m_pending.erase(0, end);
+        return result;
+    }
+
+    auto type(std::string_view text) -> void
+    {
+        m_stream.write(asio::buffer(text.data(), text.size()));
+    }
+
+    /* Whatever has been read past the last marker */
+    auto take_pending() -> std::string
+    { return std::exchange(m_pending, {}); }
+
+    auto stream() -> websocket::stream<local::socket> &
+    { return m_stream; }
+
+private:
+    websocket::stream<local::socket> m_stream;
+    std::string m_pending;
+};
+
+
+auto run(options const & opts) -> int
+{
+    auto command = std::string{};
+    for (auto const & arg : opts.args) {
+        command += (command.empty() ? "" : " ") + arg;
+    }
+
+    auto ioc = asio::io_context{};
+    auto cli = cli_session{ioc, opts.socket};
+    cli.read_until(prompt_end);
+    cli.type(command + "\r");
+
+    /* The command is echoed back, and the output ends with the next prompt */
+    auto output = cli.read_until(prompt_end);
+    if (auto echo = output.find("\r\n"); echo != std::string::npos) {
+        output.erase(0, echo + 2);
+    }
+    if (auto prompt = output.rfind('\n'); prompt != std::string::npos) {
+        output.erase(prompt + 1);
+    }
+    else {
+        output.clear();
+    }
+
+    std::cout << output << std::flush;
+    cli.stream().close(websocket::close_code::normal);
+    return output.find(error_marker) == std::string::npos ? 0 : 1;
+}
+
+
+auto attach(options const & opts) -> int
+{
+    /* Shared with the stdin thread, which may outlive this function */
+    struct state
+    {
+        state(fs::path const & path)
+            : cli{ioc, path}
+            , linger{ioc}
+        {}
+
+        asio::io_context ioc;
+        cli_session cli;
+        asio::steady_timer linger;
+    };
+    auto shared = std::make_shared<state>(opts.socket);
+    auto & cli = shared->cli;
+
+    cli.read_until(prompt_end);
+    cli.type(fmt::format("connect {}\r", opts.args[0]));
+
+    auto reply = cli.read_until(attached_banner, error_marker);
+    if (reply.find(attached_banner) == std::string::npos) {
+        auto error = reply.substr(reply.find(error_marker));
+        if (error.find('\n') == std::string::npos) {
+            error += cli.read_until("\n");
+        }
+        std::cerr << error.substr(0, error.find('\n') + 1);
+        return 1;
+    }
+
+    auto terminal = raw_terminal{};
+    std::cout << cli.take_pending() << std::flush;
+
+    /* Reading stdin blocks, and works the same for terminals, pipes and
+       files, so it has a thread of its own. Writes are made from the IO
+       context, between reads. */
+    auto write = [](std::shared_ptr<state> const & st, std::string text,
+            bool detach)
+    {
+        asio::post(st->ioc, [st, text = std::move(text), detach] {
+            auto ec = beast::error_code{};
+            st->cli.stream().write(asio::buffer(text), ec);
+            if (detach) {
+                st->cli.stream().async_close(websocket::close_code::normal,
+                    [](beast::error_code) {});
+            }
+        });
+    };
+    auto linger = std::chrono::milliseconds{opts.linger};
+    std::thread{[shared, write, linger, raw = terminal.active()] {
+        auto buffer = std::array<char, 4096>{};
+        while (true) {
+            auto len = ::read(STDIN_FILENO, buffer.data(), buffer.size());
+            if (len <= 0) {
+                break;
+            }
+            auto text = std::string(buffer.data(), static_cast<std::size_t>(len));
+            if (auto pos = text.find(detach_key); raw && pos != std::string::npos) {
+                text.erase(pos);
+                return write(shared, std::move(text), true);
+            }
+            write(shared, std::move(text), false);
+        }
+
+        /* Out of input; give the port a moment to answer the last of it */
+        asio::post(shared->ioc, [shared, linger] {
+            shared->linger.expires_after(linger);
+            shared->linger.async_wait([shared](beast::error_code ec) {
+                if (!ec) {
+                    shared->cli.stream().async_close(
+                        websocket::close_code::normal,
+                        [](beast::error_code) {});
+                }
+            });
+        });
+    }}.detach();
+
+    auto & stream = cli.stream();
+    auto buffer = beast::flat_buffer{};
+    auto read = std::function<void(beast::error_code, std::size_t)>{};
+    read = [&](beast::error_code ec, std::size_t) {
+        if (ec) {
+            shared->linger.cancel();
+            return;
+        }
+        auto data = buffer.data();
+        std::cout.write(static_cast<char const *>(data.data()),
+                static_cast<std::streamsize>(data.size()));
+        std::cout.flush();
+        buffer.consume(buffer.size());
+        stream.async_read(buffer, read);
+    };
+    stream.async_read(buffer, read);
+    shared->ioc.run();
+
+    if (terminal.active()) {
+        std::cout << "\r\n";
+    }
+    return 0;
+}
+
+
+auto main(int argc, char const * argv[]) -> int
+{
+    auto opts = get_options(argc, argv);
+
+    try {
+        if (opts.command == "get") {
+            return request(opts, http::verb::get);
+        }
+        if (opts.command == "post") {
+            return request(opts, http::verb::post);
+        }
+        if (opts.command == "run") {
+            return run(opts);
+        }
+        if (opts.command == "attach") {
+            return attach(opts);
+        }
+        fmt::print(stderr, "Unknown command '{}'\n", opts.command);
+        return 2;
+    }
+    catch (boost::system::system_error const & err) {
+        fmt::print(stderr, "{}: {}\n", opts.socket.string(), err.what());
+        return 1;
+    }
+}
@@ -0,0 +1,907 @@
+#include <apsn/latency.hpp>
+#include <apsn/logging.hpp>
+#include <apsn/thread.hpp>
+
+#include <md5.h>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/program_options.hpp>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace fs = std::filesystem;
+namespace http = beast::http;
+namespace po = boost::program_options;
+namespace websocket = beast::websocket;
+
+using tcp = asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+using namespace std::chrono_literals;
+
+
+struct options
+{
+    options()
+        : host{"127.0.0.1"}
+        , port{8080}
+        , tls{false}
+        , user{"admin"}
+        , sessions{100}
+        , connect_rate{0}
+        , concurrency{64}
+        , threads{1}
+        , duration{30}
+        , key_rate{5}
+        , paste_size{0}
+        , paste_interval{5}
+        , server_pid{0}
+    {}
+    std::string host;
+    std::uint16_t port;
+    bool tls;
+    std::string user;
+    std::string password;
+    std::string ha1;
+    std::size_t sessions;
+    double connect_rate;
+    std::size_t concurrency;
+    unsigned threads;
+    unsigned duration;
+    double key_rate;
+    std::size_t paste_size;
+    unsigned paste_interval;
+    std::vector<std::size_t> connect_ports;
+    int server_pid;
+};
+
+
+auto get_options(int argc, char const * argv[]) -> options
+{
+    auto opts = options{};
+    auto desc = po::options_description(
+        "Opens many websocket sessions against webserial, drives the control "
+        "CLI and reports how the server copes");
+    desc.add_options()
+        ("help,h", "Print help message")
+        ("host", po::value<std::string>(&opts.host), "Server address")
+        ("port,p", po::value<std::uint16_t>(&opts.port), "Server port")
+        ("tls", po::bool_switch(&opts.tls),
+            "Connect with TLS. Certificates are not verified")
+        ("user,u", po::value<std::string>(&opts.user), "User name")
+        ("password", po::value<std::string>(&opts.password),
+            "Password, for either basic or digest authentication")
+        ("ha1", po::value<std::string>(&opts.ha1),
+            "Digest HA1, as written by wspasswd, instead of a password")
+        ("sessions,n", po::value<std::size_t>(&opts.sessions),
+            "Number of websocket sessions to open")
+        ("connect-rate", po::value<double>(&opts.connect_rate),
+            "New sessions per second. 0 opens them as fast as possible")
+        ("concurrency", po::value<std::size_t>(&opts.concurrency),
+            "Most sessions being set up at once")
+        ("threads", po::value<unsigned>(&opts.threads),
+            "Client threads")
+        ("duration,d", po::value<unsigned>(&opts.duration),
+            "Seconds to drive the sessions for once they are open")
+        ("key-rate", po::value<double>(&opts.key_rate),
+            "Keystrokes per second, per session. 0 leaves sessions idle")
+        ("paste-size", po::value<std::size_t>(&opts.paste_size),
+            "Bytes in each paste. 0 disables pastes")
+        ("paste-interval", po::value<unsigned>(&opts.paste_interval),
+            "Seconds between pastes, per session")
+        ("connect", po::value<std::vector<std::size_t>>(&opts.connect_ports)
+                ->multitoken(),
+            "Port IDs to connect sessions to, in turn. Keystrokes then go to "
+            "the port, so it should echo them")
+        ("server-pid", po::value<int>(&opts.server_pid),
+            "Process to report the memory of. Defaults to the first process "
+            "named webserial");
+
+    auto vars = po::variables_map{};
+    po::store(po::parse_command_line(argc, argv, desc), vars);
+    if (vars.count("help")) {
+        std::cout << desc;
+        std::exit(0);
+    }
+    po::notify(vars);
+    return opts;
+}
+
+
+/* Memory of the server, in kB, from /proc */
+struct memory_usage
+{
+    std::uint64_t rss_kb = 0;
+    std::uint64_t peak_kb = 0;
+};
+
+
+auto find_server_pid() -> int
+{
+    auto ec = std::error_code{};
+    for (auto const & entry : fs::directory_iterator{"/proc", ec}) {
+        auto name = entry.path().filename().string();
+        auto pid = 0;
+        auto [end, err] = std::from_chars(
+                name.data(), name.data() + name.size(), pid);
+        if (err != std::errc{} || end != name.data() + name.size()) {
+            continue;
+        }
+        /* The server renames its threads, main included, so `comm` is no
+           use here */
+        auto program = std::string{};
+        std::getline(std::ifstream{entry.path() / "cmdline"}, program, '\0');
+        if (fs::path{program}.filename() == "webserial") {
+            return pid;
+        }
+    }
+    return 0;
+}
+
+
+auto read_memory(int pid) -> std::optional<memory_usage>
+{
+    auto status = std::ifstream{fmt::format("/proc/{}/status", pid)};
+    if (!status) {
+        return std::nullopt;
+    }
+    auto usage = memory_usage{};
+    auto line = std::string{};
+    while (std::getline(status, line)) {
+        auto value = [&line] {
+            auto digits = line.find_first_of("0123456789");
+            auto kb = std::uint64_t{0};
+            if (digits != std::string::npos) {
+                std::from_chars(line.data() + digits,
+                        line.data() + line.size(), kb);
+            }
+            return kb;
+        };
+        if (line.starts_with("VmRSS:")) {
+            usage.rss_kb = value();
+        }
+        else if (line.starts_with("VmHWM:")) {
+            usage.peak_kb = value();
+        }
+    }
+    return usage;
+}
+
+
+/* Thousands of sessions need thousands of descriptors */
+auto raise_file_limit() -> void
+{
+    auto limit = rlimit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+        limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+
+struct load_stats
+{
+    std::atomic<std::size_t> started{0};
+    std::atomic<std::size_t> established{0};
+    std::atomic<std::size_t> attached{0};
+    std::atomic<std::size_t> failed{0};
+    std::atomic<std::size_t> timeouts{0};
+    std::atomic<std::uint64_t> bytes_in{0};
+    std::atomic<std::uint64_t> bytes_out{0};
+
+    apsn::latency_histogram setup;
+    apsn::latency_histogram command;
+    apsn::latency_histogram echo;
+    apsn::latency_histogram paste;
+
+    auto in_flight() const -> std::size_t
+    { return started - established - failed; }
+
+    auto fail(std::string const & what) -> void
+    {
+        ++failed;
+        auto lock = std::lock_guard{mtx};
+        ++errors[what];
+    }
+
+    std::mutex mtx;
+    std::map<std::string, std::size_t> errors;
+    clock_type::time_point last_established;
+};
+
+
+/**
+ * @brief Answers basic and digest challenges
+ */
+class credentials
+{
+public:
+    credentials(std::string user, std::string password, std::string ha1)
+        : m_user{std::move(user)}
+        , m_password{std::move(password)}
+        , m_ha1{std::move(ha1)}
+    {}
+
+    auto basic() const -> std::string
+    {
+        auto plain = m_user + ":" + m_password;
+        auto encoded = std::string(
+                beast::detail::base64::encoded_size(plain.size()), '\0');
+        encoded.resize(beast::detail::base64::encode(
+                encoded.data(), plain.data(), plain.size()));
+        return "Basic " + encoded;
+    }
+
+    /* An `Authorization` value for a `WWW-Authenticate` challenge */
+    auto answer(std::string_view challenge,
+            std::string_view method,
+            std::string_view uri,
+            std::mt19937 & random) const -> std::optional<std::string>
+    {
+        if (challenge.starts_with("Basic")) {
+            return basic();
+        }
+        if (!challenge.starts_with("Digest")) {
+            return std::nullopt;
+        }
+
+        auto realm = param(challenge, "realm");
+        auto nonce = param(challenge, "nonce");
+        if (!realm || !nonce) {
+            return std::nullopt;
+        }
+
+        auto ha1 = m_ha1.empty()
+                ? md5(fmt::format("{}:{}:{}", m_user, *realm, m_password))
+                : m_ha1;
+        auto ha2 = md5(fmt::format("{}:{}", method, uri));
+        auto cnonce = fmt::format("{:08x}{:08x}", random(), random());
+        auto nc = "00000001";
+        auto response = md5(fmt::format("{}:{}:{}:{}:auth:{}",
+                ha1, *nonce, nc, cnonce, ha2));
+
+        return fmt::format("Digest username=\"{}\", realm=\"{}\", "
+                "nonce=\"{}\", uri=\"{}\", algorithm=MD5, response=\"{}\", "
+                "qop=auth, nc={}, cnonce=\"{}\"",
+                m_user, *realm, *nonce, uri, response, nc, cnonce);
+    }
+
+private:
+    static auto md5(std::string const & text) -> std::string
+    { return MD5{text}.hexdigest(); }
+
+    /* A quoted parameter of a challenge */
+    static auto param(std::string_view challenge, std::string_view name)
+        -> std::optional<std::string>
+    {
+        auto key = fmt::format("{}=\"", name);
+        auto start = challenge.find(key);
+        if (start == std::string_view::npos) {
+            return std::nullopt;
+        }
+        start += key.size();
+        auto end = challenge.find('"', start);
+        if (end == std::string_view::npos) {
+            return std::nullopt;
+        }
+        return std::string{challenge.substr(start, end - start)};
+    }
+
+    std::string m_user;
+    std::string m_password;
+    std::string m_ha1;
+};
+
+
+struct session_settings
+{
+    std::string host;
+    tcp::resolver::results_type endpoints;
+    std::shared_ptr<credentials> creds;
+    std::optional<std::size_t> port_id;
+    clock_type::duration key_interval;
+    std::size_t paste_size;
+    clock_type::duration paste_interval;
+};
+
+
+class session_base
+{
+public:
+    virtual ~session_base() = default;
+    virtual auto start() -> void = 0;
+    virtual auto close() -> void = 0;
+};
+
+
+/**
+ * @brief One simulated user
+ *
+ * Logs in, waits for the prompt, runs `list`, optionally connects to a port,
+ * and then types. Each keystroke waits for its echo before the next is
+ * sent, and the time to the echo is recorded. Pastes are timed to the echo
+ * of their last character.
+ */
+template <typename Stream>
+class load_session
+    : public session_base
+    , public std::enable_shared_from_this<load_session<Stream>>
+{
+    enum class phase
+    {
+        setup,
+        list,
+        connect,
+        echo,
+        paste,
+        clear
+    };
+
+public:
+    template <typename ... StreamArgs>
+    load_session(session_settings const & settings,
+            load_stats & stats,
+            std::uint32_t seed,
+            StreamArgs && ... stream_args)
+        : m_settings{settings}
+        , m_stats{stats}
+        , m_ws{std::forward<StreamArgs>(stream_args)...}
+        , m_timer{m_ws.get_executor()}
+        , m_random{seed}
+    {}
+
+    auto start() -> void override
+    {
+        asio::post(m_ws.get_executor(), [self = this->shared_from_this()] {
+            self->do_connect();
+        });
+    }
+
+    auto close() -> void override
+    {
+        asio::post(m_ws.get_executor(), [self = this->shared_from_this()] {
+            self->m_closing = true;
+            self->m_timer.cancel();
+            if (self->m_ws.is_open()) {
+                self->m_ws.async_close(websocket::close_code::normal,
+                    [self](beast::error_code) {});
+            }
+            else {
+                beast::get_lowest_layer(self->m_ws).close();
+            }
+        });
+    }
+
+private:
+    /* Written by control_state after each command */
+    static constexpr auto prompt = std::string_view{">\x1b[0m "};
+
+    /* Written by serial_state once it is forwarding */
+    static constexpr auto banner = std::string_view{"Type Ctrl + q to exit\r\n"};
+
+    /* Characters which the control CLI's own output does not contain */
+    static constexpr auto keys = std::string_view{"jkqvxz"};
+
+    /* Lines are cleared after this many keystrokes in the control CLI */
+    static constexpr auto keys_per_line = 32u;
+
+    static constexpr auto echo_timeout = 5s;
+
+    auto fail(std::string const & what, beast::error_code ec) -> void
+    {
+        if (m_closing) {
+            return;
+        }
+        m_closing = true;
+        m_timer.cancel();
+        if (!m_established) {
+            m_stats.fail(fmt::format("{}: {}", what, ec.message()));
+        }
+    }
+
+    auto do_connect() -> void
+    {
+        m_started = clock_type::now();
+
+        auto & lowest = beast::get_lowest_layer(m_ws);
+        lowest.expires_after(10s);
+        lowest.async_connect(m_settings.endpoints,
+            [self = this->shared_from_this()](
+                    beast::error_code ec, tcp::endpoint const &) {
+                if (ec) {
+                    return self->fail("connect", ec);
+                }
+                self->on_connect();
+            });
+    }
+
+    auto on_connect() -> void
+    {
+        if constexpr (std::is_same_v<Stream, beast::tcp_stream>) {
+            request_challenge();
+        }
+        else {
+            auto & tls = m_ws.next_layer();
+            ::SSL_set_tlsext_host_name(tls.native_handle(),
+                    m_settings.host.c_str());
+            tls.async_handshake(asio::ssl::stream_base::client,
+                [self = this->shared_from_this()](beast::error_code ec) {
+                    if (ec) {
+                        return self->fail("tls", ec);
+                    }
+                    self->request_challenge();
+                });
+        }
+    }
+
+    /* The upgrade passes through the same authentication as pages, so ask
+       for a challenge with a plain request on the same connection first */
+    auto request_challenge() -> void
+    {
+        m_request = {http::verb::get, "/", 11};
+        m_request.set(http::field::host, m_settings.host);
+        m_request.keep_alive(true);
+
+        http::async_write(m_ws.next_layer(), m_request,
+            [self = this->shared_from_this()](
+                    beast::error_code ec, std::size_t) {
+                if (ec) {
+                    return self->fail("challenge", ec);
+                }
+                http::async_read(self->m_ws.next_layer(), self->m_buffer,
+                    self->m_response,
+                    [self](beast::error_code ec, std::size_t) {
+                        if (ec) {
+                            return self->fail("challenge", ec);
+                        }
+                        self->on_challenge();
+                    });
+            });
+    }
+
+    auto on_challenge() -> void
+    {
+        auto authorization = std::string{};
+        if (m_response.result() == http::status::unauthorized) {
+            auto answer = m_settings.creds->answer(
+                    m_response[http::field::www_authenticate],
+                    "GET", "/", m_random);
+            if (!answer) {
+                return fail("challenge",
+                    make_error_code(beast::http::error::bad_value));
+            }
+            authorization = std::move(*answer);
+        }
+        m_buffer.consume(m_buffer.size());
+
+        beast::get_lowest_layer(m_ws).expires_never();
+        m_ws.set_option(websocket::stream_base::timeout::suggested(
+                beast::role_type::client));
+        m_ws.set_option(websocket::stream_base::decorator(
+            [authorization](websocket::request_type & req) {
+                if (!authorization.empty()) {
+                    req.set(http::field::authorization, authorization);
+                }
+            }));
+
+        m_ws.async_handshake(m_settings.host, "/",
+            [self = this->shared_from_this()](beast::error_code ec) {
+                if (ec) {
+                    return self->fail("handshake", ec);
+                }
+                self->expect(prompt, phase::setup);
+                self->read();
+            });
+    }
+
+    auto read() -> void
+    {
+        m_ws.async_read(m_buffer,
+            [self = this->shared_from_this()](
+                    beast::error_code ec, std::size_t bytes) {
+                if (ec) {
+                    return self->fail("read", ec);
+                }
+                self->on_read(bytes);
+            });
+    }
+
+    auto on_read(std::size_t bytes) -> void
+    {
+        m_stats.bytes_in += bytes;
+        if (!m_expect.empty()) {
+            m_seen += beast::buffers_to_string(m_buffer.data());
+            if (m_seen.find(m_expect) != std::string::npos) {
+                arrived();
+            }
+            else if (m_phase == phase::connect &&
+                m_seen.find("error:") != std::string::npos)
+            {
+                /* The port is in use or missing; carry on in the CLI */
+                m_expect.clear();
+                drive();
+            }
+        }
+        m_buffer.consume(bytes);
+        read();
+    }
+
+    auto send(std::string text) -> void
+    {
+        m_stats.bytes_out += text.size();
+        m_pending.push_back(std::move(text));
+        if (m_pending.size() == 1) {
+            write();
+        }
+    }
+
+    auto write() -> void
+    {
+        m_ws.async_write(asio::buffer(m_pending.front()),
+            [self = this->shared_from_this()](
+                    beast::error_code ec, std::size_t) {
+                if (ec) {
+                    return self->fail("write", ec);
+                }
+                self->m_pending.erase(self->m_pending.begin());
+                if (!self->m_pending.empty()) {
+                    self->write();
+                }
+            });
+    }
+
+    auto expect(std::string_view marker, phase next) -> void
+    {
+        m_expect = marker;
+        m_phase = next;
+        m_seen.clear();
+        m_sent = clock_type::now();
+    }
+
+    auto arrived() -> void
+    {
+        auto elapsed = clock_type::now() - m_sent;
+        m_expect.clear();
+
+        switch (m_phase) {
+        case phase::setup: {
+            m_established = true;
+            ++m_stats.established;
+            m_stats.setup.record(clock_type::now() - m_started);
+            {
+                auto lock = std::lock_guard{m_stats.mtx};
+                m_stats.last_established = clock_type::now();
+            }
+            send("list\r");
+            expect(prompt, phase::list);
+            break;
+        }
+        case phase::list:
+            m_stats.command.record(elapsed);
+            if (m_settings.port_id) {
+                send(fmt::format("connect {}\r", *m_settings.port_id));
+                expect(banner, phase::connect);
+            }
+            else {
+                drive();
+            }
+            break;
+        case phase::connect:
+            ++m_stats.attached;
+            m_serial = true;
+            drive();
+            break;
+        case phase::echo:
+            m_stats.echo.record(elapsed);
+            if (!m_serial && ++m_line >= keys_per_line) {
+                clear_line();
+            }
+            break;
+        case phase::paste:
+            m_stats.paste.record(elapsed);
+            if (!m_serial) {
+                clear_line();
+            }
+            break;
+        case phase::clear:
+            break;
+        }
+    }
+
+    /* Ctrl-c empties the control CLI's line */
+    auto clear_line() -> void
+    {
+        m_line = 0;
+        send("\x03");
+        expect(prompt, phase::clear);
+    }
+
+    auto drive() -> void
+    {
+        if (m_settings.key_interval == clock_type::duration::zero()) {
+            return;
+        }
+        m_next_paste = clock_type::now() + m_settings.paste_interval;
+        tick();
+    }
+
+    auto tick() -> void
+    {
+        m_timer.expires_after(m_settings.key_interval);
+        m_timer.async_wait(
+            [self = this->shared_from_this()](beast::error_code ec) {
+                if (ec || self->m_closing) {
+                    return;
+                }
+                self->type();
+                self->tick();
+            });
+    }
+
+    auto type() -> void
+    {
+        auto now = clock_type::now();
+        if (!m_expect.empty()) {
+            if (now - m_sent < echo_timeout) {
+                return;
+            }
+            ++m_stats.timeouts;
+            m_expect.clear();
+        }
+
+        if (m_settings.paste_size > 0 && now >= m_next_paste) {
+            m_next_paste = now + m_settings.paste_interval;
+            auto text = std::string{};
+            for (auto ii = std::size_t{1}; ii < m_settings.paste_size; ++ii) {
+                text.push_back(keys[m_random() % keys.size()]);
+            }
+            text.push_back('.');
+            send(std::move(text));
+            expect(".", phase::paste);
+            return;
+        }
+
+        auto key = keys[m_keys++ % keys.size()];
+        send(std::string(1, key));
+        expect(std::string_view{&key, 1}, phase::echo);
+    }
+
+    session_settings const & m_settings;
+    load_stats & m_stats;
+    websocket::stream<Stream> m_ws;
+    asio::steady_timer m_timer;
+    std::mt19937 m_random;
+
+    beast::flat_buffer m_buffer;
+    http::request<http::empty_body> m_request;
+    http::response<http::string_body> m_response;
+    std::vector<std::string> m_pending;
+
+    clock_type::time_point m_started;
+    clock_type::time_point m_sent;
+    clock_type::time_point m_next_paste;
+    std::string m_expect;
+    std::string m_seen;
+    phase m_phase = phase::setup;
+    std::size_t m_keys = 0;
+    std::size_t m_line = 0;
+    bool m_established = false;
+    bool m_serial = false;
+    bool m_closing = false;
+};
+
+
+auto print_latency(std::string_view name, apsn::latency_histogram const & hist)
+    -> void
+{
+    auto summary = hist.snapshot();
+
+    /* Percentiles are bucket bounds, which can overshoot the largest value */
+    auto ms = [&summary](std::chrono::microseconds us) {
+        return static_cast<double>(std::min(us, summary.max()).count()) / 1000.0;
+    };
+    fmt::print("{:<10} {:>8} {:>10.2f} {:>10.2f} {:>10.2f}\n",
+            name, summary.count,
+            ms(summary.percentile(0.5)),
+            ms(summary.percentile(0.99)),
+            ms(summary.max()));
+}
+
+
+auto main(int argc, char const * argv[]) -> int
+{
+    auto opts = get_options(argc, argv);
+    apsn::log::set_threshold(apsn::log::level::warn);
+    raise_file_limit();
+
+    auto ioc = asio::io_context{static_cast<int>(opts.threads)};
+    auto resolver = tcp::resolver{ioc};
+    auto ec = boost::system::error_code{};
+    auto endpoints = resolver.resolve(opts.host, std::to_string(opts.port), ec);
+    if (ec) {
+        apsn::log::fatal("Could not resolve {}: {}", opts.host, ec.message());
+        return EXIT_FAILURE;
+    }
+
+    auto ssl_ctx = asio::ssl::context{asio::ssl::context::tls_client};
+    ssl_ctx.set_verify_mode(asio::ssl::verify_none);
+
+    using seconds = std::chrono::duration<double>;
+    auto per_key = opts.key_rate > 0
+            ? std::chrono::duration_cast<clock_type::duration>(
+                seconds{1.0 / opts.key_rate})
+            : clock_type::duration::zero();
+
+    /* One settings block per port, so sessions can share them */
+    auto settings = std::vector<session_settings>{};
+    auto port_ids = opts.connect_ports.empty()
+            ? std::vector<std::optional<std::size_t>>{std::nullopt}
+            : std::vector<std::optional<std::size_t>>(
+                opts.connect_ports.begin(), opts.connect_ports.end());
+    auto creds = std::make_shared<credentials>(
+            opts.user, opts.password, opts.ha1);
+    for (auto const & port_id : port_ids) {
+        settings.push_back(session_settings{
+            opts.host,
+            endpoints,
+            creds,
+            port_id,
+            per_key,
+            opts.paste_size,
+            std::chrono::seconds{opts.paste_interval}
+        });
+    }
+
+    auto server_pid = opts.server_pid ? opts.server_pid : find_server_pid();
+    auto memory_before = read_memory(server_pid);
+
+    auto work = asio::make_work_guard(ioc);
+    auto threads = std::vector<std::thread>{};
+    for (auto ii = 0u; ii < std::max(opts.threads, 1u); ++ii) {
+        threads.emplace_back([&ioc, ii] {
+            apsn::this_thread::set_name(fmt::format("load-{}", ii));
+            ioc.run();
+        });
+    }
+
+    auto stats = load_stats{};
+    auto sessions = std::vector<std::shared_ptr<session_base>>{};
+    sessions.reserve(opts.sessions);
+
+    auto const begin = clock_type::now();
+    auto next_report = begin + 1s;
+    auto report = [&](bool force) {
+        if (!force && clock_type::now() < next_report) {
+            return;
+        }
+        next_report += 1s;
+        fmt::print(stderr, "{:6.1f}s  established {:>6}  failed {:>6}  "
+                "in flight {:>4}\n",
+                seconds{clock_type::now() - begin}.count(),
+                stats.established.load(), stats.failed.load(),
+                stats.in_flight());
+    };
+
+    for (auto ii = std::size_t{0}; ii < opts.sessions; ++ii) {
+        if (opts.connect_rate > 0) {
+            std::this_thread::sleep_until(begin +
+                std::chrono::duration_cast<clock_type::duration>(
+                    seconds{static_cast<double>(ii) / opts.connect_rate}));
+        }
+        while (stats.in_flight() >= opts.concurrency) {
+            std::this_thread::sleep_for(1ms);
+            report(false);
+        }
+        report(false);
+
+        auto const & setting = settings[ii % settings.size()];
+        auto seed = static_cast<std::uint32_t>(ii + 1);
+        auto session = opts.tls
+            ? std::shared_ptr<session_base>{
+                std::make_shared<load_session<beast::ssl_stream<beast::tcp_stream>>>(
+                    setting, stats, seed, asio::make_strand(ioc), ssl_ctx)}
+            : std::shared_ptr<session_base>{
+                std::make_shared<load_session<beast::tcp_stream>>(
+                    setting, stats, seed, asio::make_strand(ioc))};
+        ++stats.started;
+        session->start();
+        sessions.push_back(std::move(session));
+    }
+    while (stats.in_flight() > 0) {
+        std::this_thread::sleep_for(10ms);
+        report(false);
+    }
+
+    auto const setup_time = [&] {
+        auto lock = std::lock_guard{stats.mtx};
+        return stats.established > 0
+                ? seconds{stats.last_established - begin}
+                : seconds{0};
+    }();
+    auto memory_open = read_memory(server_pid);
+
+    auto const end = clock_type::now() + std::chrono::seconds{opts.duration};
+    while (clock_type::now() < end) {
+        std::this_thread::sleep_for(10ms);
+        report(false);
+    }
+    auto memory_end = read_memory(server_pid);
+
+    for (auto & session : sessions) {
+        session->close();
+    }
+    std::this_thread::sleep_for(500ms);
+    work.reset();
+    ioc.stop();
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    report(true);
+
+    fmt::print("\nsessions   {} opened, {} failed, {} attached to ports\n",
+            stats.established.load(), stats.failed.load(),
+            stats.attached.load());
+    for (auto const & [what, count] : stats.errors) {
+        fmt::print("  {:>6} x {}\n", count, what);
+    }
+    fmt::print("setup      {:.1f} sessions/s over {:.2f}s\n",
+            setup_time.count() > 0
+                ? static_cast<double>(stats.established) / setup_time.count()
+                : 0.0,
+            setup_time.count());
+    fmt::print("traffic    {} bytes in, {} bytes out, {} echo timeouts\n\n",
+            stats.bytes_in.load(), stats.bytes_out.load(),
+            stats.timeouts.load());
+
+    fmt::print("{:<10} {:>8} {:>10} {:>10} {:>10}\n",
+            "latency", "count", "p50 ms", "p99 ms", "max ms");
+    print_latency("setup", stats.setup);
+    print_latency("list", stats.command);
+    print_latency("echo", stats.echo);
+    print_latency("paste", stats.paste);
+
+    if (memory_end) {
+        auto mb = [](std::uint64_t kb) {
+            return static_cast<double>(kb) / 1024.0;
+        };
+        fmt::print("\nserver {} rss: {:.1f} MB before, {:.1f} MB open, "
+                "{:.1f} MB at end, {:.1f} MB peak\n",
+                server_pid,
+                mb(memory_before ? memory_before->rss_kb : 0),
+                mb(memory_open ? memory_open->rss_kb : 0),
+                mb(memory_end->rss_kb),
+                mb(memory_end->peak_kb));
+    }
+    else {
+        fmt::print("\nserver rss: unavailable, see --server-pid\n");
+    }
+
+    return stats.failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+#include <fmt/chrono.h>
+#include <fmt/core.h>
+#include <boost/program_options.hpp>
+
+#include <apsn/binary_logger.hpp>
+#include <apsn/logging.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace fs = std::filesystem;
+namespace po = boost::program_options;
+
+struct options
+{
+    options()
+        : threshold{apsn::log::level::trace}
+    {}
+    fs::path in;
+    apsn::log::level threshold;
+};
+
+auto get_options(int argc, char const * argv[]) -> options
+{
+    auto opts = options{};
+    auto desc = po::options_description("Decode a webserial binary log");
+    desc.add_options()
+        ("help,h",      "Print help message")
+        ("log-level,l", po::value<apsn::log::level>(&opts.threshold),
+            "Only print messages at this level or more severe")
+        ("in", po::value<fs::path>(&opts.in)->required(), "Binary log file");
+
+    auto positional = po::positional_options_description{};
+    positional.add("in", 1);
+
+    auto vars = po::variables_map{};
+    po::store(po::command_line_parser(argc, argv)
+            .options(desc)
+            .positional(positional)
+            .run(), vars);
+    if (vars.count("help")) {
+        std::cout << desc;
+        std::exit(0);
+    }
+    po::notify(vars);
+    return opts;
+}
+
+
+auto main(int argc, char const * argv[]) -> int
+{
+    auto opts = get_options(argc, argv);
+
+    auto in = std::ifstream{opts.in, std::ios::binary};
+    if (!in) {
+        apsn::log::fatal("Could not open {}", opts.in.string());
+        return 1;
+    }
+
+    auto reader = apsn::log::binary_log_reader{in};
+    if (!reader.valid()) {
+        apsn::log::fatal("{} is not a binary log", opts.in.string());
+        return 1;
+    }
+
+    while (auto rec = reader.next()) {
+        if (rec->lvl > opts.threshold) {
+            continue;
+        }
+        auto us = std::chrono::time_point_cast<std::chrono::microseconds>(
+                rec->when);
+        auto seconds = std::chrono::floor<std::chrono::seconds>(us);
+        fmt::print("[{:%Y-%m-%d %H:%M:%S}.{:06}] [{}] {}: {}: {}\n",
+                fmt::localtime(std::chrono::system_clock::to_time_t(seconds)),
+                (us - seconds).count(),
+                reader.thread_name(rec->thread),
+                reader.name(),
+                apsn::log::to_string(rec->lvl),
+                rec->message);
+    }
+}
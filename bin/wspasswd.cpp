@@ -3,6 +3,7 @@
 #include <boost/program_options.hpp>
 
 #include <apsn/logging.hpp>
+#include <apsn/http/credentials.hpp>
 
 #include <filesystem>
 #include <fstream>
@@ -22,8 +23,11 @@ struct options
 {
     options()
         : realm{"webserial"}
+        , scheme{"digest"}
     {}
     std::string realm;
+    std::string scheme;
+    apsn::http::scrypt_params scrypt;
     std::string user;
     std::optional<std::string> pass;
     fs::path out;
@@ -36,6 +40,18 @@ auto get_options(int argc, char const * argv[]) -> options
     desc.add_options()
         ("help,h",      "Print help message")
         ("realm", po::value<std::string>(&opts.realm), "Realm")
+        ("scheme", po::value<std::string>(&opts.scheme)
+                        ->notifier([](auto const & value){
+                            if (value != "digest" && value != "scrypt") {
+                                throw po::validation_error(
+                                    po::validation_error::invalid_option_value,
+                                    "scheme", value);
+                            }
+                        }),
+            "Either 'digest', for a single user MD5 HA1, or 'scrypt', which "
+            "adds or updates the user in a multi-user file")
+        ("scrypt-ln", po::value<unsigned>(&opts.scrypt.log2_n),
+            "scrypt cost, as log2 of N. Default 15")
         ("user",  po::value<std::string>(&opts.user)->required(),  "Username")
         ("pass",  po::value<std::string>()
                         ->notifier([&](auto val){
@@ -124,6 +140,36 @@ auto main(int argc, char const * argv[]) -> int
         pass = *opts.pass;
     }
 
+    if (opts.scheme == "scrypt") {
+        auto db = apsn::http::password_db{};
+        if (fs::exists(opts.out)) {
+            auto existing = apsn::http::password_db::load(opts.out);
+            if (!existing) {
+                apsn::log::error("Could not read {}: {}",
+                        opts.out.string(), existing.error_message());
+                return 1;
+            }
+            db = std::move(*existing);
+        }
+
+        auto hash = apsn::http::hash_password(pass, opts.scrypt);
+        if (!hash) {
+            apsn::log::error("Could not hash password: {}",
+                    hash.error_message());
+            return 1;
+        }
+        db.set(opts.user, std::move(*hash));
+
+        apsn::log::info("Writing {} user(s) to {}",
+                db.size(), opts.out.string());
+        if (auto error = db.save(opts.out)) {
+            apsn::log::error("Could not write outfile: {}", error.message());
+            return 1;
+        }
+        apsn::log::info("Finished building password file");
+        return 0;
+    }
+
     auto hash = MD5{fmt::format("{}:{}:{}", opts.user, opts.realm, pass)}
             .hexdigest();
 
@@ -0,0 +1,12 @@
+include(FetchContent)
+
+set(FETCHCONTENT_QUIET OFF)
+set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+set(BENCHMARK_ENABLE_GTEST_TESTS OFF CACHE BOOL "" FORCE)
+set(BENCHMARK_ENABLE_INSTALL OFF CACHE BOOL "" FORCE)
+FetchContent_Declare(benchmark SYSTEM
+    GIT_REPOSITORY https://github.com/google/benchmark.git
+    GIT_TAG v1.8.3
+    GIT_PROGRESS TRUE
+)
+FetchContent_MakeAvailable(benchmark)
@@ -337,12 +337,23 @@ std::string MD5::hexdigest() const
   if (!finalized)
     return "";
  
-  char buf[33];
-  for (int i=0; i<16; i++)
-    sprintf(buf+i*2, "%02x", digest[i]);
-  buf[32]=0;
+  char buf[32];
+  hexdigest(buf);
  
-  return std::string(buf);
+  return std::string(buf, sizeof buf);
+}
+ 
+//////////////////////////////
+ 
+// write hex representation of digest into a caller supplied buffer
+void MD5::hexdigest(char out[32]) const
+{
+  static const char digits[] = "0123456789abcdef";
+ 
+  for (int i=0; i<16; i++) {
+    out[i*2]   = finalized ? digits[digest[i] >> 4] : '0';
+    out[i*2+1] = finalized ? digits[digest[i] & 0x0f] : '0';
+  }
 }
  
 //////////////////////////////
@@ -115,6 +115,7 @@ auto to_string(fe code) -> std::string;
  */
 enum class csi_final : char
 {
+    ICH = '@', /**< Insert Characters                   */
     CUU = 'A', /**< Cursor Up                           */
     CUD = 'B', /**< Cursor Down                         */
     CUF = 'C', /**< Cursor Forward                      */
@@ -125,12 +126,23 @@ enum class csi_final : char
     CUP = 'H', /**< Cursor Position                     */
     ED  = 'J', /**< Erase in Display                    */
     EL  = 'K', /**< Erase in Line                       */
+    IL  = 'L', /**< Insert Lines                        */
+    DL  = 'M', /**< Delete Lines                        */
+    DCH = 'P', /**< Delete Characters                   */
     SU  = 'S', /**< Scroll Up                           */
     SD  = 'T', /**< Scroll Down                         */
+    ECH = 'X', /**< Erase Characters                    */
+    HPA = '`', /**< Cursor Position Horizontal absolute */
+    VPA = 'd', /**< Cursor Position Vertical absolute   */
     HVP = 'f', /**< Horizontal Vvertical Position       */
+    SM  = 'h', /**< Set Mode                            */
+    RM  = 'l', /**< Reset Mode                          */
     SGR = 'm', /**< Select Graphic Rendition            */
     AUX = 'i', /**< AUX                                 */
-    DSR = 'n'  /**< Device Status Report                */
+    DSR = 'n', /**< Device Status Report                */
+    DECSTBM = 'r', /**< Set Scrolling Region            */
+    SCP = 's', /**< Save Cursor Position                */
+    RCP = 'u'  /**< Restore Cursor Position             */
 };
 
 
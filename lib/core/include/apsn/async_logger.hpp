@@ -0,0 +1,94 @@
+#pragma once
+
+#include <apsn/logging.hpp>
+#include <apsn/spsc_queue.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+namespace apsn::log {
+
+/**
+ * @brief Logger which hands messages to a background thread for output
+ *
+ * Each logging thread gets its own lock-free queue, so logging costs the
+ * caller a format and a push. A flusher thread drains the queues every
+ * `interval`, or immediately for errors, and passes each record to `sink`.
+ * Records keep the time and thread they were logged from. If a thread's
+ * queue is full its messages are dropped, and the number dropped is reported
+ * by the flusher. A binary `sink` is handed the raw arguments, so formatting
+ * stays deferred, and its file writes happen on the flusher.
+ *
+ * \code {.cpp}
+        apsn::log::make_logger<apsn::log::async_logger>(
+            std::make_shared<apsn::log::coloured_cli_logger>("app"));
+ * \endcode
+ */
+class async_logger : public logger
+{
+public:
+    explicit async_logger(std::shared_ptr<logger> sink,
+            std::size_t queue_size = 1024,
+            std::chrono::milliseconds interval = std::chrono::milliseconds{10});
+
+    ~async_logger();
+
+    auto threshold(level threshold) -> void override;
+    auto name(std::string name) -> void override;
+
+    /* Outputs everything logged so far, from the calling thread */
+    auto flush() -> void;
+
+    auto dropped() const -> std::uint64_t
+    { return m_dropped.load(std::memory_order_relaxed); }
+
+    auto do_log(level msg_level, std::string const & message)
+        -> void override;
+
+    auto write(record const & rec) -> void override;
+
+    using logger::threshold;
+    using logger::name;
+
+protected:
+    auto do_log_binary(level msg_level,
+            std::string_view format,
+            std::string_view args) -> void override;
+
+private:
+    struct queue;
+
+    auto local_queue() -> queue *;
+    auto drain() -> void;
+    auto run() -> void;
+
+    std::shared_ptr<logger> m_sink;
+    std::size_t m_queue_size;
+    std::chrono::milliseconds m_interval;
+    std::uint64_t const m_id;
+
+    std::mutex m_queues_mtx;
+    std::vector<std::shared_ptr<queue>> m_queues;
+
+    /* Only one thread at a time may consume from the queues */
+    std::mutex m_drain_mtx;
+    std::atomic<std::uint64_t> m_dropped{0};
+    std::uint64_t m_reported{0};
+
+    std::mutex m_wake_mtx;
+    std::condition_variable m_wake;
+    bool m_urgent = false;
+    bool m_stop = false;
+    std::thread m_flusher;
+};
+
+}
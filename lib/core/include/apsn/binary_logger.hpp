@@ -0,0 +1,129 @@
+#pragma once
+
+#include <apsn/logging.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iosfwd>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+namespace apsn::log {
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Logger which writes compact binary records to a file
+ *
+ * Calls made with a format string and arguments do no formatting. Each
+ * format string is written to the file once, and after that a message is
+ * stored as the format's ID, the time, the thread and the raw argument
+ * values. Messages are buffered, and written out when the buffer fills, on
+ * `flush()`, and on destruction. Errors and fatal messages are flushed
+ * immediately. Those writes happen on the logging thread; wrap the logger in
+ * an `async_logger` to move them, and the lock, to its flusher.
+ *
+ * Use `binary_log_reader`, or the `wslogdump` tool, to turn a file back into
+ * text.
+ *
+ * \code {.cpp}
+        apsn::log::make_logger<apsn::log::async_logger>(
+            std::make_shared<apsn::log::binary_logger>(
+                "/var/log/webserial.blog", "webserial", apsn::log::level::trace));
+ * \endcode
+ */
+class binary_logger : public logger
+{
+public:
+    binary_logger(fs::path const & path,
+            std::string name,
+            level threshold = level::info,
+            std::size_t buffer_size = 64 * 1024);
+
+    ~binary_logger();
+
+    auto is_open() const -> bool
+    { return m_file.is_open(); }
+
+    auto flush() -> void;
+
+    auto do_log(level msg_level, std::string const & message)
+        -> void override;
+
+    auto write(record const & rec) -> void override;
+
+protected:
+    auto do_log_binary(level msg_level,
+            std::string_view format,
+            std::string_view args) -> void override;
+
+private:
+    struct format_entry
+    {
+        std::uint32_t id;
+        std::string text;
+    };
+
+    auto format_id(std::string_view format) -> std::uint32_t;
+    auto append(level msg_level,
+            std::uint32_t format,
+            std::int64_t when,
+            std::size_t thread,
+            std::string_view args) -> void;
+    auto flush_locked() -> void;
+
+    std::mutex m_mtx;
+    std::ofstream m_file;
+    std::string m_buffer;
+    std::size_t m_buffer_size;
+
+    /* Keyed by the address of the format string, which for literals is
+       stable; the text is compared in case it is not */
+    std::unordered_map<char const *, format_entry> m_formats;
+    std::uint32_t m_next_format = 0;
+    std::unordered_map<std::size_t, std::string> m_threads;
+};
+
+
+/**
+ * @brief Reads the records of a file written by `binary_logger`
+ */
+class binary_log_reader
+{
+public:
+    explicit binary_log_reader(std::istream & in);
+
+    /* False if the file did not start with a binary log header */
+    auto valid() const -> bool
+    { return m_valid; }
+
+    /**
+     * @brief The next message, formatted
+     *
+     * Returns nothing at the end of the file, or if the rest of the file is
+     * truncated or corrupt.
+     */
+    auto next() -> std::optional<record>;
+
+    /* Name of a thread, if the log recorded one */
+    auto thread_name(std::size_t id) const -> std::string;
+
+    /* Name of the logger which wrote the file */
+    auto name() const -> std::string
+    { return m_name; }
+
+private:
+    std::istream & m_in;
+    bool m_valid;
+    std::string m_name;
+    std::unordered_map<std::uint32_t, std::string> m_formats;
+    std::unordered_map<std::size_t, std::string> m_threads;
+};
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace apsn::log::detail {
+
+/* Type of each argument in a binary log message. Values are written in host
+   byte order straight after their tag. */
+enum class arg_tag : std::uint8_t
+{
+    int64     = 1,
+    uint64    = 2,
+    float64   = 3,
+    boolean   = 4,
+    character = 5,
+    string    = 6,  ///< u32 length, then the bytes
+    pointer   = 7,
+};
+
+
+template <typename T>
+auto put(std::string & out, T const & value) -> void
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    out.append(reinterpret_cast<char const *>(&value), sizeof(T));
+}
+
+
+inline
+auto put_string(std::string & out, std::string_view value) -> void
+{
+    put(out, arg_tag::string);
+    put(out, static_cast<std::uint32_t>(value.size()));
+    out.append(value);
+}
+
+
+/**
+ * @brief Append one formatting argument, without formatting it
+ *
+ * Arithmetic types, strings and pointers are stored raw. Anything else is
+ * formatted with `{}` and stored as a string.
+ */
+template <typename T>
+auto encode_arg(std::string & out, T const & value) -> void
+{
+    using type = std::remove_cvref_t<T>;
+
+    if constexpr (std::is_same_v<type, bool>) {
+        put(out, arg_tag::boolean);
+        put(out, static_cast<std::uint8_t>(value));
+    }
+    else if constexpr (std::is_same_v<type, char>) {
+        put(out, arg_tag::character);
+        put(out, value);
+    }
+    else if constexpr (std::is_integral_v<type> && std::is_signed_v<type>) {
+        put(out, arg_tag::int64);
+        put(out, static_cast<std::int64_t>(value));
+    }
+    else if constexpr (std::is_integral_v<type>) {
+        put(out, arg_tag::uint64);
+        put(out, static_cast<std::uint64_t>(value));
+    }
+    else if constexpr (std::is_floating_point_v<type>) {
+        put(out, arg_tag::float64);
+        put(out, static_cast<double>(value));
+    }
+    else if constexpr (std::is_convertible_v<T const &, std::string_view>) {
+        put_string(out, std::string_view{value});
+    }
+    else if constexpr (std::is_pointer_v<type>) {
+        put(out, arg_tag::pointer);
+        put(out, static_cast<std::uint64_t>(
+                reinterpret_cast<std::uintptr_t>(value)));
+    }
+    else {
+        put_string(out, fmt::format("{}", value));
+    }
+}
+
+
+/* Reused by each thread so that encoding does not allocate */
+inline
+auto args_buffer() -> std::string &
+{
+    thread_local auto buffer = std::string{};
+    buffer.clear();
+    return buffer;
+}
+
+}
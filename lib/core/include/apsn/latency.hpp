@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace apsn {
+
+/**
+ * @brief Histogram of durations, safe to record into from any thread
+ *
+ * Samples are counted in power-of-two microsecond buckets: bucket 0 holds
+ * samples under 1us, and bucket `n` holds samples in [2^(n-1), 2^n) us. The
+ * last bucket also holds everything larger. Recording is a handful of relaxed
+ * atomic operations, so it can sit on hot paths.
+ *
+ * \code {.cpp}
+        auto hist = apsn::latency_histogram{};
+        auto start = apsn::latency_histogram::clock::now();
+        do_work();
+        hist.record(apsn::latency_histogram::clock::now() - start);
+        auto p99 = hist.snapshot().percentile(0.99);
+ * \endcode
+ */
+class latency_histogram
+{
+public:
+    using clock = std::chrono::steady_clock;
+    using microseconds = std::chrono::microseconds;
+
+    constexpr static auto bucket_count = std::size_t{32};
+
+    struct summary
+    {
+        std::uint64_t count;
+        std::uint64_t sum_us;
+        std::uint64_t max_us;
+        std::array<std::uint64_t, bucket_count> buckets;
+
+        auto mean() const -> microseconds
+        { return microseconds{count == 0 ? 0 : sum_us / count}; }
+
+        auto max() const -> microseconds
+        { return microseconds{max_us}; }
+
+        /**
+         * @brief Upper bound of the bucket containing quantile `q`
+         */
+        auto percentile(double q) const -> microseconds
+        {
+            if (count == 0) {
+                return microseconds{0};
+            }
+            auto rank = static_cast<std::uint64_t>(q * static_cast<double>(count));
+            auto seen = std::uint64_t{0};
+            for (auto ii = std::size_t{0}; ii < bucket_count; ++ii) {
+                seen += buckets[ii];
+                if (seen > rank) {
+                    return microseconds{upper_bound(ii)};
+                }
+            }
+            return max();
+        }
+    };
+
+    auto record(clock::duration elapsed) -> void
+    {
+        auto us = std::chrono::duration_cast<microseconds>(elapsed).count();
+        auto value = us < 0 ? std::uint64_t{0} : static_cast<std::uint64_t>(us);
+
+        m_buckets[bucket_for(value)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+
+        auto max = m_max.load(std::memory_order_relaxed);
+        while (value > max &&
+               !m_max.compare_exchange_weak(max, value,
+                    std::memory_order_relaxed))
+        {}
+    }
+
+    auto snapshot() const -> summary
+    {
+        auto result = summary{
+            m_count.load(std::memory_order_relaxed),
+            m_sum.load(std::memory_order_relaxed),
+            m_max.load(std::memory_order_relaxed),
+            {}
+        };
+        for (auto ii = std::size_t{0}; ii < bucket_count; ++ii) {
+            result.buckets[ii] = m_buckets[ii].load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    constexpr static auto bucket_for(std::uint64_t us) -> std::size_t
+    {
+        auto width = static_cast<std::size_t>(std::bit_width(us));
+        return width < bucket_count ? width : bucket_count - 1;
+    }
+
+    constexpr static auto upper_bound(std::size_t bucket) -> std::uint64_t
+    { return std::uint64_t{1} << bucket; }
+
+private:
+    std::array<std::atomic<std::uint64_t>, bucket_count> m_buckets{};
+    std::atomic<std::uint64_t> m_count{0};
+    std::atomic<std::uint64_t> m_sum{0};
+    std::atomic<std::uint64_t> m_max{0};
+};
+
+}
@@ -1,12 +1,17 @@
 #pragma once
 
+#include <apsn/detail/binary_log.hpp>
+
 #include <fmt/core.h>
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <iosfwd>
 #include <filesystem>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <string_view>
 
 
@@ -22,11 +27,43 @@ enum class level
     trace = 8,
 };
 
+#ifndef APSN_LOG_MIN_LEVEL
+#define APSN_LOG_MIN_LEVEL 8
+#endif
+
+/**
+ * @brief Least severe level compiled in
+ *
+ * Set with the `APSN_LOG_MIN_LEVEL` CMake option. Messages below it are
+ * removed at compile time, whatever the runtime threshold.
+ */
+constexpr auto min_level = static_cast<level>(APSN_LOG_MIN_LEVEL);
+
+constexpr auto compiled(level lvl) -> bool
+{ return lvl <= min_level; }
+
 auto to_string(level lvl) -> std::string;
 auto level_from_string(std::string const & lvl) -> level;
 auto operator<<(std::ostream & lhs, level const & rhs) -> std::ostream&;
 auto operator>>(std::istream& lhs, level& rhs) -> std::istream&;
 
+
+/**
+ * @brief A formatted message, and where and when it was logged
+ */
+struct record
+{
+    level lvl;
+    std::chrono::system_clock::time_point when;
+    std::size_t thread;     ///< apsn::this_thread::id() of the logging thread
+    std::string message;
+
+    /* Only for binary loggers: if set, `message` is not yet formatted, but
+       holds the arguments for this format, encoded with detail::encode_arg */
+    std::string_view format = {};
+};
+
+
 class logger
 {
 public:
@@ -37,27 +74,51 @@ public:
     
     template <typename ... Args>
     auto fatal(fmt::format_string<Args...> format, Args && ... args) -> void
-    { return log(level::fatal, format, std::forward<Args>(args)...); }
+    {
+        if constexpr (compiled(level::fatal)) {
+            log(level::fatal, format, std::forward<Args>(args)...);
+        }
+    }
     
     template <typename ... Args>
     auto error(fmt::format_string<Args...> format, Args && ... args) -> void
-    { return log(level::error, format, std::forward<Args>(args)...); }
+    {
+        if constexpr (compiled(level::error)) {
+            log(level::error, format, std::forward<Args>(args)...);
+        }
+    }
     
     template <typename ... Args>
     auto warn(fmt::format_string<Args...> format, Args && ... args) -> void
-    { return log(level::warn, format, std::forward<Args>(args)...); }
+    {
+        if constexpr (compiled(level::warn)) {
+            log(level::warn, format, std::forward<Args>(args)...);
+        }
+    }
     
     template <typename ... Args>
     auto info(fmt::format_string<Args...> format, Args && ... args) -> void
-    { return log(level::info, format, std::forward<Args>(args)...); }
+    {
+        if constexpr (compiled(level::info)) {
+            log(level::info, format, std::forward<Args>(args)...);
+        }
+    }
     
     template <typename ... Args>
     auto debug(fmt::format_string<Args...> format, Args && ... args) -> void
-    { return log(level::debug, format, std::forward<Args>(args)...); }
+    {
+        if constexpr (compiled(level::debug)) {
+            log(level::debug, format, std::forward<Args>(args)...);
+        }
+    }
     
     template <typename ... Args>
     auto trace(fmt::format_string<Args...> format, Args && ... args) -> void
-    { return log(level::trace, format, std::forward<Args>(args)...); }
+    {
+        if constexpr (compiled(level::trace)) {
+            log(level::trace, format, std::forward<Args>(args)...);
+        }
+    }
 
 
     auto fatal(std::string const & msg) -> void;
@@ -67,49 +128,79 @@ public:
     auto debug(std::string const & msg) -> void;
     auto trace(std::string const & msg) -> void;
 
+    /* Formatting happens on the calling thread, outside of any lock. Binary
+       loggers are given the raw arguments instead. */
     template <typename ... Args>
     auto log(level msg_level, 
             fmt::format_string<Args...> format,
             Args && ... args)
         -> void
     {
-        if (msg_level <= m_threshold) {
-            auto lock = std::unique_lock<std::mutex>(m_mtx);
-            auto result = fmt::format(format, std::forward<Args>(args)...);
-            do_log(msg_level, std::move(result));
+        if (!enabled(msg_level)) {
+            return;
+        }
+        if (m_binary) {
+            auto & encoded = detail::args_buffer();
+            (detail::encode_arg(encoded, args), ...);
+            auto text = static_cast<fmt::string_view>(format);
+            do_log_binary(msg_level, {text.data(), text.size()}, encoded);
+        }
+        else {
+            do_log(msg_level, fmt::format(format, std::forward<Args>(args)...));
         }
     }
 
     auto log(level msg_level, std::string const & msg)
         -> void
     {
-        if (msg_level <= m_threshold) {
-            auto lock = std::unique_lock<std::mutex>(m_mtx);
+        if (enabled(msg_level)) {
             do_log(msg_level, msg);
         }
     }
 
-    auto threshold(level threshold)
-    { m_threshold = threshold; }
+    auto enabled(level msg_level) const -> bool
+    { return msg_level <= m_threshold.load(std::memory_order_relaxed); }
+
+    virtual auto threshold(level threshold) -> void
+    { m_threshold.store(threshold, std::memory_order_relaxed); }
 
     auto threshold() const -> log::level
-    { return m_threshold; }
+    { return m_threshold.load(std::memory_order_relaxed); }
 
     auto name() const -> std::string
     { return m_name; }
 
-    auto name(std::string name) -> void
+    virtual auto name(std::string name) -> void
     { m_name = name; }
 
+    /* Whether the logger is given raw arguments rather than messages */
+    auto binary() const -> bool
+    { return m_binary; }
+
+    /* Must be safe to call from several threads at once */
     virtual auto do_log(level msg_level, std::string const & message) 
         -> void = 0;
 
+    /**
+     * @brief Output a message which was logged earlier, possibly elsewhere
+     *
+     * The default ignores the time and thread of the record.
+     */
+    virtual auto write(record const & rec) -> void
+    { do_log(rec.lvl, rec.message); }
+
 protected:
+    /* For loggers which set `m_binary`: `args` holds the arguments encoded
+       with detail::encode_arg */
+    virtual auto do_log_binary(level, std::string_view, std::string_view)
+        -> void
+    {}
+
     std::string m_name;
+    bool m_binary = false;
 
 private:
-    level m_threshold;
-    std::mutex m_mtx;
+    std::atomic<level> m_threshold;
 };
 
 
@@ -122,11 +213,19 @@ public:
             std::string name,
             level threshold = level::info);
     ~coloured_cli_logger();
+
+    auto write(record const & rec) -> void final override;
+
 private:
     auto do_log(level msg_level, std::string const & message)
         -> void final override;
 
     std::ostream & m_out;
+    std::mutex m_mtx;
+
+    /* The formatted date only changes once a second */
+    std::chrono::system_clock::time_point m_second;
+    std::string m_date;
 };
 
 
@@ -161,37 +260,49 @@ auto make_logger(Args && ... args)
 template <typename ... Args>
 auto fatal(fmt::format_string<Args...> format, Args && ... args) -> void
 { 
-    return get_logger().fatal(format, std::forward<Args>(args)...);
+    if constexpr (compiled(level::fatal)) {
+        get_logger().fatal(format, std::forward<Args>(args)...);
+    }
 }
 
 template <typename ... Args>
 auto error(fmt::format_string<Args...> format, Args && ... args) -> void
 { 
-    return get_logger().error(format, std::forward<Args>(args)...);
+    if constexpr (compiled(level::error)) {
+        get_logger().error(format, std::forward<Args>(args)...);
+    }
 }
 
 template <typename ... Args>
 auto warn(fmt::format_string<Args...> format, Args && ... args) -> void
 { 
-    return get_logger().warn(format, std::forward<Args>(args)...);
+    if constexpr (compiled(level::warn)) {
+        get_logger().warn(format, std::forward<Args>(args)...);
+    }
 }
 
 template <typename ... Args>
 auto info(fmt::format_string<Args...> format, Args && ... args) -> void
 { 
-    return get_logger().info(format, std::forward<Args>(args)...);
+    if constexpr (compiled(level::info)) {
+        get_logger().info(format, std::forward<Args>(args)...);
+    }
 }
 
 template <typename ... Args>
 auto debug(fmt::format_string<Args...> format, Args && ... args) -> void
 { 
-    return get_logger().debug(format, std::forward<Args>(args)...);
+    if constexpr (compiled(level::debug)) {
+        get_logger().debug(format, std::forward<Args>(args)...);
+    }
 }
 
 template <typename ... Args>
 auto trace(fmt::format_string<Args...> format, Args && ... args) -> void
 { 
-    return get_logger().trace(format, std::forward<Args>(args)...);
+    if constexpr (compiled(level::trace)) {
+        get_logger().trace(format, std::forward<Args>(args)...);
+    }
 }
 
 /* For pybind11 and none fomrat string messages */
@@ -205,5 +316,29 @@ auto trace(std::string const & msg) -> void;
 }
 
 
-#define LOG_TRACE(...) apsn::log::trace ( __FILE__, ":", __LINE__, ": ", __VA_ARGS__)
+/**
+ * The macros below do not evaluate their arguments unless the message will
+ * be output, and compile to nothing below `APSN_LOG_MIN_LEVEL`. Prefer them
+ * on hot paths.
+ */
+#define APSN_LOG(lvl, ...)                                                  \
+    do {                                                                    \
+        if constexpr (::apsn::log::compiled(lvl)) {                         \
+            auto & apsn_logger_ = ::apsn::log::get_logger();                \
+            if (apsn_logger_.enabled(lvl)) {                                \
+                apsn_logger_.log(lvl, __VA_ARGS__);                         \
+            }                                                               \
+        }                                                                   \
+    } while (false)
+
+#define APSN_LOG_FATAL(...) APSN_LOG(::apsn::log::level::fatal, __VA_ARGS__)
+#define APSN_LOG_ERROR(...) APSN_LOG(::apsn::log::level::error, __VA_ARGS__)
+#define APSN_LOG_WARN(...)  APSN_LOG(::apsn::log::level::warn, __VA_ARGS__)
+#define APSN_LOG_INFO(...)  APSN_LOG(::apsn::log::level::info, __VA_ARGS__)
+#define APSN_LOG_DEBUG(...) APSN_LOG(::apsn::log::level::debug, __VA_ARGS__)
+#define APSN_LOG_TRACE(...) APSN_LOG(::apsn::log::level::trace, __VA_ARGS__)
+
+/* Trace prefixed with the file and line; the format must be a literal */
+#define LOG_TRACE(format, ...)                                              \
+    APSN_LOG_TRACE("{}:{}: " format, __FILE__, __LINE__ __VA_OPT__(,) __VA_ARGS__)
 
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace apsn {
+
+/**
+ * @brief Least-recently-used cache with a fixed number of entries
+ *
+ * Lookups and insertions are constant time. Once `capacity` entries are held,
+ * inserting a new key evicts the entry which was least recently looked up or
+ * inserted, so memory use is bounded by the capacity.
+ *
+ * The cache does no locking of its own.
+ *
+ * \code {.cpp}
+        auto cache = apsn::lru_cache<std::string, int>{2};
+        cache.put("a", 1);
+        cache.put("b", 2);
+        cache.get("a");     // 1, "a" is now most recently used
+        cache.put("c", 3);  // evicts "b"
+ * \endcode
+ *
+ * @tparam Key Key type; must be hashable with `Hash`
+ * @tparam Value Mapped type
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class lru_cache
+{
+    using entry = std::pair<Key, Value>;
+    using list_type = std::list<entry>;
+
+public:
+    explicit lru_cache(std::size_t capacity)
+        : m_capacity{capacity == 0 ? 1 : capacity}
+    {}
+
+    /**
+     * @brief Look up a key, marking it as most recently used
+     */
+    auto get(Key const & key) -> std::optional<Value>
+    {
+        auto it = m_index.find(key);
+        if (it == std::end(m_index)) {
+            return std::nullopt;
+        }
+        m_entries.splice(std::begin(m_entries), m_entries, it->second);
+        return it->second->second;
+    }
+
+    /**
+     * @brief Insert or replace a value, evicting the oldest entry if full
+     */
+    auto put(Key key, Value value) -> void
+    {
+        auto it = m_index.find(key);
+        if (it != std::end(m_index)) {
+            it->second->second = std::move(value);
+            m_entries.splice(std::begin(m_entries), m_entries, it->second);
+            return;
+        }
+
+        if (m_entries.size() == m_capacity) {
+            m_index.erase(m_entries.back().first);
+            m_entries.pop_back();
+        }
+        m_entries.emplace_front(std::move(key), std::move(value));
+        m_index.emplace(m_entries.front().first, std::begin(m_entries));
+    }
+
+    auto erase(Key const & key) -> bool
+    {
+        auto it = m_index.find(key);
+        if (it == std::end(m_index)) {
+            return false;
+        }
+        m_entries.erase(it->second);
+        m_index.erase(it);
+        return true;
+    }
+
+    auto clear() -> void
+    {
+        m_index.clear();
+        m_entries.clear();
+    }
+
+    auto size() const -> std::size_t
+    { return m_entries.size(); }
+
+    auto capacity() const -> std::size_t
+    { return m_capacity; }
+
+private:
+    std::size_t m_capacity;
+    list_type m_entries;
+    std::unordered_map<Key, typename list_type::iterator, Hash> m_index;
+};
+
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <apsn/thread.hpp>
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+
+namespace apsn::metrics {
+
+using labels = std::vector<std::pair<std::string, std::string>>;
+
+/* Updates are spread over this many cache lines, picked by thread */
+constexpr auto shard_count = std::size_t{8};
+
+namespace detail {
+
+inline auto shard() -> std::size_t
+{ return apsn::this_thread::id() % shard_count; }
+
+struct alignas(64) padded_counter
+{
+    std::atomic<std::uint64_t> value{0};
+};
+
+}
+
+
+/**
+ * @brief Monotonic count. Adding is a single relaxed atomic add.
+ */
+class counter
+{
+public:
+    auto add(std::uint64_t n = 1) -> void
+    { m_shards[detail::shard()].value.fetch_add(n, std::memory_order_relaxed); }
+
+    auto value() const -> std::uint64_t
+    {
+        auto total = std::uint64_t{0};
+        for (auto const & shard : m_shards) {
+            total += shard.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    std::array<detail::padded_counter, shard_count> m_shards;
+};
+
+
+/**
+ * @brief Value which can go up and down, such as a queue depth
+ */
+class gauge
+{
+public:
+    auto add(std::int64_t n = 1) -> void
+    { m_value.fetch_add(n, std::memory_order_relaxed); }
+
+    auto sub(std::int64_t n = 1) -> void
+    { m_value.fetch_sub(n, std::memory_order_relaxed); }
+
+    auto set(std::int64_t n) -> void
+    { m_value.store(n, std::memory_order_relaxed); }
+
+    auto value() const -> std::int64_t
+    { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::int64_t> m_value{0};
+};
+
+
+/**
+ * @brief Distribution of values in power-of-two buckets
+ *
+ * Bucket 0 counts values of 0 and 1, and bucket `n` values in
+ * (2^(n-1), 2^n]. The last bucket also counts everything larger.
+ */
+class histogram
+{
+public:
+    constexpr static auto bucket_count = std::size_t{32};
+
+    struct snapshot_type
+    {
+        std::array<std::uint64_t, bucket_count> buckets;
+        std::uint64_t count;
+        std::uint64_t sum;
+    };
+
+    auto observe(std::uint64_t value) -> void
+    {
+        auto & shard = m_shards[detail::shard()];
+        shard.buckets[bucket_for(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    auto snapshot() const -> snapshot_type;
+
+    constexpr static auto bucket_for(std::uint64_t value) -> std::size_t
+    {
+        auto width = value <= 1
+                ? std::size_t{0}
+                : static_cast<std::size_t>(std::bit_width(value - 1));
+        return width < bucket_count ? width : bucket_count - 1;
+    }
+
+    constexpr static auto upper_bound(std::size_t bucket) -> std::uint64_t
+    { return std::uint64_t{1} << bucket; }
+
+private:
+    struct alignas(64) shard
+    {
+        std::array<std::atomic<std::uint64_t>, bucket_count> buckets{};
+        std::atomic<std::uint64_t> sum{0};
+    };
+
+    std::array<shard, shard_count> m_shards;
+};
+
+
+/**
+ * @brief Named metrics, rendered in the Prometheus text format
+ *
+ * Looking up a metric takes a lock, so callers should keep the returned
+ * reference, which stays valid for the life of the registry, rather than
+ * looking it up on every update.
+ *
+ * \code {.cpp}
+        auto & rx = apsn::metrics::default_registry().counter(
+            "serial_rx_bytes_total", "Bytes read", {{"port", "/dev/ttyS0"}});
+        rx.add(len);
+ * \endcode
+ */
+class registry
+{
+public:
+    auto counter(std::string const & name,
+            std::string const & help,
+            labels const & lbls = {}) -> metrics::counter &;
+
+    auto gauge(std::string const & name,
+            std::string const & help,
+            labels const & lbls = {}) -> metrics::gauge &;
+
+    /* `scale` converts observed values to the exported unit, for example
+       1e-6 for microseconds observed but exported as seconds */
+    auto histogram(std::string const & name,
+            std::string const & help,
+            labels const & lbls = {},
+            double scale = 1.0) -> metrics::histogram &;
+
+    /* Version 0.0.4 of the text exposition format */
+    auto render() const -> std::string;
+
+private:
+    using metric = std::variant<
+        std::unique_ptr<metrics::counter>,
+        std::unique_ptr<metrics::gauge>,
+        std::unique_ptr<metrics::histogram>>;
+
+    struct family
+    {
+        std::string help;
+        std::size_t kind;
+        double scale;
+        std::map<labels, metric> series;
+    };
+
+    template <typename T>
+    auto get(std::string const & name,
+            std::string const & help,
+            labels const & lbls,
+            double scale) -> T &;
+
+    mutable std::mutex m_mtx;
+    std::map<std::string, family> m_families;
+};
+
+
+auto default_registry() -> registry &;
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace apsn {
+
+/**
+ * @brief Bounded, lock-free queue for one producer thread and one consumer
+ *
+ * The capacity is rounded up to a power of two. Neither end ever blocks:
+ * `try_push` fails when the queue is full, and `try_pop` when it is empty.
+ *
+ * \code {.cpp}
+        auto queue = apsn::spsc_queue<std::string>{1024};
+        queue.try_push("message");     // producer thread
+        auto next = queue.try_pop();   // consumer thread
+ * \endcode
+ */
+template <typename T>
+class spsc_queue
+{
+public:
+    explicit spsc_queue(std::size_t capacity)
+        : m_mask{std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity) - 1}
+        , m_slots{std::make_unique<std::optional<T>[]>(m_mask + 1)}
+    {}
+
+    spsc_queue(spsc_queue const &) = delete;
+    auto operator=(spsc_queue const &) -> spsc_queue & = delete;
+
+    template <typename U>
+    auto try_push(U && value) -> bool
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head_cache > m_mask) {
+            m_head_cache = m_head.load(std::memory_order_acquire);
+            if (tail - m_head_cache > m_mask) {
+                return false;
+            }
+        }
+        m_slots[tail & m_mask].emplace(std::forward<U>(value));
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    auto try_pop() -> std::optional<T>
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail_cache) {
+            m_tail_cache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tail_cache) {
+                return std::nullopt;
+            }
+        }
+        auto & slot = m_slots[head & m_mask];
+        auto result = std::move(slot);
+        slot.reset();
+        m_head.store(head + 1, std::memory_order_release);
+        return result;
+    }
+
+    /* Only exact when called from the consumer, with the producer idle */
+    auto empty() const -> bool
+    {
+        return m_head.load(std::memory_order_acquire) ==
+               m_tail.load(std::memory_order_acquire);
+    }
+
+    auto capacity() const -> std::size_t
+    { return m_mask + 1; }
+
+private:
+    /* Keep the producer's and consumer's indices on separate cache lines */
+    constexpr static auto line = std::size_t{64};
+
+    std::size_t const m_mask;
+    std::unique_ptr<std::optional<T>[]> m_slots;
+
+    alignas(line) std::atomic<std::size_t> m_head{0};
+    std::size_t m_tail_cache{0};
+
+    alignas(line) std::atomic<std::size_t> m_tail{0};
+    std::size_t m_head_cache{0};
+};
+
+}
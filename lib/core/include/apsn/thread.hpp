@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+namespace apsn {
+
+namespace detail {
+
+auto next_thread_id() -> std::size_t;
+
+}
+
+/**
+ * @brief Name of the thread with the given `this_thread::id()`
+ *
+ * Threads which were never named are called `Thread-<id>`. Names outlive
+ * their threads, so this can be used for records logged by a thread which
+ * has since exited.
+ */
+auto thread_name(std::size_t id) -> std::string;
+
+namespace this_thread {
+
+/**
+ * @brief Small number identifying the calling thread
+ *
+ * Numbers are handed out in the order threads first ask for one, starting
+ * from 0, and are never reused.
+ */
+inline auto id() -> std::size_t
+{
+    thread_local auto const value = detail::next_thread_id();
+    return value;
+}
+
+/**
+ * @brief Name the calling thread, for log output and for tools like `top`
+ *
+ * The kernel's copy of the name is truncated to 15 characters.
+ */
+auto set_name(std::string name) -> void;
+
+auto name() -> std::string;
+
+}
+
+}
@@ -67,6 +67,7 @@ auto ansi::to_string(fe code) -> std::string
 auto ansi::to_string(csi_final code) -> std::string
 {
     auto mapped = std::map<csi_final, std::string>{
+        { csi_final::ICH,   "ICH"   }, 
         { csi_final::CUU,   "CUU"   }, 
         { csi_final::CUD,   "CUD"   }, 
         { csi_final::CUF,   "CUF"   }, 
@@ -77,12 +78,23 @@ auto ansi::to_string(csi_final code) -> std::string
         { csi_final::CUP,   "CUP"   }, 
         { csi_final::ED,    "ED"    }, 
         { csi_final::EL,    "EL"    }, 
+        { csi_final::IL,    "IL"    }, 
+        { csi_final::DL,    "DL"    }, 
+        { csi_final::DCH,   "DCH"   }, 
         { csi_final::SU,    "SU"    }, 
         { csi_final::SD,    "SD"    }, 
+        { csi_final::ECH,   "ECH"   }, 
+        { csi_final::HPA,   "HPA"   }, 
+        { csi_final::VPA,   "VPA"   }, 
         { csi_final::HVP,   "HVP"   }, 
+        { csi_final::SM,    "SM"    }, 
+        { csi_final::RM,    "RM"    }, 
         { csi_final::SGR,   "SGR"   }, 
         { csi_final::AUX,   "AUX"   }, 
         { csi_final::DSR,   "DSR"   }, 
+        { csi_final::DECSTBM, "DECSTBM" }, 
+        { csi_final::SCP,   "SCP"   }, 
+        { csi_final::RCP,   "RCP"   }, 
     };
     return mapped.at(code);
 }
@@ -0,0 +1,216 @@
+#include "async_logger.hpp"
+
+#include <apsn/thread.hpp>
+
+#include <algorithm>
+#include <utility>
+
+
+using apsn::log::async_logger;
+using apsn::log::level;
+using apsn::log::record;
+
+
+struct async_logger::queue
+{
+    explicit queue(std::size_t size)
+        : records{size}
+    {}
+
+    spsc_queue<record> records;
+
+    /* Set once the producing thread has exited */
+    std::atomic<bool> closed{false};
+};
+
+
+namespace {
+
+auto next_id() -> std::uint64_t
+{
+    static auto counter = std::atomic<std::uint64_t>{0};
+    return ++counter;
+}
+
+}
+
+
+async_logger::async_logger(std::shared_ptr<logger> sink,
+        std::size_t queue_size,
+        std::chrono::milliseconds interval)
+    : logger{sink->name(), sink->threshold()}
+    , m_sink{std::move(sink)}
+    , m_queue_size{queue_size}
+    , m_interval{interval}
+    , m_id{next_id()}
+{
+    m_binary = m_sink->binary();
+    m_flusher = std::thread{[this] {
+        apsn::this_thread::set_name("log");
+        run();
+    }};
+}
+
+
+async_logger::~async_logger()
+{
+    {
+        auto lock = std::lock_guard{m_wake_mtx};
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_flusher.join();
+}
+
+
+auto async_logger::threshold(level threshold) -> void
+{
+    logger::threshold(threshold);
+    m_sink->threshold(threshold);
+}
+
+
+auto async_logger::name(std::string name) -> void
+{
+    logger::name(name);
+    m_sink->name(std::move(name));
+}
+
+
+auto async_logger::local_queue() -> queue *
+{
+    /* A thread's queues, one per async_logger it has used. They are marked as
+       closed when it exits, so that the flusher can let go of them. */
+    struct thread_queues
+    {
+        ~thread_queues()
+        {
+            for (auto & [id, q] : entries) {
+                q->closed.store(true, std::memory_order_release);
+            }
+        }
+        std::vector<std::pair<std::uint64_t, std::shared_ptr<queue>>> entries;
+    };
+    thread_local auto local = thread_queues{};
+
+    for (auto & [id, q] : local.entries) {
+        if (id == m_id) {
+            return q.get();
+        }
+    }
+
+    auto created = std::make_shared<queue>(m_queue_size);
+    {
+        auto lock = std::lock_guard{m_queues_mtx};
+        m_queues.push_back(created);
+    }
+    local.entries.emplace_back(m_id, created);
+    return created.get();
+}
+
+
+auto async_logger::do_log(level msg_level, std::string const & message)
+    -> void
+{
+    write(record{
+        msg_level,
+        std::chrono::system_clock::now(),
+        apsn::this_thread::id(),
+        message
+    });
+}
+
+
+auto async_logger::do_log_binary(level msg_level,
+        std::string_view format,
+        std::string_view args) -> void
+{
+    write(record{
+        msg_level,
+        std::chrono::system_clock::now(),
+        apsn::this_thread::id(),
+        std::string{args},
+        format
+    });
+}
+
+
+auto async_logger::write(record const & rec) -> void
+{
+    if (!local_queue()->records.try_push(rec)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (rec.lvl <= level::error) {
+        {
+            auto lock = std::lock_guard{m_wake_mtx};
+            m_urgent = true;
+        }
+        m_wake.notify_one();
+    }
+}
+
+
+auto async_logger::flush() -> void
+{
+    drain();
+}
+
+
+auto async_logger::drain() -> void
+{
+    auto drain_lock = std::lock_guard{m_drain_mtx};
+
+    auto queues = std::vector<std::shared_ptr<queue>>{};
+    {
+        auto lock = std::lock_guard{m_queues_mtx};
+        queues = m_queues;
+    }
+
+    /* Interleave the threads' messages in the order they were logged */
+    auto records = std::vector<record>{};
+    for (auto & q : queues) {
+        while (auto rec = q->records.try_pop()) {
+            records.push_back(std::move(*rec));
+        }
+    }
+    std::stable_sort(std::begin(records), std::end(records),
+        [](record const & lhs, record const & rhs) {
+            return lhs.when < rhs.when;
+        });
+    for (auto & rec : records) {
+        m_sink->write(rec);
+    }
+
+    auto dropped = m_dropped.load(std::memory_order_relaxed);
+    if (dropped != m_reported) {
+        m_sink->write(record{
+            level::warn,
+            std::chrono::system_clock::now(),
+            apsn::this_thread::id(),
+            fmt::format("{} log messages dropped", dropped - m_reported)
+        });
+        m_reported = dropped;
+    }
+
+    auto lock = std::lock_guard{m_queues_mtx};
+    std::erase_if(m_queues, [](auto const & q) {
+        return q->closed.load(std::memory_order_acquire) && q->records.empty();
+    });
+}
+
+
+auto async_logger::run() -> void
+{
+    auto lock = std::unique_lock{m_wake_mtx};
+    while (!m_stop) {
+        m_wake.wait_for(lock, m_interval, [this] {
+            return m_stop || m_urgent;
+        });
+        m_urgent = false;
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+    lock.unlock();
+    drain();
+}
@@ -0,0 +1,407 @@
+#include "binary_logger.hpp"
+
+#include <apsn/thread.hpp>
+
+#include <fmt/args.h>
+#include <fmt/format.h>
+
+#include <chrono>
+#include <istream>
+#include <utility>
+
+
+using apsn::log::binary_log_reader;
+using apsn::log::binary_logger;
+using apsn::log::level;
+using apsn::log::record;
+
+namespace detail = apsn::log::detail;
+
+
+/*
+ * File layout, all integers in host byte order:
+ *
+ *     header:  "APSNBLOG" u16 version, u32 length, logger name
+ *     format:  u8 1, u32 id, u32 length, format string
+ *     thread:  u8 2, u64 id, u32 length, thread name
+ *     message: u8 3, u8 level, u32 format id, i64 ns since the epoch,
+ *              u64 thread id, u32 length, arguments (see detail::arg_tag)
+ *
+ * Formats and threads are defined before the first message using them.
+ */
+namespace {
+
+constexpr auto magic = std::string_view{"APSNBLOG"};
+constexpr auto version = std::uint16_t{1};
+
+enum class entry : std::uint8_t
+{
+    format  = 1,
+    thread  = 2,
+    message = 3,
+};
+
+/* Used for messages which were formatted before reaching the logger */
+constexpr char const preformatted[] = "{}";
+
+
+auto nanoseconds(std::chrono::system_clock::time_point when) -> std::int64_t
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            when.time_since_epoch()).count();
+}
+
+
+template <typename T>
+auto get(std::istream & in, T & value) -> bool
+{
+    return static_cast<bool>(
+        in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+
+auto get_string(std::istream & in, std::string & value) -> bool
+{
+    auto length = std::uint32_t{};
+    if (!get(in, length)) {
+        return false;
+    }
+    value.resize(length);
+    return static_cast<bool>(in.read(value.data(), length));
+}
+
+
+/* Reads from a message's argument bytes */
+class arg_cursor
+{
+public:
+    explicit arg_cursor(std::string_view data)
+        : m_data{data}
+    {}
+
+    auto done() const -> bool
+    { return m_data.empty(); }
+
+    template <typename T>
+    auto get(T & value) -> bool
+    {
+        if (m_data.size() < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, m_data.data(), sizeof(T));
+        m_data.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    auto get_string(std::string & value) -> bool
+    {
+        auto length = std::uint32_t{};
+        if (!get(length) || m_data.size() < length) {
+            return false;
+        }
+        value.assign(m_data.substr(0, length));
+        m_data.remove_prefix(length);
+        return true;
+    }
+
+private:
+    std::string_view m_data;
+};
+
+
+auto decode_args(std::string_view data,
+        fmt::dynamic_format_arg_store<fmt::format_context> & store) -> bool
+{
+    using detail::arg_tag;
+
+    auto cursor = arg_cursor{data};
+    while (!cursor.done()) {
+        auto tag = arg_tag{};
+        if (!cursor.get(tag)) {
+            return false;
+        }
+        switch (tag) {
+        case arg_tag::int64: {
+            auto value = std::int64_t{};
+            if (!cursor.get(value)) { return false; }
+            store.push_back(value);
+            break;
+        }
+        case arg_tag::uint64: {
+            auto value = std::uint64_t{};
+            if (!cursor.get(value)) { return false; }
+            store.push_back(value);
+            break;
+        }
+        case arg_tag::float64: {
+            auto value = double{};
+            if (!cursor.get(value)) { return false; }
+            store.push_back(value);
+            break;
+        }
+        case arg_tag::boolean: {
+            auto value = std::uint8_t{};
+            if (!cursor.get(value)) { return false; }
+            store.push_back(value != 0);
+            break;
+        }
+        case arg_tag::character: {
+            auto value = char{};
+            if (!cursor.get(value)) { return false; }
+            store.push_back(value);
+            break;
+        }
+        case arg_tag::string: {
+            auto value = std::string{};
+            if (!cursor.get_string(value)) { return false; }
+            store.push_back(std::move(value));
+            break;
+        }
+        case arg_tag::pointer: {
+            auto value = std::uint64_t{};
+            if (!cursor.get(value)) { return false; }
+            store.push_back(reinterpret_cast<void const *>(
+                    static_cast<std::uintptr_t>(value)));
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+
+binary_logger::binary_logger(fs::path const & path,
+        std::string name,
+        level threshold,
+        std::size_t buffer_size)
+    : logger{name, threshold}
+    , m_file{path, std::ios::binary | std::ios::trunc}
+    , m_buffer{}
+    , m_buffer_size{buffer_size}
+{
+    m_binary = true;
+    m_buffer.reserve(m_buffer_size);
+    m_buffer.append(magic);
+    detail::put(m_buffer, version);
+    detail::put(m_buffer, static_cast<std::uint32_t>(name.size()));
+    m_buffer.append(name);
+}
+
+
+binary_logger::~binary_logger()
+{
+    flush();
+}
+
+
+auto binary_logger::flush() -> void
+{
+    auto lock = std::lock_guard{m_mtx};
+    flush_locked();
+}
+
+
+auto binary_logger::flush_locked() -> void
+{
+    if (!m_buffer.empty() && m_file.is_open()) {
+        m_file.write(m_buffer.data(),
+                static_cast<std::streamsize>(m_buffer.size()));
+        m_file.flush();
+    }
+    m_buffer.clear();
+}
+
+
+auto binary_logger::do_log(level msg_level, std::string const & message)
+    -> void
+{
+    write(record{
+        msg_level,
+        std::chrono::system_clock::now(),
+        apsn::this_thread::id(),
+        message
+    });
+}
+
+
+auto binary_logger::write(record const & rec) -> void
+{
+    if (!rec.format.empty()) {
+        auto lock = std::lock_guard{m_mtx};
+        append(rec.lvl, format_id(rec.format), nanoseconds(rec.when),
+                rec.thread, rec.message);
+        return;
+    }
+
+    auto & encoded = detail::args_buffer();
+    detail::encode_arg(encoded, rec.message);
+
+    auto lock = std::lock_guard{m_mtx};
+    append(rec.lvl, format_id(preformatted), nanoseconds(rec.when),
+            rec.thread, encoded);
+}
+
+
+auto binary_logger::do_log_binary(level msg_level,
+        std::string_view format,
+        std::string_view args) -> void
+{
+    auto when = nanoseconds(std::chrono::system_clock::now());
+    auto thread = apsn::this_thread::id();
+
+    auto lock = std::lock_guard{m_mtx};
+    append(msg_level, format_id(format), when, thread, args);
+}
+
+
+auto binary_logger::format_id(std::string_view format) -> std::uint32_t
+{
+    auto it = m_formats.find(format.data());
+    if (it != std::end(m_formats) && it->second.text == format) {
+        return it->second.id;
+    }
+
+    auto id = m_next_format++;
+    m_formats.insert_or_assign(format.data(),
+            format_entry{id, std::string{format}});
+
+    detail::put(m_buffer, entry::format);
+    detail::put(m_buffer, id);
+    detail::put(m_buffer, static_cast<std::uint32_t>(format.size()));
+    m_buffer.append(format);
+    return id;
+}
+
+
+auto binary_logger::append(level msg_level,
+        std::uint32_t format,
+        std::int64_t when,
+        std::size_t thread,
+        std::string_view args) -> void
+{
+    if (!m_threads.contains(thread)) {
+        auto name = apsn::thread_name(thread);
+        detail::put(m_buffer, entry::thread);
+        detail::put(m_buffer, static_cast<std::uint64_t>(thread));
+        detail::put(m_buffer, static_cast<std::uint32_t>(name.size()));
+        m_buffer.append(name);
+        m_threads.emplace(thread, std::move(name));
+    }
+
+    detail::put(m_buffer, entry::message);
+    detail::put(m_buffer, static_cast<std::uint8_t>(msg_level));
+    detail::put(m_buffer, format);
+    detail::put(m_buffer, when);
+    detail::put(m_buffer, static_cast<std::uint64_t>(thread));
+    detail::put(m_buffer, static_cast<std::uint32_t>(args.size()));
+    m_buffer.append(args);
+
+    if (m_buffer.size() >= m_buffer_size || msg_level <= level::error) {
+        flush_locked();
+    }
+}
+
+
+
+
+binary_log_reader::binary_log_reader(std::istream & in)
+    : m_in{in}
+    , m_valid{false}
+{
+    auto header = std::string(magic.size(), '\0');
+    auto file_version = std::uint16_t{};
+    m_valid = m_in.read(header.data(), header.size()) &&
+              header == magic &&
+              get(m_in, file_version) &&
+              file_version == version &&
+              get_string(m_in, m_name);
+}
+
+
+auto binary_log_reader::next() -> std::optional<record>
+{
+    if (!m_valid) {
+        return std::nullopt;
+    }
+
+    auto kind = entry{};
+    while (get(m_in, kind)) {
+        switch (kind) {
+        case entry::format: {
+            auto id = std::uint32_t{};
+            auto text = std::string{};
+            if (!get(m_in, id) || !get_string(m_in, text)) {
+                return std::nullopt;
+            }
+            m_formats[id] = std::move(text);
+            break;
+        }
+        case entry::thread: {
+            auto id = std::uint64_t{};
+            auto name = std::string{};
+            if (!get(m_in, id) || !get_string(m_in, name)) {
+                return std::nullopt;
+            }
+            m_threads[id] = std::move(name);
+            break;
+        }
+        case entry::message: {
+            auto lvl = std::uint8_t{};
+            auto format = std::uint32_t{};
+            auto when = std::int64_t{};
+            auto thread = std::uint64_t{};
+            auto args = std::string{};
+            if (!get(m_in, lvl) || !get(m_in, format) || !get(m_in, when) ||
+                !get(m_in, thread) || !get_string(m_in, args))
+            {
+                return std::nullopt;
+            }
+
+            auto text = m_formats.find(format);
+            auto store = fmt::dynamic_format_arg_store<fmt::format_context>{};
+            auto message = std::string{};
+            if (text == std::end(m_formats)) {
+                message = fmt::format("<unknown format {}>", format);
+            }
+            else if (!decode_args(args, store)) {
+                message = fmt::format("<corrupt arguments> {}", text->second);
+            }
+            else {
+                try {
+                    message = fmt::vformat(text->second, store);
+                }
+                catch (fmt::format_error const & err) {
+                    message = fmt::format("<{}> {}", err.what(), text->second);
+                }
+            }
+
+            return record{
+                static_cast<level>(lvl),
+                std::chrono::system_clock::time_point{
+                    std::chrono::duration_cast<
+                        std::chrono::system_clock::duration>(
+                            std::chrono::nanoseconds{when})},
+                static_cast<std::size_t>(thread),
+                std::move(message)
+            };
+        }
+        default:
+            return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+
+auto binary_log_reader::thread_name(std::size_t id) const -> std::string
+{
+    auto it = m_threads.find(id);
+    if (it != std::end(m_threads)) {
+        return it->second;
+    }
+    return fmt::format("Thread-{}", id);
+}
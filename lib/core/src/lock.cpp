@@ -341,7 +341,7 @@ apsn::multiprocess_mutex::~multiprocess_mutex()
                 "Error destroying mutex");
     }
     if (err) {
-        /* TODO */ apsn::log::debug("Error closing shared lock: ", err.message());
+        /* TODO */ apsn::log::debug("Error closing shared lock: {}", err.message());
     }
 }
 
@@ -352,7 +352,7 @@ auto apsn::multiprocess_mutex::lock() -> void
     if (err) {
         throw std::system_error{err};
     }
-    LOG_TRACE("Success creating lock, lock count: ",
+    LOG_TRACE("Success creating lock, lock count: {}",
             pimpl->m_counter);
 }
 
@@ -368,7 +368,7 @@ auto apsn::multiprocess_mutex::unlock() -> void
     if (err) {
         throw std::system_error{err};
     }
-    LOG_TRACE("Successfully unlocked shared lock, lock count: ",
+    LOG_TRACE("Successfully unlocked shared lock, lock count: {}",
             pimpl->m_counter);
 }
 
@@ -389,7 +389,7 @@ auto apsn::multiprocess_mutex::timed_lock(std::time_t seconds_since_epoch,
 
     auto buf = std::stringstream{};
     buf << std::put_time(std::localtime(&tt), "%Y-%m-%d %X");
-    LOG_TRACE("Try locking until ", buf.str());
+    LOG_TRACE("Try locking until {}", buf.str());
 
     auto ts = timespec {seconds_since_epoch, nanoseconds};
     auto rv = 0;
@@ -2,16 +2,17 @@
 
 #include <apsn/ansi.hpp>
 #include <apsn/fmt.hpp>
+#include <apsn/thread.hpp>
 
 #include <fmt/chrono.h>
 
+#include <chrono>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <string>
-#include <thread>
 
 
 using apsn::log::coloured_cli_logger;
@@ -137,49 +138,40 @@ coloured_cli_logger::~coloured_cli_logger()
 }
 
 
-struct thread_number
-{
-    static std::size_t counter;
-
-    thread_number()
-        : m_number{counter++}
-    {}
-
-    operator std::size_t()
-    {
-        return m_number;
-    }
-
-    std::size_t m_number;
-};
-
-std::size_t thread_number::counter = 0ull;
-
-auto get_thread_number() -> std::size_t
+auto coloured_cli_logger::do_log(level msg_level, std::string const & message)
+    -> void
 {
-    static auto map = std::map<std::thread::id, thread_number>{};
-    return map[std::this_thread::get_id()];
+    write(record{
+        msg_level,
+        std::chrono::system_clock::now(),
+        apsn::this_thread::id(),
+        message
+    });
 }
 
 
-auto coloured_cli_logger::do_log(level msg_level, std::string const & message)
-    -> void
+auto coloured_cli_logger::write(record const & rec) -> void
 {
-    auto time = std::time(nullptr);
-    auto tm = fmt::localtime(time);
-    auto date = fmt::format("[{:%Y-%m-%d %H:%M:%S}]", tm);
+    auto second = std::chrono::floor<std::chrono::seconds>(rec.when);
     auto str = std::string{};
     str.reserve(128);
 
     auto it = std::back_inserter(str);
 
-    fmt::format_to(it, "{}{}{} ", ansi::italic, date, ansi::reset);
+    auto lock = std::lock_guard{m_mtx};
+    if (m_date.empty() || second != m_second) {
+        auto tm = fmt::localtime(std::chrono::system_clock::to_time_t(second));
+        m_date = fmt::format("[{:%Y-%m-%d %H:%M:%S}]", tm);
+        m_second = second;
+    }
+
+    fmt::format_to(it, "{}{}{} ", ansi::italic, m_date, ansi::reset);
     if (threshold() == level::trace) {
-        fmt::format_to(it, "[Thread-{}] ", get_thread_number());
+        fmt::format_to(it, "[{}] ", apsn::thread_name(rec.thread));
     }
     fmt::format_to(it, "{}{}: ", ansi::bold, m_name);
 
-    switch (msg_level) {
+    switch (rec.lvl) {
     case level::fatal: fmt::format_to(it, "{}fatal: ", ansi::red); break;
     case level::error: fmt::format_to(it, "{}error: ", ansi::red); break;
     case level::warn:  fmt::format_to(it, "{}warn:  ", ansi::yellow);  break;
@@ -187,7 +179,7 @@ auto coloured_cli_logger::do_log(level msg_level, std::string const & message)
     case level::debug: fmt::format_to(it, "{}debug: ", ansi::cyan); break;
     case level::trace: fmt::format_to(it, "{}trace: ", ansi::magenta); break;
     }
-    fmt::format_to(it, "{}{}\n", ansi::reset, message);
+    fmt::format_to(it, "{}{}\n", ansi::reset, rec.message);
     
     m_out << str;
 }
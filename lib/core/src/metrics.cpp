@@ -0,0 +1,184 @@
+#include "metrics.hpp"
+
+#include <fmt/core.h>
+
+#include <iterator>
+#include <stdexcept>
+
+
+using apsn::metrics::histogram;
+using apsn::metrics::registry;
+
+
+namespace {
+
+constexpr char const * kind_names[] = {"counter", "gauge", "histogram"};
+
+
+auto escape(std::string const & value) -> std::string
+{
+    auto result = std::string{};
+    result.reserve(value.size());
+    for (auto c : value) {
+        switch (c) {
+        case '\\': result += "\\\\"; break;
+        case '"':  result += "\\\""; break;
+        case '\n': result += "\\n";  break;
+        default:   result += c;
+        }
+    }
+    return result;
+}
+
+
+/* `{a="b",c="d"}`, with `extra` appended, or nothing if there are no labels */
+auto format_labels(apsn::metrics::labels const & lbls,
+        std::string const & extra = {}) -> std::string
+{
+    if (lbls.empty() && extra.empty()) {
+        return {};
+    }
+    auto result = std::string{"{"};
+    for (auto const & [key, value] : lbls) {
+        if (result.size() > 1) {
+            result += ',';
+        }
+        result += fmt::format("{}=\"{}\"", key, escape(value));
+    }
+    if (!extra.empty()) {
+        if (result.size() > 1) {
+            result += ',';
+        }
+        result += extra;
+    }
+    result += '}';
+    return result;
+}
+
+}
+
+
+auto histogram::snapshot() const -> snapshot_type
+{
+    auto result = snapshot_type{};
+    for (auto const & shard : m_shards) {
+        for (auto ii = std::size_t{0}; ii < bucket_count; ++ii) {
+            auto n = shard.buckets[ii].load(std::memory_order_relaxed);
+            result.buckets[ii] += n;
+            result.count += n;
+        }
+        result.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+
+template <typename T>
+auto registry::get(std::string const & name,
+        std::string const & help,
+        labels const & lbls,
+        double scale) -> T &
+{
+    constexpr auto kind = std::is_same_v<T, metrics::counter> ? 0
+                        : std::is_same_v<T, metrics::gauge>   ? 1
+                        : 2;
+
+    auto lock = std::lock_guard{m_mtx};
+    auto [fam, created] = m_families.try_emplace(name,
+            family{help, kind, scale, {}});
+    if (!created && fam->second.kind != kind) {
+        throw std::logic_error{fmt::format(
+            "Metric {} is a {}, not a {}",
+            name, kind_names[fam->second.kind], kind_names[kind])};
+    }
+
+    auto & series = fam->second.series;
+    auto it = series.find(lbls);
+    if (it == std::end(series)) {
+        it = series.emplace(lbls, std::make_unique<T>()).first;
+    }
+    return *std::get<std::unique_ptr<T>>(it->second);
+}
+
+
+auto registry::counter(std::string const & name,
+        std::string const & help,
+        labels const & lbls) -> metrics::counter &
+{
+    return get<metrics::counter>(name, help, lbls, 1.0);
+}
+
+
+auto registry::gauge(std::string const & name,
+        std::string const & help,
+        labels const & lbls) -> metrics::gauge &
+{
+    return get<metrics::gauge>(name, help, lbls, 1.0);
+}
+
+
+auto registry::histogram(std::string const & name,
+        std::string const & help,
+        labels const & lbls,
+        double scale) -> metrics::histogram &
+{
+    return get<metrics::histogram>(name, help, lbls, scale);
+}
+
+
+auto registry::render() const -> std::string
+{
+    auto out = std::string{};
+    auto it = std::back_inserter(out);
+
+    auto lock = std::lock_guard{m_mtx};
+    for (auto const & [name, fam] : m_families) {
+        fmt::format_to(it, "# HELP {} {}\n", name, fam.help);
+        fmt::format_to(it, "# TYPE {} {}\n", name, kind_names[fam.kind]);
+
+        for (auto const & [lbls, metric] : fam.series) {
+            switch (metric.index()) {
+            case 0:
+                fmt::format_to(it, "{}{} {}\n", name, format_labels(lbls),
+                        std::get<0>(metric)->value());
+                break;
+            case 1:
+                fmt::format_to(it, "{}{} {}\n", name, format_labels(lbls),
+                        std::get<1>(metric)->value());
+                break;
+            case 2: {
+                auto snap = std::get<2>(metric)->snapshot();
+                auto cumulative = std::uint64_t{0};
+                /* The last bucket is unbounded, so it is only reported as
+                   +Inf */
+                for (auto ii = std::size_t{0};
+                     ii + 1 < metrics::histogram::bucket_count;
+                     ++ii)
+                {
+                    cumulative += snap.buckets[ii];
+                    auto le = static_cast<double>(
+                            metrics::histogram::upper_bound(ii)) * fam.scale;
+                    fmt::format_to(it, "{}_bucket{} {}\n", name,
+                            format_labels(lbls, fmt::format("le=\"{}\"", le)),
+                            cumulative);
+                }
+                fmt::format_to(it, "{}_bucket{} {}\n", name,
+                        format_labels(lbls, "le=\"+Inf\""), snap.count);
+                fmt::format_to(it, "{}_sum{} {}\n", name, format_labels(lbls),
+                        static_cast<double>(snap.sum) * fam.scale);
+                fmt::format_to(it, "{}_count{} {}\n", name, format_labels(lbls),
+                        snap.count);
+                break;
+            }
+            }
+        }
+    }
+    return out;
+}
+
+
+auto apsn::metrics::default_registry() -> registry &
+{
+    static auto instance = registry{};
+    return instance;
+}
@@ -0,0 +1,66 @@
+#include "thread.hpp"
+
+#include <fmt/core.h>
+
+#include <pthread.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+
+namespace {
+
+/* Only touched when naming a thread, or by log output */
+struct name_registry
+{
+    std::mutex mtx;
+    std::unordered_map<std::size_t, std::string> names;
+};
+
+auto registry() -> name_registry &
+{
+    static auto instance = name_registry{};
+    return instance;
+}
+
+}
+
+
+auto apsn::detail::next_thread_id() -> std::size_t
+{
+    static auto counter = std::atomic<std::size_t>{0};
+    return counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+auto apsn::thread_name(std::size_t id) -> std::string
+{
+    auto & reg = registry();
+    {
+        auto lock = std::lock_guard{reg.mtx};
+        auto it = reg.names.find(id);
+        if (it != std::end(reg.names)) {
+            return it->second;
+        }
+    }
+    return fmt::format("Thread-{}", id);
+}
+
+
+auto apsn::this_thread::set_name(std::string name) -> void
+{
+    /* Linux limits names to 16 bytes, including the terminator */
+    auto truncated = name.substr(0, 15);
+    ::pthread_setname_np(::pthread_self(), truncated.c_str());
+
+    auto & reg = registry();
+    auto lock = std::lock_guard{reg.mtx};
+    reg.names[id()] = std::move(name);
+}
+
+
+auto apsn::this_thread::name() -> std::string
+{
+    return thread_name(id());
+}
@@ -0,0 +1,215 @@
+#include <apsn/async_logger.hpp>
+#include <apsn/binary_logger.hpp>
+#include <apsn/logging.hpp>
+#include <apsn/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+namespace log = apsn::log;
+
+
+struct binary_log_file
+{
+    binary_log_file()
+        : path{fs::temp_directory_path() /
+            ("test_binary_logger_" + std::to_string(
+                std::chrono::steady_clock::now().time_since_epoch().count()))}
+    {}
+
+    ~binary_log_file()
+    {
+        auto ec = std::error_code{};
+        fs::remove(path, ec);
+    }
+
+    auto contents() const -> std::string
+    {
+        auto in = std::ifstream{path, std::ios::binary};
+        auto ss = std::stringstream{};
+        ss << in.rdbuf();
+        return ss.str();
+    }
+
+    auto records() const -> std::vector<log::record>
+    {
+        auto in = std::ifstream{path, std::ios::binary};
+        auto reader = log::binary_log_reader{in};
+        auto result = std::vector<log::record>{};
+        while (auto rec = reader.next()) {
+            result.push_back(*rec);
+        }
+        return result;
+    }
+
+    fs::path path;
+};
+
+
+TEST(BinaryLogger, RoundTripsArguments)
+{
+    auto file = binary_log_file{};
+    {
+        auto logger = log::binary_logger{file.path, "test_logger",
+                log::level::trace};
+        ASSERT_TRUE(logger.is_open());
+        auto name = std::string{"ttyUSB0"};
+        logger.info("{} at {} baud, {:x} {:.2f} {} {}", name, 115200,
+                std::uint8_t{255}, 1.5, true, 'c');
+    }
+
+    auto records = file.records();
+    ASSERT_EQ(1u, records.size());
+    EXPECT_EQ(log::level::info, records[0].lvl);
+    EXPECT_EQ("ttyUSB0 at 115200 baud, ff 1.50 true c", records[0].message);
+    EXPECT_EQ(apsn::this_thread::id(), records[0].thread);
+}
+
+
+TEST(BinaryLogger, WritesEachFormatOnce)
+{
+    auto file = binary_log_file{};
+    {
+        auto logger = log::binary_logger{file.path, "test_logger"};
+        for (auto ii = 0; ii < 3; ++ii) {
+            logger.info("a rather distinctive format string {}", ii);
+        }
+    }
+
+    auto contents = file.contents();
+    auto first = contents.find("a rather distinctive");
+    ASSERT_NE(std::string::npos, first);
+    EXPECT_EQ(std::string::npos, contents.find("a rather distinctive", first + 1));
+
+    auto records = file.records();
+    ASSERT_EQ(3u, records.size());
+    EXPECT_EQ("a rather distinctive format string 2", records[2].message);
+}
+
+
+TEST(BinaryLogger, StoresPreformattedMessages)
+{
+    auto file = binary_log_file{};
+    {
+        auto logger = log::binary_logger{file.path, "test_logger"};
+        logger.warn(std::string{"plain message"});
+    }
+
+    auto records = file.records();
+    ASSERT_EQ(1u, records.size());
+    EXPECT_EQ(log::level::warn, records[0].lvl);
+    EXPECT_EQ("plain message", records[0].message);
+}
+
+
+TEST(BinaryLogger, HonoursThreshold)
+{
+    auto file = binary_log_file{};
+    {
+        auto logger = log::binary_logger{file.path, "test_logger"};
+        logger.debug("hidden {}", 1);
+        logger.info("shown {}", 2);
+    }
+
+    auto records = file.records();
+    ASSERT_EQ(1u, records.size());
+    EXPECT_EQ("shown 2", records[0].message);
+}
+
+
+TEST(BinaryLogger, RecordsThreadNames)
+{
+    auto file = binary_log_file{};
+    auto id = std::size_t{};
+    {
+        auto logger = log::binary_logger{file.path, "test_logger"};
+        std::thread{[&] {
+            apsn::this_thread::set_name("binary-test");
+            id = apsn::this_thread::id();
+            logger.info("from a thread");
+        }}.join();
+    }
+
+    auto in = std::ifstream{file.path, std::ios::binary};
+    auto reader = log::binary_log_reader{in};
+    ASSERT_TRUE(reader.valid());
+    EXPECT_EQ("test_logger", reader.name());
+    auto rec = reader.next();
+    ASSERT_TRUE(rec);
+    EXPECT_EQ(id, rec->thread);
+    EXPECT_EQ("binary-test", reader.thread_name(id));
+}
+
+
+TEST(BinaryLogger, StaysBinaryBehindAsyncLogger)
+{
+    auto file = binary_log_file{};
+    auto id = std::size_t{};
+    {
+        auto sink = std::make_shared<log::binary_logger>(file.path,
+                "test_logger");
+        auto logger = log::async_logger{sink};
+        EXPECT_TRUE(logger.binary());
+        std::thread{[&] {
+            apsn::this_thread::set_name("async-binary-test");
+            id = apsn::this_thread::id();
+            for (auto ii = 0; ii < 3; ++ii) {
+                logger.info("an asynchronous format string {}", ii);
+            }
+        }}.join();
+    }
+
+    auto contents = file.contents();
+    auto first = contents.find("an asynchronous format");
+    ASSERT_NE(std::string::npos, first);
+    EXPECT_EQ(std::string::npos, contents.find("an asynchronous format", first + 1));
+
+    auto in = std::ifstream{file.path, std::ios::binary};
+    auto reader = log::binary_log_reader{in};
+    auto records = std::vector<log::record>{};
+    while (auto rec = reader.next()) {
+        records.push_back(*rec);
+    }
+    ASSERT_EQ(3u, records.size());
+    EXPECT_EQ("an asynchronous format string 2", records[2].message);
+    EXPECT_EQ(id, records[2].thread);
+    EXPECT_EQ("async-binary-test", reader.thread_name(id));
+}
+
+
+TEST(BinaryLogger, ReaderStopsAtTruncation)
+{
+    auto file = binary_log_file{};
+    {
+        auto logger = log::binary_logger{file.path, "test_logger"};
+        logger.info("first {}", 1);
+        logger.info("second {}", 2);
+    }
+
+    auto contents = file.contents();
+    auto in = std::istringstream{contents.substr(0, contents.size() - 3)};
+    auto reader = log::binary_log_reader{in};
+    auto rec = reader.next();
+    ASSERT_TRUE(rec);
+    EXPECT_EQ("first 1", rec->message);
+    EXPECT_FALSE(reader.next());
+}
+
+
+TEST(BinaryLogger, ReaderRejectsOtherFiles)
+{
+    auto in = std::istringstream{"not a binary log"};
+    auto reader = log::binary_log_reader{in};
+    EXPECT_FALSE(reader.valid());
+    EXPECT_FALSE(reader.next());
+}
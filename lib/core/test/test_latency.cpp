@@ -0,0 +1,61 @@
+#include <apsn/latency.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using apsn::latency_histogram;
+
+
+TEST(LatencyHistogram, Buckets)
+{
+    EXPECT_EQ(latency_histogram::bucket_for(0), 0);
+    EXPECT_EQ(latency_histogram::bucket_for(1), 1);
+    EXPECT_EQ(latency_histogram::bucket_for(3), 2);
+    EXPECT_EQ(latency_histogram::bucket_for(1024), 11);
+    EXPECT_EQ(latency_histogram::bucket_for(~0ull),
+            latency_histogram::bucket_count - 1);
+}
+
+
+TEST(LatencyHistogram, Summary)
+{
+    auto hist = latency_histogram{};
+    EXPECT_EQ(hist.snapshot().percentile(0.5), 0us);
+
+    for (auto ii = 0; ii < 99; ++ii) {
+        hist.record(10us);
+    }
+    hist.record(5ms);
+
+    auto summary = hist.snapshot();
+    EXPECT_EQ(summary.count, 100);
+    EXPECT_EQ(summary.max(), 5000us);
+    EXPECT_EQ(summary.mean(), (99 * 10us + 5000us) / 100);
+    EXPECT_EQ(summary.percentile(0.5), 16us);
+    EXPECT_EQ(summary.percentile(0.999), 8192us);
+}
+
+
+TEST(LatencyHistogram, ConcurrentRecording)
+{
+    auto hist = latency_histogram{};
+    auto threads = std::vector<std::thread>{};
+    for (auto ii = 0; ii < 4; ++ii) {
+        threads.emplace_back([&hist] {
+            for (auto jj = 0; jj < 1000; ++jj) {
+                hist.record(std::chrono::microseconds{jj});
+            }
+        });
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+
+    auto summary = hist.snapshot();
+    EXPECT_EQ(summary.count, 4000);
+    EXPECT_EQ(summary.max(), 999us);
+}
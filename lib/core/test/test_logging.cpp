@@ -1,3 +1,4 @@
+#include <apsn/async_logger.hpp>
 #include <apsn/logging.hpp>
 
 #include "common.hpp"
@@ -6,6 +7,7 @@
 
 #include <iostream>
 #include <string>
+#include <thread>
 
 namespace log = apsn::log;
 
@@ -617,4 +619,139 @@ TEST(Logging, OutputsTraceWhenThresholdTrace)
 
     auto empty_message = ""s;
     EXPECT_NE(empty_message, ctx.buffer.str());
-}
\ No newline at end of file
+}
+
+
+
+TEST(Logging, AsyncLoggerOutputsAfterFlush)
+{
+    using namespace std::string_literals;
+    using namespace smux;
+
+    auto ctx = test_context{};
+    auto sink = std::make_shared<log::coloured_cli_logger>(ctx.stream,
+            "test_logger");
+    auto logger = log::async_logger{sink, 16, std::chrono::hours{1}};
+    logger.info("message {}", 1);
+    logger.flush();
+
+    EXPECT_NE(std::string::npos, ctx.buffer.str().find("message 1"));
+}
+
+
+TEST(Logging, AsyncLoggerForwardsThreshold)
+{
+    using namespace smux;
+
+    auto ctx = test_context{};
+    auto sink = std::make_shared<log::coloured_cli_logger>(ctx.stream,
+            "test_logger");
+    auto logger = log::async_logger{sink};
+    logger.threshold(log::level::fatal);
+    logger.error("message");
+    logger.flush();
+
+    EXPECT_EQ(log::level::fatal, sink->threshold());
+    EXPECT_EQ("", ctx.buffer.str());
+}
+
+
+TEST(Logging, AsyncLoggerOrdersThreadsByTime)
+{
+    using namespace smux;
+
+    auto ctx = test_context{};
+    auto sink = std::make_shared<log::coloured_cli_logger>(ctx.stream,
+            "test_logger");
+    auto logger = log::async_logger{sink, 16, std::chrono::hours{1}};
+    logger.info("first");
+    std::thread{[&] { logger.info("second"); }}.join();
+    logger.info("third");
+    logger.flush();
+
+    auto out = ctx.buffer.str();
+    auto first = out.find("first");
+    auto second = out.find("second");
+    auto third = out.find("third");
+    ASSERT_NE(std::string::npos, third);
+    EXPECT_LT(first, second);
+    EXPECT_LT(second, third);
+}
+
+
+TEST(Logging, AsyncLoggerCountsDroppedMessages)
+{
+    using namespace smux;
+
+    auto ctx = test_context{};
+    auto sink = std::make_shared<log::coloured_cli_logger>(ctx.stream,
+            "test_logger");
+    auto logger = log::async_logger{sink, 2, std::chrono::hours{1}};
+    for (auto ii = 0; ii < 5; ++ii) {
+        logger.info("message");
+    }
+    EXPECT_EQ(3u, logger.dropped());
+
+    logger.flush();
+    EXPECT_NE(std::string::npos,
+            ctx.buffer.str().find("3 log messages dropped"));
+}
+
+
+TEST(Logging, AsyncLoggerFlushesOnDestruction)
+{
+    using namespace smux;
+
+    auto ctx = test_context{};
+    auto sink = std::make_shared<log::coloured_cli_logger>(ctx.stream,
+            "test_logger");
+    {
+        auto logger = log::async_logger{sink, 16, std::chrono::hours{1}};
+        logger.info("message");
+    }
+    EXPECT_NE(std::string::npos, ctx.buffer.str().find("message"));
+}
+
+
+
+
+struct global_logger_context : test_context
+{
+    global_logger_context(log::level threshold)
+    {
+        log::make_logger<log::coloured_cli_logger>(stream, "test_logger",
+                threshold);
+    }
+    ~global_logger_context()
+    {
+        log::detail::set_global_logger(log::detail::default_logger());
+    }
+};
+
+
+TEST(Logging, MacroDoesNotEvaluateArgumentsBelowThreshold)
+{
+    auto ctx = global_logger_context{log::level::info};
+    auto evaluated = 0;
+    auto argument = [&] { return ++evaluated; };
+
+    APSN_LOG_TRACE("message {}", argument());
+    EXPECT_EQ(0, evaluated);
+    EXPECT_EQ("", ctx.buffer.str());
+
+    APSN_LOG_INFO("message {}", argument());
+    EXPECT_EQ(1, evaluated);
+    EXPECT_NE(std::string::npos, ctx.buffer.str().find("message 1"));
+}
+
+
+TEST(Logging, LogTracePrefixesFileAndLine)
+{
+    auto ctx = global_logger_context{log::level::trace};
+    LOG_TRACE("message {}", 1);
+    if constexpr (log::compiled(log::level::trace)) {
+        EXPECT_NE(std::string::npos,
+                ctx.buffer.str().find("test_logging.cpp:"));
+        EXPECT_NE(std::string::npos, ctx.buffer.str().find("message 1"));
+    }
+}
@@ -0,0 +1,48 @@
+#include <apsn/lru_cache.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+
+TEST(LruCache, GetReturnsInsertedValues)
+{
+    auto cache = apsn::lru_cache<std::string, int>{4};
+    cache.put("a", 1);
+    cache.put("b", 2);
+    EXPECT_EQ(cache.get("a"), 1);
+    EXPECT_EQ(cache.get("b"), 2);
+    EXPECT_FALSE(cache.get("c"));
+    EXPECT_EQ(cache.size(), 2);
+}
+
+
+TEST(LruCache, EvictsLeastRecentlyUsed)
+{
+    auto cache = apsn::lru_cache<std::string, int>{2};
+    cache.put("a", 1);
+    cache.put("b", 2);
+    cache.get("a");
+    cache.put("c", 3);
+
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.get("a"), 1);
+    EXPECT_FALSE(cache.get("b"));
+    EXPECT_EQ(cache.get("c"), 3);
+}
+
+
+TEST(LruCache, PutReplacesExisting)
+{
+    auto cache = apsn::lru_cache<std::string, int>{2};
+    cache.put("a", 1);
+    cache.put("b", 2);
+    cache.put("a", 10);
+    cache.put("c", 3);
+
+    EXPECT_EQ(cache.get("a"), 10);
+    EXPECT_FALSE(cache.get("b"));
+    EXPECT_TRUE(cache.erase("a"));
+    EXPECT_FALSE(cache.erase("a"));
+    EXPECT_EQ(cache.size(), 1);
+}
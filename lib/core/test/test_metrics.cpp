@@ -0,0 +1,97 @@
+#include <apsn/metrics.hpp>
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace metrics = apsn::metrics;
+
+
+TEST(Metrics, CounterSumsAcrossThreads)
+{
+    auto c = metrics::counter{};
+    auto threads = std::vector<std::thread>{};
+    for (auto ii = 0; ii < 4; ++ii) {
+        threads.emplace_back([&] {
+            for (auto jj = 0; jj < 1000; ++jj) {
+                c.add();
+            }
+        });
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(4000u, c.value());
+}
+
+
+TEST(Metrics, GaugeGoesUpAndDown)
+{
+    auto g = metrics::gauge{};
+    g.add(3);
+    g.sub();
+    EXPECT_EQ(2, g.value());
+    g.set(-1);
+    EXPECT_EQ(-1, g.value());
+}
+
+
+TEST(Metrics, HistogramBuckets)
+{
+    EXPECT_EQ(0u, metrics::histogram::bucket_for(0));
+    EXPECT_EQ(0u, metrics::histogram::bucket_for(1));
+    EXPECT_EQ(1u, metrics::histogram::bucket_for(2));
+    EXPECT_EQ(2u, metrics::histogram::bucket_for(3));
+    EXPECT_EQ(2u, metrics::histogram::bucket_for(4));
+    EXPECT_EQ(3u, metrics::histogram::bucket_for(5));
+    EXPECT_EQ(metrics::histogram::bucket_count - 1,
+            metrics::histogram::bucket_for(~std::uint64_t{0}));
+
+    auto h = metrics::histogram{};
+    h.observe(4);
+    h.observe(5);
+    auto snap = h.snapshot();
+    EXPECT_EQ(2u, snap.count);
+    EXPECT_EQ(9u, snap.sum);
+    EXPECT_EQ(1u, snap.buckets[2]);
+    EXPECT_EQ(1u, snap.buckets[3]);
+}
+
+
+TEST(Metrics, RegistryReturnsSameSeries)
+{
+    auto reg = metrics::registry{};
+    auto & a = reg.counter("rx_bytes_total", "Bytes", {{"port", "a"}});
+    auto & b = reg.counter("rx_bytes_total", "Bytes", {{"port", "b"}});
+    auto & a_again = reg.counter("rx_bytes_total", "Bytes", {{"port", "a"}});
+
+    EXPECT_EQ(&a, &a_again);
+    EXPECT_NE(&a, &b);
+    EXPECT_THROW(reg.gauge("rx_bytes_total", "Bytes"), std::logic_error);
+}
+
+
+TEST(Metrics, RendersTextFormat)
+{
+    auto reg = metrics::registry{};
+    reg.counter("rx_bytes_total", "Bytes read", {{"port", "/dev/tty\"0\""}})
+        .add(42);
+    reg.gauge("sessions", "Open sessions").add(2);
+    reg.histogram("latency_seconds", "Latency", {}, 1e-6).observe(3);
+
+    auto text = reg.render();
+    EXPECT_NE(std::string::npos, text.find(
+        "# HELP rx_bytes_total Bytes read\n"
+        "# TYPE rx_bytes_total counter\n"
+        "rx_bytes_total{port=\"/dev/tty\\\"0\\\"\"} 42\n"));
+    EXPECT_NE(std::string::npos, text.find(
+        "# TYPE sessions gauge\nsessions 2\n"));
+    EXPECT_NE(std::string::npos, text.find("# TYPE latency_seconds histogram\n"));
+    EXPECT_NE(std::string::npos, text.find("latency_seconds_bucket{le=\"2e-06\"} 0\n"));
+    EXPECT_NE(std::string::npos, text.find("latency_seconds_bucket{le=\"4e-06\"} 1\n"));
+    EXPECT_NE(std::string::npos, text.find("latency_seconds_bucket{le=\"+Inf\"} 1\n"));
+    EXPECT_NE(std::string::npos, text.find("latency_seconds_count 1\n"));
+}
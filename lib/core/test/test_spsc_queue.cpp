@@ -0,0 +1,70 @@
+#include <apsn/spsc_queue.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <string>
+#include <thread>
+
+
+TEST(SpscQueue, RoundsCapacityUpToPowerOfTwo)
+{
+    EXPECT_EQ(8u, apsn::spsc_queue<int>{5}.capacity());
+    EXPECT_EQ(8u, apsn::spsc_queue<int>{8}.capacity());
+    EXPECT_EQ(2u, apsn::spsc_queue<int>{0}.capacity());
+}
+
+
+TEST(SpscQueue, PopsInOrderPushed)
+{
+    auto queue = apsn::spsc_queue<std::string>{4};
+    EXPECT_TRUE(queue.try_push("a"));
+    EXPECT_TRUE(queue.try_push("b"));
+
+    EXPECT_EQ("a", queue.try_pop());
+    EXPECT_EQ("b", queue.try_pop());
+    EXPECT_FALSE(queue.try_pop());
+    EXPECT_TRUE(queue.empty());
+}
+
+
+TEST(SpscQueue, RejectsPushWhenFull)
+{
+    auto queue = apsn::spsc_queue<int>{2};
+    EXPECT_TRUE(queue.try_push(1));
+    EXPECT_TRUE(queue.try_push(2));
+    EXPECT_FALSE(queue.try_push(3));
+
+    EXPECT_EQ(1, queue.try_pop());
+    EXPECT_TRUE(queue.try_push(3));
+    EXPECT_EQ(2, queue.try_pop());
+    EXPECT_EQ(3, queue.try_pop());
+}
+
+
+TEST(SpscQueue, TransfersAcrossThreads)
+{
+    constexpr auto count = std::size_t{10000};
+    auto queue = apsn::spsc_queue<std::size_t>{64};
+
+    auto producer = std::thread{[&] {
+        for (auto ii = std::size_t{0}; ii < count; ++ii) {
+            while (!queue.try_push(ii)) {
+                std::this_thread::yield();
+            }
+        }
+    }};
+
+    auto expected = std::size_t{0};
+    while (expected < count) {
+        if (auto value = queue.try_pop()) {
+            ASSERT_EQ(expected, *value);
+            ++expected;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(queue.empty());
+}
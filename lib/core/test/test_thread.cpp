@@ -0,0 +1,55 @@
+#include <apsn/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <thread>
+
+
+TEST(Thread, IdIsStableWithinAThread)
+{
+    EXPECT_EQ(apsn::this_thread::id(), apsn::this_thread::id());
+}
+
+
+TEST(Thread, IdsDifferBetweenThreads)
+{
+    auto main_id = apsn::this_thread::id();
+    auto other_id = main_id;
+    std::thread{[&] { other_id = apsn::this_thread::id(); }}.join();
+
+    EXPECT_NE(main_id, other_id);
+}
+
+
+TEST(Thread, UnnamedThreadsAreNumbered)
+{
+    auto id = std::size_t{};
+    auto name = std::string{};
+    std::thread{[&] {
+        id = apsn::this_thread::id();
+        name = apsn::this_thread::name();
+    }}.join();
+
+    EXPECT_EQ("Thread-" + std::to_string(id), name);
+}
+
+
+TEST(Thread, NameOutlivesThread)
+{
+    auto id = std::size_t{};
+    auto kernel_name = std::array<char, 16>{};
+    std::thread{[&] {
+        apsn::this_thread::set_name("a-rather-long-thread-name");
+        id = apsn::this_thread::id();
+        ::pthread_getname_np(::pthread_self(), kernel_name.data(),
+                kernel_name.size());
+    }}.join();
+
+    EXPECT_EQ("a-rather-long-thread-name", apsn::thread_name(id));
+    EXPECT_EQ(std::string{"a-rather-long-t"}, kernel_name.data());
+}
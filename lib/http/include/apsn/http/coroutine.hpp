@@ -0,0 +1,76 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <chrono>
+#include <exception>
+
+
+namespace apsn::http {
+
+/*
+ * Sessions, websockets and serial ports run as `asio::awaitable` loops, one
+ * per direction, each holding a `shared_from_this()` in its frame for as long
+ * as it runs.
+ *
+ * Asio already recycles coroutine frames and the operations they await
+ * through a per-thread cache, so a loop which awaits its IO directly, rather
+ * than through nested awaitables, allocates its frame once and nothing per
+ * hop. Defining BOOST_ASIO_DISABLE_AWAITABLE_FRAME_RECYCLING undoes that.
+ */
+
+/* Awaited operations report errors through an error code, as callbacks did */
+template <typename Executor = boost::asio::any_io_executor>
+auto with_error(boost::system::error_code & ec)
+{
+    return boost::asio::redirect_error(
+            boost::asio::use_awaitable_t<Executor>{}, ec);
+}
+
+
+/* Completion for `co_spawn`: exceptions leave `io_context::run` as they
+   would from a handler, rather than being dropped as `detached` does */
+struct rethrow_t
+{
+    auto operator()(std::exception_ptr error) const -> void
+    {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+inline constexpr auto rethrow = rethrow_t{};
+
+
+/**
+ * @brief Wakes a coroutine waiting for more work, such as a queue's writer
+ *
+ * A timer which never expires on its own; `notify` cancels the wait. Only
+ * for use from the executor of the coroutine which waits.
+ */
+class wakeup
+{
+public:
+    template <typename Executor>
+    explicit wakeup(Executor const & ex)
+        : m_timer{ex}
+    {}
+
+    /* Not a coroutine itself, so waiting costs no frame */
+    auto wait()
+    {
+        m_timer.expires_at(boost::asio::steady_timer::time_point::max());
+        return m_timer.async_wait(with_error(m_ec));
+    }
+
+    auto notify() -> void
+    { m_timer.cancel(); }
+
+private:
+    boost::asio::steady_timer m_timer;
+    boost::system::error_code m_ec;
+};
+
+}
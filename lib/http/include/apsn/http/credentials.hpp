@@ -0,0 +1,134 @@
+#pragma once
+
+#include <apsn/lru_cache.hpp>
+#include <apsn/result.hpp>
+
+#include <boost/asio/any_io_executor.hpp>
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+
+namespace apsn::http {
+
+namespace fs = std::filesystem;
+
+
+struct scrypt_params
+{
+    unsigned log2_n = 15;
+    unsigned r = 8;
+    unsigned p = 1;
+};
+
+
+/**
+ * @brief Hash a password with scrypt and a random salt
+ *
+ * The result is self describing, e.g.,
+ * `$scrypt$ln=15,r=8,p=1$<salt>$<hash>`, where salt and hash are hex encoded.
+ */
+auto hash_password(std::string_view password, scrypt_params params = {})
+    -> apsn::result<std::string>;
+
+/**
+ * @brief Check a password against the output of `hash_password`
+ */
+auto verify_password(std::string_view password, std::string_view encoded)
+    -> bool;
+
+
+/**
+ * @brief Users and their password hashes
+ *
+ * On disk, each line holds `user:hash`. Blank lines and lines starting with
+ * `#` are ignored.
+ */
+class password_db
+{
+public:
+    static auto parse(std::string_view contents) -> apsn::result<password_db>;
+    static auto load(fs::path const & path) -> apsn::result<password_db>;
+
+    auto save(fs::path const & path) const -> std::error_code;
+
+    auto find(std::string_view user) const -> std::optional<std::string_view>;
+    auto set(std::string user, std::string encoded) -> void;
+
+    auto size() const -> std::size_t
+    { return m_users.size(); }
+
+private:
+    std::map<std::string, std::string, std::less<>> m_users;
+};
+
+
+/**
+ * @brief Verifies credentials against a `password_db`
+ *
+ * Verification is deliberately expensive, so outcomes are kept in a bounded
+ * LRU cache keyed on a keyed hash of the credentials; plain text passwords
+ * are never retained. Uncached checks run on the supplied executor, which
+ * should not be the one serving network or serial I/O. Concurrent checks of
+ * the same credentials share one computation, and at most `max_queued`
+ * different ones wait for the executor at once.
+ */
+class credential_verifier
+{
+public:
+    using executor_type = boost::asio::any_io_executor;
+    using callback_type = std::function<void(bool)>;
+
+    credential_verifier(password_db db,
+            executor_type executor,
+            std::size_t capacity = 1024,
+            std::size_t max_queued = 64);
+
+    /**
+     * @brief Outcome of a previous check, if still cached
+     */
+    auto cached(std::string_view user, std::string_view password)
+        -> std::optional<bool>;
+
+    /**
+     * @brief Check credentials on the calling thread
+     */
+    auto verify(std::string_view user, std::string_view password) -> bool;
+
+    /**
+     * @brief Check credentials on the verifier's executor
+     *
+     * `done` is invoked on the executor once the outcome is cached. Returns
+     * false, and never invokes `done`, if `max_queued` other checks are
+     * already waiting.
+     */
+    auto async_verify(std::string user,
+            std::string password,
+            callback_type done) -> bool;
+
+private:
+    auto cache_key(std::string_view user, std::string_view password) const
+        -> std::string;
+    auto compute(std::string_view user, std::string_view password) const
+        -> bool;
+
+    password_db m_db;
+    executor_type m_executor;
+    std::size_t m_max_queued;
+    std::array<unsigned char, 32> m_key;
+
+    std::mutex m_mtx;
+    apsn::lru_cache<std::string, bool> m_cache;
+    std::map<std::string, std::vector<callback_type>> m_pending;
+};
+
+}
@@ -50,6 +50,23 @@ auto apsn::http::server_error(request<Traits> & req, std::string_view what)
 };
 
 
+template <typename Traits>
+auto apsn::http::service_unavailable(request<Traits> & req, std::string_view why)
+    -> response
+{
+    auto res = beast::http::response<beast::http::string_body>{
+            beast::http::status::service_unavailable,
+            req.version()};
+    res.set(beast::http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(beast::http::field::content_type, "text/html");
+    res.set(beast::http::field::retry_after, "1");
+    res.keep_alive(req.keep_alive());
+    res.body() = std::string(why);
+    res.prepare_payload();
+    return res;
+};
+
+
 // template <typename Traits>
 // auto apsn::http::unauthorised(request<Traits> & req, fs::path body) -> response
 // {
@@ -82,24 +99,11 @@ auto apsn::http::basic_auth(request<Traits> & req, std::string_view realm) -> re
 }
 
 
-template <std::size_t N>
-auto generate_nonce() -> apsn::result<std::string>
-{
-    unsigned char buf[N];
-    int rc = RAND_bytes(buf, N);
-    if (rc != 1) {
-        return std::make_error_code(std::errc::protocol_error);
-    }
-    auto result = std::string{};
-    for (auto v : buf) {
-        result.append(fmt::format("{:02x}", v));
-    }
-    return result;
-}
-
-
 template <typename Traits>
-auto apsn::http::digest_auth(request<Traits> & req, std::string const & realm)
+auto apsn::http::digest_auth(request<Traits> & req,
+        std::string_view realm,
+        std::string_view nonce,
+        bool stale)
     -> response
 {
     beast::http::response<beast::http::string_body> res{
@@ -108,19 +112,15 @@ auto apsn::http::digest_auth(request<Traits> & req, std::string const & realm)
     res.set(beast::http::field::server, BOOST_BEAST_VERSION_STRING);
     res.set(beast::http::field::content_type, "text/html");
 
-    auto nonce = generate_nonce<16>();
-    if (!nonce) {
-        apsn::log::fatal("Unable to generate nonce!");
-        std::terminate();
-    }
-
     auto settings = fmt::format("Digest "
-                "realm={}, "
-                "nonce={}, "
-                "charset=utf-8", 
+                "realm=\"{}\", "
+                "qop=\"auth\", "
+                "algorithm=MD5, "
+                "nonce=\"{}\", "
+                "charset=UTF-8{}", 
             realm,
-            *nonce
-            );
+            nonce,
+            stale ? ", stale=true" : "");
     res.set("WWW-Authenticate", settings);
     res.keep_alive(req.keep_alive());
     res.prepare_payload();
@@ -1,16 +1,38 @@
 
+/* Connections from a sharded listener stay on its single threaded context */
+inline auto connection_executor(asio::io_context & ioc, acceptor_mode mode)
+    -> asio::any_io_executor
+{
+    if (mode == acceptor_mode::sharded) {
+        return ioc.get_executor();
+    }
+    return asio::make_strand(ioc);
+}
+
+
 template <typename Traits>
 listener<Traits>::listener(asio::io_context & ioc, 
         tcp::endpoint endpoint, 
         std::shared_ptr<shared_type> shared,
-        std::shared_ptr<handler_type> handler)
+        std::shared_ptr<handler_type> handler,
+        std::shared_ptr<timer_wheel> timers,
+        acceptor_mode mode)
     : m_ioc{ioc}
-    , m_acceptor(m_ioc)
+    , m_mode{mode}
+    , m_acceptor(asio::make_strand(m_ioc))
     , m_shared{shared}
     , m_handler{handler}
+    , m_timers{timers}
 {
     auto ec = sys::error_code{};
 
+    if (adopt_inherited(m_acceptor, endpoint, ec)) {
+        if (ec) {
+            fail(ec, "assign");
+        }
+        return;
+    }
+
     m_acceptor.open(endpoint.protocol(), ec);
     if(ec) {
         fail(ec, "open");
@@ -23,6 +45,14 @@ listener<Traits>::listener(asio::io_context & ioc,
         return;
     }
 
+    if (m_mode == acceptor_mode::sharded) {
+        m_acceptor.set_option(reuse_port(true), ec);
+        if(ec) {
+            fail(ec, "set_option");
+            return;
+        }
+    }
+
     m_acceptor.bind(endpoint, ec);
     if(ec) {
         fail(ec, "bind");
@@ -40,13 +70,23 @@ template <typename Traits>
 auto listener<Traits>::run() -> void 
 {
     m_acceptor.async_accept(
-        asio::make_strand(m_ioc),
+        connection_executor(m_ioc, m_mode),
         beast::bind_front_handler(
             &listener::on_accept,
             this->shared_from_this()));
 }
 
 
+template <typename Traits>
+auto listener<Traits>::close() -> void
+{
+    asio::dispatch(m_acceptor.get_executor(), [self = this->shared_from_this()] {
+        auto ec = sys::error_code{};
+        self->m_acceptor.close(ec);
+    });
+}
+
+
 template <typename Traits>
 auto listener<Traits>::fail(beast::error_code ec, char const* what) -> void 
 {
@@ -63,10 +103,14 @@ auto listener<Traits>::on_accept(beast::error_code ec, tcp::socket socket) -> vo
         return this->fail(ec, "accept");
     }
     else {
-        std::make_shared<session<Traits>>(std::move(socket), m_shared, m_handler)->run();
+        /* Console output arrives as many small writes, which Nagle's
+           algorithm would hold back for the peer's acknowledgements */
+        socket.set_option(tcp::no_delay(true), ec);
+        std::make_shared<session<Traits>>(std::move(socket), m_shared, m_handler,
+                m_timers)->run();
     }
     m_acceptor.async_accept(
-        asio::make_strand(m_ioc),
+        connection_executor(m_ioc, m_mode),
         beast::bind_front_handler(
             &listener::on_accept,
             this->shared_from_this()));
@@ -78,17 +122,28 @@ ssl_listener<Traits>::ssl_listener(asio::io_context & ioc,
         tcp::endpoint endpoint, 
         ssl_ctx_ptr ssl,
         std::shared_ptr<shared_type> shared,
-        std::shared_ptr<handler_type> handler)
+        std::shared_ptr<handler_type> handler,
+        std::shared_ptr<timer_wheel> timers,
+        acceptor_mode mode)
     : m_ioc{ioc}
-    , m_acceptor(m_ioc)
+    , m_mode{mode}
+    , m_acceptor(asio::make_strand(m_ioc))
     , m_ssl{ssl}
     , m_shared{shared}
     , m_handler{handler}
+    , m_timers{timers}
 {
     // apsn::log::debug("listener::listener");
 
     auto ec = sys::error_code{};
 
+    if (adopt_inherited(m_acceptor, endpoint, ec)) {
+        if (ec) {
+            fail(ec, "assign");
+        }
+        return;
+    }
+
     m_acceptor.open(endpoint.protocol(), ec);
     if(ec) {
         fail(ec, "open");
@@ -101,6 +156,14 @@ ssl_listener<Traits>::ssl_listener(asio::io_context & ioc,
         return;
     }
 
+    if (m_mode == acceptor_mode::sharded) {
+        m_acceptor.set_option(reuse_port(true), ec);
+        if(ec) {
+            fail(ec, "set_option");
+            return;
+        }
+    }
+
     m_acceptor.bind(endpoint, ec);
     if(ec) {
         fail(ec, "bind");
@@ -121,13 +184,23 @@ auto ssl_listener<Traits>::run() -> void
     // apsn::log::debug("listener::run");
 
     m_acceptor.async_accept(
-        asio::make_strand(m_ioc),
+        connection_executor(m_ioc, m_mode),
         beast::bind_front_handler(
             &ssl_listener::on_accept,
             this->shared_from_this()));
 }
 
 
+template <typename Traits>
+auto ssl_listener<Traits>::close() -> void
+{
+    asio::dispatch(m_acceptor.get_executor(), [self = this->shared_from_this()] {
+        auto ec = sys::error_code{};
+        self->m_acceptor.close(ec);
+    });
+}
+
+
 template <typename Traits>
 auto ssl_listener<Traits>::fail(beast::error_code ec, char const* what) -> void 
 {
@@ -150,15 +223,162 @@ auto ssl_listener<Traits>::on_accept(
     else {
         // apsn::log::info("accepted");
 
+        socket.set_option(tcp::no_delay(true), ec);
         std::make_shared<ssl_session<Traits>>(std::move(socket),
                 m_ssl,
                 m_shared,
-                m_handler)->run();
+                m_handler,
+                m_timers)->run();
     }
 
     m_acceptor.async_accept(
-        asio::make_strand(m_ioc),
+        connection_executor(m_ioc, m_mode),
         beast::bind_front_handler(
             &ssl_listener::on_accept,
             this->shared_from_this()));
-}
\ No newline at end of file
+}
+
+
+
+
+template <typename Traits>
+local_listener<Traits>::local_listener(asio::io_context & ioc,
+        std::filesystem::path path,
+        std::filesystem::perms permissions,
+        authoriser authorise,
+        std::shared_ptr<shared_type> shared,
+        std::shared_ptr<handler_type> handler,
+        std::shared_ptr<timer_wheel> timers)
+    : m_ioc{ioc}
+    , m_acceptor(asio::make_strand(m_ioc))
+    , m_path{std::move(path)}
+    , m_authorise{std::move(authorise)}
+    , m_shared{shared}
+    , m_handler{handler}
+    , m_timers{timers}
+{
+    auto ec = sys::error_code{};
+    auto endpoint = protocol::endpoint{m_path.string()};
+
+    if (adopt_inherited(m_acceptor, endpoint, ec)) {
+        if (ec) {
+            fail(ec, "assign");
+        }
+        return;
+    }
+
+    /* Only take the path over from a server which is no longer there */
+    auto fs_ec = std::error_code{};
+    if (std::filesystem::is_socket(m_path, fs_ec)) {
+        auto probe = protocol::socket{m_ioc};
+        probe.connect(endpoint, ec);
+        if (!ec) {
+            fail(asio::error::address_in_use, "bind");
+            return;
+        }
+        std::filesystem::remove(m_path, fs_ec);
+    }
+
+    m_acceptor.open(endpoint.protocol(), ec);
+    if(ec) {
+        fail(ec, "open");
+        return;
+    }
+
+    m_acceptor.bind(endpoint, ec);
+    if(ec) {
+        fail(ec, "bind");
+        m_acceptor.close(ec);
+        return;
+    }
+
+    std::filesystem::permissions(m_path, permissions, fs_ec);
+    if (fs_ec) {
+        fail(sys::error_code{fs_ec.value(), sys::system_category()},
+                "permissions");
+        m_acceptor.close(ec);
+        return;
+    }
+
+    m_acceptor.listen(asio::socket_base::max_listen_connections, ec);
+    if(ec) {
+        fail(ec, "listen");
+        m_acceptor.close(ec);
+        return;
+    }
+}
+
+
+template <typename Traits>
+local_listener<Traits>::~local_listener()
+{
+    if (m_acceptor.is_open()) {
+        auto ec = std::error_code{};
+        std::filesystem::remove(m_path, ec);
+    }
+}
+
+
+template <typename Traits>
+auto local_listener<Traits>::run() -> void
+{
+    m_acceptor.async_accept(
+        asio::make_strand(m_ioc),
+        beast::bind_front_handler(
+            &local_listener::on_accept,
+            this->shared_from_this()));
+}
+
+
+/* Not unlinked, unlike on destruction: whoever has the socket now is still
+   listening on it */
+template <typename Traits>
+auto local_listener<Traits>::close() -> void
+{
+    asio::dispatch(m_acceptor.get_executor(), [self = this->shared_from_this()] {
+        auto ec = sys::error_code{};
+        self->m_acceptor.close(ec);
+    });
+}
+
+
+template <typename Traits>
+auto local_listener<Traits>::fail(beast::error_code ec, char const* what) -> void
+{
+    if(ec == asio::error::operation_aborted)
+        return;
+    apsn::log::error("{} {}: {}", m_path.string(), what, ec.message());
+}
+
+
+template <typename Traits>
+auto local_listener<Traits>::on_accept(
+        beast::error_code ec,
+        protocol::socket socket) -> void
+{
+    if (ec) {
+        return fail(ec, "accept");
+    }
+
+    auto peer = peer_credentials::of(socket.native_handle());
+    if (!peer) {
+        apsn::log::warn("{}: no peer credentials: {}",
+                m_path.string(), peer.error_message());
+    }
+    else if (!m_authorise(*peer)) {
+        apsn::log::warn("{}: refused {} (uid {}, pid {})",
+                m_path.string(), peer->user(), peer->uid, peer->pid);
+    }
+    else {
+        std::make_shared<local_session<Traits>>(std::move(socket),
+                m_shared,
+                m_handler,
+                m_timers)->run();
+    }
+
+    m_acceptor.async_accept(
+        asio::make_strand(m_ioc),
+        beast::bind_front_handler(
+            &local_listener::on_accept,
+            this->shared_from_this()));
+}
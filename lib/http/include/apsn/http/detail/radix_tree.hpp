@@ -0,0 +1,428 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+namespace apsn::detail {
+
+
+/**
+ * @brief Parameters bound while matching a path against a `radix_tree`.
+ *
+ * Storage is fixed, so binding never allocates. Names view the patterns held
+ * by the tree and values view the path being matched; neither may outlive
+ * those.
+ */
+class path_params
+{
+public:
+    constexpr static std::size_t capacity = 8;
+
+    using value_type = std::pair<std::string_view, std::string_view>;
+    using const_iterator = value_type const *;
+
+    auto get(std::string_view name) const -> std::optional<std::string_view>
+    {
+        for (auto && [key, value] : *this) {
+            if (key == name) {
+                return value;
+            }
+        }
+        return std::nullopt;
+    }
+
+    auto push(std::string_view name, std::string_view value) -> bool
+    {
+        if (m_size == capacity) {
+            return false;
+        }
+        m_items[m_size++] = {name, value};
+        return true;
+    }
+
+    auto truncate(std::size_t size) -> void
+    { m_size = std::min(size, m_size); }
+
+    auto clear() -> void
+    { m_size = 0; }
+
+    auto size() const -> std::size_t
+    { return m_size; }
+
+    auto empty() const -> bool
+    { return m_size == 0; }
+
+    auto begin() const -> const_iterator
+    { return m_items.data(); }
+
+    auto end() const -> const_iterator
+    { return m_items.data() + m_size; }
+
+private:
+    std::array<value_type, capacity> m_items{};
+    std::size_t m_size = 0;
+};
+
+
+/* Child keys are kept in 16 byte blocks so that a single SSE2 compare covers
+   the fan-out of almost every node in a route table. */
+class child_keys
+{
+public:
+    constexpr static std::size_t block = 16;
+
+    auto find(char c) const -> std::size_t
+    {
+        auto const * keys = m_keys.data();
+#if defined(__SSE2__)
+        auto const needle = _mm_set1_epi8(c);
+        for (auto ii = std::size_t{0}; ii < m_size; ii += block) {
+            auto const chunk = _mm_loadu_si128(
+                    reinterpret_cast<__m128i const *>(keys + ii));
+            auto mask = static_cast<std::uint32_t>(
+                    _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+            auto const remaining = m_size - ii;
+            if (remaining < block) {
+                mask &= (1u << remaining) - 1u;
+            }
+            if (mask != 0) {
+                return ii + static_cast<std::size_t>(__builtin_ctz(mask));
+            }
+        }
+        return m_size;
+#else
+        auto const * it = std::find(keys, keys + m_size, c);
+        return static_cast<std::size_t>(it - keys);
+#endif
+    }
+
+    auto push_back(char c) -> void
+    {
+        if (m_size == m_keys.size()) {
+            m_keys.resize(m_keys.size() + block, '\0');
+        }
+        m_keys[m_size++] = c;
+    }
+
+    auto size() const -> std::size_t
+    { return m_size; }
+
+private:
+    std::vector<char> m_keys;
+    std::size_t m_size = 0;
+};
+
+
+template <typename Mapped>
+struct radix_match
+{
+    Mapped * value = nullptr;
+    std::string_view pattern;
+
+    explicit operator bool() const
+    { return value != nullptr; }
+
+    auto operator->() const -> Mapped *
+    { return value; }
+};
+
+
+/**
+ * @brief Radix tree keyed on URL paths.
+ *
+ * Static runs of characters are compressed into single nodes. Two dynamic
+ * segment kinds are supported:
+ *
+ *   * `{name}` matches one non-empty path segment
+ *   * `*name` matches the remainder of the path and must come last
+ *
+ * Lookup prefers static children, then parameters, then wildcards, and
+ * backtracks when a more specific branch fails. Values may optionally match
+ * as a prefix of the path, in which case the longest such prefix wins when no
+ * route matches the whole path.
+ */
+template <typename Mapped>
+class radix_tree
+{
+    struct node
+    {
+        std::string prefix;
+        child_keys keys;
+        std::vector<std::unique_ptr<node>> children;
+
+        /* Dynamic children. The name is held on the child itself. */
+        std::string name;
+        std::unique_ptr<node> param;
+        std::unique_ptr<node> wildcard;
+
+        std::optional<Mapped> value;
+        std::string pattern;
+    };
+
+public:
+    radix_tree()
+        : m_root{std::make_unique<node>()}
+    {}
+
+    /**
+     * @brief Insert a route pattern
+     *
+     * @return `false` if the pattern is malformed, or it conflicts with an
+     *          existing route.
+     */
+    auto insert(std::string_view pattern, Mapped value) -> bool;
+
+    /**
+     * @brief Match a path.
+     *
+     * @param path Path to match, without query string
+     * @param params Receives bound parameters for the returned match
+     * @param is_prefix Predicate on a mapped value. When it returns `true` the
+     *        value may match any path it is a prefix of.
+     */
+    template <typename Pred>
+    auto match(std::string_view path, path_params & params, Pred && is_prefix)
+        const -> radix_match<Mapped>;
+
+    auto match(std::string_view path, path_params & params) const
+        -> radix_match<Mapped>
+    {
+        return match(path, params, [](Mapped const &){ return false; });
+    }
+
+private:
+    struct prefix_candidate
+    {
+        node * at = nullptr;
+        std::size_t consumed = 0;
+        path_params params;
+    };
+
+    auto insert_static(node * current, std::string_view text) -> node *;
+
+    template <typename Pred>
+    static auto match_node(node * current,
+            std::string_view rest,
+            std::size_t consumed,
+            path_params & params,
+            prefix_candidate & best,
+            Pred & is_prefix) -> node *;
+
+    std::unique_ptr<node> m_root;
+};
+
+
+template <typename Mapped>
+auto radix_tree<Mapped>::insert_static(node * current, std::string_view text)
+    -> node *
+{
+    while (!text.empty()) {
+        auto index = current->keys.find(text.front());
+        if (index == current->keys.size()) {
+            auto child = std::make_unique<node>();
+            child->prefix = std::string{text};
+            current->keys.push_back(text.front());
+            current->children.emplace_back(std::move(child));
+            return current->children.back().get();
+        }
+
+        auto * child = current->children[index].get();
+        auto const & label = child->prefix;
+        auto common = std::size_t{0};
+        auto const limit = std::min(label.size(), text.size());
+        while (common < limit && label[common] == text[common]) {
+            ++common;
+        }
+
+        if (common < label.size()) {
+            /* Split the child so that the shared run is its own node */
+            auto split = std::make_unique<node>();
+            split->prefix = label.substr(0, common);
+            auto old_child = std::move(current->children[index]);
+            old_child->prefix.erase(0, common);
+            split->keys.push_back(old_child->prefix.front());
+            split->children.emplace_back(std::move(old_child));
+            current->children[index] = std::move(split);
+            child = current->children[index].get();
+        }
+
+        current = child;
+        text.remove_prefix(common);
+    }
+    return current;
+}
+
+
+template <typename Mapped>
+auto radix_tree<Mapped>::insert(std::string_view pattern, Mapped value) -> bool
+{
+    auto * current = m_root.get();
+    auto rest = pattern;
+
+    while (!rest.empty()) {
+        auto const dynamic = rest.find_first_of("{*");
+        current = insert_static(current, rest.substr(0, dynamic));
+        if (dynamic == std::string_view::npos) {
+            break;
+        }
+
+        /* Dynamic segments must start a segment */
+        auto const at = static_cast<std::size_t>(rest.data() - pattern.data())
+                + dynamic;
+        if (at == 0 || pattern[at - 1] != '/') {
+            return false;
+        }
+        rest.remove_prefix(dynamic);
+
+        if (rest.front() == '*') {
+            auto name = rest.substr(1);
+            if (name.find('/') != std::string_view::npos) {
+                return false;
+            }
+            if (!current->wildcard) {
+                current->wildcard = std::make_unique<node>();
+                current->wildcard->name = std::string{name};
+            }
+            else if (current->wildcard->name != name) {
+                return false;
+            }
+            current = current->wildcard.get();
+            rest = {};
+            break;
+        }
+
+        auto const close = rest.find('}');
+        if (close == std::string_view::npos || close == 1) {
+            return false;
+        }
+        if (close + 1 < rest.size() && rest[close + 1] != '/') {
+            return false;
+        }
+        auto name = rest.substr(1, close - 1);
+        if (!current->param) {
+            current->param = std::make_unique<node>();
+            current->param->name = std::string{name};
+        }
+        else if (current->param->name != name) {
+            return false;
+        }
+        current = current->param.get();
+        rest.remove_prefix(close + 1);
+    }
+
+    if (current->value) {
+        return false;
+    }
+    current->value.emplace(std::move(value));
+    current->pattern = std::string{pattern};
+    return true;
+}
+
+
+template <typename Mapped>
+template <typename Pred>
+auto radix_tree<Mapped>::match_node(node * current,
+        std::string_view rest,
+        std::size_t consumed,
+        path_params & params,
+        prefix_candidate & best,
+        Pred & is_prefix) -> node *
+{
+    if (rest.empty() && current->value) {
+        return current;
+    }
+
+    if (current->value && is_prefix(*current->value) &&
+        (best.at == nullptr || consumed > best.consumed))
+    {
+        best.at = current;
+        best.consumed = consumed;
+        best.params = params;
+    }
+
+    if (!rest.empty()) {
+        auto index = current->keys.find(rest.front());
+        if (index != current->keys.size()) {
+            auto * child = current->children[index].get();
+            auto const & label = child->prefix;
+            if (rest.starts_with(label)) {
+                auto * found = match_node(child,
+                        rest.substr(label.size()),
+                        consumed + label.size(),
+                        params,
+                        best,
+                        is_prefix);
+                if (found) {
+                    return found;
+                }
+            }
+        }
+    }
+
+    auto const mark = params.size();
+
+    if (current->param && !rest.empty() && rest.front() != '/') {
+        auto const end = std::min(rest.find('/'), rest.size());
+        if (params.push(current->param->name, rest.substr(0, end))) {
+            auto * found = match_node(current->param.get(),
+                    rest.substr(end),
+                    consumed + end,
+                    params,
+                    best,
+                    is_prefix);
+            if (found) {
+                return found;
+            }
+            params.truncate(mark);
+        }
+    }
+
+    if (current->wildcard) {
+        if (params.push(current->wildcard->name, rest)) {
+            if (current->wildcard->value) {
+                return current->wildcard.get();
+            }
+            params.truncate(mark);
+        }
+    }
+
+    return nullptr;
+}
+
+
+template <typename Mapped>
+template <typename Pred>
+auto radix_tree<Mapped>::match(std::string_view path,
+        path_params & params,
+        Pred && is_prefix) const -> radix_match<Mapped>
+{
+    params.clear();
+    auto best = prefix_candidate{};
+
+    auto * found = match_node(m_root.get(), path, 0, params, best, is_prefix);
+    if (!found && best.at) {
+        found = best.at;
+        params = best.params;
+    }
+    if (!found) {
+        params.clear();
+        return {};
+    }
+    return {&*found->value, found->pattern};
+}
+
+
+}
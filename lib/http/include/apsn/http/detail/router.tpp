@@ -7,20 +7,24 @@ template <typename Traits>
 template <typename Alloc>
 auto router<Traits>::before_body(std::string source, 
         beast_empty_parser<Alloc> & prsr,
-        beast_empty_request<Alloc> & req)
+        beast_empty_request<Alloc> & req,
+        basic_request::suspend_fn on_suspend)
     -> std::optional<response>
 {
     /* Take request by reference */
     auto request = apsn::http::request<Traits>{source, req, m_shared};
+    request.on_suspend(std::move(on_suspend));
     auto parser = apsn::http::basic_parser{prsr};
 
-    switch (request.method()) {
-    case boost::beast::http::verb::get: {
-        return handle_get_before_body(parser, request);
+    auto * tree = routes_for(request.method());
+    if (tree == nullptr) {
+        return std::nullopt;
     }
-    default: break;
+    auto const * found = match(*tree, request);
+    if (found == nullptr) {
+        return bad_request(request, "Unhandled");
     }
-    return std::nullopt;
+    return found->handler_->before_body(parser, request);
 }
 
 template <typename Traits>
@@ -28,58 +32,65 @@ template <typename Body, typename Alloc>
 auto router<Traits>::handle(std::string source, 
         beast_request<Body, Alloc> && req)-> response
 {
-    auto response = std::optional<beast::http::message_generator>{};
     auto request = apsn::http::request<Traits>{
             source,
             std::move(req),
             m_shared};
 
-    switch (request.method()) {
-    case boost::beast::http::verb::get:
-        return handle_get(request);
-    default: break;
+    auto * tree = routes_for(request.method());
+    auto const * found = tree ? match(*tree, request) : nullptr;
+    if (found == nullptr) {
+        return bad_request(request, "Unhandled");
     }
-
-    return apsn::http::bad_request(request, "Unhandled");
+    return found->handler_->handle(request);
 }
 
 template <typename Traits>
-auto router<Traits>::handle_get(request<Traits> & request) -> response
+auto router<Traits>::routes_for(boost::beast::http::verb method) -> routes *
 {
-    auto it = m_get.longest_match(std::string{request.target()});
-    if (it == std::end(m_get)) {
-        return bad_request(request, "Unhandled");
+    switch (method) {
+    case boost::beast::http::verb::get:  return &m_get;
+    case boost::beast::http::verb::post: return &m_post;
+    default: return nullptr;
     }
-    auto [type, ptr] = it->second;
-    apsn::log::trace("match: {}", it->first);
-    if (type == router_match::exact && request.target() != it->first) {
-        return bad_request(request, "Rejected");
-    }
-    return ptr->handle(request);
 }
 
 template <typename Traits>
-auto router<Traits>::handle_get_before_body(
-        basic_parser & parser,
-        request<Traits> & request)
-    -> std::optional<response>
+auto router<Traits>::match(routes const & tree, request<Traits> & request)
+    -> matcher const *
 {
-    auto it = m_get.longest_match(std::string{request.target()});
-    if (it == std::end(m_get)) {
-        return bad_request(request, "Unhandled");
+    auto found = tree.match(request.path(), request.params(),
+        [](matcher const & m) { return m.type == router_match::prefix; });
+    if (!found) {
+        return nullptr;
     }
-    auto [type, ptr] = it->second;
-    apsn::log::trace("match: {}", it->first);
-    if (type == router_match::exact && request.target() != it->first) {
-        return bad_request(request, "Rejected");
+    APSN_LOG_TRACE("match: {}", found.pattern);
+    return found.value;
+}
+
+template <typename Traits>
+auto router<Traits>::add(routes & tree,
+        std::string path,
+        router_match type,
+        std::shared_ptr<handler<Traits>> handler_) -> void
+{
+    if (!tree.insert(path, matcher{type, std::move(handler_)})) {
+        apsn::log::error("Route {} is malformed or already registered", path);
     }
-    return ptr->before_body(parser, request);
 }
 
 template <typename Traits>
 template <typename F>
 auto router<Traits>::get(std::string path, router_match type, F && func)
 {
-    insert(m_get, path, matcher{type,
-        ensure_handler<Traits>(std::forward<F>(func))});
+    add(m_get, std::move(path), type,
+            ensure_handler<Traits>(std::forward<F>(func)));
+}
+
+template <typename Traits>
+template <typename F>
+auto router<Traits>::post(std::string path, router_match type, F && func)
+{
+    add(m_post, std::move(path), type,
+            ensure_handler<Traits>(std::forward<F>(func)));
 }
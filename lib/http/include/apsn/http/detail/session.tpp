@@ -2,15 +2,15 @@
 #include <boost/beast/core/stream_traits.hpp>
 
 
-template <typename Impl, typename Traits, bool IsSSL>
-auto session_base<Impl, Traits, IsSSL>::cast() -> Impl&
+template <typename Impl, typename Traits, apsn::ws::transport Transport>
+auto session_base<Impl, Traits, Transport>::cast() -> Impl&
 {
     return static_cast<Impl&>(*this);
 }
 
 
-template <typename Impl, typename Traits, bool IsSSL>
-auto session_base<Impl, Traits, IsSSL>::fail(beast::error_code ec, char const* what) -> void
+template <typename Impl, typename Traits, apsn::ws::transport Transport>
+auto session_base<Impl, Traits, Transport>::fail(beast::error_code ec, char const* what) -> void
 {
     // if (ec == asio::error::operation_aborted || 
     //     ec == asio::error::timed_out || 
@@ -22,148 +22,148 @@ auto session_base<Impl, Traits, IsSSL>::fail(beast::error_code ec, char const* w
 }
 
 
-template <typename Impl, typename Traits, bool IsSSL>
-auto session_base<Impl, Traits, IsSSL>::do_read_header() -> void
-{
-    using namespace std::chrono_literals;
-
-    beast::get_lowest_layer(cast().stream())
-            .expires_after(30s);
-
-    static_assert(boost::beast::is_sync_stream<
-            std::decay_t<decltype(cast().stream())>
-        >::value, "not a sync stream");
-
-
-    m_parser.emplace();
-
-    beast::http::async_read_header(
-        cast().stream(),
-        m_buffer,
-        *m_parser,
-        beast::bind_front_handler(
-            &session_base::on_read_header,
-            cast().shared_from_this()));
-}
-
-
-template <typename Impl, typename Traits, bool IsSSL>
-auto session_base<Impl, Traits, IsSSL>::on_read_header(
-        beast::error_code ec, 
-        std::size_t transferred)
+template <typename Impl, typename Traits, apsn::ws::transport Transport>
+auto session_base<Impl, Traits, Transport>::expires_after(
+        timer_wheel::clock::duration after)
     -> void
 {
-    boost::ignore_unused(transferred);
-
-    if (ec == beast::http::error::end_of_stream) {
-        apsn::log::debug("End-of-stream");
-        return cast().do_eof();
-    }
-
-    if (ec) {
-        return fail(ec, "read");
-    }
-
-    auto source = beast::get_lowest_layer(cast().stream())
-            .socket()
-            .remote_endpoint()
-            .address()
-            .to_string();
-
-    auto hdr_response = m_handler->before_body(source, *m_parser,
-            m_parser->get());
-    if (hdr_response) {
-        return send(hdr_response->message());
+    if (!m_deadline) {
+        m_deadline.emplace(m_timers,
+                cast().stream().get_executor(),
+                [weak = cast().weak_from_this()]() {
+                    if (auto self = weak.lock()) {
+                        self->on_deadline();
+                    }
+                });
     }
-
-    /* TODO: Alter parser object here for body types and various verbs.
-             Use std::variant<std::monostate, BodyTypes...> to hold the
-             parser. Use move constructor on new parser from old. Potential
-             use of std::visit for body type, but that would have to play
-             fair with router and/or handlers. */
-    
-    beast::http::async_read(
-        cast().stream(),
-        m_buffer,
-        *m_parser,
-        beast::bind_front_handler(
-            &session_base::on_read,
-            cast().shared_from_this()));
+    m_deadline->expires_after(after);
 }
 
 
-template <typename Impl, typename Traits, bool IsSSL>
-auto session_base<Impl, Traits, IsSSL>::on_read(
-        beast::error_code ec, 
-        std::size_t transferred)
-    -> void
+/* Outstanding operations fail, which ends the session */
+template <typename Impl, typename Traits, apsn::ws::transport Transport>
+auto session_base<Impl, Traits, Transport>::on_deadline() -> void
 {
-    boost::ignore_unused(transferred);
-
-    if (ec == beast::http::error::end_of_stream) {
-        return cast().do_eof();
-    }
-
-    if (ec) {
-        return fail(ec, "read");
-    }
-
+    apsn::log::debug("Session timed out");
+    beast::get_lowest_layer(cast().stream()).close();
+}
 
 
+template <typename Impl, typename Traits, apsn::ws::transport Transport>
+auto session_base<Impl, Traits, Transport>::do_session(std::shared_ptr<Impl> self)
+    -> asio::awaitable<void>
+{
     namespace websocket = beast::websocket;
-    if (websocket::is_upgrade(m_parser->get())) {
-        auto error = on_ws_upgrade();
-        if (error) {
-            return send(error->message());
-        }
-        return;
-    }
 
-    auto source = beast::get_lowest_layer(cast().stream())
-            .socket()
-            .remote_endpoint()
-            .address()
-            .to_string();
+    static_assert(boost::beast::is_sync_stream<
+            std::decay_t<decltype(cast().stream())>
+        >::value, "not a sync stream");
 
-    send(m_handler->handle(source, std::move(m_parser->release())).message());
-}
+    auto & stream = self->stream();
+    auto ec = beast::error_code{};
+    m_resume.emplace(stream.get_executor());
 
+    while (true) {
+        expires_after(m_timers->timeouts().idle);
+        m_parser.emplace();
 
+        co_await beast::http::async_read_header(stream, m_buffer, *m_parser,
+                with_error(ec));
+        if (ec == beast::http::error::end_of_stream) {
+            apsn::log::debug("End-of-stream");
+            co_return co_await cast().do_eof();
+        }
+        if (ec) {
+            co_return fail(ec, "read");
+        }
 
-template <typename Impl, typename Traits, bool IsSSL>
-auto session_base<Impl, Traits, IsSSL>::send(beast::http::message_generator && msg)
-    -> void
-{
-    bool keep_alive = msg.keep_alive();
-
-    beast::async_write(
-        cast().stream(),
-        std::move(msg),
-        beast::bind_front_handler(
-            &session_base::on_write,
-            cast().shared_from_this(),
-            keep_alive));
-}
+        auto source = remote_address(ec);
+        if (ec) {
+            co_return fail(ec, "remote_endpoint");
+        }
 
+        /* A handler may suspend the request while it waits on other work, in
+           which case nothing further happens until it is resumed. Resumption
+           runs the header through the handlers again. */
+        auto res = std::optional<apsn::http::response>{};
+        while (true) {
+            m_suspended = false;
+            m_resumed = false;
+            res = m_handler->before_body(source,
+                    *m_parser,
+                    m_parser->get(),
+                    [this, self]() -> basic_request::resume_fn {
+                        m_suspended = true;
+                        return [self]() {
+                            asio::post(self->stream().get_executor(), [self] {
+                                self->m_resumed = true;
+                                self->m_resume->notify();
+                            });
+                        };
+                    });
+            if (res || !m_suspended) {
+                break;
+            }
+            if (!m_resumed) {
+                co_await m_resume->wait();
+            }
+        }
 
-template <typename Impl, typename Traits, bool IsSSL>
-auto session_base<Impl, Traits, IsSSL>::on_write(
-        bool keep_alive,
-        beast::error_code ec, 
-        std::size_t transferred) 
-    -> void
-{
-    boost::ignore_unused(transferred);
+        /* A body is read whole, as a string, so it is held to `max_body`
+           whatever limit a handler set in `before_body`. A longer
+           Content-Length has already failed with the header. */
+        if (!res && !m_parser->is_done()) {
+            auto body_parser = beast::http::request_parser<
+                    beast::http::string_body>{std::move(*m_parser)};
+            body_parser.body_limit(max_body);
+            co_await beast::http::async_read(stream, m_buffer, body_parser,
+                    with_error(ec));
+            if (ec == beast::http::error::end_of_stream) {
+                co_return co_await cast().do_eof();
+            }
+            if (ec) {
+                co_return fail(ec, "read");
+            }
+            res = m_handler->handle(source, body_parser.release());
+            m_parser.reset();
+        }
+        else if (!res) {
+            co_await beast::http::async_read(stream, m_buffer, *m_parser,
+                    with_error(ec));
+            if (ec == beast::http::error::end_of_stream) {
+                co_return co_await cast().do_eof();
+            }
+            if (ec) {
+                co_return fail(ec, "read");
+            }
+
+            if (websocket::is_upgrade(m_parser->get())) {
+                /* The stream now belongs to the websocket */
+                m_deadline->cancel();
+                res = on_ws_upgrade();
+                if (!res) {
+                    co_return;
+                }
+            }
+            else {
+                res = m_handler->handle(source,
+                        std::move(m_parser->release()));
+            }
+        }
 
-    if (ec) {
-        return fail(ec, "write");
-    }
+        auto msg = res->message();
+        auto keep_alive = msg.keep_alive();
+        co_await beast::async_write(stream, std::move(msg), with_error(ec));
+        if (ec) {
+            co_return fail(ec, "write");
+        }
 
-    if (!keep_alive) {
-        return cast().do_eof();
+        /* A body left unread when the header was answered would be taken
+           for the next request */
+        if (!keep_alive || (m_parser && !m_parser->is_done())) {
+            co_return co_await cast().do_eof();
+        }
     }
-
-    do_read_header();
 }
 
 
@@ -171,6 +171,7 @@ auto session_base<Impl, Traits, IsSSL>::on_write(
 
 
 
+using apsn::http::local_session;
 using apsn::http::session;
 using apsn::http::ssl_session;
 
@@ -178,28 +179,30 @@ template <typename Traits>
 session<Traits>::session(
         tcp::socket&& socket,
         std::shared_ptr<shared_type> shared,
-        std::shared_ptr<handler_type> handler_)
-    : session_base<session, Traits, false>(shared, handler_)
+        std::shared_ptr<handler_type> handler_,
+        std::shared_ptr<timer_wheel> timers)
+    : session_base<session, Traits, apsn::ws::transport::tcp>(shared, handler_,
+            timers)
     , m_stream(std::move(socket))
 {
 }
 
 
 template <typename Traits>
-auto session<Traits>::do_eof() -> void
+auto session<Traits>::do_eof() -> asio::awaitable<void>
 {
     beast::error_code ec;
     m_stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+    co_return;
 }
 
 
 template <typename Traits>
 auto session<Traits>::run() -> void
 {
-    asio::dispatch(m_stream.get_executor(),
-        beast::bind_front_handler(
-            &base_type::do_read_header,
-            this->shared_from_this()));
+    asio::co_spawn(m_stream.get_executor(),
+            this->do_session(this->shared_from_this()),
+            rethrow);
 }
 
 
@@ -211,65 +214,92 @@ ssl_session<Traits>::ssl_session(
             tcp::socket&& socket, 
             ssl_ctx_ptr ssl_ctx, 
             std::shared_ptr<shared_type> shared,
-            std::shared_ptr<handler_type> handler_)
-    : session_base<ssl_session, Traits, true>(shared, handler_)
+            std::shared_ptr<handler_type> handler_,
+            std::shared_ptr<timer_wheel> timers)
+    : session_base<ssl_session, Traits, apsn::ws::transport::ssl>(shared, handler_,
+            timers)
     , m_stream(std::move(socket), *ssl_ctx)
     , m_ssl_ctx{ssl_ctx}
+    , m_accepted{std::chrono::steady_clock::now()}
 {
 }
 
 
 template <typename Traits>
-auto ssl_session<Traits>::on_handshake(beast::error_code ec, std::size_t bytes_used)
+auto ssl_session<Traits>::do_handshake(std::shared_ptr<ssl_session> self)
+    -> asio::awaitable<void>
 {
-    if (ec)
-        return this->fail(ec, "handshake");
+    auto ec = beast::error_code{};
+
+    this->expires_after(this->m_timers->timeouts().handshake);
+    auto bytes_used = co_await m_stream.async_handshake(
+            ssl::stream_base::server,
+            this->buffer().data(),
+            with_error(ec));
+    if (ec) {
+        co_return this->fail(ec, "handshake");
+    }
+
+    handshake_latency().record(
+            std::chrono::steady_clock::now() - m_accepted);
 
     this->buffer().consume(bytes_used);
-    this->do_read_header();
+    co_await this->do_session(std::move(self));
 }
 
 
 template <typename Traits>
 auto ssl_session<Traits>::run() -> void
 {
-    using namespace std::chrono_literals;
-
-    auto self = this->shared_from_this();
-    asio::dispatch(m_stream.get_executor(),
-        [self](){
-            beast::get_lowest_layer(self->m_stream).expires_after(30s);
-            self->m_stream.async_handshake(
-                ssl::stream_base::server,
-                self->buffer().data(),
-                beast::bind_front_handler(
-                    &ssl_session::on_handshake,
-                    self
-                )
-            );
-        });
+    asio::co_spawn(m_stream.get_executor(),
+            do_handshake(this->shared_from_this()),
+            rethrow);
 }
 
 
 
 template <typename Traits>
-auto ssl_session<Traits>::do_eof() -> void
+auto ssl_session<Traits>::do_eof() -> asio::awaitable<void>
 {
-    using namespace std::chrono_literals;
+    auto ec = beast::error_code{};
+    this->expires_after(this->m_timers->timeouts().idle);
+    co_await m_stream.async_shutdown(with_error(ec));
+    if (ec) {
+        co_return this->fail(ec, "shutdown");
+    }
+}
+
+
+
+
+
+template <typename Traits>
+local_session<Traits>::local_session(
+        asio::local::stream_protocol::socket && socket,
+        std::shared_ptr<shared_type> shared,
+        std::shared_ptr<handler_type> handler_,
+        std::shared_ptr<timer_wheel> timers)
+    : session_base<local_session, Traits, apsn::ws::transport::local>(
+            shared, handler_, timers)
+    , m_stream(std::move(socket))
+{
+}
 
-    beast::get_lowest_layer(m_stream).expires_after(30s);
 
-    m_stream.async_shutdown(
-        beast::bind_front_handler(
-            &ssl_session::on_shutdown,
-            this->shared_from_this()));
+template <typename Traits>
+auto local_session<Traits>::do_eof() -> asio::awaitable<void>
+{
+    beast::error_code ec;
+    m_stream.socket().shutdown(
+            asio::local::stream_protocol::socket::shutdown_send, ec);
+    co_return;
 }
 
 
 template <typename Traits>
-auto ssl_session<Traits>::on_shutdown(beast::error_code ec) -> void
+auto local_session<Traits>::run() -> void
 {
-    if (ec) {
-        return this->fail(ec, "shutdown");
-    }
+    asio::co_spawn(m_stream.get_executor(),
+            this->do_session(this->shared_from_this()),
+            rethrow);
 }
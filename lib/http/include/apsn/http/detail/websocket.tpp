@@ -1,8 +1,8 @@
 
 
-#define WS_IMPL_BASE websocket_impl<HandlerImpl, Traits, IsSSL>
+#define WS_IMPL_BASE websocket_impl<HandlerImpl, Traits, Transport>
 
-template <typename HandlerImpl, typename Traits, bool IsSSL>
+template <typename HandlerImpl, typename Traits, transport Transport>
 auto WS_IMPL_BASE::send(std::shared_ptr<std::string const> const& ss) -> void
 {
     asio::post(
@@ -10,92 +10,157 @@ auto WS_IMPL_BASE::send(std::shared_ptr<std::string const> const& ss) -> void
         beast::bind_front_handler(
             &self_type::on_send,
             handler_layer().shared_from_this(),
-            ss));
+            queued{ss, clock::now(), {}}));
 }
 
 
-template <typename HandlerImpl, typename Traits, bool IsSSL>
+template <typename HandlerImpl, typename Traits, transport Transport>
 auto WS_IMPL_BASE::fail(beast::error_code ec, char const* what) -> void
 {
     apsn::log::error("{}: {}", what, ec.message());
 }
 
 
-template <typename HandlerImpl, typename Traits, bool IsSSL>
-auto WS_IMPL_BASE::on_accept(beast::error_code ec) -> void
+template <typename HandlerImpl, typename Traits, transport Transport>
+template <typename Body, typename Alloc>
+auto WS_IMPL_BASE::do_session(std::shared_ptr<HandlerImpl> self,
+        beast_request<Body, Alloc> req) -> asio::awaitable<void>
 {
+    using apsn::http::with_error;
+
+    auto ec = beast::error_code{};
+
+    m_deadline.emplace(m_timers,
+            m_stream.get_executor(),
+            [weak = handler_layer().weak_from_this()]() {
+                if (auto self = weak.lock()) {
+                    static_cast<self_type &>(*self).on_deadline();
+                }
+            });
+    m_deadline->expires_after(m_timers->timeouts().handshake);
+
+    co_await m_stream.async_accept(req, with_error(ec));
     if (ec)  {
-        return fail(ec, "accept");
+        co_return fail(ec, "accept");
     }
 
+    m_accepted = true;
+    m_stream.control_callback(
+        [this](websocket::frame_type, beast::string_view) {
+            touch();
+        });
+    touch();
+    apsn::http::http_metrics().ws_sessions.add();
     handler_layer().handle_accept();
 
     apsn::log::debug("Stream accepted");
-    m_stream.async_read(
-        m_buffer,
-        beast::bind_front_handler(
-            &self_type::on_read,
-            handler_layer().shared_from_this()));
-}
+    asio::co_spawn(m_stream.get_executor(), do_write(self), apsn::http::rethrow);
 
+    while (true) {
+        auto bytes_transferred = co_await m_stream.async_read(m_buffer,
+                with_error(ec));
+        if (ec)  {
+            break;
+        }
+        touch();
 
-template <typename HandlerImpl, typename Traits, bool IsSSL>
-auto WS_IMPL_BASE::on_read(beast::error_code ec, std::size_t bytes_transferred) -> void
-{
-    if (ec)  {
-        return fail(ec, "read");
+        apsn::http::http_metrics().ws_frames_in.observe(bytes_transferred);
+        handler_layer().handle_message();
+
+        /* TODO:, do something with buffer */
+        m_buffer.consume(bytes_transferred);
     }
 
-    handler_layer().handle_message();
+    /* The writer holds the session too, so has to be told to finish */
+    m_deadline->cancel();
+    m_closed = true;
+    m_writable.notify();
+    fail(ec, "read");
+}
 
 
-    m_buffer.consume(bytes_transferred);
+template <typename HandlerImpl, typename Traits, transport Transport>
+auto WS_IMPL_BASE::on_send(queued entry) -> void
+{
+    entry.enqueued = clock::now();
+    m_queue.push_back(std::move(entry));
+    apsn::http::http_metrics().ws_queue_depth.add();
 
-    /* TODO:, do something with buffer */
-    m_stream.async_read(
-        m_buffer,
-        beast::bind_front_handler(
-            &self_type::on_read,
-            handler_layer().shared_from_this()));
+    // Is the writer waiting for something to write?
+    if (m_queue.size() == 1) {
+        m_writable.notify();
+    }
 }
 
 
-template <typename HandlerImpl, typename Traits, bool IsSSL>
-auto WS_IMPL_BASE::on_send(std::shared_ptr<std::string const> const& ss) -> void
+template <typename HandlerImpl, typename Traits, transport Transport>
+auto WS_IMPL_BASE::do_write(std::shared_ptr<HandlerImpl>)
+    -> asio::awaitable<void>
 {
-    m_queue.push_back(ss);
+    auto ec = beast::error_code{};
+
+    while (!m_closed) {
+        if (m_ping_due) {
+            m_ping_due = false;
+            co_await m_stream.async_ping({}, apsn::http::with_error(ec));
+            if (ec) {
+                co_return fail(ec, "ping");
+            }
+            continue;
+        }
+
+        if (m_queue.empty()) {
+            co_await m_writable.wait();
+            continue;
+        }
+
+        auto bytes_transferred = co_await m_stream.async_write(
+                asio::buffer(*m_queue.front().data),
+                apsn::http::with_error(ec));
+        if (ec) {
+            co_return fail(ec, "write");
+        }
+
+        APSN_LOG_TRACE("websocket_session: Wrote {} bytes", bytes_transferred);
+
+        /* Handlers may observe how long output waited to be written */
+        if constexpr (requires (HandlerImpl & h) { h.handle_sent(send_timing{}); })
+        {
+            auto const & front = m_queue.front();
+            handler_layer().handle_sent(
+                    send_timing{front.sent, front.enqueued, clock::now()});
+        }
+
+        // Remove the string from the queue
+        m_queue.erase(m_queue.begin());
+        apsn::http::http_metrics().ws_queue_depth.sub();
+        apsn::http::http_metrics().ws_frames_out.observe(bytes_transferred);
+    }
+}
 
-    // Are we already writing?
-    if(m_queue.size() > 1)
-        return;
 
-    // We are not currently writing, so send this immediately
-    m_stream.async_write(
-        asio::buffer(*m_queue.front()),
-        beast::bind_front_handler(
-            &self_type::on_write,
-            handler_layer().shared_from_this()));
+template <typename HandlerImpl, typename Traits, transport Transport>
+auto WS_IMPL_BASE::touch() -> void
+{
+    m_pinged = false;
+    m_deadline->expires_after(m_timers->timeouts().websocket / 2);
 }
 
 
-template <typename HandlerImpl, typename Traits, bool IsSSL>
-auto WS_IMPL_BASE::on_write(beast::error_code ec, std::size_t bytes_transferred) -> void
+/* Quiet peers are pinged first, and only closed on if that goes unanswered
+   for the rest of the timeout */
+template <typename HandlerImpl, typename Traits, transport Transport>
+auto WS_IMPL_BASE::on_deadline() -> void
 {
-    if(ec) {
-        return fail(ec, "write");
+    if (m_accepted && !m_closed && !m_pinged) {
+        m_pinged = true;
+        m_ping_due = true;
+        m_writable.notify();
+        auto const timeout = m_timers->timeouts().websocket;
+        m_deadline->expires_after(timeout - timeout / 2);
+        return;
     }
 
-    apsn::log::trace("websocket_session: Wrote {} bytes", bytes_transferred);
-
-    // Remove the string from the queue
-    m_queue.erase(m_queue.begin());
-
-    // Send the next message if any
-    if (!m_queue.empty()) {
-        m_stream.async_write(
-            asio::buffer(*m_queue.front()),
-            beast::bind_front_handler(
-                &self_type::on_write,
-                handler_layer().shared_from_this()));  
-    }
-}
\ No newline at end of file
+    apsn::log::debug("Websocket timed out");
+    beast::get_lowest_layer(m_stream).close();
+}
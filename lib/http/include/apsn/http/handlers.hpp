@@ -64,6 +64,10 @@ auto not_found(request<Traits> & req) -> response;
 template <typename Traits>
 auto server_error(request<Traits> & req, std::string_view what) -> response;
 
+/* Asks the client to try again shortly */
+template <typename Traits>
+auto service_unavailable(request<Traits> & req, std::string_view why) -> response;
+
 template <typename Traits>
 auto unauthorised(request<Traits> & req, 
         std::optional<fs::path> path = std::nullopt)
@@ -117,7 +121,10 @@ template <typename Traits>
 auto basic_auth(request<Traits> & req, std::string_view realm) -> response;
 
 template <typename Traits>
-auto digest_auth(request<Traits> & req, std::string const & realm) -> response;
+auto digest_auth(request<Traits> & req,
+        std::string_view realm,
+        std::string_view nonce,
+        bool stale = false) -> response;
 
 
 
@@ -3,6 +3,7 @@
 #include <apsn/result.hpp>
 
 #include <map>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <system_error>
@@ -47,7 +48,8 @@ public:
         qop,
         response,
         username,
-        opaque
+        opaque,
+        password
     };
 
     static auto parse_field_key(std::string_view str) -> apsn::result<field>;
@@ -55,6 +57,9 @@ public:
     static auto parse(std::string_view value) -> apsn::result<authorisation>;
 
 
+    auto type() const -> type_
+    { return m_type; }
+
     auto operator[](field field_) -> std::string&;
 
     auto has_field(field field_) const ->  bool;
@@ -65,6 +70,15 @@ private:
     std::map<field, std::string> m_elems;
 };
 
+
+/**
+ * @brief Find a cookie's value in a `Cookie` header
+ *
+ * The result views `header`.
+ */
+auto find_cookie(std::string_view header, std::string_view name)
+    -> std::optional<std::string_view>;
+
 }
 
 namespace std {
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <boost/asio.hpp>
+
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace apsn::http {
+
+/**
+ * @brief Listening sockets handed over by the process being replaced
+ *
+ * Listeners look here before opening a socket of their own, and take over
+ * any bound to the address they were asked for. Those left once every
+ * listener has been made are closed with `close_unclaimed`.
+ */
+class inherited_sockets
+{
+public:
+    auto add(int fd) -> void;
+
+    /* The inherited socket bound to `endpoint`, if any. The caller owns
+       what is returned. */
+    template <typename Endpoint>
+    auto take(Endpoint const & endpoint) -> std::optional<int>
+    {
+        auto lock = std::unique_lock<std::mutex>{m_mtx};
+        for (auto it = m_fds.begin(); it != m_fds.end(); ++it) {
+            auto bound = Endpoint{};
+            auto size = static_cast<socklen_t>(bound.capacity());
+            if (::getsockname(*it, bound.data(), &size) != 0) {
+                continue;
+            }
+            bound.resize(size);
+            if (bound == endpoint) {
+                auto fd = *it;
+                m_fds.erase(it);
+                return fd;
+            }
+        }
+        return std::nullopt;
+    }
+
+    /* Closes whatever no listener wanted, returning how many there were */
+    auto close_unclaimed() -> std::size_t;
+
+private:
+    std::mutex m_mtx;
+    std::vector<int> m_fds;
+};
+
+
+/* Shared by every listener in the process */
+auto inherited() -> inherited_sockets &;
+
+
+/**
+ * @brief Makes `acceptor` the listening socket inherited for `endpoint`
+ *
+ * Returns false, leaving `acceptor` alone, if there is none.
+ */
+template <typename Acceptor, typename Endpoint>
+auto adopt_inherited(Acceptor & acceptor,
+        Endpoint const & endpoint,
+        boost::system::error_code & ec) -> bool
+{
+    auto fd = inherited().take(endpoint);
+    if (!fd) {
+        return false;
+    }
+    acceptor.assign(endpoint.protocol(), *fd, ec);
+    if (ec) {
+        ::close(*fd);
+    }
+    return true;
+}
+
+}
@@ -4,12 +4,17 @@
 
 #include <apsn/logging.hpp>
 #include <apsn/http/handlers.hpp>
+#include <apsn/http/inherited.hpp>
+#include <apsn/http/peer.hpp>
+#include <apsn/http/timer_wheel.hpp>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/beast.hpp>
 #include <boost/system/error_code.hpp>
 
+#include <filesystem>
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -24,6 +29,24 @@ using tcp = ip::tcp;
 
 namespace apsn::http {
 
+/**
+ * @brief How a TCP listener shares its port
+ *
+ * Sharded listeners each open their own `SO_REUSEPORT` socket on the same
+ * address, one per IO context, and the kernel spreads new connections
+ * between them. Each context must be run by one thread, so a connection
+ * stays on the thread which accepted it and needs no strand.
+ */
+enum class acceptor_mode
+{
+    single,
+    sharded
+};
+
+
+using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+
 // template <typename State>
 template <typename Traits>
 class listener : public std::enable_shared_from_this<listener<Traits>>
@@ -34,18 +57,33 @@ public:
     listener(asio::io_context & ioc,
             tcp::endpoint endpoint,
             std::shared_ptr<shared_type> shared,
-            std::shared_ptr<handler_type> handler);
+            std::shared_ptr<handler_type> handler,
+            std::shared_ptr<timer_wheel> timers,
+            acceptor_mode mode = acceptor_mode::single);
 
     auto run() -> void;
 
+    /* The bound address, for example to find the port when given port 0 */
+    auto local_endpoint() const -> tcp::endpoint
+    { return m_acceptor.local_endpoint(); }
+
+    /* The listening socket, to hand to a process taking over from this one */
+    auto native_handle() -> int
+    { return m_acceptor.native_handle(); }
+
+    /* Stops accepting. Safe from any thread. */
+    auto close() -> void;
+
 private:
     auto fail(beast::error_code ec, char const* what) -> void;
     auto on_accept(beast::error_code ec, tcp::socket socket) -> void;
 
     asio::io_context & m_ioc;
+    acceptor_mode m_mode;
     tcp::acceptor m_acceptor;
     std::shared_ptr<shared_type> m_shared;
     std::shared_ptr<handler_type> m_handler;
+    std::shared_ptr<timer_wheel> m_timers;
 };
 
 
@@ -64,20 +102,93 @@ public:
             tcp::endpoint endpoint,
             ssl_ctx_ptr ssl,
             std::shared_ptr<shared_type> shared,
-            std::shared_ptr<handler_type> handler);
+            std::shared_ptr<handler_type> handler,
+            std::shared_ptr<timer_wheel> timers,
+            acceptor_mode mode = acceptor_mode::single);
 
     auto run() -> void;
 
+    /* The bound address, for example to find the port when given port 0 */
+    auto local_endpoint() const -> tcp::endpoint
+    { return m_acceptor.local_endpoint(); }
+
+    /* The listening socket, to hand to a process taking over from this one */
+    auto native_handle() -> int
+    { return m_acceptor.native_handle(); }
+
+    /* Stops accepting. Safe from any thread. */
+    auto close() -> void;
+
 private:
     auto fail(beast::error_code ec, char const* what) -> void;
     auto on_accept(beast::error_code ec, tcp::socket socket) -> void;
 
     asio::io_context & m_ioc;
+    acceptor_mode m_mode;
     tcp::acceptor m_acceptor;
     ssl_ctx_ptr m_ssl;
     std::shared_ptr<shared_type> m_shared;
     std::shared_ptr<handler_type> m_handler;
+    std::shared_ptr<timer_wheel> m_timers;
+
+};
+
 
+
+/**
+ * @brief Accepts clients on a Unix domain socket
+ *
+ * Serves the same handlers as `listener`, to clients on the same host,
+ * without TLS. Who a client is comes from `SO_PEERCRED` rather than from
+ * anything it sends; those which `authorise` turns away are disconnected
+ * before a byte is read, so handlers behind this listener need no
+ * authentication of their own.
+ *
+ * A socket file left behind by a server which has gone is replaced, and the
+ * file is removed again when the listener is destroyed while still open.
+ */
+template <typename Traits>
+class local_listener : public std::enable_shared_from_this<local_listener<Traits>>
+{
+    using shared_type = typename Traits::shared_type;
+    using handler_type = typename Traits::handler_type;
+    using protocol = asio::local::stream_protocol;
+
+public:
+    using authoriser = std::function<bool(peer_credentials const &)>;
+
+    local_listener(asio::io_context & ioc,
+            std::filesystem::path path,
+            std::filesystem::perms permissions,
+            authoriser authorise,
+            std::shared_ptr<shared_type> shared,
+            std::shared_ptr<handler_type> handler,
+            std::shared_ptr<timer_wheel> timers);
+
+    ~local_listener();
+
+    auto run() -> void;
+
+    auto is_open() const -> bool
+    { return m_acceptor.is_open(); }
+
+    auto native_handle() -> int
+    { return m_acceptor.native_handle(); }
+
+    /* Stops accepting, leaving the socket file for whoever took it over */
+    auto close() -> void;
+
+private:
+    auto fail(beast::error_code ec, char const* what) -> void;
+    auto on_accept(beast::error_code ec, protocol::socket socket) -> void;
+
+    asio::io_context & m_ioc;
+    protocol::acceptor m_acceptor;
+    std::filesystem::path m_path;
+    authoriser m_authorise;
+    std::shared_ptr<shared_type> m_shared;
+    std::shared_ptr<handler_type> m_handler;
+    std::shared_ptr<timer_wheel> m_timers;
 };
 
 #include <apsn/http/detail/listener.tpp>
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <apsn/metrics.hpp>
+
+
+namespace apsn::http {
+
+/**
+ * @brief Server metrics, registered with apsn::metrics::default_registry()
+ */
+struct server_metrics
+{
+    apsn::metrics::gauge & ws_sessions;
+    apsn::metrics::gauge & ws_queue_depth;
+    apsn::metrics::histogram & ws_frames_out;
+    apsn::metrics::histogram & ws_frames_in;
+
+    /* Microseconds spent checking credentials */
+    apsn::metrics::histogram & basic_auth_latency;
+    apsn::metrics::histogram & digest_auth_latency;
+};
+
+auto http_metrics() -> server_metrics &;
+
+}
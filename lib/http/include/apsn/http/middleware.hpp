@@ -1,13 +1,23 @@
 #pragma once
 
+#include <apsn/http/credentials.hpp>
 #include <apsn/http/handlers.hpp>
 #include <apsn/http/headers.hpp>
+#include <apsn/http/metrics.hpp>
+#include <apsn/http/nonce.hpp>
 #include <apsn/http/response.hpp>
+#include <apsn/http/tokens.hpp>
 
 #include <boost/beast.hpp>
 #include <md5.h>
+#include <openssl/crypto.h>
 
 
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <ranges>
@@ -129,21 +139,98 @@ public:
 };
 
 
+/* Session cookie handling shared by the authentication middleware */
+template <typename Traits>
+class session_cookie
+{
+public:
+    session_cookie(std::shared_ptr<session_tokens> tokens)
+        : m_tokens{tokens}
+    {}
+
+    auto claims(request<Traits> & req) const
+        -> std::optional<session_tokens::claims>
+    {
+        using beast_field = boost::beast::http::field;
+        if (!m_tokens || !req.has_field(beast_field::cookie)) {
+            return std::nullopt;
+        }
+        auto token = headers::find_cookie(req[beast_field::cookie],
+                session_tokens::cookie_name);
+        if (!token) {
+            return std::nullopt;
+        }
+        return m_tokens->verify(*token);
+    }
+
+    /* Requests only get this far once authenticated, either by token, or
+       by credentials checked in `do_before_body`. */
+    auto refresh(request<Traits> & req, response & res) const -> void
+    {
+        using apsn::http::headers::authorisation;
+        using beast_field = boost::beast::http::field;
+
+        if (!m_tokens) {
+            return;
+        }
+
+        auto user = std::string{};
+        if (auto claims_ = claims(req)) {
+            if (!m_tokens->needs_refresh(*claims_)) {
+                return;
+            }
+            user = claims_->user;
+        }
+        else if (req.has_field(beast_field::authorization)) {
+            auto auth = authorisation::parse(req[beast_field::authorization]);
+            if (!auth || !auth->has_field(authorisation::field::username)) {
+                return;
+            }
+            user = auth->get(authorisation::field::username);
+        }
+        else {
+            return;
+        }
+
+        auto token = m_tokens->issue(user);
+        if (!token) {
+            apsn::log::debug("Not issuing session token for {}: {}",
+                    user, token.error_message());
+            return;
+        }
+        res.insert(beast_field::set_cookie, m_tokens->set_cookie(*token));
+    }
+
+private:
+    std::shared_ptr<session_tokens> m_tokens;
+};
+
+
 template <typename Traits>
 class digest_auth : public middleware_base<digest_auth, Traits>
 {
     using shared_type = typename Traits::shared_type;
+    using digest_type = std::array<char, 32>;
 public:
 
     constexpr static auto handler_name = "digest_auth";
 
     digest_auth(std::string const & realm,
             std::string const & ha1,
+            std::shared_ptr<nonce_cache> nonces,
+            std::shared_ptr<session_tokens> tokens,
             std::shared_ptr<handler<Traits>> next)
         : middleware_base<digest_auth, Traits>{next}
         , m_realm{realm}
-        , m_ha1{ha1}
+        , m_nonces{nonces}
+        , m_cookie{tokens}
     {
+        /* Every response starts with "HA1:", so hash it once up front and
+           copy the context per request. */
+        auto trimmed = std::string_view{ha1};
+        trimmed = trimmed.substr(0, trimmed.find_last_not_of(" \t\r\n") + 1);
+        update(m_ha1_prefix, trimmed);
+        update(m_ha1_prefix, ":");
     }
 
     auto do_before_body(basic_parser & p, request<Traits> & req)
@@ -152,42 +239,223 @@ public:
         using apsn::http::headers::authorisation;
         using beast_field = boost::beast::http::field;
 
-        if (req.has_field(beast_field::authorization)) {
-            auto auth = authorisation::parse(req[beast_field::authorization]);
-            if (!auth) {
-                return apsn::http::bad_request(req, auth.error.message());
+        if (auto claims = m_cookie.claims(req)) {
+            req.set_meta("username", std::string{claims->user});
+            p.body_limit(std::numeric_limits<std::uint64_t>::max());
+            return this->next().before_body(p, req);
+        }
+
+        if (!req.has_field(beast_field::authorization)) {
+            return challenge(req, false);
+        }
+
+        auto auth = authorisation::parse(req[beast_field::authorization]);
+        if (!auth) {
+            return apsn::http::bad_request(req, auth.error.message());
+        }
+
+        if (!auth->has_field(authorisation::field::username) || 
+            !auth->has_field(authorisation::field::realm) || 
+            !auth->has_field(authorisation::field::uri) || 
+            !auth->has_field(authorisation::field::nonce) || 
+            !auth->has_field(authorisation::field::response) ||
+            auth->get(authorisation::field::realm) != m_realm)
+        {
+            return challenge(req, false);
+        }
+
+        auto const & uri = auth->get(authorisation::field::uri);
+        if (uri != req.target()) {
+            return apsn::http::bad_request(req, "Digest URI mismatch");
+        }
+
+        auto const & nonce = auth->get(authorisation::field::nonce);
+        auto const has_qop = auth->has_field(authorisation::field::qop);
+        auto nc = std::uint32_t{0};
+        if (has_qop) {
+            auto const & qop = auth->get(authorisation::field::qop);
+            auto const & count = auth->get(authorisation::field::nc);
+            auto [end, ec] = std::from_chars(
+                    count.data(), count.data() + count.size(), nc, 16);
+            if (qop != "auth" ||
+                !auth->has_field(authorisation::field::cnonce) ||
+                ec != std::errc{} || 
+                end != count.data() + count.size())
+            {
+                return apsn::http::bad_request(req, "Unsupported digest qop");
             }
+        }
 
-            if (auth->has_field(authorisation::field::username) && 
-                auth->has_field(authorisation::field::realm) && 
-                auth->has_field(authorisation::field::uri) && 
-                auth->has_field(authorisation::field::nonce) && 
-                auth->has_field(authorisation::field::response))
+        auto const start = std::chrono::steady_clock::now();
+        auto const method = req.method_string();
+        auto ha2 = digest_type{};
+        auto md5 = MD5{};
+        update(md5, method);
+        update(md5, ":");
+        update(md5, uri);
+        md5.finalize().hexdigest(ha2.data());
+
+        auto expected = digest_type{};
+        md5 = m_ha1_prefix;
+        update(md5, nonce);
+        update(md5, ":");
+        if (has_qop) {
+            update(md5, auth->get(authorisation::field::nc));
+            update(md5, ":");
+            update(md5, auth->get(authorisation::field::cnonce));
+            update(md5, ":");
+            update(md5, auth->get(authorisation::field::qop));
+            update(md5, ":");
+        }
+        update(md5, {ha2.data(), ha2.size()});
+        md5.finalize().hexdigest(expected.data());
+
+        auto const & given = auth->get(authorisation::field::response);
+        auto const matches = given.size() == expected.size() &&
+            CRYPTO_memcmp(given.data(), expected.data(), expected.size()) == 0;
+        http_metrics().digest_auth_latency.observe(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count()));
+        if (!matches) {
+            return challenge(req, false);
+        }
+
+        /* The digest is correct, so any failure here is the nonce's fault.
+           Marking it stale lets the browser retry without prompting. */
+        auto status = has_qop 
+                ? m_nonces->validate(nonce, nc) 
+                : m_nonces->validate(nonce);
+        if (status != nonce_cache::status::valid) {
+            apsn::log::debug("Digest nonce {} from {}: {}",
+                    nonce, req.source(), to_string(status));
+            return challenge(req, true);
+        }
+
+        req.set_meta("username", auth->get(authorisation::field::username));
+        p.body_limit(std::numeric_limits<std::uint64_t>::max());
+        return this->next().before_body(p, req); 
+    }
+
+    auto do_handle(request<Traits> & req) -> response
+    {
+        auto response = this->next().handle(req);
+        m_cookie.refresh(req, response);
+        return response;
+    }
+
+private:
+    static auto update(MD5 & md5, std::string_view str) -> void
+    {
+        md5.update(str.data(), static_cast<MD5::size_type>(str.size()));
+    }
+
+    auto challenge(request<Traits> & req, bool stale) -> response
+    {
+        auto nonce = m_nonces->issue();
+        if (!nonce) {
+            apsn::log::fatal("Unable to generate nonce!");
+            return apsn::http::server_error(req, nonce.error_message());
+        }
+        return apsn::http::digest_auth(req, m_realm, *nonce, stale);
+    }
+
+    std::string m_realm;
+    MD5 m_ha1_prefix;
+    std::shared_ptr<nonce_cache> m_nonces;
+    session_cookie<Traits> m_cookie;
+};
+
+
+template <typename Traits>
+class basic_auth : public middleware_base<basic_auth, Traits>
+{
+public:
+    constexpr static auto handler_name = "basic_auth";
+
+    basic_auth(std::string const & realm,
+            std::shared_ptr<credential_verifier> verifier,
+            std::shared_ptr<session_tokens> tokens,
+            std::shared_ptr<handler<Traits>> next)
+        : middleware_base<basic_auth, Traits>{next}
+        , m_realm{realm}
+        , m_verifier{verifier}
+        , m_cookie{tokens}
+    {}
+
+    auto do_before_body(basic_parser & p, request<Traits> & req)
+            -> std::optional<response>
+    {
+        using apsn::http::headers::authorisation;
+        using beast_field = boost::beast::http::field;
+
+        if (auto claims = m_cookie.claims(req)) {
+            return accept(p, req, claims->user);
+        }
+
+        if (!req.has_field(beast_field::authorization)) {
+            return apsn::http::basic_auth(req, m_realm);
+        }
+
+        auto auth = authorisation::parse(req[beast_field::authorization]);
+        if (!auth) {
+            return apsn::http::bad_request(req, auth.error.message());
+        }
+        if (auth->type() != authorisation::type_::basic) {
+            return apsn::http::basic_auth(req, m_realm);
+        }
+
+        auto const & user = auth->get(authorisation::field::username);
+        auto const & pass = auth->get(authorisation::field::password);
+
+        /* Only a login, or the first request after the cache has evicted
+           these credentials, has to wait on the KDF. It never runs on the
+           network thread, and once too many checks are waiting for it, the
+           client is asked to come back. */
+        auto known = m_verifier->cached(user, pass);
+        if (!known) {
+            if (!req.can_suspend()) {
+                return apsn::http::service_unavailable(req,
+                        "Credentials cannot be checked here");
+            }
+            auto resume = req.suspend();
+            if (!m_verifier->async_verify(user, pass,
+                        [resume](bool) { resume(); }))
             {
-                auto expected = MD5{fmt::format("{}:{}:{}",
-                    m_ha1, 
-                    auth->get(authorisation::field::nonce),
-                    MD5{fmt::format("{}:{}", 
-                            req.method_string(),
-                            auth->get(authorisation::field::uri)
-                        )}.hexdigest()
-                    )}.hexdigest();
-
-                if (expected == auth->get(authorisation::field::response))
-                {
-                    req.set_meta("username", 
-                        auth->get(authorisation::field::username));
-                    p.body_limit(std::numeric_limits<std::uint64_t>::max());
-                    return this->next().before_body(p, req); 
-                }
-            }   
-        }
-        return apsn::http::digest_auth(req, m_realm);
+                apsn::log::warn("Too many logins waiting; turned away {}",
+                        req.source());
+                return apsn::http::service_unavailable(req,
+                        "Too many logins at once");
+            }
+            return std::nullopt;
+        }
+
+        if (!*known) {
+            apsn::log::debug("Rejected credentials for {} from {}",
+                    user, req.source());
+            return apsn::http::basic_auth(req, m_realm);
+        }
+        return accept(p, req, user);
+    }
+
+    auto do_handle(request<Traits> & req) -> response
+    {
+        auto response = this->next().handle(req);
+        m_cookie.refresh(req, response);
+        return response;
     }
 
 private:
+    auto accept(basic_parser & p, request<Traits> & req, std::string_view user)
+        -> std::optional<response>
+    {
+        req.set_meta("username", std::string{user});
+        p.body_limit(std::numeric_limits<std::uint64_t>::max());
+        return this->next().before_body(p, req);
+    }
+
     std::string m_realm;
-    std::string m_ha1;
+    std::shared_ptr<credential_verifier> m_verifier;
+    session_cookie<Traits> m_cookie;
 };
 
 }
@@ -217,11 +485,39 @@ auto ncsa_logger(F && next) -> std::shared_ptr<base<Traits>>
 template <typename Traits, typename F>
 auto digest_auth(std::string const & realm,
             std::string const & ha1,
+            std::shared_ptr<nonce_cache> nonces,
+            std::shared_ptr<session_tokens> tokens,
             F && next) -> std::shared_ptr<base<Traits>>
 {
     return std::make_shared<detail::digest_auth<Traits>>(realm,
             ha1,
+            nonces,
+            tokens,
             ensure_handler<Traits>(std::forward<F>(next)));
 }
 
+template <typename Traits, typename F>
+auto basic_auth(std::string const & realm,
+            std::shared_ptr<credential_verifier> verifier,
+            std::shared_ptr<session_tokens> tokens,
+            F && next) -> std::shared_ptr<base<Traits>>
+{
+    return std::make_shared<detail::basic_auth<Traits>>(realm,
+            verifier,
+            tokens,
+            ensure_handler<Traits>(std::forward<F>(next)));
+}
+
+template <typename Traits, typename F>
+auto digest_auth(std::string const & realm,
+            std::string const & ha1,
+            F && next) -> std::shared_ptr<base<Traits>>
+{
+    return digest_auth<Traits>(realm,
+            ha1,
+            std::make_shared<nonce_cache>(),
+            nullptr,
+            std::forward<F>(next));
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <apsn/result.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+namespace apsn::http {
+
+
+/**
+ * @brief Server side table of issued digest nonces.
+ *
+ * A nonce is valid for `lifetime` after it is issued, and is remembered for
+ * the same period again so that late requests can be told the nonce is stale
+ * rather than unknown.
+ *
+ * When `qop=auth` is in use, the nonce count of each request is tracked in a
+ * sliding window. Browsers issue requests concurrently, so counts may arrive
+ * out of order, but a count is only ever accepted once.
+ */
+class nonce_cache
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    enum class status {
+        valid,
+        stale,
+        unknown,
+        replayed
+    };
+
+    constexpr static std::size_t window_size = 64;
+
+    nonce_cache(clock::duration lifetime = std::chrono::minutes{10},
+            std::size_t capacity = 4096);
+
+    /**
+     * @brief Create and remember a new nonce
+     */
+    auto issue() -> apsn::result<std::string>;
+
+    /**
+     * @brief Validate a nonce used without a nonce count (RFC 2069)
+     */
+    auto validate(std::string_view nonce) -> status;
+
+    /**
+     * @brief Validate and consume a nonce count
+     */
+    auto validate(std::string_view nonce, std::uint32_t nc) -> status;
+
+    auto size() const -> std::size_t;
+
+private:
+    struct entry
+    {
+        clock::time_point expires;
+        std::uint32_t highest = 0;
+        std::uint64_t seen = 0;
+    };
+
+    struct string_hash
+    {
+        using is_transparent = void;
+        auto operator()(std::string_view str) const -> std::size_t
+        { return std::hash<std::string_view>{}(str); }
+    };
+
+    auto prune(clock::time_point now) -> void;
+    auto find(std::string_view nonce, clock::time_point now) -> entry *;
+
+    clock::duration m_lifetime;
+    std::size_t m_capacity;
+
+    mutable std::mutex m_mtx;
+    std::unordered_map<std::string, entry, string_hash, std::equal_to<>>
+        m_nonces;
+    std::deque<std::string> m_order;
+};
+
+
+auto to_string(nonce_cache::status value) -> std::string_view;
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <apsn/result.hpp>
+
+#include <boost/asio.hpp>
+
+#include <string>
+
+#include <sys/types.h>
+
+
+namespace apsn::http {
+
+
+/**
+ * @brief The process at the far end of a Unix domain socket
+ *
+ * Read from the kernel with `SO_PEERCRED`, so unlike anything sent over the
+ * socket it cannot be forged by the client. Local listeners use it in place
+ * of TLS and HTTP authentication.
+ */
+struct peer_credentials
+{
+    pid_t pid;
+    uid_t uid;
+    gid_t gid;
+
+    static auto of(int fd) -> apsn::result<peer_credentials>;
+
+    /* The user's login name, or their UID if they have none */
+    auto user() const -> std::string;
+
+    /* Whether `group` is the user's primary group or one of their
+       supplementary groups */
+    auto in_group(gid_t group) const -> bool;
+};
+
+
+/* How requests and session lists describe a client; an IP address, or the
+   user and process of a local one */
+auto remote_address(boost::asio::ip::tcp::socket const & socket,
+        boost::system::error_code & ec) -> std::string;
+
+auto remote_address(boost::asio::local::stream_protocol::socket & socket,
+        boost::system::error_code & ec) -> std::string;
+
+}
@@ -1,9 +1,11 @@
 #pragma once
 
-#include <boost/beast.hpp>
+#include <apsn/http/detail/radix_tree.hpp>
 
+#include <boost/beast.hpp>
 
 #include <any>
+#include <functional>
 #include <map>
 #include <memory>
 #include <optional>
@@ -13,6 +15,8 @@
 
 namespace apsn::http {
 
+using path_params = apsn::detail::path_params;
+
 enum class body_type
 {
     string,
@@ -266,6 +270,39 @@ public:
     auto version() const -> unsigned
     { return m_impl->version(); }
 
+    /* Target without any query string */
+    auto path() const -> std::string_view
+    {
+        auto target = m_impl->target();
+        return target.substr(0, target.find('?'));
+    }
+
+    /* The first value of `name` in the query string, as sent; no percent
+       decoding is done. A name without `=` has an empty value. */
+    auto query(std::string_view name) const -> std::optional<std::string_view>
+    {
+        auto target = m_impl->target();
+        auto start = target.find('?');
+        if (start == std::string_view::npos) {
+            return std::nullopt;
+        }
+        auto rest = target.substr(start + 1);
+        while (!rest.empty()) {
+            auto end = rest.find('&');
+            auto pair = rest.substr(0, end);
+            auto eq = pair.find('=');
+            if (pair.substr(0, eq) == name) {
+                return eq == std::string_view::npos
+                    ? std::string_view{}
+                    : pair.substr(eq + 1);
+            }
+            rest = end == std::string_view::npos
+                ? std::string_view{}
+                : rest.substr(end + 1);
+        }
+        return std::nullopt;
+    }
+
 
     /* Field methods */
     auto has_field(beast_field field) const -> bool
@@ -303,11 +340,40 @@ public:
     { return m_source; }
 
 
+    /* Route parameters, bound by the router */
+    auto params() -> path_params &
+    { return m_params; }
+
+    auto params() const -> path_params const &
+    { return m_params; }
+
+    auto param(std::string_view name) const -> std::optional<std::string_view>
+    { return m_params.get(name); }
+
+
+    /* Suspension. A handler which has to wait on other work calls `suspend`
+       and returns `std::nullopt` from `before_body`. Invoking the returned
+       function later re-runs `before_body` for the same message on the
+       session's executor. */
+    using resume_fn = std::function<void()>;
+    using suspend_fn = std::function<resume_fn()>;
+
+    auto can_suspend() const -> bool
+    { return static_cast<bool>(m_suspend); }
+
+    auto suspend() -> resume_fn
+    { return m_suspend ? m_suspend() : resume_fn{}; }
+
+    auto on_suspend(suspend_fn func) -> void
+    { m_suspend = std::move(func); }
+
+
 private:
     std::string m_source;
     std::unique_ptr<interface> m_impl;
     std::map<std::string, std::any> m_data;
-
+    path_params m_params;
+    suspend_fn m_suspend;
 };
 
 
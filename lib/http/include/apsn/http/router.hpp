@@ -2,7 +2,7 @@
 
 #include <apsn/http/handlers.hpp>
 
-#include <apsn/http/detail/trie.hpp>
+#include <apsn/http/detail/radix_tree.hpp>
 
 #include <boost/beast.hpp>
 #include <nlohmann/json.hpp>
@@ -43,28 +43,39 @@ public:
     template <typename Alloc>
     auto before_body(std::string source, 
             beast_empty_parser<Alloc> & prsr,
-            beast_empty_request<Alloc> & req)
+            beast_empty_request<Alloc> & req,
+            basic_request::suspend_fn on_suspend = {})
         -> std::optional<response>;
 
     template <typename Body, typename Alloc>
     auto handle(std::string source, 
             beast_request<Body, Alloc> && req)-> response;
 
-    auto handle_get(request<Traits> & request) -> response;
-
-    auto handle_get_before_body(basic_parser & parser, request<Traits> & request)
-        -> std::optional<response>;
-
     template <typename F>
     auto get(std::string path, router_match type, F && func);
 
+    /* Handlers see the body, read as a string, in `handle`; `before_body`
+       runs first, on the header alone, as for GET */
+    template <typename F>
+    auto post(std::string path, router_match type, F && func);
+
 private:
     struct matcher {
         router_match type;
         std::shared_ptr<handler<Traits>> handler_;
     };
 
-    apsn::detail::lpm_map<std::string, matcher> m_get;
+    using routes = apsn::detail::radix_tree<matcher>;
+
+    auto routes_for(boost::beast::http::verb method) -> routes *;
+    auto add(routes & tree, std::string path, router_match type,
+            std::shared_ptr<handler<Traits>> handler_) -> void;
+
+    static auto match(routes const & tree, request<Traits> & request)
+        -> matcher const *;
+
+    routes m_get;
+    routes m_post;
     std::shared_ptr<shared_type> m_shared;
 };
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <apsn/http/router.hpp>
+#include <apsn/http/websocket.hpp>
 
 
 namespace apsn::http {
@@ -15,7 +16,7 @@ template <
     typename SharedType = no_data,
     typename UniqueType = no_data,
     template <typename> typename HttpHandler = apsn::http::router,
-    template <typename, bool> typename WebsocketHandler = no_handler
+    template <typename, apsn::ws::transport> typename WebsocketHandler = no_handler
 >
 struct server_traits
 {
@@ -23,8 +24,8 @@ struct server_traits
     using unique_type  = UniqueType;
     using handler_type = HttpHandler<server_traits>;
 
-    template <bool IsSSL>
-    using websocket_handler_type = WebsocketHandler<server_traits, IsSSL>;
+    template <apsn::ws::transport Transport>
+    using websocket_handler_type = WebsocketHandler<server_traits, Transport>;
 };
 
 }
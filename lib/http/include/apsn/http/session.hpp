@@ -1,9 +1,14 @@
 #pragma once
 
 
+#include <apsn/latency.hpp>
 #include <apsn/logging.hpp>
 
+#include <apsn/http/coroutine.hpp>
 #include <apsn/http/handlers.hpp>
+#include <apsn/http/peer.hpp>
+#include <apsn/http/timer_wheel.hpp>
+#include <apsn/http/websocket.hpp>
 
 #include <boost/asio.hpp>
 #include <boost/beast.hpp>
@@ -11,7 +16,9 @@
 #include <boost/beast/http.hpp>
 
 #include <chrono>
+#include <cstdint>
 #include <optional>
+#include <string>
 
 
 namespace asio = boost::asio;
@@ -24,7 +31,15 @@ using tcp = ip::tcp;
 
 namespace apsn::http {
 
-template <typename Impl, typename Traits, bool IsSSL>
+/**
+ * @brief Time from accepting a connection to completing its TLS handshake
+ *
+ * Shared by every SSL session in the process.
+ */
+auto handshake_latency() -> apsn::latency_histogram &;
+
+
+template <typename Impl, typename Traits, apsn::ws::transport Transport>
 class session_base
 {
 public:
@@ -32,32 +47,57 @@ public:
     using unique_type = typename Traits::unique_type;
     using handler_type = typename Traits::handler_type;
 
+    /* The most a request body read into memory may hold */
+    constexpr static std::uint64_t max_body = 1024 * 1024;
+
     session_base(std::shared_ptr<shared_type> shared,
-                 std::shared_ptr<handler_type> handler)
+                 std::shared_ptr<handler_type> handler,
+                 std::shared_ptr<timer_wheel> timers)
         : m_unique{std::make_shared<unique_type>()}
         , m_shared{shared}
         , m_handler{handler}
+        , m_timers{timers}
+        , m_suspended{false}
+        , m_resumed{false}
     {}
 
     auto cast() -> Impl&;
 
     void fail(sys::error_code, char const* what);
-    void send(beast::http::message_generator &&);
 
-    void on_read(sys::error_code, std::size_t);
-    void on_write(bool close, sys::error_code, std::size_t);
+    /* Reads requests and writes responses until the connection is done.
+       The frame keeps `self`, and so the session, alive until then. */
+    auto do_session(std::shared_ptr<Impl> self) -> asio::awaitable<void>;
 
-    void do_read_header();
-    void on_read_header(sys::error_code, std::size_t);
+    /* Closes the connection unless it is re-armed or cancelled within
+       `after` */
+    auto expires_after(timer_wheel::clock::duration after) -> void;
+    auto on_deadline() -> void;
+
+    /* The far end does not change, and for a local client is found with a
+       user lookup, so it is found once per connection */
+    auto remote_address(sys::error_code & ec) -> std::string
+    {
+        if (!m_remote) {
+            auto source = apsn::http::remote_address(
+                    beast::get_lowest_layer(cast().stream()).socket(), ec);
+            if (ec) {
+                return {};
+            }
+            m_remote = std::move(source);
+        }
+        return *m_remote;
+    }
 
     auto on_ws_upgrade() -> std::optional<apsn::http::response>
     {
-        using ws_type = typename Traits::websocket_handler_type<IsSSL>;
+        using ws_type = typename Traits::websocket_handler_type<Transport>;
         
         return std::make_shared<ws_type>(
                     std::move(cast().stream()),
                     this->m_unique,
-                    this->m_shared)
+                    this->m_shared,
+                    this->m_timers)
                 ->run(this->m_parser->release());
     }
 
@@ -74,28 +114,36 @@ public:
     std::shared_ptr<unique_type> m_unique;
     std::shared_ptr<shared_type> m_shared;
     std::shared_ptr<handler_type> m_handler;
+    std::shared_ptr<timer_wheel> m_timers;
+    std::optional<timer_wheel::deadline> m_deadline;
+    std::optional<apsn::http::wakeup> m_resume;
+    std::optional<std::string> m_remote;
+    bool m_suspended;
+    bool m_resumed;
 };
 
 
 
 template <typename Traits>
 class session
-    : public session_base<session<Traits>, Traits, false>
+    : public session_base<session<Traits>, Traits, apsn::ws::transport::tcp>
     , public std::enable_shared_from_this<session<Traits>>
 {
-    using base_type = session_base<session<Traits>, Traits, false>;
+    using base_type = session_base<session<Traits>, Traits,
+            apsn::ws::transport::tcp>;
     using shared_type = typename Traits::shared_type;
     using handler_type = typename Traits::handler_type;
 
 public:
     session(tcp::socket&& socket, 
         std::shared_ptr<shared_type> shared,
-        std::shared_ptr<handler_type> handler_);
+        std::shared_ptr<handler_type> handler_,
+        std::shared_ptr<timer_wheel> timers);
 
     auto stream() -> beast::tcp_stream&
     { return m_stream; }
 
-    auto do_eof() -> void;
+    auto do_eof() -> asio::awaitable<void>;
     auto run() -> void;
 
 private:
@@ -109,10 +157,11 @@ using ssl_ctx_ptr = std::shared_ptr<ssl::context>;
 
 template <typename Traits>
 class ssl_session
-    : public session_base<ssl_session<Traits>, Traits, true>
+    : public session_base<ssl_session<Traits>, Traits, apsn::ws::transport::ssl>
     , public std::enable_shared_from_this<ssl_session<Traits>>
 {
-    using base_type = session_base<ssl_session<Traits>, Traits, true>;    
+    using base_type = session_base<ssl_session<Traits>, Traits,
+            apsn::ws::transport::ssl>;
     using shared_type = typename Traits::shared_type;
     using handler_type = typename Traits::handler_type;
 
@@ -120,20 +169,56 @@ public:
     ssl_session(tcp::socket&& socket,
             ssl_ctx_ptr ssl,
             std::shared_ptr<shared_type> shared,
-            std::shared_ptr<handler_type> handler);
+            std::shared_ptr<handler_type> handler,
+            std::shared_ptr<timer_wheel> timers);
 
     auto stream() -> beast::ssl_stream<beast::tcp_stream>&
     { return m_stream; }
 
-    auto on_handshake(beast::error_code ec, std::size_t bytes_used);
+    auto do_eof() -> asio::awaitable<void>;
     auto run() -> void;
-    auto do_eof() -> void;
-    auto on_shutdown(beast::error_code ec) -> void;
 
 private:
+    auto do_handshake(std::shared_ptr<ssl_session> self)
+        -> asio::awaitable<void>;
+
     beast::ssl_stream<beast::tcp_stream> m_stream;
     ssl_ctx_ptr m_ssl_ctx;
+    std::chrono::steady_clock::time_point m_accepted;
+
+};
 
+
+/**
+ * @brief A session over a Unix domain socket
+ *
+ * Plain HTTP and websockets, as `session` serves, for clients on the same
+ * host. The listener has already checked who the client is.
+ */
+template <typename Traits>
+class local_session
+    : public session_base<local_session<Traits>, Traits, apsn::ws::transport::local>
+    , public std::enable_shared_from_this<local_session<Traits>>
+{
+    using base_type = session_base<local_session<Traits>, Traits,
+            apsn::ws::transport::local>;
+    using shared_type = typename Traits::shared_type;
+    using handler_type = typename Traits::handler_type;
+
+public:
+    local_session(asio::local::stream_protocol::socket && socket,
+        std::shared_ptr<shared_type> shared,
+        std::shared_ptr<handler_type> handler_,
+        std::shared_ptr<timer_wheel> timers);
+
+    auto stream() -> apsn::ws::local_stream &
+    { return m_stream; }
+
+    auto do_eof() -> asio::awaitable<void>;
+    auto run() -> void;
+
+private:
+    apsn::ws::local_stream m_stream;
 };
 
 
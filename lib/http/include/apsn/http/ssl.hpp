@@ -3,8 +3,12 @@
 #include <boost/asio/ssl.hpp>
 
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <memory>
+#include <optional>
 #include <string>
 
 
@@ -13,13 +17,63 @@ namespace apsn::ssl {
 namespace fs = std::filesystem;
 namespace ssl = boost::asio::ssl;
 
-auto make_context(std::string cert, std::string key, std::string dh)
+
+struct tls_options
+{
+    /* Server side session cache entries for TLS 1.2 session IDs. 0 disables
+       the cache. */
+    std::size_t session_cache_size = 1024;
+    std::chrono::seconds session_timeout = std::chrono::hours{2};
+
+    /* How often session ticket keys are replaced. Tickets encrypted with the
+       previous key are still accepted, and renewed. 0 disables tickets. */
+    std::chrono::seconds ticket_rotation = std::chrono::hours{12};
+};
+
+
+/**
+ * @brief Handshake and resumption counters for a context
+ */
+struct tls_stats
+{
+    long handshakes;        ///< Completed server handshakes
+    long failed;            ///< Handshakes started but not completed
+    long resumed;           ///< Handshakes which resumed a session
+    long cache_misses;      ///< Session IDs not found in the cache
+    long cache_timeouts;    ///< Session IDs found, but expired
+    long cache_full;        ///< Sessions evicted for lack of space
+    long cached;            ///< Sessions currently held in the cache
+
+    std::uint64_t tickets_issued;
+    std::uint64_t tickets_renewed;  ///< Resumed with an old key, reissued
+    std::uint64_t tickets_unknown;  ///< Key expired or never ours
+
+    auto resumption_ratio() const -> double
+    { return handshakes == 0 ? 0.0 : static_cast<double>(resumed) / handshakes; }
+};
+
+
+/**
+ * @brief Create a server context
+ *
+ * TLS 1.2 is the minimum version, and TLS 1.2 suites are restricted to
+ * ECDHE key exchange with AEAD ciphers. Supplying Diffie-Hellman parameters
+ * additionally enables the equivalent DHE suites for older clients.
+ */
+auto make_context(std::string cert,
+        std::string key,
+        std::optional<std::string> dh,
+        tls_options const & options = {})
     -> std::shared_ptr<ssl::context>;
 
 auto make_context(
-        fs::path const & cert_path, 
-        fs::path const & key_path, 
-        fs::path const & dh_path)
+        fs::path const & cert_path,
+        fs::path const & key_path,
+        std::optional<fs::path> const & dh_path,
+        tls_options const & options = {})
     -> std::shared_ptr<ssl::context>;
 
-}
\ No newline at end of file
+
+auto stats(ssl::context & ctx) -> tls_stats;
+
+}
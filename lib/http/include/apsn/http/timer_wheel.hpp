@@ -0,0 +1,141 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace apsn::http {
+
+/**
+ * @brief How long connections may sit without making progress
+ */
+struct connection_timeouts
+{
+    /* TLS handshakes and websocket upgrades */
+    std::chrono::seconds handshake{30};
+
+    /* Reading a request and writing its response */
+    std::chrono::seconds idle{30};
+
+    /* A websocket without a frame from its peer. It is pinged half way. */
+    std::chrono::seconds websocket{300};
+};
+
+
+/**
+ * @brief Deadlines for every connection, on one timer
+ *
+ * A hierarchical timing wheel: four levels of 64 slots, the first a tick
+ * apart, each of the others spanning a whole turn of the level below. A
+ * deadline is linked into the slot its expiry falls in, so arming and
+ * cancelling are constant time, and slots further out are cascaded down as
+ * the first level comes round to them.
+ *
+ * Connections are served by several threads, so the wheel is locked. Expiry
+ * callbacks are posted to the executor of their deadline, never run under
+ * the lock.
+ */
+class timer_wheel : public std::enable_shared_from_this<timer_wheel>
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    class deadline;
+
+    constexpr static std::size_t slot_bits = 6;
+    constexpr static std::size_t slots = std::size_t{1} << slot_bits;
+    constexpr static std::size_t levels = 4;
+
+    timer_wheel(boost::asio::any_io_executor ex,
+            connection_timeouts timeouts = {},
+            clock::duration resolution = std::chrono::milliseconds{250},
+            clock::time_point start = clock::now());
+
+    timer_wheel(timer_wheel const &) = delete;
+    auto operator=(timer_wheel const &) -> timer_wheel & = delete;
+
+    /**
+     * @brief Ticks until stopped
+     */
+    auto run() -> void;
+    auto stop() -> void;
+
+    /**
+     * @brief Expire everything due by `now`
+     *
+     * Called on each tick; exposed so that tests need not wait.
+     */
+    auto advance(clock::time_point now) -> void;
+
+    auto timeouts() const -> connection_timeouts const &
+    { return m_timeouts; }
+
+    auto resolution() const -> clock::duration
+    { return m_resolution; }
+
+    /* Deadlines currently armed */
+    auto size() const -> std::size_t;
+
+private:
+    struct node;
+
+    auto link(node & entry) -> void;
+    auto unlink(node & entry) -> void;
+    auto cascade(std::size_t level) -> void;
+    auto tick_at(clock::time_point when) const -> std::uint64_t;
+
+    boost::asio::steady_timer m_timer;
+    connection_timeouts m_timeouts;
+    clock::duration m_resolution;
+    clock::time_point m_start;
+
+    mutable std::mutex m_mtx;
+    std::uint64_t m_now = 0;
+    std::size_t m_size = 0;
+    std::array<std::array<node *, slots>, levels> m_slots{};
+    std::vector<std::pair<std::shared_ptr<node>, std::uint64_t>> m_expired;
+};
+
+
+/**
+ * @brief One connection's deadline on a wheel
+ *
+ * Re-arming replaces the previous expiry. `on_expiry` runs on `ex`; as it
+ * may run just after the deadline is re-armed or destroyed on another
+ * thread, it should hold only a weak reference to its connection.
+ */
+class timer_wheel::deadline
+{
+public:
+    deadline(std::shared_ptr<timer_wheel> wheel,
+            boost::asio::any_io_executor ex,
+            std::function<void()> on_expiry);
+    ~deadline();
+
+    deadline(deadline const &) = delete;
+    auto operator=(deadline const &) -> deadline & = delete;
+
+    auto expires_at(clock::time_point when) -> void;
+    auto expires_after(clock::duration after) -> void
+    { expires_at(clock::now() + after); }
+
+    auto cancel() -> void;
+
+    auto wheel() const -> timer_wheel &
+    { return *m_wheel; }
+
+private:
+    std::shared_ptr<timer_wheel> m_wheel;
+    std::shared_ptr<node> m_node;
+};
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <apsn/result.hpp>
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+
+
+namespace apsn::http {
+
+
+/**
+ * @brief Issues and verifies signed, expiring session tokens.
+ *
+ * Tokens take the form `<expiry>.<user>.<mac>`, where the MAC is a hex encoded
+ * HMAC-SHA256 of `<expiry>.<user>`. The key is generated when the object is
+ * constructed, so restarting the server invalidates every token.
+ *
+ * Tokens are carried in a cookie; see `set_cookie` and `clear_cookie` for the
+ * corresponding `Set-Cookie` header values.
+ */
+class session_tokens
+{
+public:
+    using clock = std::chrono::system_clock;
+
+    constexpr static auto cookie_name = std::string_view{"webserial_session"};
+
+    struct claims
+    {
+        std::string_view user;
+        clock::time_point expires;
+    };
+
+    session_tokens(clock::duration lifetime = std::chrono::hours{8},
+            bool secure = false);
+
+    /**
+     * @brief Create a token for `user`, expiring after the configured lifetime
+     *
+     * Fails if the user name cannot be carried in a cookie.
+     */
+    auto issue(std::string_view user) const -> apsn::result<std::string>;
+
+    /**
+     * @brief Verify a token's signature and expiry
+     *
+     * @return The token's claims, which view `token`, or `std::nullopt`
+     */
+    auto verify(std::string_view token) const -> std::optional<claims>;
+
+    /**
+     * @brief Whether a valid token should be replaced by a fresh one
+     */
+    auto needs_refresh(claims const & claims_) const -> bool;
+
+    auto set_cookie(std::string_view token) const -> std::string;
+    auto clear_cookie() const -> std::string;
+
+    auto lifetime() const -> clock::duration
+    { return m_lifetime; }
+
+private:
+    using mac_type = std::array<unsigned char, 32>;
+
+    auto sign(std::string_view payload, mac_type & mac) const -> bool;
+
+    std::array<unsigned char, 32> m_key;
+    clock::duration m_lifetime;
+    bool m_secure;
+    bool m_valid;
+};
+
+
+}
@@ -2,15 +2,22 @@
 
 
 #include <apsn/logging.hpp>
+#include <apsn/http/coroutine.hpp>
+#include <apsn/http/metrics.hpp>
 #include <apsn/http/request.hpp>
+#include <apsn/http/response.hpp>
+#include <apsn/http/timer_wheel.hpp>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/beast.hpp>
 #include <boost/beast/ssl.hpp>
 
+#include <chrono>
+#include <cstdint>
 #include <iosfwd>
 #include <memory>
+#include <optional>
 
 namespace asio = boost::asio;
 namespace ssl = boost::asio::ssl;
@@ -30,22 +37,40 @@ using beast_request = beast::http::request<Body,
 
 namespace apsn::ws {
 
+/* What a session's bytes travel over */
+enum class transport
+{
+    tcp,
+    ssl,
+    local     ///< A Unix domain socket
+};
+
+
+using local_stream = beast::basic_stream<asio::local::stream_protocol>;
 
-template <bool IsSSL>
+
+template <transport Transport>
 struct streams_when;
 
 template <>
-struct streams_when<true>
+struct streams_when<transport::ssl>
 {
     using ws_stream_type = websocket::stream<beast::ssl_stream<beast::tcp_stream>>;
-    using tcp_stream_type = beast::ssl_stream<beast::tcp_stream>;
+    using stream_type = beast::ssl_stream<beast::tcp_stream>;
 };
 
 template <>
-struct streams_when<false>
+struct streams_when<transport::tcp>
 {
     using ws_stream_type = websocket::stream<beast::tcp_stream>;
-    using tcp_stream_type = beast::tcp_stream;
+    using stream_type = beast::tcp_stream;
+};
+
+template <>
+struct streams_when<transport::local>
+{
+    using ws_stream_type = websocket::stream<local_stream>;
+    using stream_type = local_stream;
 };
 
 
@@ -61,6 +86,22 @@ template <typename T>
 constexpr static auto is_shared_from_this_v = is_shared_from_this<std::decay_t<T>>::value;
 
 
+/**
+ * @brief When a message passed through each stage of a websocket's output
+ *
+ * Handlers which define `handle_sent(send_timing const &)` are given one of
+ * these as each message finishes being written.
+ */
+struct send_timing
+{
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point sent;       ///< Handed to the websocket, on any thread
+    clock::time_point enqueued;   ///< Added to the queue on the stream's executor
+    clock::time_point written;    ///< Write to the socket completed
+};
+
+
 class websocket_base
 {
 public:
@@ -69,13 +110,13 @@ public:
 };
 
 
-template <typename HandlerImpl, typename Traits, bool IsSSL>
+template <typename HandlerImpl, typename Traits, transport Transport>
 class websocket_impl : public websocket_base//<Traits>
 {
-    using self_type = websocket_impl<HandlerImpl, Traits, IsSSL>;
-    using ws_stream_type = typename streams_when<IsSSL>::ws_stream_type;
+    using self_type = websocket_impl<HandlerImpl, Traits, Transport>;
+    using ws_stream_type = typename streams_when<Transport>::ws_stream_type;
 public:
-    using stream_type = typename streams_when<IsSSL>::tcp_stream_type;
+    using stream_type = typename streams_when<Transport>::stream_type;
     using shared_type = typename Traits::shared_type;
     using unique_type = typename Traits::unique_type;
 
@@ -106,7 +147,8 @@ public:
 
     websocket_impl(stream_type && stream,
             std::shared_ptr<unique_type> unique,
-            std::shared_ptr<shared_type> shared)
+            std::shared_ptr<shared_type> shared,
+            std::shared_ptr<apsn::http::timer_wheel> timers)
         : m_stream{std::move(stream)}
         , m_buffer{}
         , m_queue{}
@@ -114,11 +156,22 @@ public:
         , m_ostream{&m_streambuf}
         , m_unique{unique}
         , m_shared{shared}
+        , m_timers{timers}
+        , m_writable{m_stream.get_executor()}
     {
         static_assert(is_shared_from_this_v<HandlerImpl>, 
                 "Websocket handler must derive from shared_from_this");
     }
 
+    ~websocket_impl()
+    {
+        auto & metrics = apsn::http::http_metrics();
+        metrics.ws_queue_depth.sub(static_cast<std::int64_t>(m_queue.size()));
+        if (m_accepted) {
+            metrics.ws_sessions.sub();
+        }
+    }
+
 
     template <typename Body, typename Alloc>
     auto run(beast_request<Body, Alloc> && req)
@@ -129,22 +182,23 @@ public:
             return error;
         }
     
+        /* Handshake, idle and ping deadlines are kept by the timer wheel,
+           rather than by a timer in each stream */
         beast::get_lowest_layer(m_stream).expires_never();
 
-        m_stream.set_option(
-            websocket::stream_base::timeout::suggested(
-                beast::role_type::server));
+        m_stream.set_option(websocket::stream_base::timeout{
+                websocket::stream_base::none(),
+                websocket::stream_base::none(),
+                false});
 
         m_stream.set_option(websocket::stream_base::decorator(
             [](websocket::response_type& res) {
                 res.set(beast::http::field::server, "apsn-serial-mux");
             }));
 
-        m_stream.async_accept(
-            req,
-            beast::bind_front_handler(
-                &self_type::on_accept,
-                handler_layer().shared_from_this()));
+        asio::co_spawn(m_stream.get_executor(),
+                do_session(handler_layer().shared_from_this(), std::move(req)),
+                apsn::http::rethrow);
 
         return {};
     }
@@ -164,41 +218,74 @@ public:
     auto stream() -> ws_stream_type &
     { return m_stream; }
 
+    /* May be called from any thread */
     auto cancel() -> void override
     { 
-        auto self = handler_layer().shared_from_this();
-        return m_stream.async_close(websocket::close_code::normal,
+        auto self = handler_layer().weak_from_this().lock();
+        if (!self) {
+            return;
+        }
+        asio::post(m_stream.get_executor(), [self]() {
+            self->stream().async_close(websocket::close_code::normal,
                 [self](sys::error_code) {
                     apsn::log::info("Websocket closed");
                 });
+        });
     }
 
 private:
+    using clock = send_timing::clock;
+
+    /* Queued output, and when it was handed to `send` and queued */
+    struct queued
+    {
+        std::shared_ptr<std::string const> data;
+        clock::time_point sent;
+        clock::time_point enqueued;
+    };
+
     auto handler_layer() -> HandlerImpl&
     { return static_cast<HandlerImpl&>(*this); }
 
     auto send(std::shared_ptr<std::string const> const& ss) -> void;
     auto fail(beast::error_code ec, char const* what) -> void;
-    auto on_accept(beast::error_code ec) -> void;
-    auto on_read(beast::error_code ec, std::size_t bytes_transferred) -> void;
-    auto on_send(std::shared_ptr<std::string const> const& ss) -> void;
-    auto on_write(beast::error_code ec, std::size_t bytes_transferred) -> void;
+    auto on_send(queued entry) -> void;
+
+    /* Accepts, then reads messages until the websocket closes. Both loops
+       keep the handler alive through the pointer they are given. */
+    template <typename Body, typename Alloc>
+    auto do_session(std::shared_ptr<HandlerImpl> self,
+            beast_request<Body, Alloc> req) -> asio::awaitable<void>;
+
+    /* Writes the queue out, and pings, waiting for more when it is empty */
+    auto do_write(std::shared_ptr<HandlerImpl>) -> asio::awaitable<void>;
+
+    /* Any frame from the peer pushes the deadline back */
+    auto touch() -> void;
+    auto on_deadline() -> void;
 
     ws_stream_type m_stream;
     beast::flat_buffer m_buffer;
-    std::vector<std::shared_ptr<std::string const>> m_queue;
+    std::vector<queued> m_queue;
     streambuf m_streambuf;
     std::ostream m_ostream;
     std::shared_ptr<unique_type> m_unique;
     std::shared_ptr<shared_type> m_shared;
+    std::shared_ptr<apsn::http::timer_wheel> m_timers;
+    std::optional<apsn::http::timer_wheel::deadline> m_deadline;
+    apsn::http::wakeup m_writable;
+    bool m_accepted = false;
+    bool m_closed = false;
+    bool m_ping_due = false;
+    bool m_pinged = false;
 };
 
 #include <apsn/http/detail/websocket.tpp>
 
-template <template <typename, bool> typename Handler,
+template <template <typename, transport> typename Handler,
         typename Traits, 
-        bool IsSSL>
+        transport Transport>
 using websocket_handler = 
-        websocket_impl<Handler<Traits, IsSSL>, Traits, IsSSL>;
+        websocket_impl<Handler<Traits, Transport>, Traits, Transport>;
 
 }
\ No newline at end of file
@@ -0,0 +1,432 @@
+#include "credentials.hpp"
+#include "metrics.hpp"
+
+#include <apsn/logging.hpp>
+
+#include <boost/asio/post.hpp>
+#include <fmt/format.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+
+using apsn::http::credential_verifier;
+using apsn::http::password_db;
+using apsn::http::scrypt_params;
+
+
+namespace {
+
+constexpr auto digits = std::string_view{"0123456789abcdef"};
+constexpr auto prefix = std::string_view{"$scrypt$"};
+constexpr auto salt_length = std::size_t{16};
+constexpr auto key_length = std::size_t{32};
+
+/* Anything above this would take seconds per login, and is more likely to be
+   a corrupt file than a deliberate choice. */
+constexpr auto max_log2_n = 20u;
+
+
+auto to_hex(unsigned char const * data, std::size_t size) -> std::string
+{
+    auto out = std::string{};
+    out.reserve(size * 2);
+    for (auto ii = std::size_t{0}; ii < size; ++ii) {
+        out.push_back(digits[data[ii] >> 4]);
+        out.push_back(digits[data[ii] & 0x0f]);
+    }
+    return out;
+}
+
+auto from_hex(std::string_view hex) -> std::optional<std::vector<unsigned char>>
+{
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9') { return c - '0'; }
+        if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+        return -1;
+    };
+
+    if (hex.size() % 2 != 0) {
+        return std::nullopt;
+    }
+    auto out = std::vector<unsigned char>(hex.size() / 2);
+    for (auto ii = std::size_t{0}; ii < out.size(); ++ii) {
+        auto hi = nibble(hex[ii * 2]);
+        auto lo = nibble(hex[ii * 2 + 1]);
+        if (hi < 0 || lo < 0) {
+            return std::nullopt;
+        }
+        out[ii] = static_cast<unsigned char>(hi << 4 | lo);
+    }
+    return out;
+}
+
+auto max_memory(scrypt_params const & params) -> std::uint64_t
+{
+    /* scrypt needs 128 * r * (N + p) bytes; leave headroom for OpenSSL's
+       own bookkeeping. */
+    return 128ull * params.r * ((1ull << params.log2_n) + params.p)
+            + (1ull << 20);
+}
+
+auto derive(std::string_view password,
+        unsigned char const * salt, std::size_t salt_size,
+        scrypt_params const & params,
+        unsigned char * out, std::size_t out_size) -> bool
+{
+    return EVP_PBE_scrypt(password.data(), password.size(),
+            salt, salt_size,
+            std::uint64_t{1} << params.log2_n, params.r, params.p,
+            max_memory(params),
+            out, out_size) == 1;
+}
+
+/* "ln=15,r=8,p=1" */
+auto parse_params(std::string_view str) -> std::optional<scrypt_params>
+{
+    auto params = scrypt_params{};
+    auto seen = 0;
+    while (!str.empty()) {
+        auto comma = str.find(',');
+        auto item = str.substr(0, comma);
+        str = comma == std::string_view::npos
+                ? std::string_view{}
+                : str.substr(comma + 1);
+
+        auto eq = item.find('=');
+        if (eq == std::string_view::npos) {
+            return std::nullopt;
+        }
+        auto key = item.substr(0, eq);
+        auto value = item.substr(eq + 1);
+        auto number = 0u;
+        auto [end, ec] = std::from_chars(
+                value.data(), value.data() + value.size(), number);
+        if (ec != std::errc{} || end != value.data() + value.size()) {
+            return std::nullopt;
+        }
+
+        if      (key == "ln") { params.log2_n = number; seen |= 1; }
+        else if (key == "r")  { params.r = number;      seen |= 2; }
+        else if (key == "p")  { params.p = number;      seen |= 4; }
+        else                  { return std::nullopt; }
+    }
+
+    if (seen != 7 || params.log2_n == 0 || params.log2_n > max_log2_n ||
+        params.r == 0 || params.p == 0)
+    {
+        return std::nullopt;
+    }
+    return params;
+}
+
+/* Checked against when a user does not exist, so that unknown and known
+   users take equally long to reject. */
+auto dummy_hash() -> std::string const &
+{
+    static auto const hash = [] {
+        auto result = apsn::http::hash_password("");
+        return result ? *result : std::string{};
+    }();
+    return hash;
+}
+
+}
+
+
+auto apsn::http::hash_password(std::string_view password, scrypt_params params)
+    -> apsn::result<std::string>
+{
+    if (params.log2_n == 0 || params.log2_n > max_log2_n ||
+        params.r == 0 || params.p == 0)
+    {
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+
+    auto salt = std::array<unsigned char, salt_length>{};
+    if (RAND_bytes(salt.data(), static_cast<int>(salt.size())) != 1) {
+        return std::make_error_code(std::errc::operation_not_permitted);
+    }
+
+    auto key = std::array<unsigned char, key_length>{};
+    if (!derive(password, salt.data(), salt.size(), params,
+                key.data(), key.size()))
+    {
+        return std::make_error_code(std::errc::not_enough_memory);
+    }
+
+    return fmt::format("{}ln={},r={},p={}${}${}",
+            prefix,
+            params.log2_n, params.r, params.p,
+            to_hex(salt.data(), salt.size()),
+            to_hex(key.data(), key.size()));
+}
+
+
+auto apsn::http::verify_password(std::string_view password,
+        std::string_view encoded) -> bool
+{
+    if (!encoded.starts_with(prefix)) {
+        return false;
+    }
+    encoded.remove_prefix(prefix.size());
+
+    auto first = encoded.find('$');
+    auto last = encoded.rfind('$');
+    if (first == std::string_view::npos || first == last) {
+        return false;
+    }
+
+    auto params = parse_params(encoded.substr(0, first));
+    auto salt = from_hex(encoded.substr(first + 1, last - first - 1));
+    auto expected = from_hex(encoded.substr(last + 1));
+    if (!params || !salt || !expected || expected->empty()) {
+        return false;
+    }
+
+    auto key = std::vector<unsigned char>(expected->size());
+    if (!derive(password, salt->data(), salt->size(), *params,
+                key.data(), key.size()))
+    {
+        return false;
+    }
+    return CRYPTO_memcmp(key.data(), expected->data(), key.size()) == 0;
+}
+
+
+
+auto password_db::parse(std::string_view contents) -> apsn::result<password_db>
+{
+    auto db = password_db{};
+    while (!contents.empty()) {
+        auto eol = contents.find('\n');
+        auto line = contents.substr(0, eol);
+        contents = eol == std::string_view::npos
+                ? std::string_view{}
+                : contents.substr(eol + 1);
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+
+        auto colon = line.find(':');
+        if (colon == 0 || colon == std::string_view::npos ||
+            !line.substr(colon + 1).starts_with(prefix))
+        {
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        db.set(std::string{line.substr(0, colon)},
+               std::string{line.substr(colon + 1)});
+    }
+    return db;
+}
+
+
+auto password_db::load(fs::path const & path) -> apsn::result<password_db>
+{
+    auto file = std::ifstream{path};
+    if (!file) {
+        return std::make_error_code(std::errc::no_such_file_or_directory);
+    }
+    auto contents = std::stringstream{};
+    contents << file.rdbuf();
+    return parse(contents.str());
+}
+
+
+auto password_db::save(fs::path const & path) const -> std::error_code
+{
+    auto file = std::ofstream{path, std::ios::out | std::ios::trunc};
+    if (!file) {
+        return std::make_error_code(static_cast<std::errc>(errno));
+    }
+    for (auto const & [user, encoded] : m_users) {
+        file << user << ':' << encoded << '\n';
+    }
+    file.flush();
+    if (!file) {
+        return std::make_error_code(std::errc::io_error);
+    }
+    return {};
+}
+
+
+auto password_db::find(std::string_view user) const
+    -> std::optional<std::string_view>
+{
+    auto it = m_users.find(user);
+    if (it == std::end(m_users)) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+
+auto password_db::set(std::string user, std::string encoded) -> void
+{
+    m_users.insert_or_assign(std::move(user), std::move(encoded));
+}
+
+
+
+credential_verifier::credential_verifier(password_db db,
+        executor_type executor,
+        std::size_t capacity,
+        std::size_t max_queued)
+    : m_db{std::move(db)}
+    , m_executor{std::move(executor)}
+    , m_max_queued{max_queued}
+    , m_key{}
+    , m_cache{capacity}
+{
+    if (RAND_bytes(m_key.data(), static_cast<int>(m_key.size())) != 1) {
+        apsn::log::error("Could not generate credential cache key");
+    }
+    /* Computed once here, rather than on the first unknown user */
+    dummy_hash();
+}
+
+
+auto credential_verifier::cache_key(std::string_view user,
+        std::string_view password) const -> std::string
+{
+    auto message = std::string{user};
+    message.push_back('\0');
+    message.append(password);
+
+    auto mac = std::array<unsigned char, 32>{};
+    auto length = static_cast<unsigned int>(mac.size());
+    auto * result = HMAC(EVP_sha256(),
+            m_key.data(), static_cast<int>(m_key.size()),
+            reinterpret_cast<unsigned char const *>(message.data()),
+            message.size(),
+            mac.data(), &length);
+    OPENSSL_cleanse(message.data(), message.size());
+
+    if (result == nullptr) {
+        return {};
+    }
+    return std::string{reinterpret_cast<char const *>(mac.data()), length};
+}
+
+
+auto credential_verifier::compute(std::string_view user,
+        std::string_view password) const -> bool
+{
+    auto start = std::chrono::steady_clock::now();
+    auto outcome = false;
+    if (auto encoded = m_db.find(user)) {
+        outcome = verify_password(password, *encoded);
+    }
+    else {
+        verify_password(password, dummy_hash());
+    }
+    http_metrics().basic_auth_latency.observe(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+    return outcome;
+}
+
+
+auto credential_verifier::cached(std::string_view user,
+        std::string_view password) -> std::optional<bool>
+{
+    auto key = cache_key(user, password);
+    if (key.empty()) {
+        return std::nullopt;
+    }
+    auto lock = std::lock_guard{m_mtx};
+    return m_cache.get(key);
+}
+
+
+auto credential_verifier::verify(std::string_view user,
+        std::string_view password) -> bool
+{
+    auto key = cache_key(user, password);
+    if (!key.empty()) {
+        auto lock = std::lock_guard{m_mtx};
+        if (auto outcome = m_cache.get(key)) {
+            return *outcome;
+        }
+    }
+
+    auto outcome = compute(user, password);
+    if (!key.empty()) {
+        auto lock = std::lock_guard{m_mtx};
+        m_cache.put(std::move(key), outcome);
+    }
+    return outcome;
+}
+
+
+auto credential_verifier::async_verify(std::string user,
+        std::string password,
+        callback_type done) -> bool
+{
+    auto key = cache_key(user, password);
+    if (key.empty()) {
+        boost::asio::post(m_executor, [done]{ done(false); });
+        return true;
+    }
+
+    {
+        auto lock = std::lock_guard{m_mtx};
+        if (auto outcome = m_cache.get(key)) {
+            boost::asio::post(m_executor,
+                [done, value = *outcome]{ done(value); });
+            return true;
+        }
+
+        /* Each entry is one computation, queued or running */
+        auto it = m_pending.find(key);
+        if (it != std::end(m_pending)) {
+            it->second.push_back(std::move(done));
+            return true;
+        }
+        if (m_pending.size() >= m_max_queued) {
+            return false;
+        }
+        m_pending[key].push_back(std::move(done));
+    }
+
+    boost::asio::post(m_executor,
+        [this, key = std::move(key),
+         user = std::move(user), password = std::move(password)]() mutable {
+            auto outcome = compute(user, password);
+            OPENSSL_cleanse(password.data(), password.size());
+
+            auto waiting = std::vector<callback_type>{};
+            {
+                auto lock = std::lock_guard{m_mtx};
+                m_cache.put(key, outcome);
+                auto it = m_pending.find(key);
+                if (it != std::end(m_pending)) {
+                    waiting = std::move(it->second);
+                    m_pending.erase(it);
+                }
+            }
+            for (auto & callback : waiting) {
+                callback(outcome);
+            }
+        });
+    return true;
+}
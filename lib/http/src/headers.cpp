@@ -4,11 +4,14 @@
 #include <apsn/logging.hpp>
 #include <apsn/result.hpp>
 
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
 
+#include <algorithm>
 #include <map>
-#include <ranges>
 #include <string>
 #include <string_view>
+#include <vector>
 
 
 
@@ -82,14 +85,61 @@ auto authorisation::parse_type(std::string_view str)
 }
 
 
-auto authorisation::parse(std::string_view value) -> apsn::result<authorisation>
+namespace {
+
+auto trim(std::string_view str) -> std::string_view
+{
+    auto const ws = std::string_view{" \t"};
+    auto first = str.find_first_not_of(ws);
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    auto last = str.find_last_not_of(ws);
+    return str.substr(first, last - first + 1);
+}
+
+/* RFC 7617: base64 of `user-id ":" password` */
+auto parse_basic(std::string_view token, authorisation & result)
+    -> std::error_code
 {
-    using namespace std::string_literals;
-    using namespace std::string_view_literals;
+    using apsn::http::headers::error;
+
+    token = trim(token);
+    if (token.empty() || token.size() % 4 != 0) {
+        return error::invalid_message;
+    }
+
+    auto decoded = std::vector<unsigned char>(token.size() / 4 * 3);
+    auto length = EVP_DecodeBlock(decoded.data(),
+            reinterpret_cast<unsigned char const *>(token.data()),
+            static_cast<int>(token.size()));
+    if (length < 0) {
+        return error::invalid_message;
+    }
+    /* EVP_DecodeBlock counts padding as output */
+    auto size = static_cast<std::size_t>(length);
+    for (auto it = token.rbegin(); it != token.rend() && *it == '='; ++it) {
+        --size;
+    }
+
+    auto credentials = std::string_view{
+            reinterpret_cast<char const *>(decoded.data()), size};
+    auto colon = credentials.find(':');
+    if (colon == std::string_view::npos) {
+        OPENSSL_cleanse(decoded.data(), decoded.size());
+        return error::invalid_message;
+    }
+    result[authorisation::field::username] = credentials.substr(0, colon);
+    result[authorisation::field::password] = credentials.substr(colon + 1);
+    OPENSSL_cleanse(decoded.data(), decoded.size());
+    return {};
+}
+
+}
 
-    namespace rv = std::ranges::views;
-    namespace rg = std::ranges;
 
+auto authorisation::parse(std::string_view value) -> apsn::result<authorisation>
+{
     auto result  = authorisation{};
 
     auto pos = value.find(' ', 0);
@@ -105,26 +155,58 @@ auto authorisation::parse(std::string_view value) -> apsn::result<authorisation>
     }
     result.m_type = *type;
 
-    auto delim = ", "sv;
-    auto last = pos + 1;
+    if (result.m_type == type_::basic) {
+        auto ec = parse_basic(value.substr(pos + 1), result);
+        if (ec) {
+            return ec;
+        }
+        return result;
+    }
 
-    auto fields = value.substr(last);
+    /* Parameters are comma separated. Values are either tokens, e.g.,
+       `qop=auth, nc=00000001`, or quoted strings which may themselves contain
+       commas and escaped quotes. */
+    auto fields = value.substr(pos + 1);
+    while (true) {
+        auto start = fields.find_first_not_of(" \t,");
+        if (start == npos) {
+            break;
+        }
+        fields.remove_prefix(start);
 
-    for (auto const word : fields | std::views::split(delim)) {
-        auto pair = std::string_view(word);
-        auto split_pos = pair.find('=');
+        auto split_pos = fields.find('=');
         if (split_pos == npos) {
             return error::invalid_message;
         }
-
-        auto val_start = split_pos + 2; // including quote
-        auto key = authorisation::parse_field_key(pair.substr(0, split_pos));
+        auto key = authorisation::parse_field_key(
+                trim(fields.substr(0, split_pos)));
         if (!key) {
             return key.error;
         }
-        auto substr = pair.substr(val_start, pair.size() - val_start - 1);
-        auto value = std::string(substr);
-        result[*key] = value;
+        fields.remove_prefix(split_pos + 1);
+        fields = fields.substr(std::min(fields.size(),
+                fields.find_first_not_of(" \t")));
+
+        auto & field_value = result[*key];
+        field_value.clear();
+        if (!fields.empty() && fields.front() == '"') {
+            auto ii = std::size_t{1};
+            for (; ii < fields.size() && fields[ii] != '"'; ++ii) {
+                if (fields[ii] == '\\' && ii + 1 < fields.size()) {
+                    ++ii;
+                }
+                field_value.push_back(fields[ii]);
+            }
+            if (ii == fields.size()) {
+                return error::invalid_message;
+            }
+            fields.remove_prefix(ii + 1);
+        }
+        else {
+            auto end = std::min(fields.find(','), fields.size());
+            field_value = trim(fields.substr(0, end));
+            fields.remove_prefix(end);
+        }
     }
 
     return result;
@@ -148,3 +230,27 @@ auto authorisation::get(field field_) -> std::string const &
     return m_elems[field_];
 }
 
+
+
+auto apsn::http::headers::find_cookie(std::string_view header,
+        std::string_view name) -> std::optional<std::string_view>
+{
+    while (!header.empty()) {
+        auto end = std::min(header.find(';'), header.size());
+        auto pair = trim(header.substr(0, end));
+        header.remove_prefix(std::min(end + 1, header.size()));
+
+        auto split_pos = pair.find('=');
+        if (split_pos == std::string_view::npos ||
+            trim(pair.substr(0, split_pos)) != name)
+        {
+            continue;
+        }
+        auto value = trim(pair.substr(split_pos + 1));
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1, value.size() - 2);
+        }
+        return value;
+    }
+    return std::nullopt;
+}
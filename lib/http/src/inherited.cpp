@@ -0,0 +1,32 @@
+#include "inherited.hpp"
+
+#include <unistd.h>
+
+
+using apsn::http::inherited_sockets;
+
+
+auto inherited_sockets::add(int fd) -> void
+{
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    m_fds.push_back(fd);
+}
+
+
+auto inherited_sockets::close_unclaimed() -> std::size_t
+{
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    for (auto fd : m_fds) {
+        ::close(fd);
+    }
+    auto count = m_fds.size();
+    m_fds.clear();
+    return count;
+}
+
+
+auto apsn::http::inherited() -> inherited_sockets &
+{
+    static auto sockets = inherited_sockets{};
+    return sockets;
+}
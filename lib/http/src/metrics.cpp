@@ -0,0 +1,22 @@
+#include "metrics.hpp"
+
+
+auto apsn::http::http_metrics() -> server_metrics &
+{
+    auto & reg = apsn::metrics::default_registry();
+    static auto instance = server_metrics{
+        reg.gauge("websocket_sessions",
+            "Websocket sessions currently open"),
+        reg.gauge("websocket_queue_depth",
+            "Messages waiting to be written to websockets"),
+        reg.histogram("websocket_frame_bytes",
+            "Size of websocket messages", {{"direction", "out"}}),
+        reg.histogram("websocket_frame_bytes",
+            "Size of websocket messages", {{"direction", "in"}}),
+        reg.histogram("auth_duration_seconds",
+            "Time spent checking credentials", {{"scheme", "basic"}}, 1e-6),
+        reg.histogram("auth_duration_seconds",
+            "Time spent checking credentials", {{"scheme", "digest"}}, 1e-6)
+    };
+    return instance;
+}
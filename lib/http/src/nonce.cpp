@@ -0,0 +1,144 @@
+#include "nonce.hpp"
+
+#include <openssl/rand.h>
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+
+using apsn::http::nonce_cache;
+
+
+nonce_cache::nonce_cache(clock::duration lifetime, std::size_t capacity)
+    : m_lifetime{lifetime}
+    , m_capacity{capacity}
+{}
+
+
+auto nonce_cache::issue() -> apsn::result<std::string>
+{
+    auto bytes = std::array<unsigned char, 16>{};
+    if (RAND_bytes(bytes.data(), static_cast<int>(bytes.size())) != 1) {
+        return std::make_error_code(std::errc::protocol_error);
+    }
+
+    static constexpr auto digits = std::string_view{"0123456789abcdef"};
+    auto nonce = std::string(bytes.size() * 2, '0');
+    for (auto ii = std::size_t{0}; ii < bytes.size(); ++ii) {
+        nonce[ii * 2]     = digits[bytes[ii] >> 4];
+        nonce[ii * 2 + 1] = digits[bytes[ii] & 0x0f];
+    }
+
+    auto now = clock::now();
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    prune(now);
+    while (m_nonces.size() >= m_capacity && !m_order.empty()) {
+        m_nonces.erase(m_order.front());
+        m_order.pop_front();
+    }
+    m_nonces.emplace(nonce, entry{now + m_lifetime});
+    m_order.push_back(nonce);
+    return nonce;
+}
+
+
+auto nonce_cache::validate(std::string_view nonce) -> status
+{
+    auto now = clock::now();
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    auto * found = find(nonce, now);
+    if (found == nullptr) {
+        return status::unknown;
+    }
+    if (now >= found->expires) {
+        return status::stale;
+    }
+    return status::valid;
+}
+
+
+auto nonce_cache::validate(std::string_view nonce, std::uint32_t nc) -> status
+{
+    auto now = clock::now();
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    auto * found = find(nonce, now);
+    if (found == nullptr) {
+        return status::unknown;
+    }
+    if (now >= found->expires) {
+        return status::stale;
+    }
+    if (nc == 0) {
+        return status::replayed;
+    }
+
+    if (nc > found->highest) {
+        auto shift = nc - found->highest;
+        found->seen = shift >= window_size ? 0 : found->seen << shift;
+        found->seen |= 1;
+        found->highest = nc;
+        return status::valid;
+    }
+
+    auto offset = found->highest - nc;
+    if (offset >= window_size) {
+        return status::replayed;
+    }
+    auto bit = std::uint64_t{1} << offset;
+    if (found->seen & bit) {
+        return status::replayed;
+    }
+    found->seen |= bit;
+    return status::valid;
+}
+
+
+auto nonce_cache::size() const -> std::size_t
+{
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    return m_nonces.size();
+}
+
+
+auto nonce_cache::prune(clock::time_point now) -> void
+{
+    /* Entries are issued in expiry order, so only the front need be checked */
+    while (!m_order.empty()) {
+        auto it = m_nonces.find(m_order.front());
+        if (it != std::end(m_nonces) && now < it->second.expires + m_lifetime) {
+            break;
+        }
+        if (it != std::end(m_nonces)) {
+            m_nonces.erase(it);
+        }
+        m_order.pop_front();
+    }
+}
+
+
+auto nonce_cache::find(std::string_view nonce, clock::time_point now)
+    -> entry *
+{
+    prune(now);
+    auto it = m_nonces.find(nonce);
+    if (it == std::end(m_nonces)) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+
+auto apsn::http::to_string(nonce_cache::status value) -> std::string_view
+{
+    switch (value) {
+    case nonce_cache::status::valid:    return "valid";
+    case nonce_cache::status::stale:    return "stale";
+    case nonce_cache::status::unknown:  return "unknown";
+    case nonce_cache::status::replayed: return "replayed";
+    default: return "<unknown status>";
+    }
+}
@@ -0,0 +1,100 @@
+#include "peer.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <grp.h>
+#include <pwd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+using apsn::http::peer_credentials;
+
+
+namespace {
+
+/* getpwuid_r's buffer; `sysconf` may not know the size it needs */
+auto passwd_buffer_size() -> std::size_t
+{
+    auto size = ::sysconf(_SC_GETPW_R_SIZE_MAX);
+    return size > 0 ? static_cast<std::size_t>(size) : std::size_t{16384};
+}
+
+}
+
+
+auto peer_credentials::of(int fd) -> apsn::result<peer_credentials>
+{
+    auto cred = ucred{};
+    auto len = socklen_t{sizeof(cred)};
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+        return std::error_code{errno, std::system_category()};
+    }
+    return peer_credentials{cred.pid, cred.uid, cred.gid};
+}
+
+
+auto peer_credentials::user() const -> std::string
+{
+    auto buffer = std::vector<char>(passwd_buffer_size());
+    auto entry = passwd{};
+    auto * found = static_cast<passwd *>(nullptr);
+    if (::getpwuid_r(uid, &entry, buffer.data(), buffer.size(), &found) == 0
+            && found)
+    {
+        return found->pw_name;
+    }
+    return std::to_string(uid);
+}
+
+
+auto peer_credentials::in_group(gid_t group) const -> bool
+{
+    if (gid == group) {
+        return true;
+    }
+
+    auto buffer = std::vector<char>(passwd_buffer_size());
+    auto entry = passwd{};
+    auto * found = static_cast<passwd *>(nullptr);
+    if (::getpwuid_r(uid, &entry, buffer.data(), buffer.size(), &found) != 0
+            || !found)
+    {
+        return false;
+    }
+
+    auto groups = std::vector<gid_t>(32);
+    auto count = static_cast<int>(groups.size());
+    while (::getgrouplist(found->pw_name, found->pw_gid,
+                groups.data(), &count) < 0)
+    {
+        groups.resize(static_cast<std::size_t>(count));
+    }
+    groups.resize(static_cast<std::size_t>(count));
+    return std::find(groups.begin(), groups.end(), group) != groups.end();
+}
+
+
+auto apsn::http::remote_address(boost::asio::ip::tcp::socket const & socket,
+        boost::system::error_code & ec) -> std::string
+{
+    auto endpoint = socket.remote_endpoint(ec);
+    return ec ? std::string{} : endpoint.address().to_string();
+}
+
+
+auto apsn::http::remote_address(
+        boost::asio::local::stream_protocol::socket & socket,
+        boost::system::error_code & ec) -> std::string
+{
+    auto peer = peer_credentials::of(socket.native_handle());
+    if (!peer) {
+        ec = boost::system::error_code{peer.error.value(),
+                boost::system::system_category()};
+        return {};
+    }
+    return fmt::format("{}@pid:{}", peer->user(), peer->pid);
+}
@@ -1 +1,8 @@
-#include "session.hpp"
\ No newline at end of file
+#include "session.hpp"
+
+
+auto apsn::http::handshake_latency() -> apsn::latency_histogram &
+{
+    static auto histogram = apsn::latency_histogram{};
+    return histogram;
+}
@@ -5,71 +5,333 @@
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
 #include <filesystem>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 
 
 namespace fs = std::filesystem;
 namespace asio = boost::asio;
 
-auto apsn::ssl::make_context(std::string cert, std::string key, std::string dh)
+
+namespace {
+
+/* TLS 1.2 suites; TLS 1.3 suites are all AEAD with ephemeral key exchange,
+   so OpenSSL's defaults are kept for those. */
+constexpr auto ecdhe_ciphers =
+    "ECDHE-ECDSA-AES128-GCM-SHA256:"
+    "ECDHE-RSA-AES128-GCM-SHA256:"
+    "ECDHE-ECDSA-AES256-GCM-SHA384:"
+    "ECDHE-RSA-AES256-GCM-SHA384:"
+    "ECDHE-ECDSA-CHACHA20-POLY1305:"
+    "ECDHE-RSA-CHACHA20-POLY1305";
+
+constexpr auto dhe_ciphers =
+    "DHE-RSA-AES128-GCM-SHA256:"
+    "DHE-RSA-AES256-GCM-SHA384:"
+    "DHE-RSA-CHACHA20-POLY1305";
+
+constexpr auto groups = "X25519:P-256:P-384";
+
+constexpr auto session_id_context = std::string_view{"apsn-webserial"};
+
+
+/**
+ * Session ticket keys. The newest key encrypts new tickets; its predecessor
+ * is kept for one more rotation period so that tickets issued shortly before
+ * a rotation can still be used, and are then reissued under the new key.
+ */
+class ticket_keys
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct key
+    {
+        std::array<unsigned char, 16> name;
+        std::array<unsigned char, 32> aes;
+        std::array<unsigned char, 32> hmac;
+        clock::time_point created;
+    };
+
+    explicit ticket_keys(std::chrono::seconds rotation)
+        : m_rotation{rotation}
+    {}
+
+    auto current() -> std::optional<key>
+    {
+        auto lock = std::lock_guard{m_mtx};
+        auto now = clock::now();
+        if (m_keys.empty() || m_keys.front().created + m_rotation <= now) {
+            auto next = key{};
+            next.created = now;
+            if (RAND_bytes(next.name.data(), next.name.size()) != 1 ||
+                RAND_bytes(next.aes.data(), next.aes.size()) != 1 ||
+                RAND_bytes(next.hmac.data(), next.hmac.size()) != 1)
+            {
+                apsn::log::error("Could not generate session ticket key");
+                return std::nullopt;
+            }
+            m_keys.push_front(next);
+            if (m_keys.size() > 2) {
+                OPENSSL_cleanse(&m_keys.back(), sizeof(key));
+                m_keys.pop_back();
+            }
+            apsn::log::debug("Rotated session ticket key");
+        }
+        return m_keys.front();
+    }
+
+    auto find(unsigned char const * name, bool & newest) -> std::optional<key>
+    {
+        auto lock = std::lock_guard{m_mtx};
+        auto expiry = clock::now() - 2 * m_rotation;
+        for (auto it = std::begin(m_keys); it != std::end(m_keys); ++it) {
+            if (std::memcmp(it->name.data(), name, it->name.size()) == 0 &&
+                it->created > expiry)
+            {
+                newest = it == std::begin(m_keys);
+                return *it;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::atomic<std::uint64_t> issued{0};
+    std::atomic<std::uint64_t> renewed{0};
+    std::atomic<std::uint64_t> unknown{0};
+
+private:
+    std::mutex m_mtx;
+    std::chrono::seconds m_rotation;
+    std::deque<key> m_keys;
+};
+
+
+auto ticket_index() -> int
+{
+    static auto const index = SSL_CTX_get_ex_new_index(
+            0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+
+auto init_mac(EVP_MAC_CTX * hctx, std::array<unsigned char, 32> const & key)
+    -> bool
+{
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+        OSSL_PARAM_construct_end()
+    };
+    return EVP_MAC_init(hctx, key.data(), key.size(), params) == 1;
+}
+
+
+/* See SSL_CTX_set_tlsext_ticket_key_evp_cb(3) for the return values */
+auto ticket_callback(SSL * ssl,
+        unsigned char key_name[16],
+        unsigned char * iv,
+        EVP_CIPHER_CTX * cctx,
+        EVP_MAC_CTX * hctx,
+        int enc) -> int
+{
+    auto * keys = static_cast<ticket_keys *>(
+            SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ticket_index()));
+    if (keys == nullptr) {
+        return -1;
+    }
+
+    auto const * cipher = EVP_aes_256_cbc();
+    if (enc) {
+        auto key = keys->current();
+        if (!key || RAND_bytes(iv, EVP_CIPHER_get_iv_length(cipher)) != 1) {
+            return -1;
+        }
+        std::memcpy(key_name, key->name.data(), key->name.size());
+        if (EVP_EncryptInit_ex(cctx, cipher, nullptr, key->aes.data(), iv) != 1 ||
+            !init_mac(hctx, key->hmac))
+        {
+            return -1;
+        }
+        ++keys->issued;
+        return 1;
+    }
+
+    auto newest = false;
+    auto key = keys->find(key_name, newest);
+    if (!key) {
+        ++keys->unknown;
+        return 0;
+    }
+    if (!init_mac(hctx, key->hmac) ||
+        EVP_DecryptInit_ex(cctx, cipher, nullptr, key->aes.data(), iv) != 1)
+    {
+        return -1;
+    }
+    if (!newest) {
+        ++keys->renewed;
+        return 2;
+    }
+    return 1;
+}
+
+}
+
+
+auto apsn::ssl::make_context(std::string cert,
+        std::string key,
+        std::optional<std::string> dh,
+        tls_options const & options)
     -> std::shared_ptr<ssl::context>
 {
-    auto ctx = std::make_shared<ssl::context>(ssl::context::tlsv12);
+    /* The ticket keys must outlive the SSL_CTX which refers to them, so they
+       are owned by the deleter. */
+    auto keys = std::shared_ptr<ticket_keys>{};
+    if (options.ticket_rotation.count() > 0) {
+        keys = std::make_shared<ticket_keys>(options.ticket_rotation);
+    }
+    auto ctx = std::shared_ptr<ssl::context>{
+            new ssl::context{ssl::context::tls_server},
+            [keys](ssl::context * ptr) { delete ptr; }};
+    auto * native = ctx->native_handle();
+
     ctx->set_password_callback(
         [](std::size_t, ssl::context_base::password_purpose)
         {
             return "";
         });
     ctx->set_options(ssl::context::default_workarounds |
-                        ssl::context::no_sslv2 |
+                        ssl::context::no_compression |
                         ssl::context::single_dh_use);
+    SSL_CTX_set_options(native, SSL_OP_CIPHER_SERVER_PREFERENCE |
+                                SSL_OP_NO_RENEGOTIATION);
     ctx->use_certificate_chain(asio::buffer(cert.data(), cert.size()));
     ctx->use_private_key(asio::buffer(key.data(), key.size()),
             ssl::context::file_format::pem);
 
-    ctx->use_tmp_dh(
-        boost::asio::buffer(dh.data(), dh.size()));
-    
+    auto ciphers = std::string{ecdhe_ciphers};
+    if (dh) {
+        ctx->use_tmp_dh(asio::buffer(dh->data(), dh->size()));
+        ciphers = ciphers + ":" + dhe_ciphers;
+    }
+
+    if (SSL_CTX_set_min_proto_version(native, TLS1_2_VERSION) != 1 ||
+        SSL_CTX_set_cipher_list(native, ciphers.c_str()) != 1 ||
+        SSL_CTX_set1_groups_list(native, groups) != 1)
+    {
+        apsn::log::fatal("Could not configure TLS protocol parameters");
+        return nullptr;
+    }
+
+    SSL_CTX_set_session_id_context(native,
+            reinterpret_cast<unsigned char const *>(session_id_context.data()),
+            static_cast<unsigned int>(session_id_context.size()));
+    if (options.session_cache_size > 0) {
+        SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(native,
+                static_cast<long>(options.session_cache_size));
+        SSL_CTX_set_timeout(native,
+                static_cast<long>(options.session_timeout.count()));
+    }
+    else {
+        SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_OFF);
+    }
+
+    if (keys) {
+        SSL_CTX_set_ex_data(native, ticket_index(), keys.get());
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(native, ticket_callback);
+        /* One ticket per handshake is enough for a browser */
+        SSL_CTX_set_num_tickets(native, 1);
+    }
+    else {
+        SSL_CTX_set_options(native, SSL_OP_NO_TICKET);
+    }
+
     return ctx;
 }
 
 auto apsn::ssl::make_context(
-        fs::path const & cert_path, 
-        fs::path const & key_path, 
-        fs::path const & dh_path)
+        fs::path const & cert_path,
+        fs::path const & key_path,
+        std::optional<fs::path> const & dh_path,
+        tls_options const & options)
     -> std::shared_ptr<ssl::context>
 {
     auto cert_data = util::read_all(cert_path);
     auto key_data = util::read_all(key_path);
-    auto dh_data = util::read_all(dh_path);
 
     if (!cert_data) {
-        apsn::log::fatal("Error reading certificate {}: ",
+        apsn::log::fatal("Error reading certificate {}: {}",
                 cert_path.string(),
                 cert_data.error.message());
         return nullptr;
     }
 
     if (!key_data) {
-        apsn::log::fatal("Error reading private key {}: ",
+        apsn::log::fatal("Error reading private key {}: {}",
                 key_path.string(),
                 key_data.error.message());
         return nullptr;
     }
 
-    if (!dh_data) {
-        apsn::log::fatal("Error reading Diffie-Helmann parameters {}: ",
-                dh_path.string(),
-                dh_data.error.message());
-        return nullptr;
+    auto dh = std::optional<std::string>{};
+    if (dh_path) {
+        auto dh_data = util::read_all(*dh_path);
+        if (!dh_data) {
+            apsn::log::fatal("Error reading Diffie-Helmann parameters {}: {}",
+                    dh_path->string(),
+                    dh_data.error.message());
+            return nullptr;
+        }
+        apsn::log::debug("Using DH {}", dh_path->string());
+        dh = std::move(*dh_data);
     }
 
     apsn::log::debug("Using cert {}", cert_path.string());
     apsn::log::debug("Using key {}", key_path.string());
-    apsn::log::debug("Using DH {}", dh_path.string());
 
-    return make_context(*cert_data, *key_data, *dh_data);
-}
\ No newline at end of file
+    return make_context(*cert_data, *key_data, std::move(dh), options);
+}
+
+
+auto apsn::ssl::stats(ssl::context & ctx) -> tls_stats
+{
+    auto * native = ctx.native_handle();
+    auto accepted = SSL_CTX_sess_accept(native);
+    auto result = tls_stats{
+        .handshakes     = SSL_CTX_sess_accept_good(native),
+        .failed         = 0,
+        .resumed        = SSL_CTX_sess_hits(native),
+        .cache_misses   = SSL_CTX_sess_misses(native),
+        .cache_timeouts = SSL_CTX_sess_timeouts(native),
+        .cache_full     = SSL_CTX_sess_cache_full(native),
+        .cached         = SSL_CTX_sess_number(native),
+        .tickets_issued  = 0,
+        .tickets_renewed = 0,
+        .tickets_unknown = 0
+    };
+    result.failed = accepted - result.handshakes;
+
+    auto const * keys = static_cast<ticket_keys const *>(
+            SSL_CTX_get_ex_data(native, ticket_index()));
+    if (keys != nullptr) {
+        result.tickets_issued = keys->issued;
+        result.tickets_renewed = keys->renewed;
+        result.tickets_unknown = keys->unknown;
+    }
+    return result;
+}
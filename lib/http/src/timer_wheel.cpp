@@ -0,0 +1,230 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+
+namespace asio = boost::asio;
+namespace sys = boost::system;
+
+using apsn::http::timer_wheel;
+
+
+struct timer_wheel::node : std::enable_shared_from_this<node>
+{
+    node(asio::any_io_executor ex, std::function<void()> fn)
+        : executor{std::move(ex)}
+        , on_expiry{std::move(fn)}
+    {}
+
+    asio::any_io_executor executor;
+    std::function<void()> on_expiry;
+
+    /* Owned by the wheel's lock */
+    node * next = nullptr;
+    node ** pprev = nullptr;
+    std::uint64_t expires = 0;
+
+    /* Changes whenever the deadline is re-armed or cancelled, so that an
+       expiry already posted can tell it is no longer wanted */
+    std::atomic<std::uint64_t> generation{0};
+};
+
+
+namespace {
+
+constexpr auto level_shift(std::size_t level) -> std::size_t
+{ return level * timer_wheel::slot_bits; }
+
+constexpr auto slot_mask = std::uint64_t{timer_wheel::slots - 1};
+
+/* The furthest a deadline can be from now, in ticks */
+constexpr auto max_delta =
+        (std::uint64_t{1} << level_shift(timer_wheel::levels)) - 1;
+
+}
+
+
+timer_wheel::timer_wheel(asio::any_io_executor ex,
+        connection_timeouts timeouts,
+        clock::duration resolution,
+        clock::time_point start)
+    : m_timer{std::move(ex)}
+    , m_timeouts{timeouts}
+    , m_resolution{resolution}
+    , m_start{start}
+{}
+
+
+auto timer_wheel::run() -> void
+{
+    auto next = clock::time_point{};
+    {
+        auto lock = std::unique_lock<std::mutex>{m_mtx};
+        next = m_start + m_resolution * static_cast<clock::rep>(m_now + 1);
+    }
+
+    m_timer.expires_at(next);
+    m_timer.async_wait([self = shared_from_this()](sys::error_code ec) {
+        if (ec) {
+            return;
+        }
+        self->advance(clock::now());
+        self->run();
+    });
+}
+
+
+auto timer_wheel::stop() -> void
+{
+    asio::post(m_timer.get_executor(), [self = shared_from_this()] {
+        self->m_timer.cancel();
+    });
+}
+
+
+auto timer_wheel::advance(clock::time_point now) -> void
+{
+    auto expired = decltype(m_expired){};
+    {
+        auto lock = std::unique_lock<std::mutex>{m_mtx};
+        auto target = now < m_start
+            ? std::uint64_t{0}
+            : static_cast<std::uint64_t>((now - m_start) / m_resolution);
+
+        while (m_now < target) {
+            ++m_now;
+            for (auto level = std::size_t{1};
+                    level < levels
+                        && (m_now & ((std::uint64_t{1} << level_shift(level)) - 1)) == 0;
+                    ++level)
+            {
+                cascade(level);
+            }
+
+            auto & head = m_slots[0][m_now & slot_mask];
+            while (head != nullptr) {
+                auto & entry = *head;
+                unlink(entry);
+                m_expired.emplace_back(entry.shared_from_this(),
+                        entry.generation.load(std::memory_order_relaxed));
+            }
+        }
+        std::swap(expired, m_expired);
+    }
+
+    for (auto & [entry, generation] : expired) {
+        asio::post(entry->executor, [entry, generation] {
+            if (entry->generation.load(std::memory_order_acquire) == generation) {
+                entry->on_expiry();
+            }
+        });
+    }
+}
+
+
+auto timer_wheel::size() const -> std::size_t
+{
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    return m_size;
+}
+
+
+auto timer_wheel::link(node & entry) -> void
+{
+    auto delta = entry.expires - m_now;
+    auto level = std::size_t{0};
+    while (level + 1 < levels && delta >> level_shift(level + 1) != 0) {
+        ++level;
+    }
+
+    auto & head = m_slots[level][(entry.expires >> level_shift(level)) & slot_mask];
+    entry.next = head;
+    if (head != nullptr) {
+        head->pprev = &entry.next;
+    }
+    head = &entry;
+    entry.pprev = &head;
+    ++m_size;
+}
+
+
+auto timer_wheel::unlink(node & entry) -> void
+{
+    *entry.pprev = entry.next;
+    if (entry.next != nullptr) {
+        entry.next->pprev = entry.pprev;
+    }
+    entry.next = nullptr;
+    entry.pprev = nullptr;
+    --m_size;
+}
+
+
+/* Moves the slot which the first level has just come round to into the
+   levels below it. Every deadline in it is due within one turn of `level`. */
+auto timer_wheel::cascade(std::size_t level) -> void
+{
+    auto & head = m_slots[level][(m_now >> level_shift(level)) & slot_mask];
+    auto * entry = std::exchange(head, nullptr);
+    while (entry != nullptr) {
+        auto * next = entry->next;
+        entry->pprev = nullptr;
+        --m_size;
+        link(*entry);
+        entry = next;
+    }
+}
+
+
+auto timer_wheel::tick_at(clock::time_point when) const -> std::uint64_t
+{
+    if (when <= m_start) {
+        return 0;
+    }
+    /* Rounded up, so that nothing expires early */
+    auto since = when - m_start;
+    return static_cast<std::uint64_t>(
+            (since + m_resolution - clock::duration{1}) / m_resolution);
+}
+
+
+timer_wheel::deadline::deadline(std::shared_ptr<timer_wheel> wheel,
+        asio::any_io_executor ex,
+        std::function<void()> on_expiry)
+    : m_wheel{std::move(wheel)}
+    , m_node{std::make_shared<node>(std::move(ex), std::move(on_expiry))}
+{}
+
+
+timer_wheel::deadline::~deadline()
+{
+    cancel();
+}
+
+
+auto timer_wheel::deadline::expires_at(clock::time_point when) -> void
+{
+    auto & wheel = *m_wheel;
+    auto lock = std::unique_lock<std::mutex>{wheel.m_mtx};
+    if (m_node->pprev != nullptr) {
+        wheel.unlink(*m_node);
+    }
+    m_node->generation.fetch_add(1, std::memory_order_release);
+    m_node->expires = std::clamp(wheel.tick_at(when),
+            wheel.m_now + 1,
+            wheel.m_now + max_delta);
+    wheel.link(*m_node);
+}
+
+
+auto timer_wheel::deadline::cancel() -> void
+{
+    auto & wheel = *m_wheel;
+    auto lock = std::unique_lock<std::mutex>{wheel.m_mtx};
+    if (m_node->pprev != nullptr) {
+        wheel.unlink(*m_node);
+    }
+    m_node->generation.fetch_add(1, std::memory_order_release);
+}
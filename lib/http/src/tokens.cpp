@@ -0,0 +1,171 @@
+#include "tokens.hpp"
+
+#include <apsn/logging.hpp>
+
+#include <fmt/format.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+
+using apsn::http::session_tokens;
+
+
+namespace {
+
+constexpr auto digits = std::string_view{"0123456789abcdef"};
+
+/* RFC 6265 cookie-octet, less '.', which separates the token's parts */
+auto is_cookie_safe(std::string_view user) -> bool
+{
+    return !user.empty() && std::all_of(std::begin(user), std::end(user),
+        [](unsigned char c) {
+            return c > 0x20 && c < 0x7f &&
+                   c != '"' && c != ',' && c != ';' && c != '\\' && c != '.';
+        });
+}
+
+auto from_hex(char c) -> int
+{
+    if (c >= '0' && c <= '9') { return c - '0'; }
+    if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+    return -1;
+}
+
+}
+
+
+session_tokens::session_tokens(clock::duration lifetime, bool secure)
+    : m_key{}
+    , m_lifetime{lifetime}
+    , m_secure{secure}
+    , m_valid{false}
+{
+    m_valid = RAND_bytes(m_key.data(), static_cast<int>(m_key.size())) == 1;
+    if (!m_valid) {
+        apsn::log::error("Could not generate session token key");
+    }
+}
+
+
+auto session_tokens::sign(std::string_view payload, mac_type & mac) const
+    -> bool
+{
+    auto length = static_cast<unsigned int>(mac.size());
+    auto * result = HMAC(EVP_sha256(),
+            m_key.data(), static_cast<int>(m_key.size()),
+            reinterpret_cast<unsigned char const *>(payload.data()),
+            payload.size(),
+            mac.data(), &length);
+    return result != nullptr && length == mac.size();
+}
+
+
+auto session_tokens::issue(std::string_view user) const
+    -> apsn::result<std::string>
+{
+    if (!m_valid) {
+        return std::make_error_code(std::errc::operation_not_permitted);
+    }
+    if (!is_cookie_safe(user)) {
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+
+    auto expires = std::chrono::duration_cast<std::chrono::seconds>(
+            (clock::now() + m_lifetime).time_since_epoch()).count();
+    auto token = fmt::format("{}.{}", expires, user);
+
+    auto mac = mac_type{};
+    if (!sign(token, mac)) {
+        return std::make_error_code(std::errc::protocol_error);
+    }
+    token.push_back('.');
+    for (auto byte : mac) {
+        token.push_back(digits[byte >> 4]);
+        token.push_back(digits[byte & 0x0f]);
+    }
+    return token;
+}
+
+
+auto session_tokens::verify(std::string_view token) const
+    -> std::optional<claims>
+{
+    if (!m_valid) {
+        return std::nullopt;
+    }
+
+    auto first = token.find('.');
+    auto last = token.rfind('.');
+    if (first == std::string_view::npos || first == last) {
+        return std::nullopt;
+    }
+
+    auto hex = token.substr(last + 1);
+    auto given = mac_type{};
+    if (hex.size() != given.size() * 2) {
+        return std::nullopt;
+    }
+    for (auto ii = std::size_t{0}; ii < given.size(); ++ii) {
+        auto hi = from_hex(hex[ii * 2]);
+        auto lo = from_hex(hex[ii * 2 + 1]);
+        if (hi < 0 || lo < 0) {
+            return std::nullopt;
+        }
+        given[ii] = static_cast<unsigned char>(hi << 4 | lo);
+    }
+
+    auto expected = mac_type{};
+    if (!sign(token.substr(0, last), expected) ||
+        CRYPTO_memcmp(given.data(), expected.data(), expected.size()) != 0)
+    {
+        return std::nullopt;
+    }
+
+    auto seconds = std::int64_t{0};
+    auto [end, ec] = std::from_chars(token.data(), token.data() + first, seconds);
+    if (ec != std::errc{} || end != token.data() + first) {
+        return std::nullopt;
+    }
+
+    auto expires = clock::time_point{std::chrono::seconds{seconds}};
+    if (expires <= clock::now()) {
+        return std::nullopt;
+    }
+    return claims{token.substr(first + 1, last - first - 1), expires};
+}
+
+
+auto session_tokens::needs_refresh(claims const & claims_) const -> bool
+{
+    return claims_.expires - clock::now() < m_lifetime / 2;
+}
+
+
+auto session_tokens::set_cookie(std::string_view token) const -> std::string
+{
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+            m_lifetime).count();
+    return fmt::format("{}={}; Max-Age={}; Path=/; HttpOnly; SameSite=Strict{}",
+            cookie_name,
+            token,
+            seconds,
+            m_secure ? "; Secure" : "");
+}
+
+
+auto session_tokens::clear_cookie() const -> std::string
+{
+    return fmt::format("{}=; Max-Age=0; Path=/; HttpOnly; SameSite=Strict{}",
+            cookie_name,
+            m_secure ? "; Secure" : "");
+}
@@ -0,0 +1,147 @@
+#include <apsn/http/credentials.hpp>
+#include <apsn/http/headers.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <string>
+
+using apsn::http::credential_verifier;
+using apsn::http::password_db;
+
+namespace {
+
+/* Cheap enough to keep the tests quick */
+constexpr auto fast = apsn::http::scrypt_params{10, 8, 1};
+
+}
+
+
+TEST(Credentials, HashRoundTrip)
+{
+    auto hash = apsn::http::hash_password("hunter2", fast);
+    ASSERT_TRUE(static_cast<bool>(hash));
+    EXPECT_TRUE(hash->starts_with("$scrypt$ln=10,r=8,p=1$"));
+
+    EXPECT_TRUE(apsn::http::verify_password("hunter2", *hash));
+    EXPECT_FALSE(apsn::http::verify_password("hunter3", *hash));
+    EXPECT_FALSE(apsn::http::verify_password("hunter2", "$scrypt$ln=10$00$00"));
+    EXPECT_FALSE(apsn::http::verify_password("hunter2", "d41d8cd98f00b204"));
+
+    /* Salted, so the same password never hashes the same way twice */
+    EXPECT_NE(*hash, *apsn::http::hash_password("hunter2", fast));
+}
+
+
+TEST(Credentials, PasswordDatabase)
+{
+    auto alice = *apsn::http::hash_password("a", fast);
+    auto bob = *apsn::http::hash_password("b", fast);
+
+    auto db = password_db::parse(
+            "# users\n"
+            "alice:" + alice + "\r\n"
+            "\n"
+            "bob:" + bob);
+    ASSERT_TRUE(static_cast<bool>(db));
+    EXPECT_EQ(db->size(), 2);
+    EXPECT_EQ(db->find("alice"), alice);
+    EXPECT_EQ(db->find("bob"), bob);
+    EXPECT_FALSE(db->find("carol"));
+
+    /* A digest HA1 file is not a scrypt database */
+    EXPECT_FALSE(password_db::parse("d41d8cd98f00b204e9800998ecf8427e"));
+}
+
+
+TEST(Credentials, VerifierCachesOutcomes)
+{
+    auto db = password_db{};
+    db.set("alice", *apsn::http::hash_password("secret", fast));
+
+    auto pool = boost::asio::thread_pool{1};
+    auto verifier = credential_verifier{db, pool.get_executor(), 2};
+
+    EXPECT_FALSE(verifier.cached("alice", "secret"));
+    EXPECT_TRUE(verifier.verify("alice", "secret"));
+    EXPECT_EQ(verifier.cached("alice", "secret"), true);
+
+    EXPECT_FALSE(verifier.verify("alice", "wrong"));
+    EXPECT_EQ(verifier.cached("alice", "wrong"), false);
+
+    EXPECT_FALSE(verifier.verify("mallory", "secret"));
+    EXPECT_FALSE(verifier.cached("alice", "secret"));   // evicted
+
+    pool.join();
+}
+
+
+TEST(Credentials, VerifierAsync)
+{
+    auto db = password_db{};
+    db.set("alice", *apsn::http::hash_password("secret", fast));
+
+    auto pool = boost::asio::thread_pool{2};
+    auto verifier = credential_verifier{db, pool.get_executor()};
+
+    auto calls = std::atomic<int>{0};
+    auto first = std::promise<bool>{};
+    auto second = std::promise<bool>{};
+    verifier.async_verify("alice", "secret", [&](bool ok) {
+        ++calls;
+        first.set_value(ok);
+    });
+    verifier.async_verify("alice", "secret", [&](bool ok) {
+        ++calls;
+        second.set_value(ok);
+    });
+
+    EXPECT_TRUE(first.get_future().get());
+    EXPECT_TRUE(second.get_future().get());
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(verifier.cached("alice", "secret"), true);
+
+    pool.join();
+}
+
+
+TEST(Credentials, VerifierBoundsItsQueue)
+{
+    auto db = password_db{};
+    db.set("alice", *apsn::http::hash_password("secret", fast));
+
+    /* Not run until the queue is full, so nothing completes early */
+    auto ioc = boost::asio::io_context{};
+    auto verifier = credential_verifier{db, ioc.get_executor(), 16, 2};
+
+    auto calls = std::atomic<int>{0};
+    auto count = [&](bool) { ++calls; };
+    EXPECT_TRUE(verifier.async_verify("alice", "one", count));
+    EXPECT_TRUE(verifier.async_verify("alice", "two", count));
+    EXPECT_TRUE(verifier.async_verify("alice", "one", count));
+    EXPECT_FALSE(verifier.async_verify("alice", "three", count));
+
+    ioc.run();
+    EXPECT_EQ(calls, 3);
+    EXPECT_TRUE(verifier.async_verify("alice", "three", count));
+}
+
+
+TEST(Credentials, BasicAuthorisationHeader)
+{
+    using apsn::http::headers::authorisation;
+
+    /* alice:open sesame */
+    auto auth = authorisation::parse("Basic YWxpY2U6b3BlbiBzZXNhbWU=");
+    ASSERT_TRUE(static_cast<bool>(auth));
+    EXPECT_EQ(auth->type(), authorisation::type_::basic);
+    EXPECT_EQ(auth->get(authorisation::field::username), "alice");
+    EXPECT_EQ(auth->get(authorisation::field::password), "open sesame");
+
+    /* No colon */
+    EXPECT_FALSE(authorisation::parse("Basic YWxpY2U="));
+    EXPECT_FALSE(authorisation::parse("Basic !!!!"));
+}
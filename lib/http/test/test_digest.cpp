@@ -0,0 +1,102 @@
+#include <apsn/http/headers.hpp>
+#include <apsn/http/nonce.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+using apsn::http::nonce_cache;
+using apsn::http::headers::authorisation;
+
+using status = nonce_cache::status;
+
+
+TEST(NonceCache, IssuesDistinctNonces)
+{
+    auto cache = nonce_cache{};
+    auto first = cache.issue();
+    auto second = cache.issue();
+    ASSERT_TRUE(static_cast<bool>(first));
+    ASSERT_TRUE(static_cast<bool>(second));
+    EXPECT_EQ(first->size(), 32);
+    EXPECT_NE(*first, *second);
+    EXPECT_EQ(cache.size(), 2);
+}
+
+
+TEST(NonceCache, RejectsUnknownNonces)
+{
+    auto cache = nonce_cache{};
+    EXPECT_EQ(cache.validate("0123456789abcdef0123456789abcdef"), status::unknown);
+    EXPECT_EQ(cache.validate("0123456789abcdef0123456789abcdef", 1),
+            status::unknown);
+}
+
+
+TEST(NonceCache, TracksNonceCounts)
+{
+    auto cache = nonce_cache{};
+    auto nonce = *cache.issue();
+
+    EXPECT_EQ(cache.validate(nonce, 1), status::valid);
+    EXPECT_EQ(cache.validate(nonce, 1), status::replayed);
+    EXPECT_EQ(cache.validate(nonce, 3), status::valid);
+    /* Out of order, but inside the window */
+    EXPECT_EQ(cache.validate(nonce, 2), status::valid);
+    EXPECT_EQ(cache.validate(nonce, 2), status::replayed);
+    EXPECT_EQ(cache.validate(nonce, 0), status::replayed);
+
+    EXPECT_EQ(cache.validate(nonce, 3 + nonce_cache::window_size),
+            status::valid);
+    EXPECT_EQ(cache.validate(nonce, 3), status::replayed);
+}
+
+
+TEST(NonceCache, ExpiredNoncesAreStale)
+{
+    auto cache = nonce_cache{std::chrono::hours{-1}};
+    auto nonce = *cache.issue();
+    EXPECT_EQ(cache.validate(nonce), status::unknown);
+
+    auto fresh = nonce_cache{std::chrono::milliseconds{200}};
+    nonce = *fresh.issue();
+    std::this_thread::sleep_for(std::chrono::milliseconds{250});
+    EXPECT_EQ(fresh.validate(nonce, 1), status::stale);
+}
+
+
+TEST(NonceCache, BoundsCapacity)
+{
+    auto cache = nonce_cache{std::chrono::minutes{1}, 4};
+    auto first = *cache.issue();
+    for (auto ii = 0; ii < 4; ++ii) {
+        cache.issue();
+    }
+    EXPECT_EQ(cache.size(), 4);
+    EXPECT_EQ(cache.validate(first), status::unknown);
+}
+
+
+TEST(Authorisation, ParsesQuotedAndTokenValues)
+{
+    auto auth = authorisation::parse("Digest username=\"admin\", "
+            "realm=\"webserial\", nonce=\"abc\", uri=\"/a?b=1,2\", "
+            "algorithm=MD5, response=\"0123\", qop=auth, nc=00000001, "
+            "cnonce=\"xyz\"");
+    ASSERT_TRUE(static_cast<bool>(auth));
+    EXPECT_EQ(auth->get(authorisation::field::username), "admin");
+    EXPECT_EQ(auth->get(authorisation::field::uri), "/a?b=1,2");
+    EXPECT_EQ(auth->get(authorisation::field::algorithm), "MD5");
+    EXPECT_EQ(auth->get(authorisation::field::qop), "auth");
+    EXPECT_EQ(auth->get(authorisation::field::nc), "00000001");
+    EXPECT_EQ(auth->get(authorisation::field::cnonce), "xyz");
+}
+
+
+TEST(Authorisation, RejectsUnterminatedQuotes)
+{
+    auto auth = authorisation::parse("Digest username=\"admin");
+    EXPECT_FALSE(static_cast<bool>(auth));
+}
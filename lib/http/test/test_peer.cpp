@@ -0,0 +1,43 @@
+#include <apsn/http/peer.hpp>
+
+#include <boost/asio.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <unistd.h>
+
+using apsn::http::peer_credentials;
+
+namespace asio = boost::asio;
+
+
+TEST(PeerCredentials, NameThisProcess)
+{
+    auto ioc = asio::io_context{};
+    auto ends = std::pair{asio::local::stream_protocol::socket{ioc},
+                          asio::local::stream_protocol::socket{ioc}};
+    asio::local::connect_pair(ends.first, ends.second);
+
+    auto peer = peer_credentials::of(ends.first.native_handle());
+    ASSERT_TRUE(static_cast<bool>(peer));
+    EXPECT_EQ(peer->pid, ::getpid());
+    EXPECT_EQ(peer->uid, ::geteuid());
+    EXPECT_EQ(peer->gid, ::getegid());
+    EXPECT_TRUE(peer->in_group(::getegid()));
+    EXPECT_FALSE(peer->user().empty());
+
+    auto ec = boost::system::error_code{};
+    auto address = apsn::http::remote_address(ends.first, ec);
+    EXPECT_FALSE(ec);
+    EXPECT_EQ(address, peer->user() + "@pid:" + std::to_string(::getpid()));
+}
+
+
+TEST(PeerCredentials, FailWithoutASocket)
+{
+    auto peer = peer_credentials::of(-1);
+    EXPECT_FALSE(static_cast<bool>(peer));
+    EXPECT_TRUE(peer.error == std::errc::bad_file_descriptor);
+}
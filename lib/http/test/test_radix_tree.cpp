@@ -0,0 +1,112 @@
+#include <apsn/http/detail/radix_tree.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using apsn::detail::path_params;
+using apsn::detail::radix_tree;
+
+
+struct route
+{
+    std::string name;
+    bool prefix = false;
+};
+
+static auto is_prefix = [](route const & r) { return r.prefix; };
+
+
+TEST(RadixTree, MatchesStaticRoutes)
+{
+    auto tree = radix_tree<route>{};
+    ASSERT_TRUE(tree.insert("/json", {"json"}));
+    ASSERT_TRUE(tree.insert("/jsonp", {"jsonp"}));
+    ASSERT_TRUE(tree.insert("/logout", {"logout"}));
+
+    auto params = path_params{};
+    EXPECT_EQ(tree.match("/json", params)->name, "json");
+    EXPECT_EQ(tree.match("/jsonp", params)->name, "jsonp");
+    EXPECT_EQ(tree.match("/logout", params)->name, "logout");
+    EXPECT_FALSE(tree.match("/jso", params));
+    EXPECT_FALSE(tree.match("/logouts", params));
+}
+
+
+TEST(RadixTree, ExactRoutesDoNotShadowPrefixRoutes)
+{
+    auto tree = radix_tree<route>{};
+    ASSERT_TRUE(tree.insert("/", {"root", true}));
+    ASSERT_TRUE(tree.insert("/pages", {"pages", true}));
+    ASSERT_TRUE(tree.insert("/logout", {"logout"}));
+
+    auto params = path_params{};
+    EXPECT_EQ(tree.match("/loggedout.html", params, is_prefix)->name, "root");
+    EXPECT_EQ(tree.match("/logout", params, is_prefix)->name, "logout");
+    EXPECT_EQ(tree.match("/pages/a.html", params, is_prefix)->name, "pages");
+    EXPECT_EQ(tree.match("/index.html", params, is_prefix)->name, "root");
+}
+
+
+TEST(RadixTree, BindsParameters)
+{
+    auto tree = radix_tree<route>{};
+    ASSERT_TRUE(tree.insert("/api/ports/{id}", {"port"}));
+    ASSERT_TRUE(tree.insert("/api/ports/{id}/options", {"options"}));
+    ASSERT_TRUE(tree.insert("/api/ports/list", {"list"}));
+
+    auto params = path_params{};
+    auto match = tree.match("/api/ports/12", params);
+    ASSERT_TRUE(match);
+    EXPECT_EQ(match->name, "port");
+    EXPECT_EQ(match.pattern, "/api/ports/{id}");
+    EXPECT_EQ(params.get("id"), "12");
+
+    EXPECT_EQ(tree.match("/api/ports/7/options", params)->name, "options");
+    EXPECT_EQ(params.get("id"), "7");
+
+    EXPECT_EQ(tree.match("/api/ports/list", params)->name, "list");
+    EXPECT_TRUE(params.empty());
+
+    EXPECT_FALSE(tree.match("/api/ports/", params));
+    EXPECT_FALSE(tree.match("/api/ports/7/other", params));
+}
+
+
+TEST(RadixTree, WildcardCapturesRemainder)
+{
+    auto tree = radix_tree<route>{};
+    ASSERT_TRUE(tree.insert("/files/*path", {"files"}));
+
+    auto params = path_params{};
+    ASSERT_TRUE(tree.match("/files/a/b/c.txt", params));
+    EXPECT_EQ(params.get("path"), "a/b/c.txt");
+}
+
+
+TEST(RadixTree, RejectsConflictsAndMalformedPatterns)
+{
+    auto tree = radix_tree<route>{};
+    ASSERT_TRUE(tree.insert("/a/{id}", {"a"}));
+    EXPECT_FALSE(tree.insert("/a/{id}", {"again"}));
+    EXPECT_FALSE(tree.insert("/a/{name}/x", {"renamed"}));
+    EXPECT_FALSE(tree.insert("/b{id}", {"mid-segment"}));
+    EXPECT_FALSE(tree.insert("/c/{id", {"unterminated"}));
+    EXPECT_FALSE(tree.insert("/d/*rest/x", {"wildcard"}));
+}
+
+
+TEST(RadixTree, ManyChildren)
+{
+    auto tree = radix_tree<route>{};
+    for (auto c = 'A'; c <= 'z'; ++c) {
+        ASSERT_TRUE(tree.insert(std::string{"/"} + c, {std::string{c}}));
+    }
+
+    auto params = path_params{};
+    for (auto c = 'A'; c <= 'z'; ++c) {
+        auto match = tree.match(std::string{"/"} + c, params);
+        ASSERT_TRUE(match);
+        EXPECT_EQ(match->name, std::string{c});
+    }
+}
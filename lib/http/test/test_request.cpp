@@ -95,4 +95,19 @@ TEST(Request, CanModifyFieldsIfByReference)
     brequest.set(beast_field::host, host_changed);
     EXPECT_EQ(host_changed, arequest[beast_field::host]);
 
-}
\ No newline at end of file
+}
+
+TEST(Request, CanLookupQueryParameters)
+{
+    auto brequest = string_request{};
+    brequest.target("/api/triggers?since=12&all&limit=");
+
+    auto arequest = basic_request{"", std::move(brequest)};
+    EXPECT_EQ(arequest.path(), "/api/triggers");
+    EXPECT_EQ(arequest.query("since"), "12");
+    EXPECT_EQ(arequest.query("all"), "");
+    EXPECT_EQ(arequest.query("limit"), "");
+    EXPECT_FALSE(arequest.query("sin"));
+    auto bare = basic_request{"", string_request{}};
+    EXPECT_FALSE(bare.query("since"));
+}
@@ -0,0 +1,183 @@
+#include <apsn/http/ssl.hpp>
+
+#include <gtest/gtest.h>
+#include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+
+namespace {
+
+template <typename T, void (*Free)(T *)>
+struct deleter
+{
+    auto operator()(T * ptr) const -> void { Free(ptr); }
+};
+
+using bio_ptr = std::unique_ptr<BIO, deleter<BIO, BIO_free_all>>;
+using key_ptr = std::unique_ptr<EVP_PKEY, deleter<EVP_PKEY, EVP_PKEY_free>>;
+using x509_ptr = std::unique_ptr<X509, deleter<X509, X509_free>>;
+using ssl_ptr = std::unique_ptr<SSL, deleter<SSL, SSL_free>>;
+using ssl_ctx_ptr = std::unique_ptr<SSL_CTX, deleter<SSL_CTX, SSL_CTX_free>>;
+using session_ptr = std::unique_ptr<SSL_SESSION,
+        deleter<SSL_SESSION, SSL_SESSION_free>>;
+
+
+auto to_pem(auto write) -> std::string
+{
+    auto bio = bio_ptr{BIO_new(BIO_s_mem())};
+    write(bio.get());
+    char * data = nullptr;
+    auto size = BIO_get_mem_data(bio.get(), &data);
+    return std::string(data, static_cast<std::size_t>(size));
+}
+
+
+struct credentials
+{
+    std::string cert;
+    std::string key;
+};
+
+auto self_signed() -> credentials
+{
+    auto key = key_ptr{EVP_EC_gen("P-256")};
+    auto cert = x509_ptr{X509_new()};
+    X509_set_version(cert.get(), 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert.get()), 3600);
+    X509_set_pubkey(cert.get(), key.get());
+    auto * name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+            reinterpret_cast<unsigned char const *>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+    X509_sign(cert.get(), key.get(), EVP_sha256());
+
+    return {
+        to_pem([&](BIO * bio) { PEM_write_bio_X509(bio, cert.get()); }),
+        to_pem([&](BIO * bio) {
+            PEM_write_bio_PrivateKey(bio, key.get(),
+                    nullptr, nullptr, 0, nullptr, nullptr);
+        })
+    };
+}
+
+
+/* Drive a client and server through a handshake over memory BIOs */
+auto handshake(SSL_CTX * server_ctx, SSL_CTX * client_ctx,
+        SSL_SESSION * resume, int version) -> session_ptr
+{
+    auto server = ssl_ptr{SSL_new(server_ctx)};
+    auto client = ssl_ptr{SSL_new(client_ctx)};
+    SSL_set_min_proto_version(client.get(), version);
+    SSL_set_max_proto_version(client.get(), version);
+    if (resume != nullptr) {
+        SSL_set_session(client.get(), resume);
+    }
+
+    BIO * server_io = nullptr;
+    BIO * client_io = nullptr;
+    BIO_new_bio_pair(&server_io, 0, &client_io, 0);
+    SSL_set_bio(server.get(), server_io, server_io);
+    SSL_set_bio(client.get(), client_io, client_io);
+    SSL_set_accept_state(server.get());
+    SSL_set_connect_state(client.get());
+
+    auto server_done = false;
+    auto client_done = false;
+    for (auto ii = 0; ii < 32 && !(server_done && client_done); ++ii) {
+        client_done = client_done || SSL_do_handshake(client.get()) == 1;
+        server_done = server_done || SSL_do_handshake(server.get()) == 1;
+    }
+    if (!server_done || !client_done) {
+        return nullptr;
+    }
+
+    /* TLS 1.3 tickets arrive after the handshake */
+    char byte = 0;
+    SSL_write(server.get(), "x", 1);
+    SSL_read(client.get(), &byte, 1);
+
+    /* Sessions from connections which are not shut down cleanly are not
+       resumable */
+    SSL_shutdown(client.get());
+    SSL_shutdown(server.get());
+    return session_ptr{SSL_get1_session(client.get())};
+}
+
+}
+
+
+class TlsContext : public ::testing::TestWithParam<int> {};
+
+
+TEST_P(TlsContext, ResumesSessions)
+{
+    auto creds = self_signed();
+    auto server = apsn::ssl::make_context(creds.cert, creds.key, std::nullopt);
+    ASSERT_TRUE(server);
+
+    auto client = ssl_ctx_ptr{SSL_CTX_new(TLS_client_method())};
+    SSL_CTX_set_session_cache_mode(client.get(), SSL_SESS_CACHE_CLIENT);
+
+    auto session = handshake(server->native_handle(), client.get(),
+            nullptr, GetParam());
+    ASSERT_TRUE(session);
+
+    auto resumed = handshake(server->native_handle(), client.get(),
+            session.get(), GetParam());
+    ASSERT_TRUE(resumed);
+
+    auto stats = apsn::ssl::stats(*server);
+    EXPECT_EQ(stats.handshakes, 2);
+    EXPECT_EQ(stats.resumed, 1);
+    EXPECT_DOUBLE_EQ(stats.resumption_ratio(), 0.5);
+    EXPECT_GE(stats.tickets_issued, 1u);
+}
+
+INSTANTIATE_TEST_SUITE_P(Versions, TlsContext,
+        ::testing::Values(TLS1_2_VERSION, TLS1_3_VERSION));
+
+
+TEST(TlsContext, SessionCacheWithoutTickets)
+{
+    auto options = apsn::ssl::tls_options{};
+    options.ticket_rotation = std::chrono::seconds{0};
+
+    auto creds = self_signed();
+    auto server = apsn::ssl::make_context(creds.cert, creds.key,
+            std::nullopt, options);
+    ASSERT_TRUE(server);
+
+    auto client = ssl_ctx_ptr{SSL_CTX_new(TLS_client_method())};
+    auto session = handshake(server->native_handle(), client.get(),
+            nullptr, TLS1_2_VERSION);
+    ASSERT_TRUE(session);
+    ASSERT_TRUE(handshake(server->native_handle(), client.get(),
+            session.get(), TLS1_2_VERSION));
+
+    auto stats = apsn::ssl::stats(*server);
+    EXPECT_EQ(stats.resumed, 1);
+    EXPECT_EQ(stats.cached, 1);
+    EXPECT_EQ(stats.tickets_issued, 0u);
+}
+
+
+TEST(TlsContext, RejectsLegacyVersions)
+{
+    auto creds = self_signed();
+    auto server = apsn::ssl::make_context(creds.cert, creds.key, std::nullopt);
+    ASSERT_TRUE(server);
+
+    auto client = ssl_ctx_ptr{SSL_CTX_new(TLS_client_method())};
+    SSL_CTX_set_security_level(client.get(), 0);
+    EXPECT_FALSE(handshake(server->native_handle(), client.get(),
+            nullptr, TLS1_1_VERSION));
+}
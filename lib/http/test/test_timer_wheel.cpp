@@ -0,0 +1,142 @@
+#include <apsn/http/timer_wheel.hpp>
+
+#include <boost/asio.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using apsn::http::timer_wheel;
+using namespace std::chrono_literals;
+
+
+namespace {
+
+/* A wheel which is only ever advanced by hand */
+struct TimerWheel : ::testing::Test
+{
+    boost::asio::io_context ioc;
+    timer_wheel::clock::time_point start = timer_wheel::clock::now();
+    std::shared_ptr<timer_wheel> wheel = std::make_shared<timer_wheel>(
+            ioc.get_executor(),
+            apsn::http::connection_timeouts{},
+            1s,
+            start);
+    std::vector<int> fired;
+
+    auto make(int id) -> std::unique_ptr<timer_wheel::deadline>
+    {
+        return std::make_unique<timer_wheel::deadline>(wheel,
+                ioc.get_executor(),
+                [this, id] { fired.push_back(id); });
+    }
+
+    auto advance(timer_wheel::clock::duration by) -> void
+    {
+        wheel->advance(start + by);
+        ioc.restart();
+        ioc.poll();
+    }
+};
+
+}
+
+
+TEST_F(TimerWheel, ExpiresOnlyWhenDue)
+{
+    auto first = make(1);
+    first->expires_at(start + 3s);
+    EXPECT_EQ(wheel->size(), 1u);
+
+    advance(2s);
+    EXPECT_TRUE(fired.empty());
+
+    advance(3s);
+    EXPECT_EQ(fired, std::vector<int>{1});
+    EXPECT_EQ(wheel->size(), 0u);
+}
+
+
+TEST_F(TimerWheel, RoundsUpToTheNextTick)
+{
+    auto first = make(1);
+    first->expires_at(start + 1500ms);
+
+    advance(1s);
+    EXPECT_TRUE(fired.empty());
+
+    advance(2s);
+    EXPECT_EQ(fired, std::vector<int>{1});
+}
+
+
+TEST_F(TimerWheel, RearmingReplacesTheExpiry)
+{
+    auto first = make(1);
+    first->expires_at(start + 2s);
+    first->expires_at(start + 5s);
+    EXPECT_EQ(wheel->size(), 1u);
+
+    advance(4s);
+    EXPECT_TRUE(fired.empty());
+
+    advance(5s);
+    EXPECT_EQ(fired, std::vector<int>{1});
+}
+
+
+TEST_F(TimerWheel, CancelledAndDestroyedDoNotFire)
+{
+    auto first = make(1);
+    auto second = make(2);
+    first->expires_at(start + 2s);
+    second->expires_at(start + 2s);
+
+    first->cancel();
+    second.reset();
+    EXPECT_EQ(wheel->size(), 0u);
+
+    advance(10s);
+    EXPECT_TRUE(fired.empty());
+}
+
+
+TEST_F(TimerWheel, RearmedAfterExpiryIsNotRun)
+{
+    auto first = make(1);
+    first->expires_at(start + 1s);
+
+    /* Expired, but re-armed before the callback gets to run */
+    wheel->advance(start + 1s);
+    first->expires_at(start + 10s);
+    ioc.poll();
+    EXPECT_TRUE(fired.empty());
+
+    advance(10s);
+    EXPECT_EQ(fired, std::vector<int>{1});
+}
+
+
+TEST_F(TimerWheel, CascadesFromOuterLevels)
+{
+    /* One in each level, and one on either side of a turn of the first */
+    auto const ticks = std::vector<int>{5, 63, 64, 65, 300, 4096 + 7, 300000};
+    auto deadlines = std::vector<std::unique_ptr<timer_wheel::deadline>>{};
+    for (auto tick : ticks) {
+        deadlines.push_back(make(tick));
+        deadlines.back()->expires_at(start + std::chrono::seconds{tick});
+    }
+    EXPECT_EQ(wheel->size(), ticks.size());
+
+    for (auto tick : ticks) {
+        advance(std::chrono::seconds{tick - 1});
+        EXPECT_TRUE(fired.empty() || fired.back() != tick) << tick;
+        advance(std::chrono::seconds{tick});
+        ASSERT_FALSE(fired.empty());
+        EXPECT_EQ(fired.back(), tick);
+    }
+    EXPECT_EQ(fired, ticks);
+    EXPECT_EQ(wheel->size(), 0u);
+}
@@ -0,0 +1,71 @@
+#include <apsn/http/headers.hpp>
+#include <apsn/http/tokens.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+
+using apsn::http::session_tokens;
+
+
+TEST(SessionTokens, RoundTrip)
+{
+    auto tokens = session_tokens{};
+    auto token = tokens.issue("admin");
+    ASSERT_TRUE(static_cast<bool>(token));
+
+    auto claims = tokens.verify(*token);
+    ASSERT_TRUE(claims);
+    EXPECT_EQ(claims->user, "admin");
+    EXPECT_FALSE(tokens.needs_refresh(*claims));
+}
+
+
+TEST(SessionTokens, RejectsTampering)
+{
+    auto tokens = session_tokens{};
+    auto token = *tokens.issue("admin");
+
+    auto forged = token;
+    forged.replace(forged.find("admin"), 5, "root!");
+    EXPECT_FALSE(tokens.verify(forged));
+
+    forged = token;
+    forged.back() = forged.back() == '0' ? '1' : '0';
+    EXPECT_FALSE(tokens.verify(forged));
+
+    EXPECT_FALSE(tokens.verify(""));
+    EXPECT_FALSE(tokens.verify("1.admin"));
+
+    /* Tokens from another key, i.e., a restarted server */
+    EXPECT_FALSE(session_tokens{}.verify(token));
+}
+
+
+TEST(SessionTokens, RejectsExpired)
+{
+    auto tokens = session_tokens{std::chrono::seconds{-1}};
+    auto token = tokens.issue("admin");
+    ASSERT_TRUE(static_cast<bool>(token));
+    EXPECT_FALSE(tokens.verify(*token));
+}
+
+
+TEST(SessionTokens, RejectsUnsafeUsers)
+{
+    auto tokens = session_tokens{};
+    EXPECT_FALSE(static_cast<bool>(tokens.issue("a;b")));
+    EXPECT_FALSE(static_cast<bool>(tokens.issue("a.b")));
+    EXPECT_FALSE(static_cast<bool>(tokens.issue("")));
+}
+
+
+TEST(Cookies, FindsNamedCookie)
+{
+    using apsn::http::headers::find_cookie;
+    auto header = "theme=dark; webserial_session=\"abc.def\" ;other=1";
+    EXPECT_EQ(find_cookie(header, "webserial_session"), "abc.def");
+    EXPECT_EQ(find_cookie(header, "other"), "1");
+    EXPECT_FALSE(find_cookie(header, "missing"));
+}
@@ -15,6 +15,7 @@
 namespace apsn::ws {
 // template <typename Traits>
 class websocket_base;
+struct send_timing;
 }
 
 
@@ -68,9 +69,12 @@ public:
     virtual auto cancel() -> void {}
     virtual auto name() const -> std::string = 0;
 
+    /* Called on the websocket's executor as each message is written */
+    virtual auto on_sent(apsn::ws::send_timing const &) -> void {}
+
     virtual ~base_state()
     {
-        apsn::log::trace("base_state::~base_state");
+        APSN_LOG_TRACE("base_state::~base_state");
     }
 
 protected:
@@ -6,13 +6,21 @@
 #include "context.hpp"
 #include "port.hpp"
 
+#include <apsn/http/coroutine.hpp>
 #include <apsn/http/websocket.hpp>
 
 #include <apsn/ansi.hpp>
+#include <apsn/metrics.hpp>
 
 #include <boost/asio/serial_port.hpp>
 
+#include <boost/asio/steady_timer.hpp>
+
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
 
 namespace smux::cli {
 
@@ -36,6 +44,7 @@ public:
 
     auto run() -> void override;
     auto cancel() -> void override;
+    auto on_sent(apsn::ws::send_timing const & timing) -> void override;
 
 private:
     template <typename ... Args>
@@ -49,8 +58,13 @@ private:
     auto write_serial(std::shared_ptr<std::string const> const& ss) -> void;
     auto fail(sys::error_code ec, std::string extra) -> void;
 
-    auto on_read(beast::error_code ec, std::size_t bytes_transferred) -> void;
-    auto on_write(beast::error_code ec, std::size_t bytes_transferred) -> void;
+    /* Each loop keeps the state alive through the pointer it is given */
+
+    /* Forwards serial output to the session until the port is closed */
+    auto do_read(std::shared_ptr<serial_state>) -> asio::awaitable<void>;
+
+    /* Writes the queue out to the port, waiting for more when it is empty */
+    auto do_write(std::shared_ptr<serial_state>) -> asio::awaitable<void>;
     auto on_send(std::shared_ptr<std::string const> const& ss) -> void;
     auto on_csi(std::string message, apsn::ansi::csi_final final)
         -> std::shared_ptr<base_state> override;
@@ -63,10 +77,35 @@ private:
 
     auto on_char(char c) -> std::shared_ptr<base_state> override;
 
+    auto do_probe(std::shared_ptr<serial_state>) -> asio::awaitable<void>;
+    auto send_probe() -> void;
+
+    /* Only registered when latency tracing is enabled */
+    struct latency_metrics
+    {
+        apsn::metrics::histogram & handoff;
+        apsn::metrics::histogram & write;
+        apsn::metrics::histogram & total;
+        apsn::metrics::histogram & round_trip;
+    };
+
     port & m_info;
+    std::shared_ptr<screen> m_screen;
+    trigger_matcher m_triggers;
     boost_serial_port m_port;
     std::array<char, 256> m_buffer;
     std::vector<std::shared_ptr<std::string const>> m_send_queue;
+    apsn::http::wakeup m_writable;
+    bool m_closed = false;
+
+    apsn::metrics::counter & m_rx_bytes;
+    apsn::metrics::counter & m_tx_bytes;
+    apsn::metrics::histogram & m_read_sizes;
+
+    std::optional<latency_metrics> m_latency;
+    asio::steady_timer m_probe_timer;
+    std::atomic<std::uint64_t> m_probe_id{0};
+    std::atomic<std::chrono::steady_clock::rep> m_probe_sent{0};
 };
 
 }
\ No newline at end of file
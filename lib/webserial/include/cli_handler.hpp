@@ -4,18 +4,20 @@
 #include "cli/control_state.hpp"
 
 #include <apsn/http/headers.hpp>
+#include <apsn/http/peer.hpp>
 #include <apsn/http/request.hpp>
+#include <apsn/http/tokens.hpp>
 #include <apsn/http/websocket.hpp>
 
 namespace smux {
 
 
-template <typename Traits, bool IsSSL>
+template <typename Traits, apsn::ws::transport Transport>
 class cli_handler
-    : public std::enable_shared_from_this<cli_handler<Traits, IsSSL>>
-    , public apsn::ws::websocket_handler<cli_handler, Traits, IsSSL>
+    : public std::enable_shared_from_this<cli_handler<Traits, Transport>>
+    , public apsn::ws::websocket_handler<cli_handler, Traits, Transport>
 {
-    using base_type = apsn::ws::websocket_handler<cli_handler, Traits, IsSSL>;
+    using base_type = apsn::ws::websocket_handler<cli_handler, Traits, Transport>;
 
 public:
     template <typename Body, typename Alloc>
@@ -29,8 +31,9 @@ public:
 
     cli_handler(stream_type && stream,
             std::shared_ptr<unique_type> unique,
-            std::shared_ptr<shared_type> shared)
-        : base_type{std::move(stream), unique, shared}
+            std::shared_ptr<shared_type> shared,
+            std::shared_ptr<apsn::http::timer_wheel> timers)
+        : base_type{std::move(stream), unique, shared, timers}
     {
         this->stream().binary(true);
     }
@@ -38,14 +41,14 @@ public:
 
     ~cli_handler()
     {
-        apsn::log::trace("cli_handler::~cli_handler");
+        APSN_LOG_TRACE("cli_handler::~cli_handler");
         m_state->cancel();
         this->shared()->sessions.unregister_session(this);
     }
 
     auto cancel() -> void override
     {
-        apsn::log::trace("cli_handler::cancel");
+        APSN_LOG_TRACE("cli_handler::cancel");
         base_type::cancel();
     }
     
@@ -58,35 +61,52 @@ public:
         using apsn::http::request;
         using beast_field = beast::http::field;
 
-        auto source = beast::get_lowest_layer(this->stream())
-                    .socket()
-                    .remote_endpoint()
-                    .address()
-                    .to_string();
+        auto & socket = beast::get_lowest_layer(this->stream()).socket();
+        auto ec = sys::error_code{};
+        auto source = apsn::http::remote_address(socket, ec);
                 
         auto user = "<unknown>"s;
-
-        if (req.find(beast_field::authorization) != std::end(req)) {
-            auto auth = authorisation::parse(req[beast_field::authorization]);
-            if (auth->has_field(authorisation::field::username)) {
-                user = auth->get(authorisation::field::username);
+        if constexpr (Transport == apsn::ws::transport::local) {
+            /* The local listener has already checked the peer's credentials,
+               and they name the user */
+            if (auto peer = apsn::http::peer_credentials::of(
+                        socket.native_handle()))
+            {
+                user = peer->user();
             }
         }
         else {
-            auto areq = request<Traits>(source, std::move(req), this->shared());
-            return apsn::http::unauthorised(areq);
+            auto claims = std::optional<apsn::http::session_tokens::claims>{};
+
+            auto const & tokens = this->shared()->tokens;
+            if (tokens && req.find(beast_field::cookie) != std::end(req)) {
+                auto token = apsn::http::headers::find_cookie(
+                        req[beast_field::cookie],
+                        apsn::http::session_tokens::cookie_name);
+                if (token) {
+                    claims = tokens->verify(*token);
+                }
+            }
+
+            if (claims) {
+                user = claims->user;
+            }
+            else if (req.find(beast_field::authorization) != std::end(req)) {
+                auto auth = authorisation::parse(req[beast_field::authorization]);
+                if (auth && auth->has_field(authorisation::field::username)) {
+                    user = auth->get(authorisation::field::username);
+                }
+            }
+            else {
+                auto areq = request<Traits>(source, std::move(req), this->shared());
+                return apsn::http::unauthorised(areq);
+            }
         }
 
-        this->shared()->sessions.register_session(this, 
-                user,
-                beast::get_lowest_layer(this->stream())
-                    .socket()
-                    .remote_endpoint()
-                    .address()
-                    .to_string()
-                );
+        this->shared()->sessions.register_session(this, user, source);
         
         m_state = std::make_shared<cli::control_state>(this, this->shared());
+        m_forwarding = false;
         return {};
     }
 
@@ -109,13 +129,23 @@ public:
                 m_state->cancel();
                 m_state = std::move(next_state);
                 m_state->run();
+                m_forwarding = m_state->name() == "serial";
                 this->shared()->sessions.set_state(this, m_state->name());
                 break;
             }
         }
     }
 
+    auto handle_sent(apsn::ws::send_timing const & timing) -> void
+    {
+        if (m_forwarding) {
+            this->shared()->serial_forward.record(timing.written - timing.sent);
+            m_state->on_sent(timing);
+        }
+    }
+
     std::shared_ptr<cli::base_state> m_state;
+    bool m_forwarding = false;
 };
 
 
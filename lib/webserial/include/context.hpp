@@ -2,11 +2,15 @@
 
 #include "error.hpp"
 #include "port.hpp"
+#include "script.hpp"
+#include "triggers.hpp"
 
+#include <apsn/latency.hpp>
 #include <apsn/logging.hpp>
 
 #include <apsn/http/request.hpp>
 #include <apsn/http/router.hpp>
+#include <apsn/http/tokens.hpp>
 #include <apsn/http/websocket.hpp>
 
 #include <boost/asio.hpp>
@@ -14,6 +18,8 @@
 #include <map>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <vector>
 
 
 
@@ -49,6 +55,9 @@ struct session_holder
 
     auto cancel(std::size_t id) -> std::error_code;
 
+    /* Disconnects everyone, for example once handed over on upgrade */
+    auto cancel_all() -> void;
+
     auto lock() const -> std::unique_lock<std::mutex>;
 
     std::map<apsn::ws::websocket_base*, session_info> sessions;
@@ -78,10 +87,21 @@ struct ports_holder
     auto get_port(std::size_t port_id) -> apsn::result_ref<port>;
     auto add_port(std::string device, port_options opts)
         -> apsn::result<std::size_t>;
+    /* A port's ID, from the ID itself or the port's device */
+    auto find_port(std::string_view id_or_device) const
+        -> apsn::result<std::size_t>;
+
+    /* Names a set of ports to broadcast to; an empty set removes the name.
+       Call these with the port table locked. */
+    auto set_group(std::string name, std::vector<std::size_t> port_ids)
+        -> std::error_code;
+    auto get_group(std::string const & name) const
+        -> apsn::result<std::vector<std::size_t>>;
 
     auto lock() const -> std::unique_lock<std::mutex>;
 
     std::map<std::size_t, port> ports;
+    std::map<std::string, std::vector<std::size_t>> groups;
     mutable std::mutex m_mtx;
 };
 
@@ -90,7 +110,21 @@ struct context
 {
     session_holder sessions;
     ports_holder ports;
+    triggers_holder triggers;
+    scripts_holder scripts;
+
+    /* Serial ports only. HTTP, TLS and websockets run elsewhere, so that
+       handshakes and logins cannot delay console traffic. */
     asio::io_context ioc;
+
+    /* Time from serial output being queued on a websocket to being written */
+    apsn::latency_histogram serial_forward;
+
+    /* Record per-port forwarding latency, and probe round trip times */
+    bool trace_latency = false;
+
+    /* Optional; when set, session cookies are accepted on upgrade */
+    std::shared_ptr<apsn::http::session_tokens> tokens;
 };
 
 
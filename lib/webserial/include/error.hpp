@@ -13,7 +13,11 @@ enum class error
     device_in_use,
     session_not_found,
     boost_error,
-    invalid_baud
+    invalid_baud,
+    bad_handoff,
+    bad_trigger,
+    bad_script,
+    group_not_found
 };
 
 
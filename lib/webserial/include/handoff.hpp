@@ -0,0 +1,137 @@
+#pragma once
+
+#include "context.hpp"
+
+#include <apsn/result.hpp>
+
+#include <boost/asio.hpp>
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+
+/**
+ * @brief Passing a running server's sockets and ports to its replacement
+ *
+ * An upgraded server started with the same `--upgrade-socket` connects to
+ * the one it replaces, which sends it its listening sockets and every open
+ * serial port with `SCM_RIGHTS`, together with a snapshot of each port's
+ * screen. The
+ * old server then closes its own copies, stops accepting and drains, while
+ * the new one carries on accepting from the same sockets. Neither the
+ * listening sockets nor the ttys are ever closed, so clients queued to
+ * connect are not refused and devices do not see DTR drop.
+ *
+ * The exchange is one message: a fixed header carrying the descriptors,
+ * then each port's device and screen. Both ends are the same build of
+ * the same program on the same host, so integers are sent as they are.
+ */
+namespace smux::handoff {
+
+/* The most descriptors one message can carry; `SCM_MAX_FD` on Linux */
+constexpr auto max_fds = std::size_t{253};
+
+
+struct port_state
+{
+    std::string device;
+    int fd = -1;
+
+    /* `screen::snapshot` of everything kept, fed to the port's new screen */
+    std::string screen;
+};
+
+
+struct state
+{
+    std::vector<int> listeners;
+    std::vector<port_state> ports;
+};
+
+
+/* Blocks until `socket` has taken the whole of `st` */
+auto send(int socket, state const & st) -> std::error_code;
+
+/* Blocks until a whole state has been read from `socket`. Descriptors
+   received are close-on-exec, and owned by the caller. */
+auto receive(int socket) -> apsn::result<state>;
+
+
+/**
+ * @brief Every port open in `ctx`, with a descriptor of its own
+ *
+ * Call on the serial IO context. The descriptors are duplicates, to be
+ * closed once sent.
+ */
+auto collect_ports(context & ctx) -> std::vector<port_state>;
+
+/**
+ * @brief Closes this process's copies of every port in `ctx`
+ *
+ * Sessions reading them see the read aborted, so that once this returns
+ * nothing here reads output meant for the new process. Call on the serial
+ * IO context, in the same handler as `collect_ports`.
+ */
+auto detach_ports(context & ctx) -> void;
+
+/**
+ * @brief Keeps ports handed over for the sessions which next open them
+ *
+ * Ports are matched by device. Those which were not found by this
+ * process's scan are closed.
+ */
+auto restore_ports(context & ctx, std::vector<port_state> ports) -> void;
+
+
+/**
+ * @brief Takes over from the server listening on `path`
+ *
+ * Returns once the old server has closed its copies of the ports, so that
+ * they may be read straight away. Fails, leaving nothing to clean up, if
+ * there is no server there.
+ */
+auto take_over(std::filesystem::path const & path) -> apsn::result<state>;
+
+
+/**
+ * @brief Waits on `path` for a server to take over from this one
+ *
+ * Only the same user, or root, may. Runs on the serial IO context, which
+ * `collect` and `on_handed_off` are called from; `collect` gives the
+ * listening sockets to send, and `on_handed_off` should stop accepting and
+ * drain. A successor which fails part way is forgotten, and this server
+ * carries on as it was.
+ */
+class server : public std::enable_shared_from_this<server>
+{
+public:
+    using protocol = boost::asio::local::stream_protocol;
+
+    server(std::shared_ptr<context> ctx,
+            std::filesystem::path path,
+            std::function<std::vector<int>()> listeners,
+            std::function<void()> on_handed_off);
+
+    ~server();
+
+    auto run() -> void;
+
+    auto is_open() const -> bool
+    { return m_acceptor.is_open(); }
+
+private:
+    auto accept() -> void;
+    auto hand_off(protocol::socket & socket) -> bool;
+
+    std::shared_ptr<context> m_ctx;
+    std::filesystem::path m_path;
+    protocol::acceptor m_acceptor;
+    std::function<std::vector<int>()> m_listeners;
+    std::function<void()> m_on_handed_off;
+};
+
+}
@@ -1,9 +1,14 @@
 #pragma once
 
+#include "screen.hpp"
+
 #include <apsn/result.hpp>
 
 #include <boost/asio/serial_port.hpp>
 
+#include <memory>
+#include <optional>
+
 
 namespace smux {
 
@@ -74,6 +79,18 @@ struct port
     std::string device;
     port_options options;
     bool in_use;
+
+    /* What a terminal on the port would show, redrawn for whoever
+       attaches next */
+    std::shared_ptr<smux::screen> screen;
+
+    /* The attached session's port, so that it can be handed over on
+       upgrade. Only used on the serial IO context. */
+    boost_serial * open = nullptr;
+
+    /* Handed over by the process this one replaced, for the next session
+       to attach instead of opening the device again */
+    std::optional<boost_serial> inherited;
 };
 
 
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "context.hpp"
+#include "screen.hpp"
+#include "telnet.hpp"
+#include "triggers.hpp"
+
+#include <apsn/metrics.hpp>
+#include <apsn/result.hpp>
+
+#include <apsn/http/websocket.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/asio/serial_port.hpp>
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+
+namespace smux {
+
+enum class port_protocol
+{
+    raw,
+    rfc2217
+};
+
+auto to_string(port_protocol value) -> std::string;
+
+
+/**
+ * @brief A serial port served straight over TCP, without the web UI
+ *
+ * Bytes are copied between the socket and the tty on the serial IO context,
+ * with no HTTP, websocket framing or control CLI in between. With
+ * `port_protocol::rfc2217` the stream is Telnet, and the client can set the
+ * line up with RFC 2217 COM-PORT-OPTION commands.
+ *
+ * A connection claims the port as a websocket session's `connect` does, so a
+ * port is used by one client of either kind at a time. Connections are
+ * listed among the sessions, and `session kill` ends them.
+ */
+class port_connection
+    : public apsn::ws::websocket_base
+    , public std::enable_shared_from_this<port_connection>
+{
+public:
+    using tcp = asio::ip::tcp;
+    using boost_serial_port = asio::serial_port;
+
+    port_connection(tcp::socket && socket,
+            std::shared_ptr<context> ctx,
+            port_protocol protocol);
+
+    ~port_connection();
+
+    /* Without a port ID, the client's first line names the port */
+    auto start(std::optional<std::size_t> port_id) -> void;
+
+    auto ostream() -> std::ostream & override
+    { return m_ostream; }
+
+    auto cancel() -> void override;
+
+private:
+    class streambuf : public std::streambuf
+    {
+    public:
+        explicit streambuf(port_connection * conn)
+            : m_conn{conn}
+        {}
+
+        auto xsputn(char const * s, std::streamsize n)
+            -> std::streamsize override;
+
+        auto overflow(int c) -> int override;
+
+    private:
+        port_connection * m_conn;
+    };
+
+    auto read_selection() -> void;
+    auto attach(std::size_t port_id, std::string_view pending) -> void;
+    auto refuse(std::string message) -> void;
+    auto close() -> void;
+
+    auto read_serial() -> void;
+    auto read_socket() -> void;
+    auto on_socket_data(std::string_view data) -> void;
+
+    auto write_serial(std::string data) -> void;
+    auto write_socket(std::string data) -> void;
+    auto flush_serial() -> void;
+    auto flush_socket() -> void;
+
+    /* RFC 2217 */
+    auto offer_options() -> void;
+    auto on_negotiate(std::uint8_t verb, std::uint8_t option) -> void;
+    auto on_com_port(std::string_view payload) -> void;
+    auto on_control(std::uint8_t value) -> std::uint8_t;
+    auto reply(telnet::com_port command, std::string_view value) -> void;
+    auto modem_state() -> std::uint8_t;
+
+    /* Reads wait while this much is queued for the other side */
+    static constexpr auto max_queued = std::size_t{64 * 1024};
+
+    std::shared_ptr<context> m_ctx;
+    tcp::socket m_socket;
+    boost_serial_port m_serial;
+    port_protocol m_protocol;
+    std::string m_address;
+
+    std::optional<std::size_t> m_port_id;
+    std::string m_device;
+    std::shared_ptr<screen> m_screen;
+    trigger_matcher m_triggers;
+    std::string m_selection;
+
+    std::array<char, 4096> m_serial_buffer;
+    std::array<char, 4096> m_socket_buffer;
+    std::deque<std::string> m_to_serial;
+    std::deque<std::string> m_to_socket;
+    std::size_t m_serial_queued = 0;
+    std::size_t m_socket_queued = 0;
+    bool m_serial_reading = false;
+    bool m_socket_reading = false;
+    bool m_closing = false;
+    bool m_closed = false;
+
+    telnet::decoder m_telnet;
+    std::bitset<256> m_local;
+    std::bitset<256> m_remote;
+    bool m_suspended = false;
+    bool m_break = false;
+
+    apsn::metrics::counter * m_rx_bytes = nullptr;
+    apsn::metrics::counter * m_tx_bytes = nullptr;
+    apsn::metrics::gauge & m_connections;
+
+    streambuf m_streambuf;
+    std::ostream m_ostream;
+};
+
+
+/**
+ * @brief Accepts TCP clients for serial ports
+ *
+ * Serves one port if given its ID, and otherwise lets each client choose,
+ * by sending the port's ID and a newline before anything else. A client
+ * which names a missing or busy port is sent a line starting `error:` and
+ * disconnected.
+ *
+ * There is no authentication; bind to loopback, or an otherwise trusted
+ * network.
+ *
+ * \code {.cpp}
+        std::make_shared<smux::port_listener>(shared,
+            tcp::endpoint{ip::make_address("127.0.0.1"), 7000 + port_id},
+            smux::port_protocol::rfc2217, port_id)->run();
+ * \endcode
+ */
+class port_listener : public std::enable_shared_from_this<port_listener>
+{
+public:
+    using tcp = asio::ip::tcp;
+
+    port_listener(std::shared_ptr<context> ctx,
+            tcp::endpoint endpoint,
+            port_protocol protocol,
+            std::optional<std::size_t> port_id = std::nullopt);
+
+    auto run() -> void;
+
+    auto is_open() const -> bool
+    { return m_acceptor.is_open(); }
+
+    auto local_endpoint() const -> tcp::endpoint
+    { return m_acceptor.local_endpoint(); }
+
+    auto native_handle() -> int
+    { return m_acceptor.native_handle(); }
+
+    /* Stops accepting, for example once a new process has taken over */
+    auto close() -> void;
+
+private:
+    auto accept() -> void;
+
+    std::shared_ptr<context> m_ctx;
+    tcp::acceptor m_acceptor;
+    port_protocol m_protocol;
+    std::optional<std::size_t> m_port_id;
+};
+
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace smux {
+
+/**
+ * @brief What a terminal attached to a serial port would be showing
+ *
+ * Output from the port is fed through a VT100/xterm state machine, as it
+ * arrives, into a grid of cells. Lines scrolled off the top are kept,
+ * already rendered, up to a limit. `snapshot` turns the grid back into a
+ * short stream which, written to a fresh terminal, redraws it; so a viewer
+ * attaching after hours of output gets a few KB rather than a replay.
+ *
+ * Cursor movement, erasing, insertion and deletion, scrolling regions,
+ * SGR attributes (including 256 colour and RGB) and the alternate screen
+ * are modelled. Strings (OSC, DCS, APC, PM and SOS) are skipped, as are
+ * modes which only change how the terminal reports input. Every character
+ * is taken to be one column wide.
+ *
+ * Fed on the serial IO context and snapshotted from anywhere, so it is
+ * locked; the lock is taken once per read from the port, not per byte.
+ */
+class screen
+{
+public:
+    constexpr static std::size_t default_rows = 24;
+    constexpr static std::size_t default_cols = 80;
+    constexpr static std::size_t default_history = 1000;
+
+    /* For `snapshot`, every line kept */
+    constexpr static std::size_t all = std::numeric_limits<std::size_t>::max();
+
+    struct position
+    {
+        std::size_t row;
+        std::size_t col;
+    };
+
+    explicit screen(std::size_t rows = default_rows,
+            std::size_t cols = default_cols,
+            std::size_t history = default_history);
+
+    auto feed(std::string_view data) -> void;
+
+    /**
+     * @brief Redraws the screen, after up to `history` lines above it
+     *
+     * Written at the start of a line of a terminal at least as large, leaves
+     * its bottom rows looking as this does, with the cursor and attributes as
+     * they are here. Cursor movement is relative, so a viewer need not be
+     * cleared first. Feeding it to a fresh `screen` reproduces this one.
+     */
+    auto snapshot(std::size_t history = 0) const -> std::string;
+
+    /* The text of a row, without attributes or trailing blanks */
+    auto line(std::size_t row) const -> std::string;
+
+    /* Nothing in the history and every cell blank */
+    auto empty() const -> bool;
+
+    auto cursor() const -> position;
+    auto history_size() const -> std::size_t;
+
+    auto rows() const -> std::size_t
+    { return m_rows; }
+
+    auto cols() const -> std::size_t
+    { return m_cols; }
+
+private:
+    /* Colours are 0 for the default, `palette | index`, or `rgb | 0xRRGGBB` */
+    constexpr static std::uint32_t palette = 1u << 24;
+    constexpr static std::uint32_t rgb = 2u << 24;
+
+    enum flag : std::uint8_t
+    {
+        bold      = 1 << 0,
+        dim       = 1 << 1,
+        italic    = 1 << 2,
+        underline = 1 << 3,
+        blink     = 1 << 4,
+        inverse   = 1 << 5,
+        hidden    = 1 << 6,
+        strike    = 1 << 7
+    };
+
+    struct attributes
+    {
+        std::uint32_t fg = 0;
+        std::uint32_t bg = 0;
+        std::uint8_t flags = 0;
+
+        auto operator==(attributes const &) const -> bool = default;
+    };
+
+    struct cell
+    {
+        char32_t ch = U' ';
+        attributes attrs;
+
+        auto operator==(cell const &) const -> bool = default;
+    };
+
+    using row_type = std::vector<cell>;
+    using grid_type = std::vector<row_type>;
+
+    struct saved_cursor
+    {
+        position pos;
+        attributes attrs;
+    };
+
+    enum class parse_state
+    {
+        ground,
+        escape,
+        escape_intermediate,
+        csi,
+        osc,
+        string,
+        string_escape
+    };
+
+    constexpr static std::size_t max_params = 16;
+
+    /* Parser */
+    auto put(unsigned char c) -> void;
+    auto control(unsigned char c) -> void;
+    auto escape(unsigned char c) -> void;
+    auto csi(unsigned char c) -> void;
+    auto dispatch_csi(char final) -> void;
+    auto sgr() -> void;
+    auto set_mode(bool on) -> void;
+    auto param(std::size_t index, unsigned fallback) const -> unsigned;
+
+    /* Screen operations */
+    auto print(char32_t ch) -> void;
+    auto linefeed() -> void;
+    auto reverse_index() -> void;
+    auto scroll_up(std::size_t top,
+            std::size_t bottom,
+            std::size_t count,
+            bool keep) -> void;
+    auto scroll_down(std::size_t top, std::size_t bottom, std::size_t count) -> void;
+    auto move_to(std::size_t row, std::size_t col) -> void;
+    auto erase(std::size_t row, std::size_t first, std::size_t last) -> void;
+    auto blank() const -> cell;
+    auto save_cursor() -> void;
+    auto restore_cursor() -> void;
+    auto use_alternate(bool on) -> void;
+    auto reset() -> void;
+
+    auto grid() -> grid_type &
+    { return m_alternate ? *m_alternate : m_main; }
+
+    auto grid() const -> grid_type const &
+    { return m_alternate ? *m_alternate : m_main; }
+
+    /* Appends `row` with its attributes, ending with them reset */
+    static auto render(row_type const & row, std::string & out) -> void;
+    static auto render_sgr(attributes const & attrs, std::string & out) -> void;
+
+    std::size_t m_rows;
+    std::size_t m_cols;
+    std::size_t m_history_limit;
+
+    grid_type m_main;
+    std::optional<grid_type> m_alternate;
+    std::deque<std::string> m_history;
+
+    position m_cursor{0, 0};
+    attributes m_attrs;
+    bool m_wrap_pending = false;
+    bool m_autowrap = true;
+    bool m_cursor_visible = true;
+    std::size_t m_top = 0;
+    std::size_t m_bottom;
+    saved_cursor m_saved{};
+    saved_cursor m_saved_main{};
+
+    parse_state m_state = parse_state::ground;
+    std::vector<unsigned> m_params;
+    char m_private = 0;
+    bool m_intermediate = false;
+    char32_t m_codepoint = 0;
+    int m_continuation = 0;
+
+    mutable std::mutex m_mtx;
+};
+
+}
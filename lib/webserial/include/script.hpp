@@ -0,0 +1,203 @@
+#pragma once
+
+#include "triggers.hpp"
+
+#include <apsn/result.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace smux {
+
+struct context;
+
+
+/**
+ * @brief One step of a script: bytes to send, or output to wait for
+ */
+struct script_step
+{
+    enum class kind
+    {
+        send,
+        expect,
+
+        /* Reads until the timeout, which is not a failure */
+        wait
+    };
+
+    kind type;
+
+    /* What to send, or the pattern expected. Shared, so that a script run
+       on many ports holds one copy. */
+    std::shared_ptr<std::string const> text;
+
+    /* The pattern, compiled; only for `expect` */
+    std::shared_ptr<trigger_set const> pattern;
+
+    /* For every kind */
+    std::chrono::milliseconds timeout;
+};
+
+
+/**
+ * @brief Steps run in order against one port, as `expect` would
+ *
+ * Parsed from JSON, where a step is `{"send": text}` or
+ * `{"expect": pattern}`, either with an optional `timeout` in milliseconds,
+ * or `{"wait": milliseconds}` to take in output for that long.
+ * A pattern is an ECMAScript regular expression, or plain text, matched as
+ * with triggers but as soon as it has arrived rather than when its line
+ * ends. `timeout` at the top level is the default for every step.
+ *
+ * \code {.json}
+    {"timeout": 5000, "steps": [
+        {"send": "\r"},
+        {"expect": "login: $"},
+        {"send": "root\r"},
+        {"expect": "# $", "timeout": 30000}
+    ]}
+ * \endcode
+ */
+struct script
+{
+    constexpr static std::size_t max_steps = 1000;
+    constexpr static auto default_timeout = std::chrono::milliseconds{10'000};
+    constexpr static auto max_timeout = std::chrono::milliseconds{600'000};
+    constexpr static auto default_window = std::chrono::milliseconds{2'000};
+
+    static auto parse(std::string_view json) -> apsn::result<script>;
+
+    /**
+     * @brief The script a broadcast runs on each port
+     *
+     * From `{"send": text, "window": milliseconds, "until": pattern}`: sends
+     * the text, then takes in output for the window, or only until `until`
+     * matches if it is given. The window defaults to 2 seconds.
+     */
+    static auto parse_broadcast(std::string_view json) -> apsn::result<script>;
+
+    std::vector<script_step> steps;
+};
+
+
+enum class script_state
+{
+    running,
+    passed,
+    timed_out,
+    error
+};
+
+auto to_string(script_state value) -> std::string;
+
+
+/**
+ * @brief A script's progress, and what the port sent while it ran
+ */
+struct script_job
+{
+    /* Only the end of longer output is kept */
+    constexpr static std::size_t max_transcript = 1024 * 1024;
+
+    std::size_t id;
+    std::size_t port_id;
+    std::string device;
+    std::size_t steps;
+    std::chrono::system_clock::time_point started;
+
+    script_state state = script_state::running;
+
+    /* The step running, or the one which stopped the script */
+    std::size_t step = 0;
+
+    /* Time each step finished, from the start */
+    std::vector<std::chrono::milliseconds> finished;
+    std::string error;
+
+    std::string transcript;
+    bool truncated = false;
+
+    auto append(std::string_view output) -> void;
+};
+
+
+/**
+ * @brief One script started on every port of a group
+ */
+struct broadcast_job
+{
+    struct member
+    {
+        std::size_t port_id;
+
+        /* Unset, with the reason in `error`, if the port was not free */
+        std::optional<std::size_t> job;
+        std::string error;
+    };
+
+    std::size_t id;
+    std::string group;
+    std::vector<member> members;
+};
+
+
+/**
+ * @brief Scripts running, and those finished, until there are too many
+ */
+struct scripts_holder
+{
+    constexpr static std::size_t max_finished = 100;
+    constexpr static std::size_t max_broadcasts = 100;
+
+    auto add(std::size_t port_id, std::string device, std::size_t steps)
+        -> std::size_t;
+
+    /* A copy, taken under the lock */
+    auto get(std::size_t id) const -> std::optional<script_job>;
+
+    auto add_broadcast(std::string group, std::vector<broadcast_job::member> members)
+        -> std::size_t;
+    auto get_broadcast(std::size_t id) const -> std::optional<broadcast_job>;
+
+    auto lock() const -> std::unique_lock<std::mutex>;
+
+    std::map<std::size_t, script_job> jobs;
+    std::map<std::size_t, broadcast_job> broadcasts;
+    std::size_t next_id = 1;
+    std::size_t next_broadcast = 1;
+    mutable std::mutex m_mtx;
+};
+
+
+/**
+ * @brief Claims a port and runs `script_` on it, on the serial IO context
+ *
+ * Fails straight away if the port is missing or in use. Otherwise claims
+ * it and returns the job's ID; the tty is opened on the serial IO context,
+ * and if it will not open the job ends in `error`. The port is released
+ * when the script ends. Output read while waiting goes to the port's screen and its
+ * triggers, as for a session.
+ */
+auto run_script(std::shared_ptr<context> ctx, std::size_t port_id, script script_)
+    -> apsn::result<std::size_t>;
+
+/**
+ * @brief Runs `script_` on every port of `group` at once
+ *
+ * Every port gets its own copy of the steps, but not of what they send.
+ * Ports which are busy are recorded as such, and do not stop the rest. Fails only if there is no such group.
+ */
+auto run_broadcast(std::shared_ptr<context> ctx,
+        std::string const & group,
+        script const & script_) -> apsn::result<std::size_t>;
+
+}
@@ -69,4 +69,26 @@ auto create(ExecutionContext const & ex, std::string device, port_options option
     return port;
 }
 
+
+/**
+ * @brief Opens `info`'s device for a session
+ *
+ * Takes the port handed over on upgrade if there is one, as it was left,
+ * and otherwise opens the device with `info`'s options. Call with the port
+ * table locked.
+ */
+template <typename ExecutionContext>
+auto open(ExecutionContext const & ex, port & info)
+    -> boost_result<boost_serial>
+{
+    if (info.inherited) {
+        apsn::log::info("Attaching serial port '{}' kept over upgrade",
+                info.device);
+        auto port = std::move(*info.inherited);
+        info.inherited.reset();
+        return port;
+    }
+    return create(ex, info.device, info.options);
+}
+
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace smux {
@@ -8,4 +9,8 @@ namespace smux {
 auto split(std::string const & to_split, char delim = ' ')
     -> std::vector<std::string>;
 
+/* Without escape sequences or other controls, and as valid UTF-8, so that
+   the text can be logged and sent as JSON */
+auto printable(std::string_view text) -> std::string;
+
 }
\ No newline at end of file
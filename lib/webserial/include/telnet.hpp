@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+
+/**
+ * Telnet (RFC 854) framing, as far as RFC 2217 needs it
+ */
+namespace smux::telnet {
+
+namespace cmd {
+
+constexpr auto se   = std::uint8_t{240};
+constexpr auto nop  = std::uint8_t{241};
+constexpr auto sb   = std::uint8_t{250};
+constexpr auto will = std::uint8_t{251};
+constexpr auto wont = std::uint8_t{252};
+constexpr auto do_  = std::uint8_t{253};
+constexpr auto dont = std::uint8_t{254};
+constexpr auto iac  = std::uint8_t{255};
+
+}
+
+
+namespace option {
+
+constexpr auto binary   = std::uint8_t{0};
+constexpr auto echo     = std::uint8_t{1};
+constexpr auto sga      = std::uint8_t{3};
+constexpr auto com_port = std::uint8_t{44};
+
+}
+
+
+/* RFC 2217 COM-PORT-OPTION commands, as sent by the client. The server
+   answers with the same command plus `server_offset`. */
+enum class com_port : std::uint8_t
+{
+    signature           = 0,
+    set_baudrate        = 1,
+    set_datasize        = 2,
+    set_parity          = 3,
+    set_stopsize        = 4,
+    set_control         = 5,
+    notify_linestate    = 6,
+    notify_modemstate   = 7,
+    flowcontrol_suspend = 8,
+    flowcontrol_resume  = 9,
+    set_linestate_mask  = 10,
+    set_modemstate_mask = 11,
+    purge_data          = 12
+};
+
+constexpr auto server_offset = std::uint8_t{100};
+
+
+/**
+ * @brief Splits a telnet stream into data, negotiation and subnegotiation
+ *
+ * Input may be fed in pieces of any size; commands split across reads are
+ * held until they are complete. Data is passed on in runs, with doubled
+ * IACs undone. Outside binary mode a NUL after a CR is dropped, as RFC 854
+ * asks.
+ */
+class decoder
+{
+public:
+    struct handlers
+    {
+        std::function<void(std::string_view)> on_data;
+        std::function<void(std::uint8_t verb, std::uint8_t option)> on_negotiate;
+        std::function<void(std::uint8_t option, std::string_view payload)>
+            on_subnegotiate;
+    };
+
+    explicit decoder(handlers h);
+
+    auto feed(std::string_view bytes) -> void;
+
+    /* Set once the peer has agreed to send binary */
+    auto binary(bool value) -> void
+    { m_binary = value; }
+
+private:
+    enum class state
+    {
+        data,
+        iac,
+        negotiate,
+        sb_option,
+        sb_data,
+        sb_iac
+    };
+
+    auto flush() -> void;
+
+    handlers m_handlers;
+    state m_state = state::data;
+    std::uint8_t m_verb = 0;
+    std::uint8_t m_sb_option = 0;
+    bool m_binary = false;
+    bool m_after_cr = false;
+    std::string m_data;
+    std::string m_sb;
+};
+
+
+/* Doubles each IAC, so that `data` passes through unchanged */
+auto escape(std::string_view data) -> std::string;
+
+auto negotiation(std::uint8_t verb, std::uint8_t option) -> std::string;
+
+auto subnegotiation(std::uint8_t option, std::string_view payload)
+    -> std::string;
+
+}
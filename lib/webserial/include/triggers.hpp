@@ -0,0 +1,200 @@
+#pragma once
+
+#include <apsn/result.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace smux {
+
+/**
+ * @brief A pattern to look for in console output
+ *
+ * `pattern` is an ECMAScript regular expression, matched against one line
+ * at a time. A pattern without any metacharacters is matched as it is.
+ */
+struct trigger
+{
+    std::string name;
+    std::string pattern;
+};
+
+/* Kernel panics and oopses, which are always looked for */
+auto default_triggers() -> std::vector<trigger>;
+
+/* `name=pattern`, or a bare pattern which names itself */
+auto parse_trigger(std::string_view spec) -> trigger;
+
+
+/**
+ * @brief Every trigger, compiled to be looked for in one pass
+ *
+ * The longest run of plain characters each pattern must contain is taken
+ * out of it, and those literals are built into one Aho-Corasick automaton
+ * with every transition filled in, so that each byte of output costs one
+ * table lookup however many triggers there are. Only a line in which a
+ * pattern's literal was seen is given to its regular expression. A pattern
+ * with no literal, such as one with `|` at the top level, is tried on every
+ * line, which is correct but slow.
+ *
+ * Built once and shared, read only, by every port.
+ */
+class trigger_set
+{
+public:
+    static auto compile(std::vector<trigger> triggers)
+        -> apsn::result<std::shared_ptr<trigger_set const>>;
+
+    auto size() const -> std::size_t
+    { return m_patterns.size(); }
+
+    auto name(std::size_t id) const -> std::string const &
+    { return m_patterns[id].spec.name; }
+
+    auto pattern(std::size_t id) const -> std::string const &
+    { return m_patterns[id].spec.pattern; }
+
+    /* What the automaton looks for in place of the pattern; empty when
+       every line is tried */
+    auto literal(std::size_t id) const -> std::string const &
+    { return m_patterns[id].literal; }
+
+private:
+    friend class trigger_matcher;
+
+    struct compiled
+    {
+        trigger spec;
+        std::string literal;
+
+        /* Unset when the literal is the whole pattern */
+        std::optional<std::regex> regex;
+    };
+
+    trigger_set() = default;
+
+    auto build() -> void;
+
+    auto next(std::uint32_t state, unsigned char byte) const -> std::uint32_t
+    { return m_next[state * 256 + byte]; }
+
+    auto outputs(std::uint32_t state) const -> std::span<std::uint32_t const>
+    {
+        return std::span{m_outputs}.subspan(m_output_begin[state],
+                m_output_begin[state + 1] - m_output_begin[state]);
+    }
+
+    std::vector<compiled> m_patterns;
+    std::vector<std::uint32_t> m_next;
+    std::vector<std::uint32_t> m_output_begin;
+    std::vector<std::uint32_t> m_outputs;
+    std::vector<std::uint32_t> m_unfiltered;
+};
+
+
+/**
+ * @brief One port's progress through its output
+ *
+ * Keeps the automaton's state and the line so far between reads, so that
+ * a pattern split over two reads is still found. Matches are reported when
+ * their line ends, once per pattern per line. Lines longer than
+ * `max_line` are cut short, though the automaton still sees all of them.
+ */
+class trigger_matcher
+{
+public:
+    constexpr static std::size_t max_line = 4096;
+
+    struct hit
+    {
+        std::size_t pattern;
+        std::string line;
+    };
+
+    struct found
+    {
+        /* Bytes of `data` up to the end of the match, or all of them */
+        std::size_t consumed;
+        std::optional<std::size_t> pattern;
+    };
+
+    explicit trigger_matcher(std::shared_ptr<trigger_set const> set);
+
+    /* The hits on lines which ended in `data`, valid until the next call */
+    auto feed(std::string_view data) -> std::span<hit const>;
+
+    /**
+     * @brief Stops at the first match, without waiting for its line to end
+     *
+     * For waiting on a prompt, which is not followed by a newline. A literal
+     * pattern matches as soon as its last byte is read. A regular expression
+     * is tried on the line so far whenever a read ends, and at each line
+     * end, once its literal has been seen; so `$` matches the end of what
+     * has arrived. After a match the matcher starts afresh from the byte
+     * following it. Not to be mixed with `feed`.
+     */
+    auto find(std::string_view data) -> found;
+
+private:
+    auto end_line() -> void;
+
+    /* The first pattern to match `line`, and where the match ends */
+    auto search(std::string_view line) const
+        -> std::optional<std::pair<std::size_t, std::size_t>>;
+    auto restart() -> void;
+
+    std::shared_ptr<trigger_set const> m_set;
+    std::uint32_t m_state = 0;
+    std::string m_line;
+    std::vector<bool> m_seen;
+    bool m_any_seen = false;
+    std::vector<hit> m_hits;
+};
+
+
+/**
+ * @brief The patterns in use, and the most recent matches on any port
+ */
+struct triggers_holder
+{
+    constexpr static std::size_t max_events = 1000;
+
+    struct event
+    {
+        std::uint64_t seq;
+        std::chrono::system_clock::time_point time;
+        std::string device;
+        std::string trigger;
+        std::string line;
+    };
+
+    /* Logs, counts and keeps each hit */
+    auto record(std::string const & device,
+            std::span<trigger_matcher::hit const> hits) -> void;
+
+    /* Events after `seq`, oldest first */
+    auto since(std::uint64_t seq) const -> std::vector<event>;
+
+    auto lock() const -> std::unique_lock<std::mutex>;
+
+    /* Set before any port is opened, and not changed after */
+    std::shared_ptr<trigger_set const> set;
+
+    std::deque<event> events;
+    std::uint64_t next_seq = 1;
+    mutable std::mutex m_mtx;
+};
+
+}
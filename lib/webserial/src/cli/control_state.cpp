@@ -35,14 +35,14 @@ control_state::control_state(apsn::ws::websocket_base * session,
     : base_state{session, ctx}
     , m_cli{}
 {
-    apsn::log::trace("control_state::control_state");
+    APSN_LOG_TRACE("control_state::control_state");
     make_menus();
 }
 
 
 control_state::~control_state()
 {
-    apsn::log::trace("control_state::~control_state");
+    APSN_LOG_TRACE("control_state::~control_state");
 }
 
 
@@ -51,7 +51,7 @@ auto control_state::on_csi(std::string message, apsn::ansi::csi_final final)
 {
     using namespace apsn::ansi;
 
-    apsn::log::trace("control_state::on_csi {}", message);
+    APSN_LOG_TRACE("control_state::on_csi {}", message);
 
     auto clear_write_session = [this](auto to_write){
         for (auto ii = 0ull; ii != m_inbuf.size(); ++ii) {
@@ -83,7 +83,7 @@ auto control_state::on_csi(std::string message, apsn::ansi::csi_final final)
 auto control_state::on_dcs(std::string message)
     -> std::shared_ptr<base_state>
 {
-    apsn::log::trace("control_state::on_dcs {}", message);
+    APSN_LOG_TRACE("control_state::on_dcs {}", message);
     (void)(message);
     return nullptr;
 }
@@ -92,7 +92,7 @@ auto control_state::on_dcs(std::string message)
 auto control_state::on_apc(std::string message)
     -> std::shared_ptr<base_state>
 {
-    apsn::log::trace("control_state::on_apc {}", message);
+    APSN_LOG_TRACE("control_state::on_apc {}", message);
 
     auto split = smux::split(message, '=');
     if (split.size() >= 2 && split[0] == "open_port") {
@@ -298,7 +298,9 @@ auto control_state::make_menus() -> void
 
     root->Insert("connect",
         [this](std::ostream &, std::size_t port_id) {
-            auto sess_lock = m_ctx->sessions.lock();
+            /* The session table locks itself, so is updated once the port
+               table is released; `system refresh` takes them in the
+               opposite order. */
             auto port_lock = m_ctx->ports.lock();
             auto info = m_ctx->ports.get_port(port_id);
             if (!info) {
@@ -313,9 +315,7 @@ auto control_state::make_menus() -> void
                 return;
             }
 
-            auto serial_port = serial::create(m_ctx->ioc.get_executor(),
-                    info->device,
-                    info->options);
+            auto serial_port = serial::open(m_ctx->ioc.get_executor(), *info);
             if (!serial_port) {
                 send_error(fmt::format("Error creating port: {}",
                         serial_port.error_message()));
@@ -328,7 +328,9 @@ auto control_state::make_menus() -> void
                     *info,
                     std::move(*serial_port));
             info->in_use = true;
-            m_ctx->sessions.set_device(m_session, info->device);
+            auto device = info->device;
+            port_lock.unlock();
+            m_ctx->sessions.set_device(m_session, device);
         },
         "Connect to a port");
 
@@ -15,30 +15,81 @@
 #include <boost/asio/serial_port.hpp>
 
 #include <array>
+#include <charconv>
 
 
 using smux::cli::serial_state;
 
+
+namespace {
+
+constexpr auto probe_interval = std::chrono::seconds{5};
+constexpr auto probe_prefix = std::string_view{"probe="};
+
+/* Lines from above the screen redrawn on attach, for a little context */
+constexpr auto attach_history = std::size_t{100};
+
+auto micros(std::chrono::steady_clock::duration d) -> std::uint64_t
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    return us < 0 ? 0 : static_cast<std::uint64_t>(us);
+}
+
+}
+
+
 serial_state::serial_state(apsn::ws::websocket_base * session, 
         std::shared_ptr<context> ctx,
         port & port_info,
         boost_serial_port && port)
     : base_state{session, ctx}
     , m_info{port_info}
+    , m_screen{port_info.screen}
+    , m_triggers{ctx->triggers.set}
     , m_port{std::move(port)}
     , m_buffer{}
+    , m_writable{m_port.get_executor()}
+    , m_rx_bytes{apsn::metrics::default_registry().counter(
+        "serial_rx_bytes_total", "Bytes read from serial ports",
+        {{"port", port_info.device}})}
+    , m_tx_bytes{apsn::metrics::default_registry().counter(
+        "serial_tx_bytes_total", "Bytes written to serial ports",
+        {{"port", port_info.device}})}
+    , m_read_sizes{apsn::metrics::default_registry().histogram(
+        "serial_read_bytes", "Bytes returned by each serial port read",
+        {{"port", port_info.device}})}
+    , m_probe_timer{m_port.get_executor()}
 {
-    apsn::log::trace("serial_state::serial_state");
-
+    APSN_LOG_TRACE("serial_state::serial_state");
+
+    /* Made with the port table locked */
+    m_info.open = &m_port;
+
+    if (m_ctx->trace_latency) {
+        auto & reg = apsn::metrics::default_registry();
+        auto stage = [&](char const * name) -> apsn::metrics::histogram & {
+            return reg.histogram("serial_forward_seconds",
+                "Time taken by serial output to reach the network, by stage",
+                {{"port", m_info.device}, {"stage", name}}, 1e-6);
+        };
+        m_latency.emplace(latency_metrics{
+            stage("handoff"),
+            stage("write"),
+            stage("total"),
+            reg.histogram("websocket_rtt_seconds",
+                "Round trip time of probes echoed by the browser",
+                {{"port", m_info.device}}, 1e-6)
+        });
+    }
 }
 
 
 serial_state::~serial_state() {
-    apsn::log::trace("serial_state::~serial_state");
-    // auto sess_lock = m_ctx->sessions.lock();
-    // auto port_lock = m_ctx->ports.lock();
+    APSN_LOG_TRACE("serial_state::~serial_state");
     m_ctx->sessions.set_device(m_session, "");
+    auto port_lock = m_ctx->ports.lock();
     m_info.in_use = false;
+    m_info.open = nullptr;
 }
 
 
@@ -46,7 +97,7 @@ auto serial_state::run() -> void
 {
     namespace ansi = apsn::ansi;
 
-    apsn::log::trace("serial_state::run");
+    APSN_LOG_TRACE("serial_state::run");
     
     write_session(ansi::send_dcs("serial", 'S'));
 
@@ -60,12 +111,19 @@ auto serial_state::run() -> void
                 been established. */
     write_session("Connected.\r\nType Ctrl + q to exit\r\n");
 
+    /* Redraw what the port has shown, including before an upgrade */
+    if (!m_screen->empty()) {
+        m_out << m_screen->snapshot(attach_history);
+    }
+
 
+    using apsn::http::rethrow;
     auto self = shared_from_this();
-    m_port.async_read_some(asio::buffer(m_buffer.data(), m_buffer.size()), 
-            [self](sys::error_code ec, std::size_t len){
-                self->on_read(ec, len);
-            });
+    asio::co_spawn(m_port.get_executor(), do_read(self), rethrow);
+    asio::co_spawn(m_port.get_executor(), do_write(self), rethrow);
+    if (m_latency) {
+        asio::co_spawn(m_port.get_executor(), do_probe(self), rethrow);
+    }
 
     // write_serial("{}", ansi::c0::FF);
 
@@ -74,8 +132,56 @@ auto serial_state::run() -> void
 
 auto serial_state::cancel() -> void
 {
-    apsn::log::trace("serial_state::cancel");
-    m_port.cancel();
+    APSN_LOG_TRACE("serial_state::cancel");
+    /* Called from the websocket's thread; the port belongs to the serial
+       IO context. */
+    auto self = shared_from_this();
+    asio::post(m_port.get_executor(), [self]() {
+        /* Already closed if the port has been handed over */
+        auto ec = sys::error_code{};
+        self->m_port.cancel(ec);
+        self->m_probe_timer.cancel();
+    });
+}
+
+
+auto serial_state::on_sent(apsn::ws::send_timing const & timing) -> void
+{
+    if (!m_latency) {
+        return;
+    }
+    /* The message was sent from `do_read`, as soon as the read completed */
+    m_latency->handoff.observe(micros(timing.enqueued - timing.sent));
+    m_latency->write.observe(micros(timing.written - timing.enqueued));
+    m_latency->total.observe(micros(timing.written - timing.sent));
+}
+
+
+auto serial_state::do_probe(std::shared_ptr<serial_state>)
+    -> asio::awaitable<void>
+{
+    auto ec = sys::error_code{};
+    while (true) {
+        m_probe_timer.expires_after(probe_interval);
+        co_await m_probe_timer.async_wait(apsn::http::with_error(ec));
+        if (ec) {
+            co_return;
+        }
+        send_probe();
+    }
+}
+
+
+auto serial_state::send_probe() -> void
+{
+    namespace ansi = apsn::ansi;
+
+    /* The browser echoes the ID back as an APC, see `on_apc` */
+    auto id = m_probe_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    m_probe_sent.store(
+        std::chrono::steady_clock::now().time_since_epoch().count(),
+        std::memory_order_relaxed);
+    write_session(ansi::send_dcs(std::to_string(id), 'p'));
 }
 
 auto serial_state::fail(sys::error_code ec,
@@ -95,7 +201,7 @@ auto serial_state::fail(sys::error_code ec,
 
 auto serial_state::write_serial(std::shared_ptr<std::string const> const& ss) -> void
 {
-    apsn::log::trace("serial_state::send {}", *ss);
+    APSN_LOG_TRACE("serial_state::send {}", *ss);
     
     auto self = shared_from_this();
     asio::post(
@@ -107,43 +213,59 @@ auto serial_state::write_serial(std::shared_ptr<std::string const> const& ss) ->
 }
 
 
-auto serial_state::on_read(beast::error_code ec, std::size_t bytes_transferred) -> void
+auto serial_state::do_read(std::shared_ptr<serial_state>)
+    -> asio::awaitable<void>
 {
-    apsn::log::trace("serial_state::on_read {}", bytes_transferred);
-
-    if (ec) {
-        return fail(ec, "read");
+    auto ec = sys::error_code{};
+    while (true) {
+        auto bytes_transferred = co_await m_port.async_read_some(
+                asio::buffer(m_buffer.data(), m_buffer.size()),
+                apsn::http::with_error(ec));
+        APSN_LOG_TRACE("serial_state::do_read {}", bytes_transferred);
+        if (ec) {
+            break;
+        }
+        m_rx_bytes.add(bytes_transferred);
+        m_read_sizes.observe(bytes_transferred);
+
+        auto to_write = std::string{m_buffer.data(), 
+                m_buffer.data() + bytes_transferred};
+
+        m_screen->feed(to_write);
+        m_out << to_write;
+
+        /* After forwarding, so that matching never delays it */
+        m_ctx->triggers.record(m_info.device, m_triggers.feed(to_write));
     }
 
-    auto to_write = std::string{m_buffer.data(), 
-            m_buffer.data() + bytes_transferred};
-
-    m_out << to_write;
-
-    auto self = shared_from_this();
-    m_port.async_read_some(asio::buffer(m_buffer.data(), m_buffer.size()), 
-            [self](sys::error_code ec, std::size_t len){
-                self->on_read(ec, len);
-            });
+    /* The writer and the probe hold the state too */
+    m_closed = true;
+    m_writable.notify();
+    m_probe_timer.cancel();
+    fail(ec, "read");
 }
 
 
-auto serial_state::on_write(beast::error_code ec, 
-        [[maybe_unused]]std::size_t bytes_transferred) -> void
+auto serial_state::do_write(std::shared_ptr<serial_state>)
+    -> asio::awaitable<void>
 {
-    apsn::log::trace("serial_state::on_write {}", bytes_transferred);
-    if (ec) {
-        return fail(ec, "write");
-    }
-
-    m_send_queue.erase(m_send_queue.begin());
-
-    if (!m_send_queue.empty()) {
-        auto self = shared_from_this();
-        m_port.async_write_some(asio::buffer(&m_send_queue.front(), 1),
-            [self](sys::error_code ec, std::size_t len){
-                self->on_write(ec, len);
-            });
+    auto ec = sys::error_code{};
+    while (!m_closed) {
+        if (m_send_queue.empty()) {
+            co_await m_writable.wait();
+            continue;
+        }
+
+        auto bytes_transferred = co_await m_port.async_write_some(
+                asio::buffer(*m_send_queue.front()),
+                apsn::http::with_error(ec));
+        APSN_LOG_TRACE("serial_state::do_write {}", bytes_transferred);
+        if (ec) {
+            co_return fail(ec, "write");
+        }
+        m_tx_bytes.add(bytes_transferred);
+
+        m_send_queue.erase(m_send_queue.begin());
     }
 }
 
@@ -152,22 +274,16 @@ auto serial_state::on_send(std::shared_ptr<std::string const> const& ss) -> void
 {
     m_send_queue.push_back(ss);
 
-    if (m_send_queue.size() > 1) {
-        return;
+    if (m_send_queue.size() == 1) {
+        m_writable.notify();
     }
-
-    auto self = shared_from_this();
-    m_port.async_write_some(asio::buffer(*m_send_queue.front()),
-        [self](sys::error_code ec, std::size_t len){
-            self->on_write(ec, len);
-        });
 }
 
 
 auto serial_state::on_csi(std::string message, apsn::ansi::csi_final final)
     -> std::shared_ptr<base_state>
 {
-    apsn::log::trace("serial_state::on_csi, message: '{}', final: '{}'", message,
+    APSN_LOG_TRACE("serial_state::on_csi, message: '{}', final: '{}'", message,
         apsn::ansi::to_value(final));
 
     write_serial("\x1b[{}{}", message, apsn::ansi::to_value(final));
@@ -179,7 +295,7 @@ auto serial_state::on_csi(std::string message, apsn::ansi::csi_final final)
 auto serial_state::on_dcs(std::string message)
     -> std::shared_ptr<base_state>
 {
-    apsn::log::trace("serial_state::on_dcs {}", message);
+    APSN_LOG_TRACE("serial_state::on_dcs {}", message);
     return nullptr;
 }
 
@@ -187,7 +303,23 @@ auto serial_state::on_dcs(std::string message)
 auto serial_state::on_apc(std::string message)
     -> std::shared_ptr<base_state>
 {
-    apsn::log::trace("serial_state::on_apc {}", message);
+    APSN_LOG_TRACE("serial_state::on_apc {}", message);
+
+    if (m_latency && message.starts_with(probe_prefix)) {
+        auto id = std::uint64_t{};
+        auto const * first = message.data() + probe_prefix.size();
+        auto const * last = message.data() + message.size();
+        auto [ptr, ec] = std::from_chars(first, last, id);
+        /* Replies to anything but the latest probe are ignored */
+        if (ec == std::errc{} && ptr == last
+                && id == m_probe_id.load(std::memory_order_relaxed)) {
+            auto sent = std::chrono::steady_clock::time_point{
+                std::chrono::steady_clock::duration{
+                    m_probe_sent.load(std::memory_order_relaxed)}};
+            m_latency->round_trip.observe(
+                micros(std::chrono::steady_clock::now() - sent));
+        }
+    }
     return nullptr;
 }
 
@@ -196,7 +328,7 @@ auto serial_state::on_char(char c) -> std::shared_ptr<base_state>
 {
     namespace ansi = apsn::ansi;
 
-    apsn::log::trace("serial_state::on_char {}", c);
+    APSN_LOG_TRACE("serial_state::on_char {}", c);
     switch (ansi::c0_cast(c)) {
     case ansi::c0::DC1: {
         return std::make_shared<control_state>(m_session, m_ctx);
@@ -11,9 +11,13 @@
 
 #include <boost/asio.hpp>
 
+#include <algorithm>
+#include <charconv>
 #include <map>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <vector>
 
 
 std::size_t smux::session_holder::current_id = 0ull;
@@ -39,6 +43,7 @@ auto smux::session_holder::register_session(apsn::ws::websocket_base * sess,
 auto smux::session_holder::set_state(apsn::ws::websocket_base * sess,
         std::string state) -> std::error_code
 {
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
     auto it = sessions.find(sess);
     if (it == std::end(sessions)) {
         return error::session_not_found;
@@ -51,6 +56,7 @@ auto smux::session_holder::set_state(apsn::ws::websocket_base * sess,
 auto smux::session_holder::set_device(apsn::ws::websocket_base * sess,
         std::string device) -> std::error_code
 {
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
     auto it = sessions.find(sess);
     if (it == std::end(sessions)) {
         return error::session_not_found;
@@ -63,6 +69,7 @@ auto smux::session_holder::set_device(apsn::ws::websocket_base * sess,
 auto smux::session_holder::unregister_session(apsn::ws::websocket_base * sess)
     -> std::error_code
 {
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
     auto it = sessions.find(sess);
     if (it == std::end(sessions)) {
         return error::session_not_found;
@@ -74,6 +81,7 @@ auto smux::session_holder::unregister_session(apsn::ws::websocket_base * sess)
 
 auto smux::session_holder::cancel(std::size_t id) -> std::error_code
 {
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
     for (auto && [sess, info] : sessions) {
         if (info.id == id) {
             sess->cancel();
@@ -84,6 +92,15 @@ auto smux::session_holder::cancel(std::size_t id) -> std::error_code
 }
 
 
+auto smux::session_holder::cancel_all() -> void
+{
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    for (auto && [sess, info] : sessions) {
+        sess->cancel();
+    }
+}
+
+
 auto smux::session_holder::lock() const -> std::unique_lock<std::mutex>
 {
     return std::unique_lock<std::mutex>{m_mtx};
@@ -190,4 +207,57 @@ auto smux::ports_holder::add_port(std::string device, port_options opts)
             std::forward_as_tuple(device, opts));
 
     return port_id;
-}
\ No newline at end of file
+}
+
+
+auto smux::ports_holder::find_port(std::string_view id_or_device) const
+    -> apsn::result<std::size_t>
+{
+    auto id = std::size_t{0};
+    auto const * last = id_or_device.data() + id_or_device.size();
+    auto [end, ec] = std::from_chars(id_or_device.data(), last, id);
+    if (ec == std::errc{} && end == last && ports.contains(id)) {
+        return id;
+    }
+    for (auto && [port_id, p] : ports) {
+        if (p.device == id_or_device) {
+            return port_id;
+        }
+    }
+    return error::device_not_found;
+}
+
+
+auto smux::ports_holder::set_group(std::string name,
+        std::vector<std::size_t> port_ids) -> std::error_code
+{
+    if (name.empty()) {
+        return error::bad_value;
+    }
+    if (port_ids.empty()) {
+        groups.erase(name);
+        return error::ok;
+    }
+
+    std::ranges::sort(port_ids);
+    auto [first, last] = std::ranges::unique(port_ids);
+    port_ids.erase(first, last);
+    for (auto port_id : port_ids) {
+        if (!ports.contains(port_id)) {
+            return error::device_not_found;
+        }
+    }
+    groups[std::move(name)] = std::move(port_ids);
+    return error::ok;
+}
+
+
+auto smux::ports_holder::get_group(std::string const & name) const
+    -> apsn::result<std::vector<std::size_t>>
+{
+    auto it = groups.find(name);
+    if (it == std::end(groups)) {
+        return error::group_not_found;
+    }
+    return it->second;
+}
@@ -19,6 +19,10 @@ auto error_category::message(int ec) const -> std::string
     case error::session_not_found: return "Session not found";
     case error::invalid_baud:      return "Invalid baud rate";
     case error::boost_error:       return "Internal boost error";
+    case error::bad_handoff:       return "Malformed upgrade handoff";
+    case error::bad_trigger:       return "Invalid trigger pattern";
+    case error::bad_script:        return "Invalid script";
+    case error::group_not_found:   return "Port group not found";
     default: return "<unknown error>";
     }
 }
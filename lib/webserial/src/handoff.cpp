@@ -0,0 +1,542 @@
+#include "handoff.hpp"
+
+#include "context.hpp"
+#include "error.hpp"
+#include "port.hpp"
+
+#include <apsn/http/peer.hpp>
+#include <apsn/logging.hpp>
+
+#include <boost/asio.hpp>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace asio = boost::asio;
+namespace sys = boost::system;
+
+using smux::handoff::port_state;
+using smux::handoff::server;
+using smux::handoff::state;
+
+
+namespace {
+
+constexpr auto magic = std::array<char, 4>{'W', 'S', 'M', 'X'};
+constexpr auto version = std::uint32_t{1};
+
+/* Rather more than any number of full screens and histories would take */
+constexpr auto max_payload = std::uint64_t{64} * 1024 * 1024;
+
+/* Neither end waits longer than this for the other */
+constexpr auto io_timeout = ::timeval{10, 0};
+
+struct header
+{
+    std::array<char, 4> magic;
+    std::uint32_t version;
+    std::uint32_t listeners;
+    std::uint32_t ports;
+    std::uint64_t payload;
+};
+
+
+auto last_error() -> std::error_code
+{
+    return std::error_code{errno, std::system_category()};
+}
+
+
+auto set_timeouts(int fd) -> void
+{
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &io_timeout, sizeof(io_timeout));
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &io_timeout, sizeof(io_timeout));
+}
+
+
+auto write_all(int fd, char const * data, std::size_t size) -> std::error_code
+{
+    while (size > 0) {
+        auto sent = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return last_error();
+        }
+        data += sent;
+        size -= static_cast<std::size_t>(sent);
+    }
+    return {};
+}
+
+
+auto read_all(int fd, char * data, std::size_t size) -> std::error_code
+{
+    while (size > 0) {
+        auto got = ::recv(fd, data, size, 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return last_error();
+        }
+        if (got == 0) {
+            return std::make_error_code(std::errc::connection_reset);
+        }
+        data += got;
+        size -= static_cast<std::size_t>(got);
+    }
+    return {};
+}
+
+
+template <typename Integer>
+auto put(std::string & out, Integer value) -> void
+{
+    out.append(reinterpret_cast<char const *>(&value), sizeof(value));
+}
+
+
+template <typename Integer>
+auto get(std::string_view & in, Integer & value) -> bool
+{
+    if (in.size() < sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return true;
+}
+
+
+auto get(std::string_view & in, std::string & value) -> bool
+{
+    auto size = std::uint64_t{};
+    if (!get(in, size) || in.size() < size) {
+        return false;
+    }
+    value.assign(in.substr(0, size));
+    in.remove_prefix(size);
+    return true;
+}
+
+
+auto close_all(state const & st) -> void
+{
+    for (auto fd : st.listeners) {
+        ::close(fd);
+    }
+    for (auto const & port : st.ports) {
+        ::close(port.fd);
+    }
+}
+
+}
+
+
+auto smux::handoff::send(int socket, state const & st) -> std::error_code
+{
+    auto fds = std::vector<int>{st.listeners};
+    for (auto const & port : st.ports) {
+        fds.push_back(port.fd);
+    }
+    if (fds.size() > max_fds) {
+        return std::make_error_code(std::errc::too_many_files_open);
+    }
+
+    auto payload = std::string{};
+    for (auto const & port : st.ports) {
+        put(payload, std::uint64_t{port.device.size()});
+        payload += port.device;
+        put(payload, std::uint64_t{port.screen.size()});
+        payload += port.screen;
+    }
+
+    auto head = header{magic,
+            version,
+            static_cast<std::uint32_t>(st.listeners.size()),
+            static_cast<std::uint32_t>(st.ports.size()),
+            payload.size()};
+
+    /* The descriptors ride on the header, so that they arrive with the
+       counts which say what they are */
+    auto iov = ::iovec{&head, sizeof(head)};
+    auto control = std::vector<char>(CMSG_SPACE(sizeof(int) * fds.size()));
+    auto msg = ::msghdr{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (!fds.empty()) {
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+        auto * cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    }
+
+    auto sent = ssize_t{};
+    do {
+        sent = ::sendmsg(socket, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent < 0) {
+        return last_error();
+    }
+
+    /* Anything of the header left over goes without the descriptors */
+    auto const * rest = reinterpret_cast<char const *>(&head) + sent;
+    if (auto ec = write_all(socket, rest,
+                sizeof(head) - static_cast<std::size_t>(sent)))
+    {
+        return ec;
+    }
+    return write_all(socket, payload.data(), payload.size());
+}
+
+
+auto smux::handoff::receive(int socket) -> apsn::result<state>
+{
+    auto head = header{};
+    auto iov = ::iovec{&head, sizeof(head)};
+    auto control = std::vector<char>(CMSG_SPACE(sizeof(int) * max_fds));
+    auto msg = ::msghdr{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    auto got = ssize_t{};
+    do {
+        got = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) {
+        return last_error();
+    }
+
+    auto fds = std::vector<int>{};
+    for (auto * cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+            cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        auto first = fds.size();
+        fds.resize(first + count);
+        std::memcpy(fds.data() + first, CMSG_DATA(cmsg), sizeof(int) * count);
+    }
+
+    auto st = state{};
+    auto fail = [&](std::error_code ec) {
+        for (auto fd : fds) {
+            ::close(fd);
+        }
+        return ec;
+    };
+
+    if (got == 0) {
+        return fail(std::make_error_code(std::errc::connection_reset));
+    }
+    if (msg.msg_flags & MSG_CTRUNC) {
+        return fail(error::bad_handoff);
+    }
+    auto * rest = reinterpret_cast<char *>(&head) + got;
+    if (auto ec = read_all(socket, rest,
+                sizeof(head) - static_cast<std::size_t>(got)))
+    {
+        return fail(ec);
+    }
+    if (head.magic != magic || head.version != version
+        || fds.size() != std::size_t{head.listeners} + head.ports
+        || head.payload > max_payload)
+    {
+        return fail(error::bad_handoff);
+    }
+
+    auto payload = std::string(head.payload, '\0');
+    if (auto ec = read_all(socket, payload.data(), payload.size())) {
+        return fail(ec);
+    }
+
+    auto in = std::string_view{payload};
+    st.listeners.assign(fds.begin(), fds.begin() + head.listeners);
+    for (auto ii = std::size_t{0}; ii < head.ports; ++ii) {
+        auto & port = st.ports.emplace_back();
+        port.fd = fds[head.listeners + ii];
+        if (!get(in, port.device) || !get(in, port.screen)) {
+            return fail(error::bad_handoff);
+        }
+    }
+    return st;
+}
+
+
+auto smux::handoff::collect_ports(context & ctx) -> std::vector<port_state>
+{
+    auto ports = std::vector<port_state>{};
+    auto lock = ctx.ports.lock();
+    for (auto & [id, port] : ctx.ports.ports) {
+        auto * serial = port.open != nullptr
+            ? port.open
+            : port.inherited ? &*port.inherited : nullptr;
+        if (serial == nullptr || !serial->is_open()) {
+            continue;
+        }
+        auto fd = ::fcntl(serial->native_handle(), F_DUPFD_CLOEXEC, 0);
+        if (fd < 0) {
+            apsn::log::error("Could not hand over {}: {}",
+                    port.device, std::strerror(errno));
+            continue;
+        }
+        ports.push_back(port_state{port.device, fd, port.screen->snapshot(smux::screen::all)});
+    }
+    return ports;
+}
+
+
+auto smux::handoff::detach_ports(context & ctx) -> void
+{
+    auto lock = ctx.ports.lock();
+    auto ec = sys::error_code{};
+    for (auto & [id, port] : ctx.ports.ports) {
+        if (port.open != nullptr) {
+            port.open->close(ec);
+        }
+        port.inherited.reset();
+    }
+}
+
+
+auto smux::handoff::restore_ports(context & ctx, std::vector<port_state> ports)
+    -> void
+{
+    auto lock = ctx.ports.lock();
+    auto by_device = std::map<std::string, smux::port *>{};
+    for (auto & [id, port] : ctx.ports.ports) {
+        by_device[port.device] = &port;
+    }
+
+    for (auto & handed : ports) {
+        auto it = by_device.find(handed.device);
+        if (it == by_device.end()) {
+            apsn::log::warn("Closing {}, handed over but no longer present",
+                    handed.device);
+            ::close(handed.fd);
+            continue;
+        }
+
+        auto & port = *it->second;
+        auto ec = sys::error_code{};
+        auto serial = boost_serial{ctx.ioc};
+        serial.assign(handed.fd, ec);
+        if (ec) {
+            apsn::log::error("Could not keep {}: {}", port.device, ec.message());
+            ::close(handed.fd);
+            continue;
+        }
+
+        /* As it was left, which may not be as configured */
+        serial.get_option(port.options.baud_rate, ec);
+        serial.get_option(port.options.flow_control, ec);
+        serial.get_option(port.options.parity, ec);
+        serial.get_option(port.options.stop_bits, ec);
+        serial.get_option(port.options.character_size, ec);
+
+        port.screen->feed(handed.screen);
+        port.inherited.emplace(std::move(serial));
+        apsn::log::info("Kept {} open over upgrade, with {} lines of history",
+                port.device, port.screen->history_size());
+    }
+}
+
+
+auto smux::handoff::take_over(std::filesystem::path const & path)
+    -> apsn::result<state>
+{
+    auto address = ::sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    if (path.native().size() >= sizeof(address.sun_path)) {
+        return std::make_error_code(std::errc::filename_too_long);
+    }
+    std::strcpy(address.sun_path, path.c_str());
+
+    auto socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socket < 0) {
+        return last_error();
+    }
+    set_timeouts(socket);
+    if (::connect(socket, reinterpret_cast<::sockaddr *>(&address),
+                sizeof(address)) != 0)
+    {
+        auto ec = last_error();
+        ::close(socket);
+        return ec;
+    }
+
+    auto st = receive(socket);
+    if (!st) {
+        ::close(socket);
+        return st;
+    }
+
+    /* The old server hangs up once it has closed its copies of the ports */
+    auto byte = char{};
+    auto got = ssize_t{};
+    do {
+        got = ::recv(socket, &byte, 1, 0);
+    } while (got < 0 && errno == EINTR);
+    ::close(socket);
+    if (got != 0) {
+        close_all(*st);
+        return got < 0 ? last_error() : make_error_code(error::bad_handoff);
+    }
+    return st;
+}
+
+
+server::server(std::shared_ptr<context> ctx,
+        std::filesystem::path path,
+        std::function<std::vector<int>()> listeners,
+        std::function<void()> on_handed_off)
+    : m_ctx{std::move(ctx)}
+    , m_path{std::move(path)}
+    , m_acceptor{m_ctx->ioc}
+    , m_listeners{std::move(listeners)}
+    , m_on_handed_off{std::move(on_handed_off)}
+{
+    auto ec = sys::error_code{};
+    auto endpoint = protocol::endpoint{m_path.string()};
+    auto fail = [this, &ec](char const * what) {
+        apsn::log::error("{} {}: {}", m_path.string(), what, ec.message());
+        m_acceptor.close(ec);
+    };
+
+    /* A socket still there has been handed over from, or its server has
+       gone; one which still answers belongs to a running server. Anything
+       else is not ours to remove. */
+    auto fs_ec = std::error_code{};
+    if (std::filesystem::is_socket(m_path, fs_ec)) {
+        auto probe = protocol::socket{m_ctx->ioc};
+        probe.connect(endpoint, ec);
+        if (!ec) {
+            apsn::log::error("{} is in use by a running server; not replacing it",
+                    m_path.string());
+            return;
+        }
+        std::filesystem::remove(m_path, fs_ec);
+    }
+    else if (std::filesystem::exists(std::filesystem::symlink_status(m_path, fs_ec))) {
+        apsn::log::error("{} exists and is not a socket; not replacing it",
+                m_path.string());
+        return;
+    }
+
+    m_acceptor.open(endpoint.protocol(), ec);
+    if (ec) {
+        fail("open");
+        return;
+    }
+    m_acceptor.bind(endpoint, ec);
+    if (ec) {
+        fail("bind");
+        return;
+    }
+    std::filesystem::permissions(m_path,
+            std::filesystem::perms::owner_read | std::filesystem::perms::owner_write,
+            fs_ec);
+    m_acceptor.listen(1, ec);
+    if (ec) {
+        fail("listen");
+        return;
+    }
+}
+
+
+server::~server()
+{
+    if (m_acceptor.is_open()) {
+        auto ec = std::error_code{};
+        std::filesystem::remove(m_path, ec);
+    }
+}
+
+
+auto server::run() -> void
+{
+    if (m_acceptor.is_open()) {
+        accept();
+    }
+}
+
+
+auto server::accept() -> void
+{
+    auto self = shared_from_this();
+    m_acceptor.async_accept(
+        [self](sys::error_code ec, protocol::socket socket) {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+            if (ec) {
+                apsn::log::error("{} accept: {}",
+                        self->m_path.string(), ec.message());
+            }
+            else if (self->hand_off(socket)) {
+                return self->m_on_handed_off();
+            }
+            self->accept();
+        });
+}
+
+
+auto server::hand_off(protocol::socket & socket) -> bool
+{
+    auto peer = apsn::http::peer_credentials::of(socket.native_handle());
+    if (!peer) {
+        apsn::log::warn("{}: no peer credentials: {}",
+                m_path.string(), peer.error_message());
+        return false;
+    }
+    if (peer->uid != 0 && peer->uid != ::geteuid()) {
+        apsn::log::warn("{}: refused upgrade by {} (uid {}, pid {})",
+                m_path.string(), peer->user(), peer->uid, peer->pid);
+        return false;
+    }
+
+    /* Sent without returning to the IO context, so that the serial ports
+       are not read again before they are detached. The successor reads as
+       soon as it has connected, and the socket is still blocking. */
+    set_timeouts(socket.native_handle());
+    auto st = state{m_listeners(), collect_ports(*m_ctx)};
+    auto ec = send(socket.native_handle(), st);
+    for (auto const & port : st.ports) {
+        ::close(port.fd);
+    }
+    if (ec) {
+        apsn::log::error("Handing over to pid {}: {}", peer->pid, ec.message());
+        return false;
+    }
+
+    apsn::log::info("Handed {} listeners and {} ports to pid {}",
+            st.listeners.size(), st.ports.size(), peer->pid);
+
+    /* The successor listens here next, once it sees the hang up */
+    auto sys_ec = sys::error_code{};
+    m_acceptor.close(sys_ec);
+    auto fs_ec = std::error_code{};
+    std::filesystem::remove(m_path, fs_ec);
+
+    detach_ports(*m_ctx);
+    socket.close(sys_ec);
+    return true;
+}
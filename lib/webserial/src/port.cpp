@@ -150,6 +150,7 @@ port::port(std::string device)
     : device{device}
     , options{}
     , in_use{false}
+    , screen{std::make_shared<smux::screen>()}
 {}
 
 
@@ -157,4 +158,5 @@ port::port(std::string device, port_options options)
     : device{device}
     , options{std::move(options)}
     , in_use{false}
+    , screen{std::make_shared<smux::screen>()}
 {}
@@ -0,0 +1,794 @@
+#include "port_server.hpp"
+
+#include "context.hpp"
+#include "port.hpp"
+#include "serial.hpp"
+#include "telnet.hpp"
+
+#include <apsn/http/inherited.hpp>
+#include <apsn/logging.hpp>
+#include <apsn/metrics.hpp>
+
+#include <boost/asio.hpp>
+#include <fmt/format.h>
+
+#include <charconv>
+#include <string>
+#include <string_view>
+
+#include <sys/ioctl.h>
+#include <termios.h>
+
+
+using smux::port_connection;
+using smux::port_listener;
+using smux::port_protocol;
+
+namespace telnet = smux::telnet;
+
+
+namespace {
+
+/* Longest line a client may send to choose a port */
+constexpr auto max_selection = std::size_t{32};
+
+auto to_be32(std::uint32_t value) -> std::string
+{
+    return {
+        static_cast<char>((value >> 24) & 0xff),
+        static_cast<char>((value >> 16) & 0xff),
+        static_cast<char>((value >> 8) & 0xff),
+        static_cast<char>(value & 0xff)
+    };
+}
+
+
+auto from_be32(std::string_view bytes) -> std::uint32_t
+{
+    auto value = std::uint32_t{0};
+    for (auto ch : bytes) {
+        value = (value << 8) | static_cast<std::uint8_t>(ch);
+    }
+    return value;
+}
+
+
+auto trim(std::string_view text) -> std::string_view
+{
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' ||
+                             text.back() == '\r'))
+    {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+}
+
+
+auto smux::to_string(port_protocol value) -> std::string
+{
+    switch (value) {
+    case port_protocol::raw:     return "raw";
+    case port_protocol::rfc2217: return "rfc2217";
+    default: return "<unknown>";
+    }
+}
+
+
+auto port_connection::streambuf::xsputn(char const * s, std::streamsize n)
+    -> std::streamsize
+{
+    auto conn = m_conn->shared_from_this();
+    asio::post(conn->m_socket.get_executor(),
+        [conn, data = std::string(s, s + n)]() mutable {
+            conn->write_socket(std::move(data));
+        });
+    return n;
+}
+
+
+auto port_connection::streambuf::overflow(int c) -> int
+{
+    auto ch = static_cast<char>(c);
+    xsputn(&ch, 1);
+    return 1;
+}
+
+
+port_connection::port_connection(tcp::socket && socket,
+        std::shared_ptr<context> ctx,
+        port_protocol protocol)
+    : m_ctx{std::move(ctx)}
+    , m_socket{std::move(socket)}
+    , m_serial{m_ctx->ioc}
+    , m_protocol{protocol}
+    , m_triggers{m_ctx->triggers.set}
+    , m_telnet{telnet::decoder::handlers{
+        [this](std::string_view data) { write_serial(std::string{data}); },
+        [this](std::uint8_t verb, std::uint8_t option) {
+            on_negotiate(verb, option);
+        },
+        [this](std::uint8_t option, std::string_view payload) {
+            if (option == telnet::option::com_port) {
+                on_com_port(payload);
+            }
+        }}}
+    , m_connections{apsn::metrics::default_registry().gauge(
+        "port_server_connections", "Clients attached to serial ports over TCP",
+        {{"protocol", to_string(protocol)}})}
+    , m_streambuf{this}
+    , m_ostream{&m_streambuf}
+{
+    auto ec = sys::error_code{};
+    auto remote = m_socket.remote_endpoint(ec);
+    m_address = ec ? "<unknown>" : remote.address().to_string();
+    m_connections.add();
+}
+
+
+port_connection::~port_connection()
+{
+    APSN_LOG_TRACE("port_connection::~port_connection");
+    m_connections.sub();
+    m_ctx->sessions.unregister_session(this);
+    if (!m_port_id) {
+        return;
+    }
+
+    /* The port table may have been rescanned since */
+    auto port_lock = m_ctx->ports.lock();
+    auto port = m_ctx->ports.get_port(*m_port_id);
+    if (port && port->device == m_device) {
+        port->in_use = false;
+        port->open = nullptr;
+    }
+}
+
+
+auto port_connection::start(std::optional<std::size_t> port_id) -> void
+{
+    m_ctx->sessions.register_session(this, "<unknown>", m_address);
+    m_ctx->sessions.set_state(this, to_string(m_protocol));
+
+    if (port_id) {
+        return attach(*port_id, {});
+    }
+    read_selection();
+}
+
+
+auto port_connection::cancel() -> void
+{
+    APSN_LOG_TRACE("port_connection::cancel");
+    /* Called from the control CLI's thread */
+    auto self = shared_from_this();
+    asio::post(m_socket.get_executor(), [self] {
+        self->close();
+    });
+}
+
+
+auto port_connection::read_selection() -> void
+{
+    auto self = shared_from_this();
+    m_socket.async_read_some(asio::buffer(m_socket_buffer),
+        [self](sys::error_code ec, std::size_t len) {
+            if (ec) {
+                return self->close();
+            }
+            self->m_selection.append(self->m_socket_buffer.data(), len);
+
+            auto end = self->m_selection.find('\n');
+            if (end == std::string::npos) {
+                if (self->m_selection.size() > max_selection) {
+                    return self->refuse("Expected a port ID");
+                }
+                return self->read_selection();
+            }
+
+            auto line = trim(std::string_view{self->m_selection}.substr(0, end));
+            auto port_id = std::size_t{0};
+            auto [ptr, err] = std::from_chars(
+                    line.data(), line.data() + line.size(), port_id);
+            if (line.empty() || err != std::errc{} ||
+                ptr != line.data() + line.size())
+            {
+                return self->refuse(fmt::format("Invalid port ID '{}'", line));
+            }
+
+            auto pending = self->m_selection.substr(end + 1);
+            self->m_selection.clear();
+            self->attach(port_id, pending);
+        });
+}
+
+
+auto port_connection::attach(std::size_t port_id, std::string_view pending)
+    -> void
+{
+    auto port_lock = m_ctx->ports.lock();
+    auto info = m_ctx->ports.get_port(port_id);
+    if (!info) {
+        return refuse(fmt::format("Unable to find port with id {}: {}",
+                port_id, info.error_message()));
+    }
+    if (info->in_use) {
+        return refuse(fmt::format("Port with id {} is in use", port_id));
+    }
+
+    auto serial_port = serial::open(m_ctx->ioc.get_executor(), *info);
+    if (!serial_port) {
+        return refuse(fmt::format("Error creating port: {}",
+                serial_port.error_message()));
+    }
+    m_serial = std::move(*serial_port);
+    info->in_use = true;
+    info->open = &m_serial;
+    m_port_id = port_id;
+    m_device = info->device;
+    m_screen = info->screen;
+    port_lock.unlock();
+
+    m_ctx->sessions.set_device(this, m_device);
+
+    /* The same series as websocket sessions on this port */
+    auto & reg = apsn::metrics::default_registry();
+    m_rx_bytes = &reg.counter("serial_rx_bytes_total",
+            "Bytes read from serial ports", {{"port", m_device}});
+    m_tx_bytes = &reg.counter("serial_tx_bytes_total",
+            "Bytes written to serial ports", {{"port", m_device}});
+
+    apsn::log::info("{} client {} attached to {}",
+            to_string(m_protocol), m_address, m_device);
+
+    if (m_protocol == port_protocol::rfc2217) {
+        offer_options();
+    }
+    if (!pending.empty()) {
+        on_socket_data(pending);
+    }
+    read_serial();
+    read_socket();
+}
+
+
+auto port_connection::refuse(std::string message) -> void
+{
+    apsn::log::info("Refused {} client {}: {}",
+            to_string(m_protocol), m_address, message);
+    write_socket(fmt::format("error: {}\r\n", message));
+    m_closing = true;
+}
+
+
+auto port_connection::close() -> void
+{
+    if (m_closed) {
+        return;
+    }
+    APSN_LOG_DEBUG("Closing {} client {}", to_string(m_protocol), m_address);
+    m_closed = true;
+
+    auto ec = sys::error_code{};
+    m_socket.shutdown(tcp::socket::shutdown_both, ec);
+    m_socket.close(ec);
+    m_serial.close(ec);
+}
+
+
+auto port_connection::read_serial() -> void
+{
+    if (m_closed || m_serial_reading || m_suspended ||
+        m_socket_queued >= max_queued)
+    {
+        return;
+    }
+    m_serial_reading = true;
+
+    auto self = shared_from_this();
+    m_serial.async_read_some(asio::buffer(m_serial_buffer),
+        [self](sys::error_code ec, std::size_t len) {
+            self->m_serial_reading = false;
+            if (ec) {
+                if (ec != asio::error::operation_aborted) {
+                    apsn::log::warn("Reading {}: {}", self->m_device, ec.message());
+                }
+                return self->close();
+            }
+            self->m_rx_bytes->add(len);
+
+            auto data = std::string_view{self->m_serial_buffer.data(), len};
+            self->m_screen->feed(data);
+            self->write_socket(self->m_protocol == port_protocol::rfc2217
+                    ? telnet::escape(data)
+                    : std::string{data});
+            self->m_ctx->triggers.record(self->m_device,
+                    self->m_triggers.feed(data));
+            self->read_serial();
+        });
+}
+
+
+auto port_connection::read_socket() -> void
+{
+    if (m_closed || m_socket_reading || m_serial_queued >= max_queued) {
+        return;
+    }
+    m_socket_reading = true;
+
+    auto self = shared_from_this();
+    m_socket.async_read_some(asio::buffer(m_socket_buffer),
+        [self](sys::error_code ec, std::size_t len) {
+            self->m_socket_reading = false;
+            if (ec) {
+                return self->close();
+            }
+            self->on_socket_data({self->m_socket_buffer.data(), len});
+            self->read_socket();
+        });
+}
+
+
+auto port_connection::on_socket_data(std::string_view data) -> void
+{
+    if (m_protocol == port_protocol::rfc2217) {
+        return m_telnet.feed(data);
+    }
+    write_serial(std::string{data});
+}
+
+
+auto port_connection::write_serial(std::string data) -> void
+{
+    if (m_closed || data.empty()) {
+        return;
+    }
+    m_serial_queued += data.size();
+    m_to_serial.push_back(std::move(data));
+    if (m_to_serial.size() == 1) {
+        flush_serial();
+    }
+}
+
+
+auto port_connection::write_socket(std::string data) -> void
+{
+    if (m_closed || data.empty()) {
+        return;
+    }
+    m_socket_queued += data.size();
+    m_to_socket.push_back(std::move(data));
+    if (m_to_socket.size() == 1) {
+        flush_socket();
+    }
+}
+
+
+auto port_connection::flush_serial() -> void
+{
+    auto self = shared_from_this();
+    asio::async_write(m_serial, asio::buffer(m_to_serial.front()),
+        [self](sys::error_code ec, std::size_t len) {
+            if (ec) {
+                return self->close();
+            }
+            self->m_tx_bytes->add(len);
+            self->m_serial_queued -= self->m_to_serial.front().size();
+            self->m_to_serial.pop_front();
+            if (!self->m_to_serial.empty()) {
+                self->flush_serial();
+            }
+            self->read_socket();
+        });
+}
+
+
+auto port_connection::flush_socket() -> void
+{
+    auto self = shared_from_this();
+    asio::async_write(m_socket, asio::buffer(m_to_socket.front()),
+        [self](sys::error_code ec, std::size_t) {
+            if (ec) {
+                return self->close();
+            }
+            self->m_socket_queued -= self->m_to_socket.front().size();
+            self->m_to_socket.pop_front();
+            if (!self->m_to_socket.empty()) {
+                return self->flush_socket();
+            }
+            if (self->m_closing) {
+                return self->close();
+            }
+            self->read_serial();
+        });
+}
+
+
+auto port_connection::offer_options() -> void
+{
+    using telnet::negotiation;
+    namespace cmd = telnet::cmd;
+    namespace option = telnet::option;
+
+    /* The device does its own echoing, so the client should not */
+    auto offers = std::string{};
+    for (auto opt : {option::binary, option::sga, option::echo}) {
+        m_local.set(opt);
+        offers += negotiation(cmd::will, opt);
+    }
+    for (auto opt : {option::binary, option::com_port}) {
+        m_remote.set(opt);
+        offers += negotiation(cmd::do_, opt);
+    }
+    write_socket(std::move(offers));
+}
+
+
+auto port_connection::on_negotiate(std::uint8_t verb, std::uint8_t option)
+    -> void
+{
+    using telnet::negotiation;
+    namespace cmd = telnet::cmd;
+    namespace opt = telnet::option;
+
+    auto local = option == opt::binary || option == opt::sga ||
+                 option == opt::echo;
+    auto remote = option == opt::binary || option == opt::sga ||
+                  option == opt::com_port;
+
+    /* Only changes are answered, so that agreement does not loop */
+    switch (verb) {
+    case cmd::do_:
+        if (!local) {
+            write_socket(negotiation(cmd::wont, option));
+        }
+        else if (!m_local.test(option)) {
+            m_local.set(option);
+            write_socket(negotiation(cmd::will, option));
+        }
+        break;
+    case cmd::dont:
+        if (m_local.test(option)) {
+            m_local.reset(option);
+            write_socket(negotiation(cmd::wont, option));
+        }
+        break;
+    case cmd::will:
+        if (!remote) {
+            write_socket(negotiation(cmd::dont, option));
+            break;
+        }
+        if (!m_remote.test(option)) {
+            m_remote.set(option);
+            write_socket(negotiation(cmd::do_, option));
+        }
+        if (option == opt::binary) {
+            m_telnet.binary(true);
+        }
+        break;
+    case cmd::wont:
+        if (m_remote.test(option)) {
+            m_remote.reset(option);
+            write_socket(negotiation(cmd::dont, option));
+        }
+        if (option == opt::binary) {
+            m_telnet.binary(false);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+
+auto port_connection::on_com_port(std::string_view payload) -> void
+{
+    using telnet::com_port;
+
+    if (payload.empty() || !m_port_id) {
+        return;
+    }
+    auto command = static_cast<com_port>(payload.front());
+    auto value = payload.substr(1);
+    auto byte = value.empty() ? std::uint8_t{0}
+                              : static_cast<std::uint8_t>(value.front());
+    auto ec = sys::error_code{};
+
+    APSN_LOG_TRACE("port_connection::on_com_port {} {}",
+            static_cast<int>(command), value.size());
+
+    switch (command) {
+    case com_port::signature:
+        if (value.empty()) {
+            reply(command, fmt::format("webserial {}", m_device));
+        }
+        break;
+
+    case com_port::set_baudrate: {
+        if (value.size() != 4) {
+            break;
+        }
+        if (auto requested = from_be32(value); requested != 0) {
+            m_serial.set_option(boost_serial::baud_rate{requested}, ec);
+            if (!ec) {
+                m_ctx->ports.set_speed(*m_port_id, requested);
+            }
+        }
+        auto current = boost_serial::baud_rate{};
+        m_serial.get_option(current, ec);
+        reply(command, to_be32(current.value()));
+        break;
+    }
+
+    case com_port::set_datasize: {
+        if (byte >= 5 && byte <= 8) {
+            m_serial.set_option(boost_serial::character_size{byte}, ec);
+            if (!ec) {
+                m_ctx->ports.set_character_size(*m_port_id, byte);
+            }
+        }
+        auto current = boost_serial::character_size{};
+        m_serial.get_option(current, ec);
+        reply(command, std::string(1, static_cast<char>(current.value())));
+        break;
+    }
+
+    case com_port::set_parity: {
+        /* Mark and space parity are not supported */
+        if (byte >= 1 && byte <= 3) {
+            auto requested = byte == 1 ? parity::none
+                           : byte == 2 ? parity::odd
+                           : parity::even;
+            m_serial.set_option(boost_serial::parity{boost_cast(requested)}, ec);
+            if (!ec) {
+                m_ctx->ports.set_parity(*m_port_id, requested);
+            }
+        }
+        auto current = boost_serial::parity{};
+        m_serial.get_option(current, ec);
+        auto code = current.value() == boost_serial::parity::odd  ? 2
+                  : current.value() == boost_serial::parity::even ? 3
+                  : 1;
+        reply(command, std::string(1, static_cast<char>(code)));
+        break;
+    }
+
+    case com_port::set_stopsize: {
+        if (byte >= 1 && byte <= 3) {
+            auto requested = byte == 1 ? stop_bits::one
+                           : byte == 2 ? stop_bits::two
+                           : stop_bits::onepointfive;
+            m_serial.set_option(
+                    boost_serial::stop_bits{boost_cast(requested)}, ec);
+            if (!ec) {
+                m_ctx->ports.set_stop_bits(*m_port_id, requested);
+            }
+        }
+        auto current = boost_serial::stop_bits{};
+        m_serial.get_option(current, ec);
+        auto code = current.value() == boost_serial::stop_bits::two ? 2
+                  : current.value() == boost_serial::stop_bits::onepointfive ? 3
+                  : 1;
+        reply(command, std::string(1, static_cast<char>(code)));
+        break;
+    }
+
+    case com_port::set_control:
+        reply(command, std::string(1, static_cast<char>(on_control(byte))));
+        break;
+
+    case com_port::notify_modemstate:
+        /* Clients such as pyserial poll with this */
+        reply(command, std::string(1, static_cast<char>(modem_state())));
+        break;
+
+    case com_port::flowcontrol_suspend:
+        m_suspended = true;
+        break;
+
+    case com_port::flowcontrol_resume:
+        m_suspended = false;
+        read_serial();
+        break;
+
+    case com_port::set_linestate_mask:
+    case com_port::set_modemstate_mask:
+        /* State changes are not pushed, so the masks only need agreeing */
+        reply(command, value);
+        break;
+
+    case com_port::purge_data: {
+        auto queue = byte == 1 ? TCIFLUSH
+                   : byte == 2 ? TCOFLUSH
+                   : TCIOFLUSH;
+        ::tcflush(m_serial.native_handle(), queue);
+        reply(command, value);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+
+auto port_connection::on_control(std::uint8_t value) -> std::uint8_t
+{
+    auto fd = m_serial.native_handle();
+    auto lines = 0;
+    auto set_line = [fd](int line, bool on) {
+        ::ioctl(fd, on ? TIOCMBIS : TIOCMBIC, &line);
+    };
+
+    switch (value) {
+    case 0: {
+        auto current = boost_serial::flow_control{};
+        auto ec = sys::error_code{};
+        m_serial.get_option(current, ec);
+        return current.value() == boost_serial::flow_control::software ? 2
+             : current.value() == boost_serial::flow_control::hardware ? 3
+             : 1;
+    }
+    case 1:
+    case 2:
+    case 3: {
+        auto requested = value == 1 ? flow_control::none
+                       : value == 2 ? flow_control::software
+                       : flow_control::hardware;
+        auto ec = sys::error_code{};
+        m_serial.set_option(
+                boost_serial::flow_control{boost_cast(requested)}, ec);
+        if (ec) {
+            return on_control(0);
+        }
+        m_ctx->ports.set_flow_control(*m_port_id, requested);
+        return value;
+    }
+    case 4:
+        return m_break ? 5 : 6;
+    case 5:
+    case 6:
+        m_break = value == 5;
+        ::ioctl(fd, m_break ? TIOCSBRK : TIOCCBRK);
+        return value;
+    case 7:
+        ::ioctl(fd, TIOCMGET, &lines);
+        return (lines & TIOCM_DTR) ? 8 : 9;
+    case 8:
+    case 9:
+        set_line(TIOCM_DTR, value == 8);
+        return value;
+    case 10:
+        ::ioctl(fd, TIOCMGET, &lines);
+        return (lines & TIOCM_RTS) ? 11 : 12;
+    case 11:
+    case 12:
+        set_line(TIOCM_RTS, value == 11);
+        return value;
+    default:
+        /* Inbound flow control, and DCD/DSR flow control, are not supported */
+        return value;
+    }
+}
+
+
+auto port_connection::modem_state() -> std::uint8_t
+{
+    auto lines = 0;
+    if (::ioctl(m_serial.native_handle(), TIOCMGET, &lines) != 0) {
+        return 0;
+    }
+    return static_cast<std::uint8_t>(
+        ((lines & TIOCM_CAR) ? 0x80 : 0) |
+        ((lines & TIOCM_RNG) ? 0x40 : 0) |
+        ((lines & TIOCM_DSR) ? 0x20 : 0) |
+        ((lines & TIOCM_CTS) ? 0x10 : 0));
+}
+
+
+auto port_connection::reply(telnet::com_port command, std::string_view value)
+    -> void
+{
+    auto payload = std::string(1, static_cast<char>(
+            static_cast<std::uint8_t>(command) + telnet::server_offset));
+    payload += value;
+    write_socket(telnet::subnegotiation(telnet::option::com_port, payload));
+}
+
+
+
+
+port_listener::port_listener(std::shared_ptr<context> ctx,
+        tcp::endpoint endpoint,
+        port_protocol protocol,
+        std::optional<std::size_t> port_id)
+    : m_ctx{std::move(ctx)}
+    , m_acceptor{m_ctx->ioc}
+    , m_protocol{protocol}
+    , m_port_id{port_id}
+{
+    auto ec = sys::error_code{};
+    auto fail = [this, &ec, &endpoint](char const * what) {
+        apsn::log::error("{} listener on {}:{}: {} {}",
+                to_string(m_protocol),
+                endpoint.address().to_string(),
+                endpoint.port(),
+                what,
+                ec.message());
+        m_acceptor.close(ec);
+    };
+
+    if (apsn::http::adopt_inherited(m_acceptor, endpoint, ec)) {
+        if (ec) {
+            fail("assign");
+        }
+        return;
+    }
+
+    m_acceptor.open(endpoint.protocol(), ec);
+    if (ec) {
+        fail("open");
+        return;
+    }
+    m_acceptor.set_option(asio::socket_base::reuse_address(true), ec);
+    if (ec) {
+        fail("set_option");
+        return;
+    }
+    m_acceptor.bind(endpoint, ec);
+    if (ec) {
+        fail("bind");
+        return;
+    }
+    m_acceptor.listen(asio::socket_base::max_listen_connections, ec);
+    if (ec) {
+        fail("listen");
+        return;
+    }
+}
+
+
+auto port_listener::run() -> void
+{
+    if (m_acceptor.is_open()) {
+        accept();
+    }
+}
+
+
+auto port_listener::close() -> void
+{
+    asio::post(m_ctx->ioc, [self = shared_from_this()] {
+        auto ec = sys::error_code{};
+        self->m_acceptor.close(ec);
+    });
+}
+
+
+auto port_listener::accept() -> void
+{
+    /* Connections live on the serial IO context, beside their port */
+    auto self = shared_from_this();
+    m_acceptor.async_accept(m_ctx->ioc,
+        [self](sys::error_code ec, tcp::socket socket) {
+            if (ec == asio::error::operation_aborted) {
+                return;
+            }
+            if (ec) {
+                apsn::log::error("{} accept: {}",
+                        to_string(self->m_protocol), ec.message());
+            }
+            else {
+                auto ec = sys::error_code{};
+                socket.set_option(tcp::no_delay(true), ec);
+                std::make_shared<port_connection>(std::move(socket),
+                        self->m_ctx,
+                        self->m_protocol)->start(self->m_port_id);
+            }
+            self->accept();
+        });
+}
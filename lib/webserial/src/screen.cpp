@@ -0,0 +1,841 @@
+#include "screen.hpp"
+
+#include <apsn/ansi.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+
+namespace ansi = apsn::ansi;
+
+using smux::screen;
+
+
+namespace {
+
+constexpr auto replacement = char32_t{0xfffd};
+
+/* Parameters larger than any screen, so that arithmetic on them is safe */
+constexpr auto max_param = 65535u;
+
+auto append_utf8(char32_t ch, std::string & out) -> void
+{
+    if (ch < 0x80) {
+        out.push_back(static_cast<char>(ch));
+    }
+    else if (ch < 0x800) {
+        out.push_back(static_cast<char>(0xc0 | (ch >> 6)));
+        out.push_back(static_cast<char>(0x80 | (ch & 0x3f)));
+    }
+    else if (ch < 0x10000) {
+        out.push_back(static_cast<char>(0xe0 | (ch >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (ch & 0x3f)));
+    }
+    else {
+        out.push_back(static_cast<char>(0xf0 | ((ch >> 18) & 0x07)));
+        out.push_back(static_cast<char>(0x80 | ((ch >> 12) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (ch & 0x3f)));
+    }
+}
+
+}
+
+
+screen::screen(std::size_t rows, std::size_t cols, std::size_t history)
+    : m_rows{std::max<std::size_t>(rows, 1)}
+    , m_cols{std::max<std::size_t>(cols, 1)}
+    , m_history_limit{history}
+    , m_main(m_rows, row_type(m_cols))
+    , m_bottom{m_rows - 1}
+{
+    m_params.reserve(max_params);
+}
+
+
+auto screen::feed(std::string_view data) -> void
+{
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    for (auto c : data) {
+        put(static_cast<unsigned char>(c));
+    }
+}
+
+
+auto screen::snapshot(std::size_t history) const -> std::string
+{
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    auto out = std::string{};
+    out.reserve(m_rows * (m_cols + 16));
+    out += "\x1b[0m";
+
+    /* Printed from the top, so that they scroll up out of the way */
+    auto count = std::min(history, m_history.size());
+    for (auto it = m_history.end() - static_cast<std::ptrdiff_t>(count);
+            it != m_history.end(); ++it)
+    {
+        out += *it;
+        out += "\r\n";
+    }
+
+    auto const & rows = grid();
+    for (auto row = std::size_t{0}; row < m_rows; ++row) {
+        render(rows[row], out);
+        if (row + 1 < m_rows) {
+            out += "\r\n";
+        }
+    }
+
+    /* Back from the bottom row to where the cursor was */
+    if (auto up = m_rows - 1 - m_cursor.row; up > 0) {
+        out += fmt::format("\x1b[{}{}", up, ansi::to_value(ansi::csi_final::CUU));
+    }
+    if (m_wrap_pending) {
+        /* Only printing into the last column leaves a wrap pending */
+        auto const & last = rows[m_cursor.row][m_cols - 1];
+        out += fmt::format("\x1b[{}{}", m_cols, ansi::to_value(ansi::csi_final::CHA));
+        render_sgr(last.attrs, out);
+        append_utf8(last.ch, out);
+        out += "\x1b[0m";
+    }
+    else {
+        out += fmt::format("\x1b[{}{}", m_cursor.col + 1,
+                ansi::to_value(ansi::csi_final::CHA));
+    }
+
+    if (m_attrs != attributes{}) {
+        render_sgr(m_attrs, out);
+    }
+    if (!m_cursor_visible) {
+        out += "\x1b[?25l";
+    }
+    return out;
+}
+
+
+auto screen::line(std::size_t row) const -> std::string
+{
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    auto out = std::string{};
+    if (row >= m_rows) {
+        return out;
+    }
+    for (auto const & c : grid()[row]) {
+        append_utf8(c.ch, out);
+    }
+    out.erase(out.find_last_not_of(' ') + 1);
+    return out;
+}
+
+
+auto screen::empty() const -> bool
+{
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    if (!m_history.empty()) {
+        return false;
+    }
+    return std::ranges::all_of(grid(), [](row_type const & row) {
+        return std::ranges::all_of(row, [](cell const & c) { return c == cell{}; });
+    });
+}
+
+
+auto screen::cursor() const -> position
+{
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    return m_cursor;
+}
+
+
+auto screen::history_size() const -> std::size_t
+{
+    auto lock = std::unique_lock<std::mutex>{m_mtx};
+    return m_history.size();
+}
+
+
+auto screen::put(unsigned char c) -> void
+{
+    /* Cancel and substitute abandon any sequence, and escape starts a new
+       one, or ends a string */
+    switch (ansi::c0_cast(static_cast<char>(c))) {
+    case ansi::c0::CAN:
+    case ansi::c0::SUB:
+        m_state = parse_state::ground;
+        m_continuation = 0;
+        return;
+    case ansi::c0::ESC:
+        m_continuation = 0;
+        m_state = m_state == parse_state::osc || m_state == parse_state::string
+            ? parse_state::string_escape
+            : parse_state::escape;
+        return;
+    default:
+        break;
+    }
+
+    switch (m_state) {
+    case parse_state::ground:
+        if (c < 0x20) {
+            m_continuation = 0;
+            return control(c);
+        }
+        if (c < 0x80) {
+            m_continuation = 0;
+            if (c != 0x7f) {
+                print(c);
+            }
+            return;
+        }
+        if ((c & 0xc0) == 0x80) {
+            if (m_continuation == 0) {
+                return print(replacement);
+            }
+            m_codepoint = (m_codepoint << 6) | (c & 0x3f);
+            if (--m_continuation == 0) {
+                print(m_codepoint);
+            }
+            return;
+        }
+        if ((c & 0xe0) == 0xc0) {
+            m_codepoint = c & 0x1f;
+            m_continuation = 1;
+        }
+        else if ((c & 0xf0) == 0xe0) {
+            m_codepoint = c & 0x0f;
+            m_continuation = 2;
+        }
+        else if ((c & 0xf8) == 0xf0) {
+            m_codepoint = c & 0x07;
+            m_continuation = 3;
+        }
+        else {
+            m_continuation = 0;
+            print(replacement);
+        }
+        return;
+
+    case parse_state::escape:
+        return escape(c);
+
+    case parse_state::escape_intermediate:
+        /* Character set designations and the like, which are not modelled */
+        if (c < 0x20) {
+            return control(c);
+        }
+        if (c >= 0x30) {
+            m_state = parse_state::ground;
+        }
+        return;
+
+    case parse_state::csi:
+        return csi(c);
+
+    case parse_state::osc:
+        /* xterm also ends these with BEL */
+        if (ansi::c0_cast(static_cast<char>(c)) == ansi::c0::BEL) {
+            m_state = parse_state::ground;
+        }
+        return;
+
+    case parse_state::string:
+        return;
+
+    case parse_state::string_escape:
+        if (ansi::fe_cast(static_cast<char>(c)) == ansi::fe::ST) {
+            m_state = parse_state::ground;
+            return;
+        }
+        return escape(c);
+    }
+}
+
+
+/* Obeyed wherever they appear, even part way through a sequence */
+auto screen::control(unsigned char c) -> void
+{
+    switch (ansi::c0_cast(static_cast<char>(c))) {
+    case ansi::c0::BS:
+        if (m_cursor.col > 0) {
+            --m_cursor.col;
+        }
+        m_wrap_pending = false;
+        break;
+    case ansi::c0::TAB:
+        m_cursor.col = std::min(m_cols - 1, (m_cursor.col / 8 + 1) * 8);
+        m_wrap_pending = false;
+        break;
+    case ansi::c0::LF:
+    case ansi::c0::VT:
+    case ansi::c0::FF:
+        linefeed();
+        break;
+    case ansi::c0::CR:
+        m_cursor.col = 0;
+        m_wrap_pending = false;
+        break;
+    default:
+        break;
+    }
+}
+
+
+auto screen::escape(unsigned char c) -> void
+{
+    m_state = parse_state::ground;
+
+    switch (ansi::fe_cast(static_cast<char>(c))) {
+    case ansi::fe::CSI:
+        m_state = parse_state::csi;
+        m_params.clear();
+        m_private = 0;
+        m_intermediate = false;
+        return;
+    case ansi::fe::OSC:
+        m_state = parse_state::osc;
+        return;
+    case ansi::fe::DCS:
+    case ansi::fe::APC:
+    case ansi::fe::PM:
+    case ansi::fe::SOS:
+        m_state = parse_state::string;
+        return;
+    default:
+        break;
+    }
+
+    switch (c) {
+    case '7': return save_cursor();
+    case '8': return restore_cursor();
+    case 'D': return linefeed();
+    case 'E':
+        m_cursor.col = 0;
+        return linefeed();
+    case 'M': return reverse_index();
+    case 'c': return reset();
+    default:
+        if (c < 0x20) {
+            return control(c);
+        }
+        if (c < 0x30) {
+            m_state = parse_state::escape_intermediate;
+        }
+        return;
+    }
+}
+
+
+auto screen::csi(unsigned char c) -> void
+{
+    if (c < 0x20) {
+        return control(c);
+    }
+    if (c >= '0' && c <= '9') {
+        if (m_params.empty()) {
+            m_params.push_back(0);
+        }
+        auto & value = m_params.back();
+        value = std::min(value * 10 + (c - '0'), max_param);
+        return;
+    }
+    if (c == ';' || c == ':') {
+        if (m_params.empty()) {
+            m_params.push_back(0);
+        }
+        if (m_params.size() < max_params) {
+            m_params.push_back(0);
+        }
+        return;
+    }
+    if (c >= 0x3c && c <= 0x3f) {
+        m_private = static_cast<char>(c);
+        return;
+    }
+    if (c >= 0x20 && c <= 0x2f) {
+        m_intermediate = true;
+        return;
+    }
+    if (c >= 0x40 && c <= 0x7e) {
+        m_state = parse_state::ground;
+        if (!m_intermediate) {
+            dispatch_csi(static_cast<char>(c));
+        }
+    }
+}
+
+
+auto screen::param(std::size_t index, unsigned fallback) const -> unsigned
+{
+    if (index < m_params.size() && m_params[index] != 0) {
+        return m_params[index];
+    }
+    return fallback;
+}
+
+
+auto screen::dispatch_csi(char final) -> void
+{
+    using ansi::csi_final;
+
+    auto const code = ansi::csi_cast(final);
+    if (m_private != 0 && code != csi_final::SM && code != csi_final::RM) {
+        return;
+    }
+
+    auto const n = std::size_t{param(0, 1)};
+    auto const row = m_cursor.row;
+    auto const col = m_cursor.col;
+    auto & rows = grid();
+
+    switch (code) {
+    case csi_final::CUU:
+        return move_to(row - std::min(row, n), col);
+    case csi_final::CUD:
+        return move_to(row + n, col);
+    case csi_final::CUF:
+        return move_to(row, col + n);
+    case csi_final::CUB:
+        return move_to(row, col - std::min(col, n));
+    case csi_final::CNL:
+        return move_to(row + n, 0);
+    case csi_final::CPL:
+        return move_to(row - std::min(row, n), 0);
+    case csi_final::CHA:
+    case csi_final::HPA:
+        return move_to(row, n - 1);
+    case csi_final::VPA:
+        return move_to(n - 1, col);
+    case csi_final::CUP:
+    case csi_final::HVP:
+        return move_to(param(0, 1) - 1, param(1, 1) - 1);
+
+    case csi_final::ED:
+        switch (param(0, 0)) {
+        case 0:
+            erase(row, col, m_cols - 1);
+            for (auto r = row + 1; r < m_rows; ++r) {
+                erase(r, 0, m_cols - 1);
+            }
+            break;
+        case 1:
+            for (auto r = std::size_t{0}; r < row; ++r) {
+                erase(r, 0, m_cols - 1);
+            }
+            erase(row, 0, col);
+            break;
+        case 3:
+            m_history.clear();
+            [[fallthrough]];
+        case 2:
+            for (auto r = std::size_t{0}; r < m_rows; ++r) {
+                erase(r, 0, m_cols - 1);
+            }
+            break;
+        }
+        return;
+
+    case csi_final::EL:
+        switch (param(0, 0)) {
+        case 0: return erase(row, col, m_cols - 1);
+        case 1: return erase(row, 0, col);
+        case 2: return erase(row, 0, m_cols - 1);
+        }
+        return;
+
+    case csi_final::ECH:
+        return erase(row, col, std::min(m_cols - 1, col + n - 1));
+
+    case csi_final::ICH: {
+        auto & line = rows[row];
+        auto count = std::min(n, m_cols - col);
+        std::move_backward(line.begin() + col, line.end() - count, line.end());
+        std::fill(line.begin() + col, line.begin() + col + count, blank());
+        m_wrap_pending = false;
+        return;
+    }
+    case csi_final::DCH: {
+        auto & line = rows[row];
+        auto count = std::min(n, m_cols - col);
+        std::move(line.begin() + col + count, line.end(), line.begin() + col);
+        std::fill(line.end() - count, line.end(), blank());
+        m_wrap_pending = false;
+        return;
+    }
+
+    case csi_final::IL:
+        if (row >= m_top && row <= m_bottom) {
+            scroll_down(row, m_bottom, n);
+            move_to(row, 0);
+        }
+        return;
+    case csi_final::DL:
+        if (row >= m_top && row <= m_bottom) {
+            scroll_up(row, m_bottom, n, false);
+            move_to(row, 0);
+        }
+        return;
+    case csi_final::SU:
+        return scroll_up(m_top, m_bottom, n, true);
+    case csi_final::SD:
+        return scroll_down(m_top, m_bottom, n);
+
+    case csi_final::SGR:
+        return sgr();
+    case csi_final::SM:
+        return set_mode(true);
+    case csi_final::RM:
+        return set_mode(false);
+
+    case csi_final::DECSTBM: {
+        auto top = std::size_t{param(0, 1)} - 1;
+        auto bottom = std::min(std::size_t{param(1, max_param)}, m_rows) - 1;
+        if (top < bottom) {
+            m_top = top;
+            m_bottom = bottom;
+            move_to(0, 0);
+        }
+        return;
+    }
+    case csi_final::SCP:
+        return save_cursor();
+    case csi_final::RCP:
+        return restore_cursor();
+
+    default:
+        return;
+    }
+}
+
+
+auto screen::sgr() -> void
+{
+    if (m_params.empty()) {
+        m_attrs = attributes{};
+        return;
+    }
+
+    auto & flags = m_attrs.flags;
+    for (auto ii = std::size_t{0}; ii < m_params.size(); ++ii) {
+        auto const code = m_params[ii];
+        switch (code) {
+        case 0:  m_attrs = attributes{}; break;
+        case 1:  flags |= bold; break;
+        case 2:  flags |= dim; break;
+        case 3:  flags |= italic; break;
+        case 4:
+        case 21: flags |= underline; break;
+        case 5:
+        case 6:  flags |= blink; break;
+        case 7:  flags |= inverse; break;
+        case 8:  flags |= hidden; break;
+        case 9:  flags |= strike; break;
+        case 22: flags &= ~(bold | dim); break;
+        case 23: flags &= ~italic; break;
+        case 24: flags &= ~underline; break;
+        case 25: flags &= ~blink; break;
+        case 27: flags &= ~inverse; break;
+        case 28: flags &= ~hidden; break;
+        case 29: flags &= ~strike; break;
+        case 39: m_attrs.fg = 0; break;
+        case 49: m_attrs.bg = 0; break;
+
+        case 38:
+        case 48: {
+            auto & colour = code == 38 ? m_attrs.fg : m_attrs.bg;
+            auto left = m_params.size() - ii - 1;
+            if (left >= 2 && m_params[ii + 1] == 5) {
+                colour = palette | std::min(m_params[ii + 2], 255u);
+                ii += 2;
+            }
+            else if (left >= 4 && m_params[ii + 1] == 2) {
+                colour = rgb
+                    | std::min(m_params[ii + 2], 255u) << 16
+                    | std::min(m_params[ii + 3], 255u) << 8
+                    | std::min(m_params[ii + 4], 255u);
+                ii += 4;
+            }
+            else {
+                /* Nothing after a malformed colour can be trusted */
+                return;
+            }
+            break;
+        }
+
+        default:
+            if (code >= 30 && code <= 37) {
+                m_attrs.fg = palette | (code - 30);
+            }
+            else if (code >= 40 && code <= 47) {
+                m_attrs.bg = palette | (code - 40);
+            }
+            else if (code >= 90 && code <= 97) {
+                m_attrs.fg = palette | (code - 90 + 8);
+            }
+            else if (code >= 100 && code <= 107) {
+                m_attrs.bg = palette | (code - 100 + 8);
+            }
+            break;
+        }
+    }
+}
+
+
+auto screen::set_mode(bool on) -> void
+{
+    if (m_private != '?') {
+        return;
+    }
+    for (auto mode : m_params) {
+        switch (mode) {
+        case 7:
+            m_autowrap = on;
+            m_wrap_pending = false;
+            break;
+        case 25:
+            m_cursor_visible = on;
+            break;
+        case 47:
+        case 1047:
+            use_alternate(on);
+            break;
+        case 1049:
+            if (on) {
+                m_saved_main = saved_cursor{m_cursor, m_attrs};
+                use_alternate(true);
+            }
+            else {
+                use_alternate(false);
+                m_cursor = m_saved_main.pos;
+                m_attrs = m_saved_main.attrs;
+                m_wrap_pending = false;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+
+auto screen::print(char32_t ch) -> void
+{
+    if (m_wrap_pending) {
+        m_cursor.col = 0;
+        linefeed();
+    }
+    grid()[m_cursor.row][m_cursor.col] = cell{ch, m_attrs};
+    if (m_cursor.col + 1 < m_cols) {
+        ++m_cursor.col;
+    }
+    else if (m_autowrap) {
+        m_wrap_pending = true;
+    }
+}
+
+
+auto screen::linefeed() -> void
+{
+    m_wrap_pending = false;
+    if (m_cursor.row == m_bottom) {
+        scroll_up(m_top, m_bottom, 1, true);
+    }
+    else if (m_cursor.row + 1 < m_rows) {
+        ++m_cursor.row;
+    }
+}
+
+
+auto screen::reverse_index() -> void
+{
+    m_wrap_pending = false;
+    if (m_cursor.row == m_top) {
+        scroll_down(m_top, m_bottom, 1);
+    }
+    else if (m_cursor.row > 0) {
+        --m_cursor.row;
+    }
+}
+
+
+/* Rows are swapped rather than copied, so scrolling costs a few pointer
+   moves and clearing the rows which come in at the bottom */
+auto screen::scroll_up(std::size_t top,
+        std::size_t bottom,
+        std::size_t count,
+        bool keep) -> void
+{
+    auto & rows = grid();
+    count = std::min(count, bottom - top + 1);
+
+    /* Only whole screen scrolls on the main screen reach the history, as
+       on xterm */
+    if (keep && top == 0 && !m_alternate && m_history_limit > 0) {
+        for (auto ii = std::size_t{0}; ii < count; ++ii) {
+            auto & line = m_history.emplace_back();
+            render(rows[ii], line);
+        }
+        while (m_history.size() > m_history_limit) {
+            m_history.pop_front();
+        }
+    }
+
+    auto first = rows.begin() + static_cast<std::ptrdiff_t>(top);
+    auto last = rows.begin() + static_cast<std::ptrdiff_t>(bottom + 1);
+    std::rotate(first, first + static_cast<std::ptrdiff_t>(count), last);
+    for (auto it = last - static_cast<std::ptrdiff_t>(count); it != last; ++it) {
+        std::fill(it->begin(), it->end(), blank());
+    }
+}
+
+
+auto screen::scroll_down(std::size_t top, std::size_t bottom, std::size_t count)
+    -> void
+{
+    auto & rows = grid();
+    count = std::min(count, bottom - top + 1);
+
+    auto first = rows.begin() + static_cast<std::ptrdiff_t>(top);
+    auto last = rows.begin() + static_cast<std::ptrdiff_t>(bottom + 1);
+    std::rotate(first, last - static_cast<std::ptrdiff_t>(count), last);
+    for (auto it = first; it != first + static_cast<std::ptrdiff_t>(count); ++it) {
+        std::fill(it->begin(), it->end(), blank());
+    }
+}
+
+
+auto screen::move_to(std::size_t row, std::size_t col) -> void
+{
+    m_cursor.row = std::min(row, m_rows - 1);
+    m_cursor.col = std::min(col, m_cols - 1);
+    m_wrap_pending = false;
+}
+
+
+auto screen::erase(std::size_t row, std::size_t first, std::size_t last) -> void
+{
+    auto & line = grid()[row];
+    last = std::min(last, m_cols - 1);
+    if (first > last) {
+        return;
+    }
+    std::fill(line.begin() + static_cast<std::ptrdiff_t>(first),
+            line.begin() + static_cast<std::ptrdiff_t>(last + 1),
+            blank());
+    m_wrap_pending = false;
+}
+
+
+/* Erased cells take the current background, as on xterm */
+auto screen::blank() const -> cell
+{
+    return cell{U' ', attributes{0, m_attrs.bg, 0}};
+}
+
+
+auto screen::save_cursor() -> void
+{
+    m_saved = saved_cursor{m_cursor, m_attrs};
+}
+
+
+auto screen::restore_cursor() -> void
+{
+    move_to(m_saved.pos.row, m_saved.pos.col);
+    m_attrs = m_saved.attrs;
+}
+
+
+auto screen::use_alternate(bool on) -> void
+{
+    if (on && !m_alternate) {
+        m_alternate.emplace(m_rows, row_type(m_cols));
+    }
+    else if (!on) {
+        m_alternate.reset();
+    }
+}
+
+
+/* As RIS; the history is kept, as xterm keeps its scrollback */
+auto screen::reset() -> void
+{
+    for (auto & line : m_main) {
+        std::fill(line.begin(), line.end(), cell{});
+    }
+    m_alternate.reset();
+    m_cursor = position{0, 0};
+    m_attrs = attributes{};
+    m_wrap_pending = false;
+    m_autowrap = true;
+    m_cursor_visible = true;
+    m_top = 0;
+    m_bottom = m_rows - 1;
+    m_saved = saved_cursor{};
+    m_saved_main = saved_cursor{};
+}
+
+
+auto screen::render(row_type const & row, std::string & out) -> void
+{
+    auto last = row.size();
+    while (last > 0 && row[last - 1] == cell{}) {
+        --last;
+    }
+
+    auto current = attributes{};
+    for (auto ii = std::size_t{0}; ii < last; ++ii) {
+        auto const & c = row[ii];
+        if (c.attrs != current) {
+            render_sgr(c.attrs, out);
+            current = c.attrs;
+        }
+        append_utf8(c.ch, out);
+    }
+    if (current != attributes{}) {
+        out += "\x1b[0m";
+    }
+}
+
+
+auto screen::render_sgr(attributes const & attrs, std::string & out) -> void
+{
+    constexpr auto flag_codes = std::array<std::pair<std::uint8_t, char>, 8>{{
+        {bold, '1'}, {dim, '2'}, {italic, '3'}, {underline, '4'},
+        {blink, '5'}, {inverse, '7'}, {hidden, '8'}, {strike, '9'}
+    }};
+
+    out += "\x1b[0";
+    for (auto [bit, code] : flag_codes) {
+        if (attrs.flags & bit) {
+            out += ';';
+            out += code;
+        }
+    }
+
+    /* `base` is 30 or 40; bright colours are 60 above, others extended */
+    auto colour = [&out](std::uint32_t value, unsigned base) {
+        auto const index = value & 0xffffff;
+        if ((value & ~0xffffffu) == palette) {
+            if (index < 8) {
+                out += fmt::format(";{}", base + index);
+            }
+            else if (index < 16) {
+                out += fmt::format(";{}", base + 60 + index - 8);
+            }
+            else {
+                out += fmt::format(";{};5;{}", base + 8, index);
+            }
+        }
+        else if ((value & ~0xffffffu) == rgb) {
+            out += fmt::format(";{};2;{};{};{}", base + 8,
+                    (index >> 16) & 0xff, (index >> 8) & 0xff, index & 0xff);
+        }
+    };
+    colour(attrs.fg, 30);
+    colour(attrs.bg, 40);
+    out += ansi::to_value(ansi::csi_final::SGR);
+}
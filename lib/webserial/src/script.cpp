@@ -0,0 +1,561 @@
+#include "script.hpp"
+
+#include "context.hpp"
+#include "error.hpp"
+#include "port.hpp"
+#include "serial.hpp"
+
+#include <apsn/logging.hpp>
+#include <apsn/metrics.hpp>
+
+#include <apsn/http/coroutine.hpp>
+
+#include <boost/asio.hpp>
+#include <boost/asio/serial_port.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <string>
+
+
+using smux::broadcast_job;
+using smux::script;
+using smux::script_job;
+using smux::script_state;
+using smux::scripts_holder;
+
+namespace sys = boost::system;
+
+
+namespace {
+
+auto bad_script(std::string_view why) -> smux::error
+{
+    apsn::log::warn("Rejected script: {}", why);
+    return smux::error::bad_script;
+}
+
+
+/* Frees a port claimed for a script. The port table may have been rescanned
+   since it was claimed. */
+auto release(smux::context & ctx, std::size_t port_id, std::string const & device)
+    -> void
+{
+    auto port_lock = ctx.ports.lock();
+    auto port = ctx.ports.get_port(port_id);
+    if (port && port->device == device) {
+        port->in_use = false;
+        port->open = nullptr;
+    }
+}
+
+
+/**
+ * Runs a script's steps in one loop on the serial IO context. Each step is
+ * bounded by a timer, which cancels the port's outstanding operation when
+ * it expires.
+ */
+class script_runner : public std::enable_shared_from_this<script_runner>
+{
+public:
+    using boost_serial_port = boost::asio::serial_port;
+
+    script_runner(std::shared_ptr<smux::context> ctx,
+            std::size_t job_id,
+            std::size_t port_id,
+            smux::port & info,
+            boost_serial_port && serial_port,
+            script script_)
+        : m_ctx{std::move(ctx)}
+        , m_job_id{job_id}
+        , m_port_id{port_id}
+        , m_device{info.device}
+        , m_screen{info.screen}
+        , m_triggers{m_ctx->triggers.set}
+        , m_port{std::move(serial_port)}
+        , m_deadline{m_port.get_executor()}
+        , m_script{std::move(script_)}
+        , m_rx_bytes{apsn::metrics::default_registry().counter(
+            "serial_rx_bytes_total", "Bytes read from serial ports",
+            {{"port", m_device}})}
+        , m_tx_bytes{apsn::metrics::default_registry().counter(
+            "serial_tx_bytes_total", "Bytes written to serial ports",
+            {{"port", m_device}})}
+    {}
+
+    auto serial() -> boost_serial_port *
+    { return &m_port; }
+
+    auto run(std::shared_ptr<script_runner>) -> asio::awaitable<void>;
+
+private:
+    auto start_step(std::size_t index) -> void;
+    auto on_output(std::string_view data) -> void;
+    auto finish(script_state state, std::string what) -> void;
+
+    std::shared_ptr<smux::context> m_ctx;
+    std::size_t m_job_id;
+    std::size_t m_port_id;
+    std::string m_device;
+    std::shared_ptr<smux::screen> m_screen;
+    smux::trigger_matcher m_triggers;
+    boost_serial_port m_port;
+    asio::steady_timer m_deadline;
+    script m_script;
+
+    std::array<char, 4096> m_buffer;
+
+    /* Read, but after the last match */
+    std::string m_pending;
+    std::size_t m_step = 0;
+    bool m_timed_out = false;
+    std::chrono::steady_clock::time_point m_started;
+
+    apsn::metrics::counter & m_rx_bytes;
+    apsn::metrics::counter & m_tx_bytes;
+};
+
+
+auto script_runner::run(std::shared_ptr<script_runner> self)
+    -> asio::awaitable<void>
+{
+    using apsn::http::with_error;
+    using kind = smux::script_step::kind;
+
+    m_started = std::chrono::steady_clock::now();
+    auto ec = sys::error_code{};
+
+    for (auto index = std::size_t{0}; index < m_script.steps.size(); ++index) {
+        auto const & step = m_script.steps[index];
+        start_step(index);
+
+        m_timed_out = false;
+        m_deadline.expires_after(step.timeout);
+        m_deadline.async_wait([self, index](sys::error_code ec) {
+            /* Expiry may already be queued when a step completes */
+            if (!ec && self->m_step == index) {
+                self->m_timed_out = true;
+                self->m_port.cancel(ec);
+            }
+        });
+
+        if (step.type == kind::send) {
+            auto sent = co_await asio::async_write(m_port,
+                    asio::buffer(*step.text), with_error(ec));
+            m_tx_bytes.add(sent);
+        }
+        else if (step.type == kind::wait) {
+            m_pending.clear();
+
+            /* As for `expect`, a read may complete as the deadline passes */
+            while (!ec && !m_timed_out) {
+                auto read = co_await m_port.async_read_some(
+                        asio::buffer(m_buffer), with_error(ec));
+                if (!ec) {
+                    on_output({m_buffer.data(), read});
+                }
+            }
+            if (m_timed_out) {
+                ec = {};
+            }
+        }
+        else {
+            auto matcher = smux::trigger_matcher{step.pattern};
+            while (true) {
+                auto found = matcher.find(m_pending);
+                if (found.pattern) {
+                    m_pending.erase(0, found.consumed);
+                    break;
+                }
+                m_pending.clear();
+
+                /* A read which completed as the deadline passed was not
+                   cancelled, so the next one would have no deadline */
+                if (m_timed_out) {
+                    ec = asio::error::operation_aborted;
+                    break;
+                }
+                auto read = co_await m_port.async_read_some(
+                        asio::buffer(m_buffer), with_error(ec));
+                if (ec) {
+                    break;
+                }
+                m_pending.assign(m_buffer.data(), read);
+                on_output(m_pending);
+            }
+        }
+        m_deadline.cancel();
+        if (ec) {
+            co_return m_timed_out
+                ? finish(script_state::timed_out, "Timed out")
+                : finish(script_state::error, ec.message());
+        }
+    }
+    finish(script_state::passed, {});
+}
+
+
+auto script_runner::start_step(std::size_t index) -> void
+{
+    m_step = index;
+
+    auto lock = m_ctx->scripts.lock();
+    auto & job = m_ctx->scripts.jobs.at(m_job_id);
+    if (index > 0) {
+        job.finished.push_back(
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - m_started));
+    }
+    job.step = index;
+}
+
+
+/* As a session would, so that whoever attaches next sees it */
+auto script_runner::on_output(std::string_view data) -> void
+{
+    m_rx_bytes.add(data.size());
+    m_screen->feed(data);
+    m_ctx->triggers.record(m_device, m_triggers.feed(data));
+
+    auto lock = m_ctx->scripts.lock();
+    m_ctx->scripts.jobs.at(m_job_id).append(data);
+}
+
+
+auto script_runner::finish(script_state state, std::string what) -> void
+{
+    auto ec = sys::error_code{};
+    m_port.close(ec);
+    release(*m_ctx, m_port_id, m_device);
+
+    auto lock = m_ctx->scripts.lock();
+    auto & job = m_ctx->scripts.jobs.at(m_job_id);
+    if (state == script_state::passed) {
+        job.finished.push_back(
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - m_started));
+    }
+    job.state = state;
+    job.error = std::move(what);
+
+    apsn::log::info("Script {} on {} {} at step {}",
+            m_job_id, m_device, to_string(state), job.step);
+}
+
+
+/* Opening a tty can block, so it is done here, on the serial IO context,
+   once the request has claimed the port */
+auto start_script(std::shared_ptr<smux::context> ctx,
+        std::size_t job_id,
+        std::size_t port_id,
+        std::string const & device,
+        script script_) -> void
+{
+    auto fail = [&](std::string what) {
+        apsn::log::error("Could not open {} for script {}: {}",
+                device, job_id, what);
+        release(*ctx, port_id, device);
+
+        auto lock = ctx->scripts.lock();
+        auto & job = ctx->scripts.jobs.at(job_id);
+        job.state = script_state::error;
+        job.error = std::move(what);
+    };
+
+    auto port_lock = ctx->ports.lock();
+    auto info = ctx->ports.get_port(port_id);
+    if (!info || info->device != device) {
+        port_lock.unlock();
+        return fail("Port has gone");
+    }
+    auto serial_port = smux::serial::open(ctx->ioc.get_executor(), *info);
+    if (!serial_port) {
+        port_lock.unlock();
+        return fail(serial_port.error_message());
+    }
+
+    auto runner = std::make_shared<script_runner>(ctx,
+            job_id,
+            port_id,
+            *info,
+            std::move(*serial_port),
+            std::move(script_));
+    info->open = runner->serial();
+    port_lock.unlock();
+
+    asio::co_spawn(ctx->ioc, runner->run(runner), apsn::http::rethrow);
+}
+
+}
+
+
+auto smux::to_string(script_state value) -> std::string
+{
+    switch (value) {
+    case script_state::running:   return "running";
+    case script_state::passed:    return "passed";
+    case script_state::timed_out: return "timed_out";
+    case script_state::error:     return "error";
+    default: return "<unknown>";
+    }
+}
+
+
+auto script::parse(std::string_view json) -> apsn::result<script>
+{
+    auto body = nlohmann::json::parse(json, nullptr, false);
+    if (body.is_discarded() || !body.is_object()) {
+        return bad_script("not a JSON object");
+    }
+
+    auto timeout_of = [](nlohmann::json const & object,
+            std::chrono::milliseconds fallback)
+        -> std::optional<std::chrono::milliseconds>
+    {
+        auto it = object.find("timeout");
+        if (it == object.end()) {
+            return fallback;
+        }
+        if (!it->is_number_unsigned() || it->get<std::uint64_t>() == 0
+                || it->get<std::uint64_t>() > static_cast<std::uint64_t>(
+                    max_timeout.count()))
+        {
+            return std::nullopt;
+        }
+        return std::chrono::milliseconds{it->get<std::uint64_t>()};
+    };
+
+    auto fallback = timeout_of(body, default_timeout);
+    if (!fallback) {
+        return bad_script("bad default timeout");
+    }
+
+    auto steps = body.find("steps");
+    if (steps == body.end() || !steps->is_array() || steps->empty()) {
+        return bad_script("no steps");
+    }
+    if (steps->size() > max_steps) {
+        return bad_script("too many steps");
+    }
+
+    auto parsed = script{};
+    for (auto const & entry : *steps) {
+        if (!entry.is_object()) {
+            return bad_script("step is not an object");
+        }
+        auto timeout = timeout_of(entry, *fallback);
+        if (!timeout) {
+            return bad_script("bad step timeout");
+        }
+
+        auto send = entry.find("send");
+        auto expect = entry.find("expect");
+        auto wait = entry.find("wait");
+        auto kinds = (send != entry.end()) + (expect != entry.end())
+            + (wait != entry.end());
+        if (kinds != 1) {
+            return bad_script("step must have one of send, expect or wait");
+        }
+
+        if (wait != entry.end()) {
+            auto length = nlohmann::json{{"timeout", *wait}};
+            auto duration = timeout_of(length, *fallback);
+            if (!duration) {
+                return bad_script("bad wait");
+            }
+            parsed.steps.push_back({script_step::kind::wait,
+                    nullptr, nullptr, *duration});
+            continue;
+        }
+
+        if (send != entry.end()) {
+            if (!send->is_string()) {
+                return bad_script("send is not a string");
+            }
+            parsed.steps.push_back({script_step::kind::send,
+                    std::make_shared<std::string const>(send->get<std::string>()),
+                    nullptr,
+                    *timeout});
+            continue;
+        }
+
+        if (!expect->is_string()) {
+            return bad_script("expect is not a string");
+        }
+        auto pattern = expect->get<std::string>();
+        auto compiled = trigger_set::compile({{"expect", pattern}});
+        if (!compiled) {
+            return bad_script("bad pattern");
+        }
+        parsed.steps.push_back({script_step::kind::expect,
+                std::make_shared<std::string const>(std::move(pattern)),
+                *compiled.value,
+                *timeout});
+    }
+    return parsed;
+}
+
+
+/* The same checks as a script's steps, by building one */
+auto script::parse_broadcast(std::string_view json) -> apsn::result<script>
+{
+    auto body = nlohmann::json::parse(json, nullptr, false);
+    if (body.is_discarded() || !body.is_object()) {
+        return bad_script("not a JSON object");
+    }
+    auto send = body.find("send");
+    if (send == body.end()) {
+        return bad_script("nothing to send");
+    }
+
+    auto window = body.value("window", nlohmann::json(
+            static_cast<std::uint64_t>(default_window.count())));
+    auto steps = nlohmann::json::array({{{"send", *send}, {"timeout", window}}});
+    if (auto until = body.find("until"); until != body.end()) {
+        steps.push_back({{"expect", *until}, {"timeout", window}});
+    }
+    else {
+        steps.push_back({{"wait", window}});
+    }
+    return parse(nlohmann::json{{"steps", steps}}.dump());
+}
+
+
+auto script_job::append(std::string_view output) -> void
+{
+    transcript.append(output);
+
+    /* Trimmed in batches, rather than on every read */
+    if (transcript.size() > max_transcript + max_transcript / 4) {
+        transcript.erase(0, transcript.size() - max_transcript);
+        truncated = true;
+    }
+}
+
+
+auto scripts_holder::add(std::size_t port_id, std::string device, std::size_t steps)
+    -> std::size_t
+{
+    auto lock = this->lock();
+
+    auto finished = std::ranges::count_if(jobs, [](auto const & entry) {
+        return entry.second.state != script_state::running;
+    });
+    for (auto it = jobs.begin(); it != jobs.end()
+            && finished >= static_cast<std::ptrdiff_t>(max_finished);)
+    {
+        if (it->second.state == script_state::running) {
+            ++it;
+            continue;
+        }
+        it = jobs.erase(it);
+        --finished;
+    }
+
+    auto id = next_id++;
+    auto job = script_job{};
+    job.id = id;
+    job.port_id = port_id;
+    job.device = std::move(device);
+    job.steps = steps;
+    job.started = std::chrono::system_clock::now();
+    jobs.emplace(id, std::move(job));
+    return id;
+}
+
+
+auto scripts_holder::get(std::size_t id) const -> std::optional<script_job>
+{
+    auto lock = this->lock();
+    auto it = jobs.find(id);
+    if (it == jobs.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+
+auto scripts_holder::add_broadcast(std::string group,
+        std::vector<broadcast_job::member> members) -> std::size_t
+{
+    auto lock = this->lock();
+    while (broadcasts.size() >= max_broadcasts) {
+        broadcasts.erase(broadcasts.begin());
+    }
+    auto id = next_broadcast++;
+    broadcasts.emplace(id, broadcast_job{id, std::move(group), std::move(members)});
+    return id;
+}
+
+
+auto scripts_holder::get_broadcast(std::size_t id) const
+    -> std::optional<broadcast_job>
+{
+    auto lock = this->lock();
+    auto it = broadcasts.find(id);
+    if (it == broadcasts.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+
+auto scripts_holder::lock() const -> std::unique_lock<std::mutex>
+{
+    return std::unique_lock<std::mutex>{m_mtx};
+}
+
+
+auto smux::run_script(std::shared_ptr<context> ctx,
+        std::size_t port_id,
+        script script_) -> apsn::result<std::size_t>
+{
+    auto port_lock = ctx->ports.lock();
+    auto info = ctx->ports.get_port(port_id);
+    if (!info) {
+        return info.error;
+    }
+    if (info->in_use) {
+        return error::device_in_use;
+    }
+    info->in_use = true;
+    auto device = info->device;
+    port_lock.unlock();
+
+    auto steps = script_.steps.size();
+    auto job_id = ctx->scripts.add(port_id, device, steps);
+    apsn::log::info("Running script {} of {} steps on {}",
+            job_id, steps, device);
+    asio::post(ctx->ioc,
+        [ctx, job_id, port_id, device, script_ = std::move(script_)]() mutable {
+            start_script(std::move(ctx), job_id, port_id, device,
+                    std::move(script_));
+        });
+    return job_id;
+}
+
+
+auto smux::run_broadcast(std::shared_ptr<context> ctx,
+        std::string const & group,
+        script const & script_) -> apsn::result<std::size_t>
+{
+    auto port_ids = [&] {
+        auto lock = ctx->ports.lock();
+        return ctx->ports.get_group(group);
+    }();
+    if (!port_ids) {
+        return port_ids.error;
+    }
+
+    auto members = std::vector<broadcast_job::member>{};
+    for (auto port_id : *port_ids) {
+        auto job = run_script(ctx, port_id, script_);
+        members.push_back(job
+            ? broadcast_job::member{port_id, *job, {}}
+            : broadcast_job::member{port_id, std::nullopt, job.error_message()});
+    }
+
+    apsn::log::info("Broadcast to {} ports of group '{}'", members.size(), group);
+    return ctx->scripts.add_broadcast(group, std::move(members));
+}
@@ -1,6 +1,7 @@
 #include "strings.hpp"
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 
@@ -16,3 +17,74 @@ auto smux::split(std::string const & to_split, char delim)
     result.emplace_back(to_split.substr(last));
     return result;
 }
+
+
+auto smux::printable(std::string_view text) -> std::string
+{
+    auto out = std::string{};
+    out.reserve(text.size());
+
+    auto continuation = [&](std::size_t at, unsigned char low, unsigned char high) {
+        if (at >= text.size()) {
+            return false;
+        }
+        auto byte = static_cast<unsigned char>(text[at]);
+        return byte >= low && byte <= high;
+    };
+
+    for (auto ii = std::size_t{0}; ii < text.size();) {
+        auto const c = static_cast<unsigned char>(text[ii]);
+        if (c == 0x1b) {
+            ++ii;
+            if (ii < text.size() && text[ii] == '[') {
+                ++ii;
+                while (ii < text.size() && (text[ii] < 0x40 || text[ii] > 0x7e)) {
+                    ++ii;
+                }
+            }
+            ++ii;
+            continue;
+        }
+        if (c < 0x20 || c == 0x7f) {
+            if (c == '\t') {
+                out += ' ';
+            }
+            ++ii;
+            continue;
+        }
+        if (c < 0x80) {
+            out += static_cast<char>(c);
+            ++ii;
+            continue;
+        }
+
+        /* Second byte ranges exclude overlong forms and surrogates */
+        auto length = std::size_t{0};
+        if (c >= 0xc2 && c <= 0xdf) {
+            length = continuation(ii + 1, 0x80, 0xbf) ? 2 : 0;
+        }
+        else if (c >= 0xe0 && c <= 0xef) {
+            auto low = static_cast<unsigned char>(c == 0xe0 ? 0xa0 : 0x80);
+            auto high = static_cast<unsigned char>(c == 0xed ? 0x9f : 0xbf);
+            length = continuation(ii + 1, low, high)
+                && continuation(ii + 2, 0x80, 0xbf) ? 3 : 0;
+        }
+        else if (c >= 0xf0 && c <= 0xf4) {
+            auto low = static_cast<unsigned char>(c == 0xf0 ? 0x90 : 0x80);
+            auto high = static_cast<unsigned char>(c == 0xf4 ? 0x8f : 0xbf);
+            length = continuation(ii + 1, low, high)
+                && continuation(ii + 2, 0x80, 0xbf)
+                && continuation(ii + 3, 0x80, 0xbf) ? 4 : 0;
+        }
+
+        if (length == 0) {
+            out += "\xef\xbf\xbd";
+            ++ii;
+        }
+        else {
+            out.append(text.substr(ii, length));
+            ii += length;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,143 @@
+#include "telnet.hpp"
+
+#include <string>
+#include <string_view>
+
+
+using smux::telnet::decoder;
+
+
+decoder::decoder(handlers h)
+    : m_handlers{std::move(h)}
+{
+    m_data.reserve(4096);
+}
+
+
+auto decoder::feed(std::string_view bytes) -> void
+{
+    for (auto ch : bytes) {
+        auto byte = static_cast<std::uint8_t>(ch);
+        switch (m_state) {
+        case state::data:
+            if (byte == cmd::iac) {
+                m_state = state::iac;
+                break;
+            }
+            if (!m_binary && m_after_cr && byte == 0) {
+                m_after_cr = false;
+                break;
+            }
+            m_after_cr = byte == '\r';
+            m_data.push_back(ch);
+            break;
+
+        case state::iac:
+            m_state = state::data;
+            if (byte == cmd::iac) {
+                m_data.push_back(ch);
+            }
+            else if (byte >= cmd::will && byte <= cmd::dont) {
+                m_verb = byte;
+                m_state = state::negotiate;
+            }
+            else if (byte == cmd::sb) {
+                m_state = state::sb_option;
+            }
+            /* Anything else, such as NOP or a stray SE, carries no data */
+            break;
+
+        case state::negotiate:
+            flush();
+            if (m_handlers.on_negotiate) {
+                m_handlers.on_negotiate(m_verb, byte);
+            }
+            m_state = state::data;
+            break;
+
+        case state::sb_option:
+            m_sb_option = byte;
+            m_sb.clear();
+            m_state = state::sb_data;
+            break;
+
+        case state::sb_data:
+            if (byte == cmd::iac) {
+                m_state = state::sb_iac;
+            }
+            else {
+                m_sb.push_back(ch);
+            }
+            break;
+
+        case state::sb_iac:
+            if (byte == cmd::iac) {
+                m_sb.push_back(ch);
+                m_state = state::sb_data;
+            }
+            else {
+                /* SE ends the subnegotiation; anything else is malformed,
+                   and ends it too */
+                flush();
+                if (m_handlers.on_subnegotiate) {
+                    m_handlers.on_subnegotiate(m_sb_option, m_sb);
+                }
+                m_state = state::data;
+            }
+            break;
+        }
+    }
+    flush();
+}
+
+
+auto decoder::flush() -> void
+{
+    if (m_data.empty()) {
+        return;
+    }
+    if (m_handlers.on_data) {
+        m_handlers.on_data(m_data);
+    }
+    m_data.clear();
+}
+
+
+auto smux::telnet::escape(std::string_view data) -> std::string
+{
+    auto escaped = std::string{};
+    escaped.reserve(data.size());
+    for (auto ch : data) {
+        escaped.push_back(ch);
+        if (static_cast<std::uint8_t>(ch) == cmd::iac) {
+            escaped.push_back(ch);
+        }
+    }
+    return escaped;
+}
+
+
+auto smux::telnet::negotiation(std::uint8_t verb, std::uint8_t option)
+    -> std::string
+{
+    return {
+        static_cast<char>(cmd::iac),
+        static_cast<char>(verb),
+        static_cast<char>(option)
+    };
+}
+
+
+auto smux::telnet::subnegotiation(std::uint8_t option, std::string_view payload)
+    -> std::string
+{
+    auto message = std::string{
+        static_cast<char>(cmd::iac),
+        static_cast<char>(cmd::sb),
+        static_cast<char>(option)
+    };
+    message += escape(payload);
+    message.push_back(static_cast<char>(cmd::iac));
+    message.push_back(static_cast<char>(cmd::se));
+    return message;
+}
@@ -0,0 +1,497 @@
+#include "triggers.hpp"
+
+#include "error.hpp"
+#include "strings.hpp"
+
+#include <apsn/logging.hpp>
+#include <apsn/metrics.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <limits>
+
+
+using smux::trigger_matcher;
+using smux::trigger_set;
+using smux::triggers_holder;
+
+
+namespace {
+
+/* Literals shorter than this match too often to be worth filtering on */
+constexpr auto min_literal = std::size_t{2};
+
+constexpr auto none = std::numeric_limits<std::uint32_t>::max();
+
+
+struct extracted
+{
+    std::string literal;
+
+    /* No metacharacters at all, so the literal is the pattern */
+    bool plain;
+};
+
+
+/* The longest run of characters which every match must contain, found
+   conservatively: anything inside a group, class or quantified is left
+   out, and alternation at the top level gives up altogether */
+auto extract_literal(std::string_view pattern) -> extracted
+{
+    auto best = std::string{};
+    auto run = std::string{};
+    auto plain = true;
+    auto depth = 0;
+    auto last_single = false;
+
+    auto flush = [&] {
+        if (run.size() > best.size()) {
+            best = run;
+        }
+        run.clear();
+        last_single = false;
+    };
+
+    for (auto ii = std::size_t{0}; ii < pattern.size(); ++ii) {
+        auto const c = pattern[ii];
+        switch (c) {
+        case '\\': {
+            plain = false;
+            if (ii + 1 >= pattern.size()) {
+                break;
+            }
+            auto const escaped = pattern[++ii];
+            if (std::ispunct(static_cast<unsigned char>(escaped)) && depth == 0) {
+                run += escaped;
+                last_single = true;
+                break;
+            }
+            flush();
+            /* Skip the operands of numeric escapes, which are not literal */
+            auto skip = std::size_t{0};
+            switch (escaped) {
+            case 'x': skip = 2; break;
+            case 'u': skip = 4; break;
+            case 'c': skip = 1; break;
+            default:
+                while (std::isdigit(static_cast<unsigned char>(escaped))
+                        && ii + skip + 1 < pattern.size()
+                        && std::isdigit(static_cast<unsigned char>(pattern[ii + skip + 1])))
+                {
+                    ++skip;
+                }
+                break;
+            }
+            ii = std::min(ii + skip, pattern.size() - 1);
+            break;
+        }
+        case '(':
+            plain = false;
+            flush();
+            ++depth;
+            break;
+        case ')':
+            plain = false;
+            flush();
+            depth = std::max(depth - 1, 0);
+            break;
+        case '[':
+            plain = false;
+            flush();
+            ++ii;
+            if (ii < pattern.size() && pattern[ii] == '^') {
+                ++ii;
+            }
+            if (ii < pattern.size() && pattern[ii] == ']') {
+                ++ii;
+            }
+            while (ii < pattern.size() && pattern[ii] != ']') {
+                ii += pattern[ii] == '\\' ? 2 : 1;
+            }
+            break;
+        case '|':
+            if (depth == 0) {
+                return {"", false};
+            }
+            plain = false;
+            break;
+        case '*':
+        case '?':
+        case '{':
+            /* The character before may not be there at all */
+            plain = false;
+            if (last_single && !run.empty()) {
+                run.pop_back();
+            }
+            flush();
+            if (c == '{') {
+                while (ii < pattern.size() && pattern[ii] != '}') {
+                    ++ii;
+                }
+            }
+            break;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+        case ']':
+        case '}':
+            plain = false;
+            flush();
+            break;
+        default:
+            if (depth == 0) {
+                run += c;
+                last_single = true;
+            }
+            break;
+        }
+    }
+    flush();
+
+    if (plain) {
+        return {std::string{pattern}, true};
+    }
+    if (best.size() < min_literal) {
+        best.clear();
+    }
+    return {std::move(best), false};
+}
+
+
+auto is_name(std::string_view text) -> bool
+{
+    return !text.empty() && std::ranges::all_of(text, [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c))
+            || c == '_' || c == '-' || c == '.';
+    });
+}
+
+}
+
+
+auto smux::default_triggers() -> std::vector<trigger>
+{
+    return {
+        {"kernel_panic", "Kernel panic"},
+        {"call_trace", "Call Trace"}
+    };
+}
+
+
+auto smux::parse_trigger(std::string_view spec) -> trigger
+{
+    if (auto eq = spec.find('='); eq != std::string_view::npos
+            && is_name(spec.substr(0, eq)))
+    {
+        return {std::string{spec.substr(0, eq)}, std::string{spec.substr(eq + 1)}};
+    }
+    return {std::string{spec}, std::string{spec}};
+}
+
+
+auto trigger_set::compile(std::vector<trigger> triggers)
+    -> apsn::result<std::shared_ptr<trigger_set const>>
+{
+    auto set = std::shared_ptr<trigger_set>{new trigger_set{}};
+    for (auto & spec : triggers) {
+        if (spec.pattern.empty()) {
+            apsn::log::error("Trigger '{}' has an empty pattern", spec.name);
+            return error::bad_trigger;
+        }
+
+        auto [literal, plain] = extract_literal(spec.pattern);
+        auto entry = compiled{std::move(spec), std::move(literal), std::nullopt};
+        if (!plain) {
+            try {
+                entry.regex.emplace(entry.spec.pattern,
+                        std::regex::ECMAScript | std::regex::optimize);
+            }
+            catch (std::regex_error const & e) {
+                apsn::log::error("Trigger '{}': {}", entry.spec.name, e.what());
+                return error::bad_trigger;
+            }
+        }
+        if (entry.literal.empty()) {
+            apsn::log::warn("Trigger '{}' has no literal text to look for, "
+                            "so is tried on every line", entry.spec.name);
+        }
+        set->m_patterns.push_back(std::move(entry));
+    }
+    set->build();
+    return std::shared_ptr<trigger_set const>{std::move(set)};
+}
+
+
+/* The trie of literals, then failure links breadth first, which fill in
+   each missing transition from the state the failure link leads to */
+auto trigger_set::build() -> void
+{
+    m_next.assign(256, none);
+    auto out = std::vector<std::vector<std::uint32_t>>(1);
+
+    for (auto id = std::uint32_t{0}; id < m_patterns.size(); ++id) {
+        auto const & literal = m_patterns[id].literal;
+        if (literal.empty()) {
+            m_unfiltered.push_back(id);
+            continue;
+        }
+        auto state = std::uint32_t{0};
+        for (auto ch : literal) {
+            auto index = state * 256 + static_cast<unsigned char>(ch);
+            if (m_next[index] == none) {
+                m_next[index] = static_cast<std::uint32_t>(out.size());
+                out.emplace_back();
+                m_next.resize(m_next.size() + 256, none);
+            }
+            state = m_next[index];
+        }
+        out[state].push_back(id);
+    }
+
+    auto fail = std::vector<std::uint32_t>(out.size(), 0);
+    auto queue = std::deque<std::uint32_t>{};
+    for (auto byte = 0u; byte < 256; ++byte) {
+        if (m_next[byte] == none) {
+            m_next[byte] = 0;
+        }
+        else {
+            queue.push_back(m_next[byte]);
+        }
+    }
+    while (!queue.empty()) {
+        auto state = queue.front();
+        queue.pop_front();
+        for (auto byte = 0u; byte < 256; ++byte) {
+            auto & target = m_next[state * 256 + byte];
+            auto via_fail = m_next[fail[state] * 256 + byte];
+            if (target == none) {
+                target = via_fail;
+                continue;
+            }
+            fail[target] = via_fail;
+            out[target].insert(out[target].end(),
+                    out[via_fail].begin(), out[via_fail].end());
+            queue.push_back(target);
+        }
+    }
+
+    m_output_begin.clear();
+    m_outputs.clear();
+    for (auto const & ids : out) {
+        m_output_begin.push_back(static_cast<std::uint32_t>(m_outputs.size()));
+        m_outputs.insert(m_outputs.end(), ids.begin(), ids.end());
+    }
+    m_output_begin.push_back(static_cast<std::uint32_t>(m_outputs.size()));
+}
+
+
+trigger_matcher::trigger_matcher(std::shared_ptr<trigger_set const> set)
+    : m_set{std::move(set)}
+    , m_seen(m_set ? m_set->size() : 0, false)
+{
+    m_line.reserve(max_line);
+}
+
+
+auto trigger_matcher::feed(std::string_view data) -> std::span<hit const>
+{
+    m_hits.clear();
+    if (!m_set || m_set->size() == 0) {
+        return m_hits;
+    }
+
+    auto const & set = *m_set;
+    auto append = [this](std::string_view piece) {
+        m_line.append(piece.substr(0, max_line - m_line.size()));
+    };
+
+    auto line_start = std::size_t{0};
+    for (auto ii = std::size_t{0}; ii < data.size(); ++ii) {
+        auto const byte = static_cast<unsigned char>(data[ii]);
+        m_state = set.next(m_state, byte);
+        for (auto id : set.outputs(m_state)) {
+            m_seen[id] = true;
+            m_any_seen = true;
+        }
+        if (byte == '\n') {
+            append(data.substr(line_start, ii - line_start));
+            line_start = ii + 1;
+            end_line();
+        }
+    }
+    append(data.substr(line_start));
+    return m_hits;
+}
+
+
+auto trigger_matcher::find(std::string_view data) -> found
+{
+    if (!m_set || m_set->size() == 0) {
+        return {data.size(), std::nullopt};
+    }
+
+    auto const & set = *m_set;
+    auto append = [this](std::string_view piece) {
+        m_line.append(piece.substr(0, max_line - m_line.size()));
+    };
+
+    auto line_start = std::size_t{0};
+    for (auto ii = std::size_t{0}; ii < data.size(); ++ii) {
+        auto const byte = static_cast<unsigned char>(data[ii]);
+        m_state = set.next(m_state, byte);
+        for (auto id : set.outputs(m_state)) {
+            if (!set.m_patterns[id].regex) {
+                restart();
+                return {ii + 1, id};
+            }
+            m_seen[id] = true;
+            m_any_seen = true;
+        }
+        if (byte == '\n') {
+            append(data.substr(line_start, ii - line_start));
+            line_start = ii + 1;
+
+            auto line = std::string_view{m_line};
+            while (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            auto match = search(line);
+            restart();
+            if (match) {
+                return {ii + 1, match->first};
+            }
+        }
+    }
+    append(data.substr(line_start));
+
+    auto match = search(m_line);
+    if (!match) {
+        return {data.size(), std::nullopt};
+    }
+
+    /* Whatever followed the match in this read is left for the caller */
+    auto unread = std::min(m_line.size() - match->second, data.size() - line_start);
+    restart();
+    return {data.size() - unread, match->first};
+}
+
+
+auto trigger_matcher::search(std::string_view line) const
+    -> std::optional<std::pair<std::size_t, std::size_t>>
+{
+    auto const & set = *m_set;
+    auto try_one = [&](std::size_t id) -> std::optional<std::size_t> {
+        auto match = std::match_results<std::string_view::const_iterator>{};
+        if (std::regex_search(line.begin(), line.end(), match,
+                    *set.m_patterns[id].regex))
+        {
+            return match.position(0) + match.length(0);
+        }
+        return std::nullopt;
+    };
+
+    if (m_any_seen) {
+        for (auto id = std::size_t{0}; id < m_seen.size(); ++id) {
+            if (auto end = m_seen[id] ? try_one(id) : std::nullopt) {
+                return std::pair{id, *end};
+            }
+        }
+    }
+    for (auto id : set.m_unfiltered) {
+        if (auto end = try_one(id)) {
+            return std::pair{id, *end};
+        }
+    }
+    return std::nullopt;
+}
+
+
+auto trigger_matcher::restart() -> void
+{
+    m_state = 0;
+    m_line.clear();
+    if (m_any_seen) {
+        m_seen.assign(m_seen.size(), false);
+        m_any_seen = false;
+    }
+}
+
+
+auto trigger_matcher::end_line() -> void
+{
+    auto const & set = *m_set;
+    m_state = 0;
+
+    if (m_any_seen || !set.m_unfiltered.empty()) {
+        auto line = std::string_view{m_line};
+        while (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        auto confirm = [&](std::size_t id) {
+            auto const & regex = set.m_patterns[id].regex;
+            if (!regex || std::regex_search(line.begin(), line.end(), *regex)) {
+                m_hits.push_back(hit{id, std::string{line}});
+            }
+        };
+
+        if (m_any_seen) {
+            for (auto id = std::size_t{0}; id < m_seen.size(); ++id) {
+                if (m_seen[id]) {
+                    m_seen[id] = false;
+                    confirm(id);
+                }
+            }
+            m_any_seen = false;
+        }
+        for (auto id : set.m_unfiltered) {
+            confirm(id);
+        }
+    }
+    m_line.clear();
+}
+
+
+auto triggers_holder::record(std::string const & device,
+        std::span<trigger_matcher::hit const> hits) -> void
+{
+    if (hits.empty()) {
+        return;
+    }
+
+    auto & reg = apsn::metrics::default_registry();
+    auto lock = this->lock();
+    for (auto const & hit : hits) {
+        auto const & name = set->name(hit.pattern);
+        auto line = smux::printable(hit.line);
+        apsn::log::warn("Trigger '{}' on {}: {}", name, device, line);
+        reg.counter("trigger_hits_total",
+                "Lines of console output matching a trigger",
+                {{"port", device}, {"trigger", name}}).add();
+
+        events.push_back(event{next_seq++,
+                std::chrono::system_clock::now(),
+                device,
+                name,
+                std::move(line)});
+        if (events.size() > max_events) {
+            events.pop_front();
+        }
+    }
+}
+
+
+auto triggers_holder::since(std::uint64_t seq) const -> std::vector<event>
+{
+    auto lock = this->lock();
+    auto first = std::ranges::upper_bound(events, seq, {}, &event::seq);
+    return {first, events.end()};
+}
+
+
+auto triggers_holder::lock() const -> std::unique_lock<std::mutex>
+{
+    return std::unique_lock<std::mutex>{m_mtx};
+}
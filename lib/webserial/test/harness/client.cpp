@@ -0,0 +1,241 @@
+#include "harness/client.hpp"
+
+#include <fmt/format.h>
+
+#include <string_view>
+
+
+using smux::test::tcp_client;
+using smux::test::ws_client;
+
+namespace websocket = boost::beast::websocket;
+
+
+namespace {
+
+/* Written by serial_state once it is forwarding */
+constexpr auto attached_banner = std::string_view{"Type Ctrl + q to exit\r\n"};
+
+/* Written by control_state when a command fails */
+constexpr auto error_marker = std::string_view{"error:"};
+
+
+auto basic_credentials(std::string const & user) -> std::string
+{
+    auto plain = user + ":";
+    auto encoded = std::string(
+            beast::detail::base64::encoded_size(plain.size()), '\0');
+    encoded.resize(beast::detail::base64::encode(
+            encoded.data(), plain.data(), plain.size()));
+    return "Basic " + encoded;
+}
+
+}
+
+
+ws_client::ws_client(asio::io_context & ioc, std::string user)
+    : m_stream{asio::make_strand(ioc)}
+    , m_user{std::move(user)}
+{}
+
+
+auto ws_client::attach(tcp::endpoint server,
+        std::size_t port_id,
+        stream_tracker & tracker,
+        handler on_ready) -> void
+{
+    m_tracker = &tracker;
+    m_on_ready = std::move(on_ready);
+
+    auto self = shared_from_this();
+    auto & tcp_stream = beast::get_lowest_layer(m_stream);
+    tcp_stream.expires_after(std::chrono::seconds{10});
+    tcp_stream.async_connect(server,
+        [self, server, port_id](beast::error_code ec) {
+            if (ec) {
+                return self->fail(ec);
+            }
+            beast::get_lowest_layer(self->m_stream).expires_never();
+            self->m_stream.set_option(
+                websocket::stream_base::timeout::suggested(
+                    beast::role_type::client));
+
+            /* The websocket handler only needs to know who is connecting;
+               credentials are checked by the HTTP routes */
+            auto user = self->m_user;
+            self->m_stream.set_option(websocket::stream_base::decorator(
+                [user](websocket::request_type & req) {
+                    req.set(beast::http::field::authorization,
+                            basic_credentials(user));
+                }));
+
+            self->m_stream.async_handshake(
+                fmt::format("{}:{}", server.address().to_string(), server.port()),
+                "/",
+                [self, port_id](beast::error_code ec) {
+                    if (ec) {
+                        return self->fail(ec);
+                    }
+                    self->read();
+                    self->type(fmt::format("connect {}\r", port_id));
+                });
+        });
+}
+
+
+auto ws_client::type(std::string text) -> void
+{
+    auto self = shared_from_this();
+    asio::post(m_stream.get_executor(), [self, text = std::move(text)] {
+        /* Short and rare enough to write synchronously */
+        auto ec = beast::error_code{};
+        self->m_stream.write(asio::buffer(text), ec);
+        if (ec) {
+            self->fail(ec);
+        }
+    });
+}
+
+
+auto ws_client::close() -> void
+{
+    auto self = shared_from_this();
+    asio::post(m_stream.get_executor(), [self] {
+        self->m_stream.async_close(websocket::close_code::normal,
+            [self](beast::error_code) {});
+    });
+}
+
+
+auto ws_client::fail(std::error_code ec) -> void
+{
+    if (m_on_ready) {
+        std::exchange(m_on_ready, {})(ec);
+    }
+}
+
+
+auto ws_client::read() -> void
+{
+    m_stream.async_read(m_buffer,
+        beast::bind_front_handler(&ws_client::on_read, shared_from_this()));
+}
+
+
+auto ws_client::on_read(beast::error_code ec, std::size_t bytes) -> void
+{
+    if (ec) {
+        return fail(ec);
+    }
+
+    if (m_attached) {
+        m_tracker->on_received(bytes);
+    }
+    else {
+        /* Everything up to the banner is the control CLI talking */
+        m_banner += beast::buffers_to_string(m_buffer.data());
+        if (auto pos = m_banner.find(attached_banner);
+            pos != std::string::npos)
+        {
+            auto extra = m_banner.size() - pos - attached_banner.size();
+            m_attached = true;
+            m_banner.clear();
+            if (extra > 0) {
+                m_tracker->on_received(extra);
+            }
+            if (m_on_ready) {
+                std::exchange(m_on_ready, {})(std::error_code{});
+            }
+        }
+        else if (m_banner.find(error_marker) != std::string::npos) {
+            m_banner.clear();
+            fail(std::make_error_code(std::errc::device_or_resource_busy));
+        }
+    }
+    m_buffer.consume(bytes);
+    read();
+}
+
+
+tcp_client::tcp_client(asio::io_context & ioc)
+    : m_socket{asio::make_strand(ioc)}
+{}
+
+
+auto tcp_client::attach(tcp::endpoint server,
+        std::size_t port_id,
+        stream_tracker & tracker,
+        handler on_ready) -> void
+{
+    m_tracker = &tracker;
+    m_on_ready = std::move(on_ready);
+
+    auto self = shared_from_this();
+    m_socket.async_connect(server, [self, port_id](boost::system::error_code ec) {
+        if (ec) {
+            return self->fail(ec);
+        }
+        self->m_socket.set_option(tcp::no_delay{true});
+
+        auto selection = std::make_shared<std::string>(
+                fmt::format("{}\n", port_id));
+        asio::async_write(self->m_socket, asio::buffer(*selection),
+            [self, selection](boost::system::error_code ec, std::size_t) {
+                if (ec) {
+                    return self->fail(ec);
+                }
+                /* The server answers a refusal with an `error:` line, but
+                   says nothing when it accepts; whether the port was
+                   claimed is for the caller to check */
+                self->read();
+                std::exchange(self->m_on_ready, {})(std::error_code{});
+            });
+    });
+}
+
+
+auto tcp_client::type(std::string text) -> void
+{
+    auto self = shared_from_this();
+    asio::post(m_socket.get_executor(), [self, text = std::move(text)] {
+        auto ec = boost::system::error_code{};
+        asio::write(self->m_socket, asio::buffer(text), ec);
+        if (ec) {
+            self->fail(ec);
+        }
+    });
+}
+
+
+auto tcp_client::close() -> void
+{
+    auto self = shared_from_this();
+    asio::post(m_socket.get_executor(), [self] {
+        auto ec = boost::system::error_code{};
+        self->m_socket.shutdown(tcp::socket::shutdown_both, ec);
+        self->m_socket.close(ec);
+    });
+}
+
+
+auto tcp_client::fail(std::error_code ec) -> void
+{
+    if (m_on_ready) {
+        std::exchange(m_on_ready, {})(ec);
+    }
+}
+
+
+auto tcp_client::read() -> void
+{
+    m_socket.async_read_some(asio::buffer(m_buffer),
+        [self = shared_from_this()](boost::system::error_code ec,
+                std::size_t bytes)
+        {
+            if (ec) {
+                return self->fail(ec);
+            }
+            self->m_tracker->on_received(bytes);
+            self->read();
+        });
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "harness/traffic.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+
+
+namespace smux::test {
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+
+/**
+ * @brief A headless client of one serial port
+ *
+ * Once attached, counts what arrives from the port against a
+ * `stream_tracker`.
+ */
+class client
+{
+public:
+    using tcp = asio::ip::tcp;
+    using handler = std::function<void(std::error_code)>;
+
+    virtual ~client() = default;
+
+    /* `on_ready` is called once the client is attached to the port, or with
+       the error which stopped it. It is called from the client's IO context. */
+    virtual auto attach(tcp::endpoint server,
+            std::size_t port_id,
+            stream_tracker & tracker,
+            handler on_ready) -> void = 0;
+
+    /* Sends keystrokes to the port. May be called from any thread. */
+    virtual auto type(std::string text) -> void = 0;
+
+    virtual auto close() -> void = 0;
+};
+
+
+/**
+ * @brief A headless stand-in for the browser
+ *
+ * Connects to the server's websocket, types `connect <port>` into the control
+ * CLI as a user would, and from then on counts what arrives from the port
+ * against a `stream_tracker`.
+ */
+class ws_client
+    : public client
+    , public std::enable_shared_from_this<ws_client>
+{
+public:
+    ws_client(asio::io_context & ioc, std::string user = "loopback");
+
+    auto attach(tcp::endpoint server,
+            std::size_t port_id,
+            stream_tracker & tracker,
+            handler on_ready) -> void override;
+
+    auto type(std::string text) -> void override;
+
+    auto close() -> void override;
+
+private:
+    auto fail(std::error_code ec) -> void;
+    auto on_read(beast::error_code ec, std::size_t bytes) -> void;
+    auto read() -> void;
+
+    beast::websocket::stream<beast::tcp_stream> m_stream;
+    beast::flat_buffer m_buffer;
+    std::string m_user;
+    std::string m_banner;
+    stream_tracker * m_tracker = nullptr;
+    handler m_on_ready;
+    bool m_attached = false;
+};
+
+
+
+/**
+ * @brief A client of the raw TCP port server
+ *
+ * Names the port on its first line, as `port_listener` expects when it serves
+ * every port, and counts everything after that.
+ */
+class tcp_client
+    : public client
+    , public std::enable_shared_from_this<tcp_client>
+{
+public:
+    explicit tcp_client(asio::io_context & ioc);
+
+    auto attach(tcp::endpoint server,
+            std::size_t port_id,
+            stream_tracker & tracker,
+            handler on_ready) -> void override;
+
+    auto type(std::string text) -> void override;
+
+    auto close() -> void override;
+
+private:
+    auto fail(std::error_code ec) -> void;
+    auto read() -> void;
+
+    tcp::socket m_socket;
+    std::array<char, 4096> m_buffer;
+    stream_tracker * m_tracker = nullptr;
+    handler m_on_ready;
+};
+
+}
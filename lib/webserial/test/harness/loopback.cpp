@@ -0,0 +1,300 @@
+#include "harness/loopback.hpp"
+
+#include "cli_handler.hpp"
+#include "error.hpp"
+#include "port_server.hpp"
+
+#include <apsn/http/listener.hpp>
+#include <apsn/http/router.hpp>
+#include <apsn/http/server_traits.hpp>
+#include <apsn/http/timer_wheel.hpp>
+#include <apsn/thread.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <future>
+
+
+using smux::test::loopback;
+using smux::test::loopback_report;
+
+
+namespace {
+
+using server_traits = apsn::http::server_traits<
+    smux::context,
+    smux::session_data,
+    apsn::http::router,
+    smux::cli_handler
+>;
+
+/* How long clients get to receive everything once traffic stops */
+constexpr auto drain_timeout = std::chrono::seconds{2};
+
+}
+
+
+auto loopback_report::throughput() const -> double
+{
+    auto total = std::uint64_t{0};
+    for (auto const & port : ports) {
+        total += port.received;
+    }
+    return elapsed.count() > 0
+            ? static_cast<double>(total) / elapsed.count()
+            : 0.0;
+}
+
+
+auto loopback_report::latency() const -> apsn::latency_histogram::summary
+{
+    auto result = apsn::latency_histogram::summary{};
+    for (auto const & port : ports) {
+        for (auto ii = std::size_t{0}; ii < result.buckets.size(); ++ii) {
+            result.buckets[ii] += port.latency.buckets[ii];
+        }
+        result.count += port.latency.count;
+        result.sum_us += port.latency.sum_us;
+        result.max_us = std::max(result.max_us, port.latency.max_us);
+    }
+    return result;
+}
+
+
+loopback::loopback(loopback_options options)
+    : m_options{options}
+    , m_shared{std::make_shared<smux::context>()}
+{}
+
+
+loopback::~loopback()
+{
+    stop();
+}
+
+
+auto loopback::start(std::chrono::milliseconds timeout) -> std::error_code
+{
+    for (auto ii = std::size_t{0}; ii < m_options.ports; ++ii) {
+        auto pty = pty_pair::open();
+        if (!pty) {
+            return pty.error;
+        }
+        auto id = add_fake_port(m_shared->ports, *pty);
+        if (!id) {
+            return id.error;
+        }
+        m_ptys.push_back(std::move(*pty));
+        m_port_ids.push_back(*id);
+        m_trackers.push_back(std::make_unique<stream_tracker>());
+        m_attached.push_back(false);
+    }
+
+    if (m_options.transport == loopback_transport::tcp) {
+        if (m_options.sessions > m_options.ports) {
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        auto listener = std::make_shared<smux::port_listener>(m_shared,
+                asio::ip::tcp::endpoint{asio::ip::address_v4::loopback(), 0},
+                smux::port_protocol::raw);
+        listener->run();
+        m_endpoint = listener->local_endpoint();
+    }
+    else {
+        /* Upgrades pass through the router's header checks first. The harness
+           skips authentication, so anything is let through. */
+        auto router = std::make_shared<apsn::http::router<server_traits>>(m_shared);
+        router->get("/", apsn::http::router_match::prefix,
+            [](auto &) { return std::string{}; });
+        auto timers = std::make_shared<apsn::http::timer_wheel>(
+                asio::make_strand(m_net));
+        timers->run();
+        auto listener = std::make_shared<apsn::http::listener<server_traits>>(
+                m_net,
+                asio::ip::tcp::endpoint{asio::ip::address_v4::loopback(), 0},
+                m_shared,
+                router,
+                timers);
+        listener->run();
+        m_endpoint = listener->local_endpoint();
+    }
+
+    /* The same split of work as webserial: network threads, one serial
+       thread, and a thread for the clients */
+    m_work.emplace_back(asio::make_work_guard(m_net));
+    m_work.emplace_back(asio::make_work_guard(m_shared->ioc));
+    m_work.emplace_back(asio::make_work_guard(m_client_ioc));
+    for (auto ii = 0u; ii < std::max(m_options.network_threads, 1u); ++ii) {
+        m_threads.emplace_back([this, ii] {
+            apsn::this_thread::set_name(fmt::format("net-{}", ii));
+            m_net.run();
+        });
+    }
+    m_threads.emplace_back([this] {
+        apsn::this_thread::set_name("serial");
+        m_shared->ioc.run();
+    });
+    m_threads.emplace_back([this] {
+        apsn::this_thread::set_name("clients");
+        m_client_ioc.run();
+    });
+    m_running = true;
+
+    auto ready = std::vector<std::future<std::error_code>>{};
+    for (auto ii = std::size_t{0}; ii < m_options.sessions; ++ii) {
+        auto index = ii % m_options.ports;
+        auto promise = std::make_shared<std::promise<std::error_code>>();
+        ready.push_back(promise->get_future());
+
+        auto client = std::shared_ptr<test::client>{};
+        if (m_options.transport == loopback_transport::tcp) {
+            client = std::make_shared<tcp_client>(m_client_ioc);
+        }
+        else {
+            client = std::make_shared<ws_client>(m_client_ioc,
+                    fmt::format("loopback{}", ii));
+        }
+        client->attach(m_endpoint, m_port_ids[index], *m_trackers[index],
+            [promise](std::error_code ec) { promise->set_value(ec); });
+        m_clients.push_back(std::move(client));
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    auto result = std::error_code{};
+    for (auto ii = std::size_t{0}; ii < ready.size(); ++ii) {
+        auto index = ii % m_options.ports;
+        if (ready[ii].wait_until(deadline) != std::future_status::ready) {
+            result = std::make_error_code(std::errc::timed_out);
+            continue;
+        }
+        auto ec = ready[ii].get();
+        if (!ec) {
+            m_attached[index] = true;
+        }
+    }
+    if (result) {
+        return result;
+    }
+
+    /* The port server does not say when it has claimed the port */
+    if (m_options.transport == loopback_transport::tcp) {
+        auto claimed = [this] {
+            auto lock = m_shared->ports.lock();
+            for (auto ii = std::size_t{0}; ii < m_options.sessions; ++ii) {
+                auto port = m_shared->ports.get_port(m_port_ids[ii]);
+                if (!port || !port->in_use) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        while (!claimed() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{5});
+        }
+        for (auto ii = std::size_t{0}; ii < m_options.sessions; ++ii) {
+            auto lock = m_shared->ports.lock();
+            auto port = m_shared->ports.get_port(m_port_ids[ii]);
+            m_attached[ii] = m_attached[ii] && port && port->in_use;
+        }
+    }
+
+    /* Every port with a session of its own should be in use */
+    for (auto ii = std::size_t{0};
+            ii < std::min(m_options.ports, m_options.sessions); ++ii)
+    {
+        if (!m_attached[ii]) {
+            return smux::error::device_in_use;
+        }
+    }
+    return {};
+}
+
+
+auto loopback::run(std::chrono::milliseconds duration) -> loopback_report
+{
+    using clock = std::chrono::steady_clock;
+
+    auto drivers = std::vector<std::unique_ptr<traffic_driver>>{};
+    for (auto ii = std::size_t{0}; ii < m_ptys.size(); ++ii) {
+        if (m_attached[ii]) {
+            drivers.push_back(std::make_unique<traffic_driver>(
+                    m_ptys[ii],
+                    *m_trackers[ii],
+                    m_options.traffic,
+                    static_cast<std::uint32_t>(ii + 1)));
+        }
+    }
+
+    auto start = clock::now();
+    for (auto & driver : drivers) {
+        driver->start();
+    }
+    std::this_thread::sleep_for(duration);
+    for (auto & driver : drivers) {
+        driver->stop();
+    }
+
+    auto caught_up = [this] {
+        for (auto const & tracker : m_trackers) {
+            if (tracker->received() < tracker->written()) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto deadline = clock::now() + drain_timeout;
+    while (!caught_up() && clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    }
+
+    auto report = loopback_report{};
+    report.elapsed = clock::now() - start;
+    report.attached = static_cast<std::size_t>(
+            std::count(m_attached.begin(), m_attached.end(), true));
+    for (auto ii = std::size_t{0}; ii < m_ptys.size(); ++ii) {
+        auto const & tracker = *m_trackers[ii];
+        report.ports.push_back(port_report{
+            m_ptys[ii].device(),
+            tracker.written(),
+            tracker.received(),
+            tracker.latency().snapshot()
+        });
+    }
+    return report;
+}
+
+
+auto loopback::stop() -> void
+{
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+
+    for (auto & client : m_clients) {
+        client->close();
+    }
+
+    /* Let the sessions close, so that their serial ports are released before
+       the IO contexts stop */
+    auto deadline = std::chrono::steady_clock::now() + drain_timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+        auto lock = m_shared->sessions.lock();
+        if (m_shared->sessions.sessions.empty()) {
+            break;
+        }
+        lock.unlock();
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    }
+
+    m_work.clear();
+    m_net.stop();
+    m_shared->ioc.stop();
+    m_client_ioc.stop();
+    for (auto & thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+    m_clients.clear();
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "harness/client.hpp"
+#include "harness/pty.hpp"
+#include "harness/traffic.hpp"
+
+#include "context.hpp"
+
+#include <apsn/latency.hpp>
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+
+namespace smux::test {
+
+enum class loopback_transport
+{
+    /* Through the websocket and the control CLI, as the browser does */
+    websocket,
+    /* Through the raw TCP port server */
+    tcp
+};
+
+
+struct loopback_options
+{
+    std::size_t ports = 1;
+
+    /* Session `n` connects to port `n % ports`. Ports can only be used by
+       one session at a time, so sessions beyond the number of ports stay in
+       the control CLI. Over TCP, a session for a port already in use
+       would be refused, so there can be no more sessions than ports. */
+    std::size_t sessions = 1;
+
+    loopback_transport transport = loopback_transport::websocket;
+
+    unsigned network_threads = 1;
+    traffic_options traffic;
+};
+
+
+struct port_report
+{
+    std::string device;
+    std::uint64_t written;
+    std::uint64_t received;
+    apsn::latency_histogram::summary latency;
+};
+
+
+struct loopback_report
+{
+    std::chrono::duration<double> elapsed;
+    std::size_t attached;
+    std::vector<port_report> ports;
+
+    /* Bytes per second received by clients, over all ports */
+    auto throughput() const -> double;
+
+    /* Latency over all ports */
+    auto latency() const -> apsn::latency_histogram::summary;
+};
+
+
+/**
+ * @brief The whole server, serving pseudo terminals to headless clients
+ *
+ * Runs the listener, websocket handlers and serial states as `webserial`
+ * does, on threads of their own, with `ports` pseudo terminals registered as
+ * serial ports. Clients connect over loopback, to the websocket or to a raw
+ * `port_listener`.
+ *
+ * \code {.cpp}
+        auto harness = smux::test::loopback{{.ports = 4, .sessions = 4}};
+        if (auto ec = harness.start()) { ... }
+        auto report = harness.run(std::chrono::seconds{10});
+ * \endcode
+ */
+class loopback
+{
+public:
+    explicit loopback(loopback_options options);
+    ~loopback();
+
+    /* Opens the ports, starts the server and attaches the sessions */
+    auto start(std::chrono::milliseconds timeout = std::chrono::seconds{10})
+        -> std::error_code;
+
+    /* Drives traffic into every attached port for `duration`, then waits a
+       little for the clients to catch up */
+    auto run(std::chrono::milliseconds duration) -> loopback_report;
+
+    auto stop() -> void;
+
+    auto context() -> smux::context &
+    { return *m_shared; }
+
+    auto endpoint() const -> asio::ip::tcp::endpoint
+    { return m_endpoint; }
+
+    auto pty(std::size_t index) -> pty_pair &
+    { return m_ptys[index]; }
+
+    auto client(std::size_t index) -> test::client &
+    { return *m_clients[index]; }
+
+private:
+    loopback_options m_options;
+    std::shared_ptr<smux::context> m_shared;
+    asio::io_context m_net;
+    asio::io_context m_client_ioc;
+    asio::ip::tcp::endpoint m_endpoint;
+
+    std::vector<pty_pair> m_ptys;
+    std::vector<std::size_t> m_port_ids;
+    std::vector<std::unique_ptr<stream_tracker>> m_trackers;
+    std::vector<bool> m_attached;
+    std::vector<std::shared_ptr<test::client>> m_clients;
+
+    std::vector<asio::executor_work_guard<
+        asio::io_context::executor_type>> m_work;
+    std::vector<std::thread> m_threads;
+    bool m_running = false;
+};
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "harness/pty.hpp"
+
+#include "context.hpp"
+
+#include <boost/asio.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+
+
+namespace smux::test {
+
+/* Polls `condition` until it holds, or `timeout` passes */
+inline
+auto eventually(std::function<bool()> condition,
+        std::chrono::milliseconds timeout = std::chrono::seconds{5}) -> bool
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    }
+    return condition();
+}
+
+
+/**
+ * @brief A context with one pseudo terminal registered as a port
+ *
+ * The serial IO context runs on a thread of its own from `SetUp` until
+ * `TearDown`, as the main thread runs it in the server.
+ */
+class port_fixture : public ::testing::Test
+{
+protected:
+    auto SetUp() -> void override
+    {
+        auto pty = pty_pair::open();
+        ASSERT_TRUE(static_cast<bool>(pty));
+        m_pty.emplace(std::move(*pty));
+
+        auto id = add_fake_port(m_ctx->ports, *m_pty);
+        ASSERT_TRUE(static_cast<bool>(id));
+        m_port_id = *id;
+
+        m_thread = std::thread{[this] { m_ctx->ioc.run(); }};
+    }
+
+    auto TearDown() -> void override
+    {
+        m_work.reset();
+        m_ctx->ioc.stop();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    auto in_use() -> bool
+    {
+        auto lock = m_ctx->ports.lock();
+        return m_ctx->ports.get_port(m_port_id)->in_use;
+    }
+
+    std::shared_ptr<smux::context> m_ctx = std::make_shared<smux::context>();
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type>
+        m_work = boost::asio::make_work_guard(m_ctx->ioc);
+    std::optional<pty_pair> m_pty;
+    std::size_t m_port_id = 0;
+    std::thread m_thread;
+};
+
+}
@@ -0,0 +1,162 @@
+#include "harness/pty.hpp"
+
+#include "port.hpp"
+
+#include <array>
+#include <cerrno>
+#include <utility>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+using smux::test::pty_pair;
+
+
+namespace {
+
+auto last_error() -> std::error_code
+{
+    return {errno, std::system_category()};
+}
+
+
+/* Waits for `events` on `fd`, returning false on timeout */
+auto wait_for(int fd, short events, std::chrono::milliseconds timeout)
+    -> apsn::result<bool>
+{
+    auto pfd = pollfd{fd, events, 0};
+    auto ready = ::poll(&pfd, 1, static_cast<int>(timeout.count()));
+    if (ready < 0) {
+        return last_error();
+    }
+    return ready > 0;
+}
+
+}
+
+
+auto pty_pair::open() -> apsn::result<pty_pair>
+{
+    auto master = -1;
+    auto slave = -1;
+    auto name = std::array<char, 256>{};
+
+    /* Raw from the start, so that nothing is echoed or translated before the
+       server applies its own settings */
+    auto settings = termios{};
+    ::cfmakeraw(&settings);
+
+    if (::openpty(&master, &slave, name.data(), &settings, nullptr) != 0) {
+        return last_error();
+    }
+
+    auto flags = ::fcntl(master, F_GETFL);
+    if (flags < 0 || ::fcntl(master, F_SETFL, flags | O_NONBLOCK) < 0) {
+        auto ec = last_error();
+        ::close(master);
+        ::close(slave);
+        return ec;
+    }
+    return pty_pair{master, slave, name.data()};
+}
+
+
+pty_pair::pty_pair(int master, int slave, std::string device)
+    : m_master{master}
+    , m_slave{slave}
+    , m_device{std::move(device)}
+{}
+
+
+pty_pair::pty_pair(pty_pair && other) noexcept
+    : m_master{std::exchange(other.m_master, -1)}
+    , m_slave{std::exchange(other.m_slave, -1)}
+    , m_device{std::move(other.m_device)}
+{}
+
+
+auto pty_pair::operator=(pty_pair && other) noexcept -> pty_pair &
+{
+    if (this != &other) {
+        close();
+        m_master = std::exchange(other.m_master, -1);
+        m_slave = std::exchange(other.m_slave, -1);
+        m_device = std::move(other.m_device);
+    }
+    return *this;
+}
+
+
+pty_pair::~pty_pair()
+{
+    close();
+}
+
+
+auto pty_pair::close() -> void
+{
+    if (m_master >= 0) {
+        ::close(m_master);
+    }
+    if (m_slave >= 0) {
+        ::close(m_slave);
+    }
+    m_master = -1;
+    m_slave = -1;
+}
+
+
+auto pty_pair::write(std::string_view data, std::chrono::milliseconds timeout)
+    -> std::error_code
+{
+    while (!data.empty()) {
+        auto written = ::write(m_master, data.data(), data.size());
+        if (written >= 0) {
+            data.remove_prefix(static_cast<std::size_t>(written));
+            continue;
+        }
+        if (errno != EAGAIN && errno != EINTR) {
+            return last_error();
+        }
+        auto ready = wait_for(m_master, POLLOUT, timeout);
+        if (!ready) {
+            return ready.error;
+        }
+        if (!*ready) {
+            return std::make_error_code(std::errc::timed_out);
+        }
+    }
+    return {};
+}
+
+
+auto pty_pair::read(std::chrono::milliseconds timeout)
+    -> apsn::result<std::string>
+{
+    auto ready = wait_for(m_master, POLLIN, timeout);
+    if (!ready) {
+        return ready.error;
+    }
+    if (!*ready) {
+        return std::make_error_code(std::errc::timed_out);
+    }
+
+    auto buffer = std::array<char, 4096>{};
+    auto count = ::read(m_master, buffer.data(), buffer.size());
+    if (count < 0) {
+        return last_error();
+    }
+    return std::string{buffer.data(), static_cast<std::size_t>(count)};
+}
+
+
+auto smux::test::add_fake_port(smux::ports_holder & ports,
+        pty_pair const & pty) -> apsn::result<std::size_t>
+{
+    auto lock = ports.lock();
+    return ports.add_port(pty.device(), smux::port_options{});
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "context.hpp"
+
+#include <apsn/result.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+
+namespace smux::test {
+
+/**
+ * @brief A pseudo terminal pair standing in for a serial adaptor
+ *
+ * The server opens `device()` as it would a USB adaptor, and the test writes
+ * what the "adaptor" receives to `master()`. The device side is held open
+ * too, so that the pair survives the server closing and reopening the port.
+ */
+class pty_pair
+{
+public:
+    static auto open() -> apsn::result<pty_pair>;
+
+    pty_pair(pty_pair && other) noexcept;
+    auto operator=(pty_pair && other) noexcept -> pty_pair &;
+    pty_pair(pty_pair const &) = delete;
+    auto operator=(pty_pair const &) -> pty_pair & = delete;
+    ~pty_pair();
+
+    auto device() const -> std::string const &
+    { return m_device; }
+
+    auto master() const -> int
+    { return m_master; }
+
+    /* Writes all of `data` to the master side, unless `timeout` passes
+       first while the device side is not being read */
+    auto write(std::string_view data,
+            std::chrono::milliseconds timeout = std::chrono::seconds{5})
+        -> std::error_code;
+
+    /* Reads whatever the server has written to the device, waiting up to
+       `timeout` for something to arrive */
+    auto read(std::chrono::milliseconds timeout) -> apsn::result<std::string>;
+
+private:
+    pty_pair(int master, int slave, std::string device);
+    auto close() -> void;
+
+    int m_master = -1;
+    int m_slave = -1;
+    std::string m_device;
+};
+
+
+/* Adds a pseudo terminal to `ports` as if it were a detected serial port */
+auto add_fake_port(smux::ports_holder & ports, pty_pair const & pty)
+    -> apsn::result<std::size_t>;
+
+}
@@ -0,0 +1,227 @@
+#include "harness/traffic.hpp"
+
+#include "error.hpp"
+
+#include <fmt/format.h>
+
+#include <array>
+#include <map>
+
+
+using smux::test::pattern;
+using smux::test::stream_tracker;
+using smux::test::traffic_driver;
+using smux::test::traffic_generator;
+
+
+namespace {
+
+constexpr auto kernel_lines = std::array{
+    "Booting Linux on physical CPU 0x{}",
+    "usb 1-1: new high-speed USB device number {} using xhci_hcd",
+    "EXT4-fs (mmcblk0p{}): mounted filesystem with ordered data mode",
+    "eth0: link up, 1000Mbps, full-duplex, lpa 0x{:04X}",
+    "random: crng init done, {} bits of entropy",
+};
+
+constexpr auto service_lines = std::array{
+    "Started Journal Service.",
+    "Reached target Network.",
+    "Starting OpenSSH Daemon...",
+    "Mounted /boot.",
+};
+
+}
+
+
+auto smux::test::to_string(pattern value) -> std::string
+{
+    switch (value) {
+    case pattern::boot_log: return "boot_log";
+    case pattern::binary:   return "binary";
+    case pattern::bursty:   return "bursty";
+    }
+    return "unknown";
+}
+
+
+auto smux::test::pattern_from_string(std::string const & value)
+    -> apsn::result<pattern>
+{
+    auto mapped = std::map<std::string, pattern>{
+        { "boot_log", pattern::boot_log },
+        { "binary",   pattern::binary   },
+        { "bursty",   pattern::bursty   }
+    };
+    auto it = mapped.find(value);
+    if (it == std::end(mapped)) {
+        return smux::error::bad_value;
+    }
+    return it->second;
+}
+
+
+traffic_generator::traffic_generator(test::pattern pattern, std::uint32_t seed)
+    : m_pattern{pattern}
+    , m_state{seed == 0 ? 1 : seed}
+{}
+
+
+auto traffic_generator::random() -> std::uint32_t
+{
+    /* xorshift32; fast and repeatable, which is all that is needed */
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return m_state;
+}
+
+
+auto traffic_generator::next_line() -> std::string
+{
+    auto n = m_lines++;
+    auto seconds = n / 50;
+    auto micros = (n % 50) * 20000 + random() % 20000;
+
+    /* Every fifth line is a coloured systemd status line */
+    if (n % 5 == 4) {
+        return fmt::format("[\x1b[0;32m  OK  \x1b[0m] {}\r\n",
+                service_lines[random() % service_lines.size()]);
+    }
+    auto text = fmt::format(fmt::runtime(
+            kernel_lines[random() % kernel_lines.size()]), random() % 64);
+    return fmt::format("[{:5}.{:06}] {}\r\n", seconds, micros, text);
+}
+
+
+auto traffic_generator::next(std::size_t size) -> std::string
+{
+    auto out = std::string{};
+    out.reserve(size);
+
+    if (m_pattern == pattern::binary) {
+        while (out.size() < size) {
+            out.push_back(static_cast<char>(random() & 0xff));
+        }
+        return out;
+    }
+
+    while (out.size() < size) {
+        if (m_pending.empty()) {
+            m_pending = next_line();
+        }
+        auto take = std::min(size - out.size(), m_pending.size());
+        out.append(m_pending, 0, take);
+        m_pending.erase(0, take);
+    }
+    return out;
+}
+
+
+auto stream_tracker::on_written(std::size_t bytes) -> void
+{
+    auto end = m_written.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    auto lock = std::lock_guard{m_mtx};
+    m_marks.push_back(mark{end, clock::now()});
+}
+
+
+auto stream_tracker::on_received(std::size_t bytes) -> void
+{
+    auto now = clock::now();
+    auto total = m_received.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+    auto lock = std::lock_guard{m_mtx};
+    while (!m_marks.empty() && m_marks.front().end <= total) {
+        m_latency.record(now - m_marks.front().when);
+        m_marks.pop_front();
+    }
+}
+
+
+traffic_driver::traffic_driver(pty_pair & pty,
+        stream_tracker & tracker,
+        traffic_options options,
+        std::uint32_t seed)
+    : m_pty{pty}
+    , m_tracker{tracker}
+    , m_options{options}
+    , m_generator{options.pattern, seed}
+{}
+
+
+traffic_driver::~traffic_driver()
+{
+    stop();
+}
+
+
+auto traffic_driver::start() -> void
+{
+    m_stop = false;
+    m_thread = std::thread{[this] { run(); }};
+}
+
+
+auto traffic_driver::stop() -> void
+{
+    m_stop = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+
+auto traffic_driver::error() const -> std::error_code
+{
+    auto lock = std::lock_guard{m_mtx};
+    return m_error;
+}
+
+
+auto traffic_driver::send(std::size_t bytes) -> bool
+{
+    while (bytes > 0 && !m_stop) {
+        auto chunk = m_generator.next(std::min(bytes, m_options.chunk_size));
+        auto ec = m_pty.write(chunk);
+        if (ec) {
+            auto lock = std::lock_guard{m_mtx};
+            m_error = ec;
+            return false;
+        }
+        m_tracker.on_written(chunk.size());
+        bytes -= chunk.size();
+    }
+    return !m_stop;
+}
+
+
+auto traffic_driver::run() -> void
+{
+    using clock = std::chrono::steady_clock;
+    using seconds = std::chrono::duration<double>;
+
+    auto const rate = static_cast<double>(m_options.bytes_per_second);
+    auto const start = clock::now();
+    auto sent = std::size_t{0};
+
+    auto period = m_options.pattern == pattern::bursty
+            ? std::chrono::duration_cast<clock::duration>(m_options.burst_period)
+            : std::chrono::duration_cast<clock::duration>(seconds{
+                static_cast<double>(m_options.chunk_size) / rate});
+    if (period <= clock::duration::zero()) {
+        period = std::chrono::milliseconds{1};
+    }
+
+    /* Catch up to where the rate says we should be at each tick, so that
+       slow writes do not lower the overall rate */
+    for (auto next = start; !m_stop; next += period) {
+        std::this_thread::sleep_until(next);
+        auto due = static_cast<std::size_t>(
+                rate * seconds{clock::now() - start}.count());
+        if (due > sent && !send(due - sent)) {
+            return;
+        }
+        sent = std::max(sent, due);
+    }
+}
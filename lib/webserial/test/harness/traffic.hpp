@@ -0,0 +1,145 @@
+#pragma once
+
+#include "harness/pty.hpp"
+
+#include <apsn/latency.hpp>
+#include <apsn/result.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+namespace smux::test {
+
+enum class pattern
+{
+    boot_log,   ///< Kernel style log lines, some coloured, at a steady rate
+    binary,     ///< Every byte value, at a steady rate
+    bursty      ///< Log lines, with each period's bytes sent at once
+};
+
+auto to_string(pattern value) -> std::string;
+auto pattern_from_string(std::string const & value) -> apsn::result<pattern>;
+
+
+struct traffic_options
+{
+    test::pattern pattern = pattern::boot_log;
+
+    /* 115200 baud, 8N1 */
+    std::size_t bytes_per_second = 11520;
+
+    /* Largest single write to the device */
+    std::size_t chunk_size = 64;
+
+    /* For `bursty`, time between bursts */
+    std::chrono::milliseconds burst_period{250};
+};
+
+
+/**
+ * @brief Produces the bytes of a pattern, the same for the same seed
+ */
+class traffic_generator
+{
+public:
+    explicit traffic_generator(test::pattern pattern, std::uint32_t seed = 1);
+
+    auto next(std::size_t size) -> std::string;
+
+private:
+    auto next_line() -> std::string;
+    auto random() -> std::uint32_t;
+
+    test::pattern m_pattern;
+    std::uint32_t m_state;
+    std::uint64_t m_lines = 0;
+    std::string m_pending;
+};
+
+
+/**
+ * @brief Matches bytes written to a device with bytes read by a client
+ *
+ * The serial path preserves order, so the time at which the byte at each
+ * offset was written is enough to find how long it took to arrive.
+ */
+class stream_tracker
+{
+public:
+    using clock = apsn::latency_histogram::clock;
+
+    /* From the driving thread, after writing `bytes` more */
+    auto on_written(std::size_t bytes) -> void;
+
+    /* From the client, after receiving `bytes` more */
+    auto on_received(std::size_t bytes) -> void;
+
+    auto written() const -> std::uint64_t
+    { return m_written.load(std::memory_order_relaxed); }
+
+    auto received() const -> std::uint64_t
+    { return m_received.load(std::memory_order_relaxed); }
+
+    auto latency() const -> apsn::latency_histogram const &
+    { return m_latency; }
+
+private:
+    struct mark
+    {
+        std::uint64_t end;
+        clock::time_point when;
+    };
+
+    std::mutex m_mtx;
+    std::deque<mark> m_marks;
+    std::atomic<std::uint64_t> m_written{0};
+    std::atomic<std::uint64_t> m_received{0};
+    apsn::latency_histogram m_latency;
+};
+
+
+/**
+ * @brief Writes a pattern to a pseudo terminal at a given rate
+ *
+ * Runs on a thread of its own between `start()` and `stop()`.
+ */
+class traffic_driver
+{
+public:
+    traffic_driver(pty_pair & pty,
+            stream_tracker & tracker,
+            traffic_options options,
+            std::uint32_t seed = 1);
+
+    ~traffic_driver();
+
+    auto start() -> void;
+    auto stop() -> void;
+
+    /* The first error writing to the device, if any */
+    auto error() const -> std::error_code;
+
+private:
+    auto run() -> void;
+    auto send(std::size_t bytes) -> bool;
+
+    pty_pair & m_pty;
+    stream_tracker & m_tracker;
+    traffic_options m_options;
+    traffic_generator m_generator;
+
+    std::atomic<bool> m_stop{false};
+    std::thread m_thread;
+
+    mutable std::mutex m_mtx;
+    std::error_code m_error;
+};
+
+}
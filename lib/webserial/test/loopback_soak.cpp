@@ -0,0 +1,119 @@
+#include "harness/loopback.hpp"
+
+#include <apsn/logging.hpp>
+
+#include <boost/program_options.hpp>
+#include <fmt/format.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+
+namespace po = boost::program_options;
+
+using smux::test::loopback;
+using smux::test::loopback_options;
+
+
+auto main(int argc, char const * argv[]) -> int
+{
+    auto opts = loopback_options{};
+    auto seconds = 10u;
+    auto pattern_name = std::string{"boot_log"};
+    auto burst_ms = 250u;
+    auto transport = std::string{"websocket"};
+
+    auto description = po::options_description{
+        "Serves pseudo terminals through the whole server to headless "
+        "clients, and reports throughput and latency"};
+    description.add_options()
+        ("help,h", "Display this message")
+        ("ports", po::value<std::size_t>(&opts.ports)->default_value(1),
+            "Number of pseudo terminal ports")
+        ("sessions", po::value<std::size_t>(&opts.sessions)->default_value(1),
+            "Number of sessions; session n uses port n % ports")
+        ("transport", po::value<std::string>(&transport)->default_value(transport),
+            "websocket, or tcp for the raw port server")
+        ("network-threads",
+            po::value<unsigned>(&opts.network_threads)->default_value(1),
+            "Threads serving HTTP and websockets")
+        ("rate", po::value<std::size_t>(&opts.traffic.bytes_per_second)
+                ->default_value(opts.traffic.bytes_per_second),
+            "Bytes per second written to each port")
+        ("chunk", po::value<std::size_t>(&opts.traffic.chunk_size)
+                ->default_value(opts.traffic.chunk_size),
+            "Largest single write to a port")
+        ("pattern", po::value<std::string>(&pattern_name)->default_value(pattern_name),
+            "One of boot_log, binary or bursty")
+        ("burst-period", po::value<unsigned>(&burst_ms)->default_value(burst_ms),
+            "Milliseconds between bursts, for the bursty pattern")
+        ("duration", po::value<unsigned>(&seconds)->default_value(seconds),
+            "Seconds to drive traffic for")
+        ("log-level,l", po::value<apsn::log::level>()->default_value(
+                apsn::log::level::warn)->notifier([](apsn::log::level lvl) {
+                    apsn::log::set_threshold(lvl);
+                }),
+            "Server log level");
+
+    auto vars = po::variables_map{};
+    po::store(po::parse_command_line(argc, argv, description), vars);
+    if (vars.count("help")) {
+        std::cout << description;
+        return 0;
+    }
+    po::notify(vars);
+
+    auto pattern = smux::test::pattern_from_string(pattern_name);
+    if (transport == "tcp") {
+        opts.transport = smux::test::loopback_transport::tcp;
+    }
+    else if (transport != "websocket") {
+        std::cerr << description;
+        return EXIT_FAILURE;
+    }
+
+    if (!pattern || opts.ports == 0) {
+        std::cerr << description;
+        return EXIT_FAILURE;
+    }
+    opts.traffic.pattern = *pattern;
+    opts.traffic.burst_period = std::chrono::milliseconds{burst_ms};
+
+    auto harness = loopback{opts};
+    if (auto ec = harness.start()) {
+        fmt::print(stderr, "Could not start: {}\n", ec.message());
+        return EXIT_FAILURE;
+    }
+
+    auto report = harness.run(std::chrono::seconds{seconds});
+    harness.stop();
+
+    auto us = [](auto duration) { return duration.count(); };
+    fmt::print("{:<16} {:>12} {:>12} {:>10} {:>10} {:>10}\n",
+            "port", "written", "received", "p50 us", "p99 us", "max us");
+    for (auto const & port : report.ports) {
+        fmt::print("{:<16} {:>12} {:>12} {:>10} {:>10} {:>10}\n",
+                port.device, port.written, port.received,
+                us(port.latency.percentile(0.5)),
+                us(port.latency.percentile(0.99)),
+                us(port.latency.max()));
+    }
+
+    auto latency = report.latency();
+    fmt::print("\n{} of {} ports attached, {} sessions, {:.1f}s\n",
+            report.attached, report.ports.size(), opts.sessions,
+            report.elapsed.count());
+    fmt::print("throughput {:.0f} B/s, latency p50 {} us, p99 {} us, max {} us\n",
+            report.throughput(),
+            us(latency.percentile(0.5)),
+            us(latency.percentile(0.99)),
+            us(latency.max()));
+
+    auto lost = false;
+    for (auto const & port : report.ports) {
+        lost = lost || port.received != port.written;
+    }
+    return lost ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+#include "harness/pty.hpp"
+
+#include "context.hpp"
+#include "error.hpp"
+#include "handoff.hpp"
+#include "screen.hpp"
+#include "serial.hpp"
+
+#include <boost/asio.hpp>
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+using smux::test::pty_pair;
+
+namespace handoff = smux::handoff;
+
+
+namespace {
+
+struct socket_pair
+{
+    socket_pair()
+    {
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0) {
+            sender = fds[0];
+            receiver = fds[1];
+        }
+    }
+
+    ~socket_pair()
+    {
+        ::close(sender);
+        ::close(receiver);
+    }
+
+    int sender = -1;
+    int receiver = -1;
+};
+
+}
+
+
+TEST(Handoff, PassesDescriptorsAndScreens)
+{
+    auto pair = socket_pair{};
+    ASSERT_GE(pair.sender, 0);
+
+    int pipe[2];
+    ASSERT_EQ(::pipe(pipe), 0);
+
+    auto sent = handoff::state{};
+    sent.listeners.push_back(pipe[0]);
+    sent.ports.push_back({"/dev/ttyUSB0", pipe[1], "login: "});
+    sent.ports.push_back({"/dev/ttyUSB1", pipe[1], ""});
+    ASSERT_FALSE(handoff::send(pair.sender, sent));
+
+    auto received = handoff::receive(pair.receiver);
+    ASSERT_TRUE(static_cast<bool>(received)) << received.error_message();
+    ASSERT_EQ(received->listeners.size(), 1u);
+    ASSERT_EQ(received->ports.size(), 2u);
+    EXPECT_EQ(received->ports[0].device, "/dev/ttyUSB0");
+    EXPECT_EQ(received->ports[0].screen, "login: ");
+    EXPECT_EQ(received->ports[1].device, "/dev/ttyUSB1");
+    EXPECT_TRUE(received->ports[1].screen.empty());
+
+    /* New descriptors for the same pipe, which outlive the originals */
+    EXPECT_NE(received->ports[0].fd, pipe[1]);
+    EXPECT_TRUE(::fcntl(received->ports[0].fd, F_GETFD) & FD_CLOEXEC);
+    ::close(pipe[1]);
+    ASSERT_EQ(::write(received->ports[0].fd, "x", 1), 1);
+    auto byte = char{};
+    ASSERT_EQ(::read(received->listeners[0], &byte, 1), 1);
+    EXPECT_EQ(byte, 'x');
+
+    ::close(pipe[0]);
+    ::close(received->listeners[0]);
+    for (auto const & port : received->ports) {
+        ::close(port.fd);
+    }
+}
+
+
+TEST(Handoff, RejectsAnythingElse)
+{
+    auto pair = socket_pair{};
+    ASSERT_GE(pair.sender, 0);
+
+    auto const junk = std::string(64, 'j');
+    ASSERT_EQ(::write(pair.sender, junk.data(), junk.size()),
+            static_cast<ssize_t>(junk.size()));
+
+    auto received = handoff::receive(pair.receiver);
+    ASSERT_FALSE(static_cast<bool>(received));
+    EXPECT_EQ(received.error, smux::error::bad_handoff);
+}
+
+
+TEST(Handoff, NextSessionTakesTheRestoredPort)
+{
+    auto pty = pty_pair::open();
+    ASSERT_TRUE(static_cast<bool>(pty));
+
+    auto ctx = smux::context{};
+    auto id = smux::test::add_fake_port(ctx.ports, *pty);
+    ASSERT_TRUE(static_cast<bool>(id));
+
+    auto fd = ::open(pty->device().c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+    ASSERT_GE(fd, 0);
+    auto ports = std::vector<handoff::port_state>{};
+    ports.push_back({pty->device(), fd, "before\r\n$ "});
+    ports.push_back({"/dev/gone", ::dup(fd), ""});
+    handoff::restore_ports(ctx, std::move(ports));
+
+    auto & port = ctx.ports.ports.at(*id);
+    ASSERT_TRUE(port.inherited.has_value());
+    EXPECT_EQ(port.screen->line(0), "before");
+    EXPECT_EQ(port.screen->cursor().row, 1u);
+    EXPECT_EQ(port.screen->cursor().col, 2u);
+
+    auto serial = smux::serial::open(ctx.ioc.get_executor(), port);
+    ASSERT_TRUE(static_cast<bool>(serial));
+    EXPECT_EQ(serial->native_handle(), fd);
+    EXPECT_FALSE(port.inherited.has_value());
+
+    boost::asio::write(*serial, boost::asio::buffer(std::string{"ok"}));
+    auto echoed = pty->read(1s);
+    ASSERT_TRUE(static_cast<bool>(echoed));
+    EXPECT_EQ(*echoed, "ok");
+}
+
+
+TEST(Handoff, TakesOverFromARunningServer)
+{
+    auto pty = pty_pair::open();
+    ASSERT_TRUE(static_cast<bool>(pty));
+
+    auto ctx = std::make_shared<smux::context>();
+    auto id = smux::test::add_fake_port(ctx->ports, *pty);
+    ASSERT_TRUE(static_cast<bool>(id));
+
+    /* As if a session had the port open */
+    auto & port = ctx->ports.ports.at(*id);
+    auto serial = smux::serial::open(ctx->ioc.get_executor(), port);
+    ASSERT_TRUE(static_cast<bool>(serial));
+    port.open = &*serial;
+    port.screen->feed("$ ls");
+
+    int pipe[2];
+    ASSERT_EQ(::pipe(pipe), 0);
+
+    auto path = std::filesystem::temp_directory_path()
+        / ("webserial-upgrade-" + std::to_string(::getpid()));
+    auto handed_off = false;
+    auto server = std::make_shared<handoff::server>(ctx, path,
+            [&] { return std::vector<int>{pipe[0]}; },
+            [&] { handed_off = true; });
+    ASSERT_TRUE(server->is_open());
+    server->run();
+    auto thread = std::thread{[&] { ctx->ioc.run(); }};
+
+    auto taken = handoff::take_over(path);
+    thread.join();
+
+    ASSERT_TRUE(static_cast<bool>(taken)) << taken.error_message();
+    EXPECT_TRUE(handed_off);
+    EXPECT_FALSE(serial->is_open());
+    EXPECT_FALSE(std::filesystem::exists(path));
+    ASSERT_EQ(taken->listeners.size(), 1u);
+    ASSERT_EQ(taken->ports.size(), 1u);
+    EXPECT_EQ(taken->ports[0].device, pty->device());
+    auto restored = smux::screen{};
+    restored.feed(taken->ports[0].screen);
+    EXPECT_EQ(restored.line(0), "$ ls");
+
+    /* Still the same tty, though the old server has closed it */
+    ASSERT_EQ(::write(taken->ports[0].fd, "up", 2), 2);
+    auto echoed = pty->read(1s);
+    ASSERT_TRUE(static_cast<bool>(echoed));
+    EXPECT_EQ(*echoed, "up");
+
+    ::close(pipe[0]);
+    ::close(pipe[1]);
+    ::close(taken->listeners[0]);
+    ::close(taken->ports[0].fd);
+}
+
+
+TEST(Handoff, LeavesAnythingButASocketAtItsPath)
+{
+    auto ctx = std::make_shared<smux::context>();
+    auto path = std::filesystem::temp_directory_path()
+        / ("webserial-upgrade-file-" + std::to_string(::getpid()));
+    {
+        auto file = std::ofstream{path};
+        file << "keep";
+    }
+
+    auto server = std::make_shared<handoff::server>(ctx, path,
+            [] { return std::vector<int>{}; },
+            [] {});
+    EXPECT_FALSE(server->is_open());
+    server.reset();
+
+    auto file = std::ifstream{path};
+    auto contents = std::string{};
+    file >> contents;
+    EXPECT_EQ(contents, "keep");
+    std::filesystem::remove(path);
+}
+
+
+TEST(Handoff, LeavesARunningServersSocket)
+{
+    auto ctx = std::make_shared<smux::context>();
+    auto path = std::filesystem::temp_directory_path()
+        / ("webserial-upgrade-live-" + std::to_string(::getpid()));
+    auto no_listeners = [] { return std::vector<int>{}; };
+
+    /* Left behind by a server which has gone */
+    {
+        auto stale = boost::asio::local::stream_protocol::acceptor{ctx->ioc,
+                boost::asio::local::stream_protocol::endpoint{path.string()}};
+    }
+    ASSERT_TRUE(std::filesystem::is_socket(path));
+    auto running = std::make_shared<handoff::server>(ctx, path,
+            no_listeners, [] {});
+    ASSERT_TRUE(running->is_open());
+
+    auto second = std::make_shared<handoff::server>(ctx, path,
+            no_listeners, [] {});
+    EXPECT_FALSE(second->is_open());
+    second.reset();
+    EXPECT_TRUE(std::filesystem::is_socket(path));
+
+    running.reset();
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
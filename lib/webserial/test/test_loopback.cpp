@@ -0,0 +1,91 @@
+#include "harness/loopback.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+using smux::test::loopback;
+using smux::test::loopback_options;
+using smux::test::pattern;
+
+
+namespace {
+
+auto options(std::size_t ports, std::size_t sessions, pattern p)
+    -> loopback_options
+{
+    auto opts = loopback_options{};
+    opts.ports = ports;
+    opts.sessions = sessions;
+    opts.traffic.pattern = p;
+    opts.traffic.bytes_per_second = 20000;
+    opts.traffic.burst_period = 50ms;
+    return opts;
+}
+
+}
+
+
+TEST(Loopback, ForwardsEveryByte)
+{
+    auto harness = loopback{options(2, 2, pattern::boot_log)};
+    auto ec = harness.start();
+    ASSERT_FALSE(ec) << ec.message();
+
+    auto report = harness.run(200ms);
+    EXPECT_EQ(report.attached, 2u);
+    ASSERT_EQ(report.ports.size(), 2u);
+    for (auto const & port : report.ports) {
+        EXPECT_GT(port.written, 0u);
+        EXPECT_EQ(port.received, port.written) << port.device;
+        EXPECT_GT(port.latency.count, 0u);
+    }
+    EXPECT_GT(report.throughput(), 0.0);
+}
+
+
+TEST(Loopback, ForwardsBinaryAndBursts)
+{
+    for (auto p : {pattern::binary, pattern::bursty}) {
+        auto harness = loopback{options(1, 1, p)};
+        auto ec = harness.start();
+    ASSERT_FALSE(ec) << ec.message();
+
+        auto report = harness.run(200ms);
+        ASSERT_EQ(report.ports.size(), 1u);
+        EXPECT_GT(report.ports[0].written, 0u) << to_string(p);
+        EXPECT_EQ(report.ports[0].received, report.ports[0].written)
+            << to_string(p);
+    }
+}
+
+
+TEST(Loopback, ExtraSessionsStayInControl)
+{
+    auto harness = loopback{options(1, 3, pattern::boot_log)};
+    auto ec = harness.start();
+    ASSERT_FALSE(ec) << ec.message();
+
+    auto report = harness.run(50ms);
+    EXPECT_EQ(report.attached, 1u);
+
+    auto lock = harness.context().sessions.lock();
+    EXPECT_EQ(harness.context().sessions.sessions.size(), 3u);
+}
+
+
+TEST(Loopback, ForwardsEveryByteOverTcp)
+{
+    auto opts = options(2, 2, pattern::binary);
+    opts.transport = smux::test::loopback_transport::tcp;
+    auto harness = loopback{opts};
+    auto ec = harness.start();
+    ASSERT_FALSE(ec) << ec.message();
+
+    auto report = harness.run(200ms);
+    EXPECT_EQ(report.attached, 2u);
+    for (auto const & port : report.ports) {
+        EXPECT_GT(port.written, 0u);
+        EXPECT_EQ(port.received, port.written) << port.device;
+    }
+}
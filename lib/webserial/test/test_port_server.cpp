@@ -0,0 +1,218 @@
+#include "harness/port_fixture.hpp"
+#include "harness/pty.hpp"
+
+#include "context.hpp"
+#include "port_server.hpp"
+
+#include <boost/asio.hpp>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <optional>
+#include <string>
+
+#include <poll.h>
+#include <sys/socket.h>
+
+using namespace std::chrono_literals;
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+using smux::port_protocol;
+using smux::test::eventually;
+using smux::test::port_fixture;
+
+
+namespace {
+
+auto bytes(std::initializer_list<unsigned> values) -> std::string
+{
+    auto result = std::string{};
+    for (auto value : values) {
+        result.push_back(static_cast<char>(value));
+    }
+    return result;
+}
+
+
+/* Up to `size` bytes, or fewer if the peer closes or `timeout` passes */
+auto receive(tcp::socket & socket, std::size_t size,
+        std::chrono::milliseconds timeout = 2s) -> std::string
+{
+    using clock = std::chrono::steady_clock;
+    auto deadline = clock::now() + timeout;
+    auto data = std::string{};
+    auto buffer = std::array<char, 4096>{};
+    while (data.size() < size) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - clock::now());
+        auto pfd = pollfd{socket.native_handle(), POLLIN, 0};
+        if (left <= 0ms || ::poll(&pfd, 1, static_cast<int>(left.count())) <= 0) {
+            break;
+        }
+        auto len = ::recv(socket.native_handle(), buffer.data(),
+                std::min(buffer.size(), size - data.size()), 0);
+        if (len <= 0) {
+            break;
+        }
+        data.append(buffer.data(), static_cast<std::size_t>(len));
+    }
+    return data;
+}
+
+
+class PortServer : public port_fixture
+{
+protected:
+    auto TearDown() -> void override
+    {
+        EXPECT_TRUE(eventually([this] {
+            auto lock = m_ctx->sessions.lock();
+            return m_ctx->sessions.sessions.empty();
+        }));
+        port_fixture::TearDown();
+    }
+
+    auto listen(port_protocol protocol,
+            std::optional<std::size_t> port_id = std::nullopt) -> tcp::endpoint
+    {
+        auto listener = std::make_shared<smux::port_listener>(m_ctx,
+                tcp::endpoint{asio::ip::address_v4::loopback(), 0},
+                protocol,
+                port_id);
+        listener->run();
+        return listener->local_endpoint();
+    }
+
+    auto connect(tcp::endpoint endpoint) -> tcp::socket
+    {
+        auto socket = tcp::socket{m_client_ioc};
+        socket.connect(endpoint);
+        return socket;
+    }
+
+    asio::io_context m_client_ioc;
+};
+
+}
+
+
+TEST_F(PortServer, RawClientChoosesPort)
+{
+    auto client = connect(listen(port_protocol::raw));
+    asio::write(client, asio::buffer(fmt::format("{}\r\n", m_port_id)));
+    ASSERT_TRUE(eventually([this] { return in_use(); }));
+
+    {
+        auto lock = m_ctx->sessions.lock();
+        ASSERT_EQ(m_ctx->sessions.sessions.size(), 1u);
+        auto const & info = m_ctx->sessions.sessions.begin()->second;
+        EXPECT_EQ(info.state, "raw");
+        EXPECT_EQ(info.device, m_pty->device());
+    }
+
+    auto const output = std::string{"boot\r\n\xff\x00", 8};
+    ASSERT_FALSE(m_pty->write(output));
+    EXPECT_EQ(receive(client, output.size()), output);
+
+    asio::write(client, asio::buffer(std::string{"ls\r"}));
+    auto typed = m_pty->read(1s);
+    ASSERT_TRUE(static_cast<bool>(typed));
+    EXPECT_EQ(*typed, "ls\r");
+}
+
+
+TEST_F(PortServer, RefusesBusyMissingAndMalformedPorts)
+{
+    auto endpoint = listen(port_protocol::raw);
+    {
+        auto lock = m_ctx->ports.lock();
+        m_ctx->ports.get_port(m_port_id)->in_use = true;
+    }
+
+    auto busy = connect(endpoint);
+    asio::write(busy, asio::buffer(fmt::format("{}\n", m_port_id)));
+    EXPECT_TRUE(receive(busy, 256).starts_with("error: Port with id"));
+
+    auto missing = connect(endpoint);
+    asio::write(missing, asio::buffer(std::string{"99\n"}));
+    EXPECT_TRUE(receive(missing, 256).starts_with("error: Unable to find port"));
+
+    auto malformed = connect(endpoint);
+    asio::write(malformed, asio::buffer(std::string{"console\n"}));
+    EXPECT_TRUE(receive(malformed, 256).starts_with("error: Invalid port ID"));
+
+    auto lock = m_ctx->ports.lock();
+    m_ctx->ports.get_port(m_port_id)->in_use = false;
+}
+
+
+TEST_F(PortServer, ReleasesPortOnDisconnect)
+{
+    auto endpoint = listen(port_protocol::raw, m_port_id);
+    {
+        auto client = connect(endpoint);
+        ASSERT_TRUE(eventually([this] { return in_use(); }));
+
+        /* Only one client at a time */
+        auto second = connect(endpoint);
+        EXPECT_TRUE(receive(second, 256).starts_with("error:"));
+    }
+    EXPECT_TRUE(eventually([this] { return !in_use(); }));
+}
+
+
+TEST_F(PortServer, SessionKillDisconnects)
+{
+    auto client = connect(listen(port_protocol::raw, m_port_id));
+    ASSERT_TRUE(eventually([this] { return in_use(); }));
+
+    auto id = [this] {
+        auto lock = m_ctx->sessions.lock();
+        return m_ctx->sessions.sessions.begin()->second.id;
+    }();
+    EXPECT_FALSE(m_ctx->sessions.cancel(id));
+
+    EXPECT_EQ(receive(client, 1), "");
+    EXPECT_TRUE(eventually([this] { return !in_use(); }));
+}
+
+
+TEST_F(PortServer, Rfc2217NegotiatesAndSetsUpLine)
+{
+    auto client = connect(listen(port_protocol::rfc2217, m_port_id));
+
+    /* WILL BINARY, SGA and ECHO; DO BINARY and COM-PORT-OPTION */
+    auto offers = bytes({255, 251, 0, 255, 251, 3, 255, 251, 1,
+                         255, 253, 0, 255, 253, 44});
+    EXPECT_EQ(receive(client, offers.size()), offers);
+
+    /* Agreeing to what was offered needs no answer, so the next thing back
+       is the reply to SET-BAUDRATE 9600 */
+    asio::write(client, asio::buffer(bytes({
+        255, 251, 0, 255, 251, 44, 255, 253, 0, 255, 253, 3, 255, 253, 1,
+        255, 250, 44, 1, 0, 0, 0x25, 0x80, 255, 240})));
+    auto baud_reply = bytes({255, 250, 44, 101, 0, 0, 0x25, 0x80, 255, 240});
+    EXPECT_EQ(receive(client, baud_reply.size()), baud_reply);
+
+    asio::write(client, asio::buffer(bytes({255, 250, 44, 2, 0, 255, 240})));
+    auto size_reply = bytes({255, 250, 44, 102, 8, 255, 240});
+    EXPECT_EQ(receive(client, size_reply.size()), size_reply);
+
+    {
+        auto lock = m_ctx->ports.lock();
+        EXPECT_EQ(m_ctx->ports.get_port(m_port_id)->options.baud_rate.value(),
+                9600u);
+    }
+
+    /* IACs in the data are doubled on the way out, and undone on the way in */
+    ASSERT_FALSE(m_pty->write(bytes({'a', 255, 'b'})));
+    EXPECT_EQ(receive(client, 4), bytes({'a', 255, 255, 'b'}));
+
+    asio::write(client, asio::buffer(bytes({'x', 255, 255, 'y'})));
+    auto typed = m_pty->read(1s);
+    ASSERT_TRUE(static_cast<bool>(typed));
+    EXPECT_EQ(*typed, bytes({'x', 255, 'y'}));
+}
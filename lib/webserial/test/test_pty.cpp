@@ -0,0 +1,104 @@
+#include "harness/pty.hpp"
+#include "harness/traffic.hpp"
+
+#include "context.hpp"
+#include "serial.hpp"
+
+#include <boost/asio.hpp>
+
+#include <gtest/gtest.h>
+
+#include <set>
+
+using namespace std::chrono_literals;
+
+using smux::test::pattern;
+using smux::test::pty_pair;
+
+
+TEST(PtyPair, PassesBytesBothWays)
+{
+    auto pty = pty_pair::open();
+    ASSERT_TRUE(static_cast<bool>(pty));
+
+    auto ioc = boost::asio::io_context{};
+    auto port = smux::serial::create(ioc.get_executor(), pty->device(),
+            smux::port_options{});
+    ASSERT_TRUE(static_cast<bool>(port));
+
+    /* Bytes which a cooked terminal would translate or swallow */
+    auto const sent = std::string{"a\r\n\x03\x11\x1b[0m\x7f"};
+    ASSERT_FALSE(pty->write(sent));
+
+    auto received = std::string(sent.size(), '\0');
+    boost::asio::read(*port, boost::asio::buffer(received));
+    EXPECT_EQ(received, sent);
+
+    boost::asio::write(*port, boost::asio::buffer(std::string{"ok\r\n"}));
+    auto echoed = pty->read(1s);
+    ASSERT_TRUE(static_cast<bool>(echoed));
+    EXPECT_EQ(*echoed, "ok\r\n");
+}
+
+
+TEST(PtyPair, RegistersAsPort)
+{
+    auto pty = pty_pair::open();
+    ASSERT_TRUE(static_cast<bool>(pty));
+
+    auto ports = smux::ports_holder{};
+    auto id = smux::test::add_fake_port(ports, *pty);
+    ASSERT_TRUE(static_cast<bool>(id));
+    EXPECT_EQ(ports.get_port(*id)->device, pty->device());
+    EXPECT_FALSE(ports.get_port(*id)->in_use);
+
+    EXPECT_FALSE(smux::test::add_fake_port(ports, *pty));
+}
+
+
+TEST(PtyPair, ReadTimesOut)
+{
+    auto pty = pty_pair::open();
+    ASSERT_TRUE(static_cast<bool>(pty));
+
+    auto result = pty->read(10ms);
+    EXPECT_FALSE(result);
+    EXPECT_EQ(result.error, std::errc::timed_out);
+}
+
+
+TEST(TrafficGenerator, IsRepeatable)
+{
+    auto first = smux::test::traffic_generator{pattern::boot_log, 7};
+    auto second = smux::test::traffic_generator{pattern::boot_log, 7};
+    EXPECT_EQ(first.next(1000), second.next(1000));
+
+    auto log = first.next(4096);
+    EXPECT_EQ(log.size(), 4096u);
+    EXPECT_NE(log.find("\r\n"), std::string::npos);
+}
+
+
+TEST(TrafficGenerator, BinaryCoversEveryByte)
+{
+    auto generator = smux::test::traffic_generator{pattern::binary};
+    auto data = generator.next(64 * 1024);
+    auto seen = std::set<unsigned char>(data.begin(), data.end());
+    EXPECT_EQ(seen.size(), 256u);
+}
+
+
+TEST(StreamTracker, MatchesReceivedToWritten)
+{
+    auto tracker = smux::test::stream_tracker{};
+    tracker.on_written(10);
+    tracker.on_written(10);
+
+    tracker.on_received(15);
+    EXPECT_EQ(tracker.latency().snapshot().count, 1u);
+
+    tracker.on_received(5);
+    EXPECT_EQ(tracker.latency().snapshot().count, 2u);
+    EXPECT_EQ(tracker.written(), 20u);
+    EXPECT_EQ(tracker.received(), 20u);
+}
@@ -0,0 +1,168 @@
+#include "screen.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using smux::screen;
+
+
+namespace {
+
+auto expect_same(screen const & a, screen const & b) -> void
+{
+    ASSERT_EQ(a.rows(), b.rows());
+    for (auto row = std::size_t{0}; row < a.rows(); ++row) {
+        EXPECT_EQ(a.line(row), b.line(row)) << "row " << row;
+    }
+    EXPECT_EQ(a.cursor().row, b.cursor().row);
+    EXPECT_EQ(a.cursor().col, b.cursor().col);
+    EXPECT_EQ(a.history_size(), b.history_size());
+    EXPECT_EQ(a.snapshot(screen::all), b.snapshot(screen::all));
+}
+
+}
+
+
+TEST(Screen, WrapsAtTheLastColumn)
+{
+    auto term = screen{3, 5};
+    EXPECT_TRUE(term.empty());
+    term.feed("hello world");
+    EXPECT_FALSE(term.empty());
+    EXPECT_EQ(term.line(0), "hello");
+    EXPECT_EQ(term.line(1), " worl");
+    EXPECT_EQ(term.line(2), "d");
+    EXPECT_EQ(term.cursor().row, 2u);
+    EXPECT_EQ(term.cursor().col, 1u);
+
+    /* Filling a row leaves the cursor there until the next character */
+    term.feed("\rabcde");
+    EXPECT_EQ(term.cursor().row, 2u);
+    EXPECT_EQ(term.line(2), "abcde");
+    EXPECT_EQ(term.history_size(), 0u);
+}
+
+
+TEST(Screen, KeepsABoundedHistory)
+{
+    auto term = screen{2, 10, 3};
+    term.feed("1\r\n2\r\n3\r\n4\r\n5\r\n6");
+    EXPECT_EQ(term.line(0), "5");
+    EXPECT_EQ(term.line(1), "6");
+    EXPECT_EQ(term.history_size(), 3u);
+
+    /* Only the history asked for is redrawn */
+    auto replay = screen{2, 10, 3};
+    replay.feed(term.snapshot(1));
+    EXPECT_EQ(replay.history_size(), 1u);
+    EXPECT_EQ(replay.line(0), "5");
+}
+
+
+TEST(Screen, MovesAndErases)
+{
+    auto term = screen{4, 10};
+    term.feed("abcdef\x1b[1;3H\x1b[K");
+    EXPECT_EQ(term.line(0), "ab");
+
+    term.feed("\x1b[2;2Hx\x1b[3G\x1b[2@yz");
+    EXPECT_EQ(term.line(1), " xyz");
+
+    term.feed("\x1b[2;2H\x1b[P");
+    EXPECT_EQ(term.line(1), " yz");
+
+    term.feed("\x1b[4;1Hbottom\x1b[1;1H\x1b[L");
+    EXPECT_EQ(term.line(0), "");
+    EXPECT_EQ(term.line(1), "ab");
+    EXPECT_EQ(term.line(3), "");
+
+    term.feed("\x1b[2J");
+    EXPECT_TRUE(term.empty());
+}
+
+
+TEST(Screen, ScrollsOnlyTheRegion)
+{
+    auto term = screen{4, 10};
+    term.feed("status\x1b[2;4r\x1b[4;1H");
+    term.feed("a\r\nb\r\nc\r\nd");
+    EXPECT_EQ(term.line(0), "status");
+    EXPECT_EQ(term.line(1), "b");
+    EXPECT_EQ(term.line(3), "d");
+
+    /* Not scrolled from the top of the screen, so not history */
+    EXPECT_EQ(term.history_size(), 0u);
+}
+
+
+TEST(Screen, SkipsStringsAndUnknownSequences)
+{
+    auto term = screen{2, 20};
+    term.feed("\x1b]0;title\x07" "a\x1bP1$q\x1b\\" "b\x1b(Bc\x1b[>0c\x1b[?2004hd");
+    EXPECT_EQ(term.line(0), "abcd");
+}
+
+
+TEST(Screen, LeavesTheAlternateScreenAsItWas)
+{
+    auto term = screen{3, 20};
+    term.feed("$ vi\r\n");
+    term.feed("\x1b[?1049h\x1b[H\x1b[2Jediting");
+    EXPECT_EQ(term.line(0), "editing");
+    term.feed("\x1b[?1049l");
+    EXPECT_EQ(term.line(0), "$ vi");
+    EXPECT_EQ(term.cursor().row, 1u);
+    EXPECT_EQ(term.cursor().col, 0u);
+}
+
+
+TEST(Screen, DecodesUtf8AcrossReads)
+{
+    auto term = screen{1, 10};
+    auto const text = std::string{"caf\xc3\xa9 \xe2\x9c\x93"};
+    for (auto c : text) {
+        term.feed(std::string_view{&c, 1});
+    }
+    EXPECT_EQ(term.line(0), text);
+    EXPECT_EQ(term.cursor().col, 6u);
+
+    term.feed("\r\xff");
+    EXPECT_EQ(term.line(0), "\xef\xbf\xbd" "af\xc3\xa9 \xe2\x9c\x93");
+}
+
+
+TEST(Screen, SnapshotRedrawsTheScreen)
+{
+    auto term = screen{5, 20};
+    term.feed("boot\r\n\x1b[1;31merror\x1b[0m: \x1b[38;5;208mdisk\x1b[0m\r\n");
+    term.feed("\x1b[48;2;1;2;3m  \x1b[0m\x1b[7m inverse \x1b[27m\r\n");
+    for (auto ii = 0; ii < 10; ++ii) {
+        term.feed("line " + std::to_string(ii) + "\r\n");
+    }
+    term.feed("01234567890123456789");
+    term.feed("\x1b[2;3H\x1b[4;32m\x1b[?25l");
+
+    auto replay = screen{5, 20};
+    replay.feed(term.snapshot(screen::all));
+    expect_same(term, replay);
+
+    /* And with a wrap pending at the last column */
+    term.feed("\x1b[5;20Hz");
+    auto again = screen{5, 20};
+    again.feed(term.snapshot(screen::all));
+    expect_same(term, again);
+    again.feed("!");
+    EXPECT_EQ(again.cursor().col, 1u);
+}
+
+
+TEST(Screen, SnapshotStaysSmall)
+{
+    auto term = screen{};
+    for (auto ii = 0; ii < 100000; ++ii) {
+        term.feed("[  12.345678] usb 1-1: new high-speed USB device\r\n");
+    }
+    EXPECT_EQ(term.history_size(), screen::default_history);
+    EXPECT_LT(term.snapshot().size(), 4096u);
+}
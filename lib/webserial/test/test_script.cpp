@@ -0,0 +1,237 @@
+#include "harness/port_fixture.hpp"
+#include "harness/pty.hpp"
+
+#include "context.hpp"
+#include "error.hpp"
+#include "script.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+using smux::script;
+using smux::script_state;
+using smux::test::eventually;
+using smux::test::port_fixture;
+using smux::test::pty_pair;
+
+
+namespace {
+
+class Script : public port_fixture
+{
+protected:
+    auto SetUp() -> void override
+    {
+        auto set = smux::trigger_set::compile(smux::default_triggers());
+        ASSERT_TRUE(static_cast<bool>(set));
+        m_ctx->triggers.set = *set.value;
+
+        port_fixture::SetUp();
+    }
+
+    auto start(std::string_view json) -> std::size_t
+    {
+        auto parsed = script::parse(json);
+        EXPECT_TRUE(static_cast<bool>(parsed));
+        auto job = smux::run_script(m_ctx, m_port_id, std::move(*parsed.value));
+        EXPECT_TRUE(static_cast<bool>(job));
+        return job ? *job : 0;
+    }
+
+    auto finished(std::size_t job) -> std::optional<smux::script_job>
+    {
+        auto done = std::optional<smux::script_job>{};
+        eventually([&] {
+            done = m_ctx->scripts.get(job);
+            return done && done->state != script_state::running;
+        });
+        return done;
+    }
+
+    /* The tty is opened after run_script returns */
+    auto opened() -> bool
+    {
+        auto lock = m_ctx->ports.lock();
+        return m_ctx->ports.get_port(m_port_id)->open != nullptr;
+    }
+};
+
+}
+
+
+TEST(ScriptParse, RejectsMalformedScripts)
+{
+    auto ok = script::parse(R"({"timeout": 500, "steps": [
+        {"send": "\r"}, {"expect": "login: $", "timeout": 2000}]})");
+    ASSERT_TRUE(static_cast<bool>(ok));
+    ASSERT_EQ(ok.value->steps.size(), 2u);
+    EXPECT_EQ(ok.value->steps[0].timeout, 500ms);
+    EXPECT_EQ(ok.value->steps[1].timeout, 2000ms);
+    EXPECT_TRUE(ok.value->steps[1].pattern);
+
+    for (auto bad : {
+        "not json",
+        R"({"steps": []})",
+        R"({"steps": [{"send": "a", "expect": "b"}]})",
+        R"({"steps": [{"expect": "(unclosed"}]})",
+        R"({"steps": [{"send": 1}]})",
+        R"({"steps": [{"send": "a", "timeout": 0}]})",
+        R"({"timeout": -1, "steps": [{"send": "a"}]})"})
+    {
+        EXPECT_EQ(script::parse(bad).error, smux::error::bad_script) << bad;
+    }
+}
+
+
+TEST_F(Script, SendsAndExpects)
+{
+    auto job = start(R"({"timeout": 2000, "steps": [
+        {"send": "root\r"},
+        {"expect": "[Pp]assword: $"},
+        {"send": "secret\r"},
+        {"expect": "# "}]})");
+    ASSERT_TRUE(eventually([this] { return in_use(); }));
+
+    auto typed = m_pty->read(1s);
+    ASSERT_TRUE(static_cast<bool>(typed));
+    EXPECT_EQ(*typed, "root\r");
+
+    /* Both prompts in one read; the second is left for the last step */
+    ASSERT_FALSE(m_pty->write("Password: "));
+    auto password = m_pty->read(1s);
+    ASSERT_TRUE(static_cast<bool>(password));
+    EXPECT_EQ(*password, "secret\r");
+    ASSERT_FALSE(m_pty->write("\r\nwelcome\r\n~ # "));
+
+    auto done = finished(job);
+    ASSERT_TRUE(done);
+    EXPECT_EQ(done->state, script_state::passed);
+    EXPECT_EQ(done->finished.size(), 4u);
+    EXPECT_EQ(done->transcript, "Password: \r\nwelcome\r\n~ # ");
+    EXPECT_TRUE(eventually([this] { return !in_use(); }));
+}
+
+
+TEST_F(Script, TimesOutAndReleasesThePort)
+{
+    auto job = start(R"({"steps": [
+        {"expect": "never", "timeout": 100}]})");
+
+    /* Busy until the script ends */
+    auto parsed = script::parse(R"({"steps": [{"send": "a"}]})");
+    ASSERT_TRUE(static_cast<bool>(parsed));
+    EXPECT_EQ(smux::run_script(m_ctx, m_port_id, std::move(*parsed.value)).error,
+            smux::error::device_in_use);
+
+    ASSERT_TRUE(eventually([this] { return opened(); }));
+    ASSERT_FALSE(m_pty->write("Kernel panic\r\n"));
+    auto done = finished(job);
+    ASSERT_TRUE(done);
+    EXPECT_EQ(done->state, script_state::timed_out);
+    EXPECT_EQ(done->step, 0u);
+    EXPECT_EQ(done->transcript, "Kernel panic\r\n");
+    EXPECT_TRUE(eventually([this] { return !in_use(); }));
+
+    /* Output seen by a script is still matched against the triggers */
+    EXPECT_EQ(m_ctx->triggers.since(0).size(), 1u);
+}
+
+
+/* Reads keep completing, so the deadline often passes with one queued */
+TEST_F(Script, WaitEndsOnABusyPort)
+{
+    auto stop = std::atomic<bool>{false};
+    auto writer = std::thread{[&] {
+        auto const line = std::string(256, 'x') + "\r\n";
+        while (!stop) {
+            (void)m_pty->write(line, 100ms);
+        }
+    }};
+
+    for (auto ii = 0; ii < 10; ++ii) {
+        auto job = start(R"({"steps": [{"wait": 20}]})");
+        auto done = finished(job);
+        ASSERT_TRUE(done);
+        EXPECT_EQ(done->state, script_state::passed);
+        ASSERT_TRUE(eventually([this] { return !in_use(); }));
+    }
+
+    stop = true;
+    writer.join();
+}
+
+
+TEST(ScriptParse, BuildsTheBroadcastScript)
+{
+    auto window = script::parse_broadcast(R"({"send": "show version\r"})");
+    ASSERT_TRUE(static_cast<bool>(window));
+    ASSERT_EQ(window.value->steps.size(), 2u);
+    EXPECT_EQ(window.value->steps[1].type, smux::script_step::kind::wait);
+    EXPECT_EQ(window.value->steps[1].timeout, script::default_window);
+
+    auto until = script::parse_broadcast(
+            R"({"send": "show version\r", "window": 500, "until": "# $"})");
+    ASSERT_TRUE(static_cast<bool>(until));
+    EXPECT_EQ(until.value->steps[1].type, smux::script_step::kind::expect);
+    EXPECT_EQ(until.value->steps[1].timeout, 500ms);
+
+    EXPECT_EQ(script::parse_broadcast(R"({"window": 500})").error,
+            smux::error::bad_script);
+}
+
+
+TEST_F(Script, BroadcastsToEveryPortInAGroup)
+{
+    auto second = pty_pair::open();
+    ASSERT_TRUE(static_cast<bool>(second));
+    auto second_id = smux::test::add_fake_port(m_ctx->ports, *second);
+    ASSERT_TRUE(static_cast<bool>(second_id));
+
+    {
+        auto lock = m_ctx->ports.lock();
+        EXPECT_EQ(m_ctx->ports.set_group("switches", {m_port_id, 99}),
+                smux::error::device_not_found);
+        auto by_device = m_ctx->ports.find_port(second->device());
+        ASSERT_TRUE(static_cast<bool>(by_device));
+        EXPECT_FALSE(m_ctx->ports.set_group("switches",
+                {*by_device, m_port_id, m_port_id}));
+        EXPECT_EQ(m_ctx->ports.get_group("switches")->size(), 2u);
+    }
+    EXPECT_EQ(smux::run_broadcast(m_ctx, "routers", {}).error,
+            smux::error::group_not_found);
+
+    auto parsed = script::parse_broadcast(
+            R"({"send": "show version\r", "window": 2000, "until": "# $"})");
+    ASSERT_TRUE(static_cast<bool>(parsed));
+    auto id = smux::run_broadcast(m_ctx, "switches", *parsed.value);
+    ASSERT_TRUE(static_cast<bool>(id));
+
+    /* One buffer, sent to both */
+    auto broadcast = m_ctx->scripts.get_broadcast(*id);
+    ASSERT_TRUE(broadcast);
+    ASSERT_EQ(broadcast->members.size(), 2u);
+    for (auto * pty : {&*m_pty, &*second}) {
+        auto typed = pty->read(1s);
+        ASSERT_TRUE(static_cast<bool>(typed));
+        EXPECT_EQ(*typed, "show version\r");
+    }
+    ASSERT_FALSE(m_pty->write("v1.0\r\nsw1# "));
+    ASSERT_FALSE(second->write("v2.0\r\nsw2# "));
+
+    for (auto const & member : broadcast->members) {
+        ASSERT_TRUE(member.job);
+        auto done = finished(*member.job);
+        ASSERT_TRUE(done);
+        EXPECT_EQ(done->state, script_state::passed);
+        EXPECT_EQ(done->transcript, member.port_id == m_port_id
+                ? "v1.0\r\nsw1# "
+                : "v2.0\r\nsw2# ");
+    }
+}
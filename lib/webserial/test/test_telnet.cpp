@@ -0,0 +1,98 @@
+#include "telnet.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace telnet = smux::telnet;
+
+
+namespace {
+
+struct recorder
+{
+    recorder()
+        : decoder{telnet::decoder::handlers{
+            [this](std::string_view d) { data += d; },
+            [this](std::uint8_t verb, std::uint8_t option) {
+                negotiations.emplace_back(verb, option);
+            },
+            [this](std::uint8_t option, std::string_view payload) {
+                subnegotiations.emplace_back(option, std::string{payload});
+            }}}
+    {}
+
+    std::string data;
+    std::vector<std::pair<std::uint8_t, std::uint8_t>> negotiations;
+    std::vector<std::pair<std::uint8_t, std::string>> subnegotiations;
+    telnet::decoder decoder;
+};
+
+auto bytes(std::initializer_list<unsigned> values) -> std::string
+{
+    auto result = std::string{};
+    for (auto value : values) {
+        result.push_back(static_cast<char>(value));
+    }
+    return result;
+}
+
+}
+
+
+TEST(TelnetDecoder, SeparatesDataFromCommands)
+{
+    auto rec = recorder{};
+    rec.decoder.feed("ab" + bytes({255, 253, 0}) + "c" + bytes({255, 255}) + "d");
+
+    EXPECT_EQ(rec.data, "abc\xff" "d");
+    ASSERT_EQ(rec.negotiations.size(), 1u);
+    EXPECT_EQ(rec.negotiations[0].first, telnet::cmd::do_);
+    EXPECT_EQ(rec.negotiations[0].second, telnet::option::binary);
+}
+
+
+TEST(TelnetDecoder, JoinsCommandsSplitAcrossReads)
+{
+    auto stream = bytes({255, 250, 44, 1, 0, 0, 255, 255, 0, 255, 240}) + "x";
+    auto whole = recorder{};
+    whole.decoder.feed(stream);
+
+    auto split = recorder{};
+    for (auto ch : stream) {
+        split.decoder.feed(std::string(1, ch));
+    }
+
+    for (auto const * rec : {&whole, &split}) {
+        ASSERT_EQ(rec->subnegotiations.size(), 1u);
+        EXPECT_EQ(rec->subnegotiations[0].first, telnet::option::com_port);
+        EXPECT_EQ(rec->subnegotiations[0].second, bytes({1, 0, 0, 255, 0}));
+        EXPECT_EQ(rec->data, "x");
+    }
+}
+
+
+TEST(TelnetDecoder, DropsNulAfterCarriageReturnUnlessBinary)
+{
+    auto rec = recorder{};
+    rec.decoder.feed(std::string{"a\r\0b", 4});
+    EXPECT_EQ(rec.data, "a\rb");
+
+    rec.data.clear();
+    rec.decoder.binary(true);
+    rec.decoder.feed(std::string{"a\r\0b", 4});
+    EXPECT_EQ(rec.data, std::string("a\r\0b", 4));
+}
+
+
+TEST(Telnet, EscapesIac)
+{
+    EXPECT_EQ(telnet::escape(bytes({1, 255, 2})), bytes({1, 255, 255, 2}));
+    EXPECT_EQ(telnet::negotiation(telnet::cmd::will, telnet::option::echo),
+            bytes({255, 251, 1}));
+    EXPECT_EQ(telnet::subnegotiation(telnet::option::com_port,
+                bytes({101, 0, 0, 0, 255})),
+            bytes({255, 250, 44, 101, 0, 0, 0, 255, 255, 255, 240}));
+}
@@ -0,0 +1,169 @@
+#include "error.hpp"
+#include "triggers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using smux::trigger_matcher;
+using smux::trigger_set;
+
+
+namespace {
+
+auto compile(std::vector<smux::trigger> triggers)
+{
+    auto set = trigger_set::compile(std::move(triggers));
+    EXPECT_TRUE(static_cast<bool>(set));
+    return *set.value;
+}
+
+/* Names of the triggers hit, in the order they were reported */
+auto feed(trigger_matcher & matcher, trigger_set const & set, std::string_view data)
+    -> std::vector<std::string>
+{
+    auto names = std::vector<std::string>{};
+    for (auto const & hit : matcher.feed(data)) {
+        names.push_back(set.name(hit.pattern));
+    }
+    return names;
+}
+
+}
+
+
+TEST(Triggers, ParsesNamedAndBarePatterns)
+{
+    auto named = smux::parse_trigger("oom=Out of memory: .*");
+    EXPECT_EQ(named.name, "oom");
+    EXPECT_EQ(named.pattern, "Out of memory: .*");
+
+    auto bare = smux::parse_trigger("a=b or c");
+    EXPECT_EQ(bare.name, "a");
+
+    auto unnamed = smux::parse_trigger("x == 1");
+    EXPECT_EQ(unnamed.name, "x == 1");
+    EXPECT_EQ(unnamed.pattern, "x == 1");
+}
+
+
+TEST(Triggers, TakesTheRequiredLiteralOutOfEachPattern)
+{
+    auto set = compile({
+        {"plain", "Kernel panic"},
+        {"anchored", "^BUG: soft lockup"},
+        {"optional", "errors?: [0-9]+ found"},
+        {"escaped", "eth0\\.100 down"},
+        {"hex", "\\x41BCDEF"},
+        {"either", "panic|oops"}
+    });
+    EXPECT_EQ(set->literal(0), "Kernel panic");
+    EXPECT_EQ(set->literal(1), "BUG: soft lockup");
+    EXPECT_EQ(set->literal(2), " found");
+    EXPECT_EQ(set->literal(3), "eth0.100 down");
+    EXPECT_EQ(set->literal(4), "BCDEF");
+    EXPECT_EQ(set->literal(5), "");
+}
+
+
+TEST(Triggers, RejectsBadPatterns)
+{
+    auto bad = trigger_set::compile({{"bad", "unclosed (group"}});
+    EXPECT_EQ(bad.error, smux::error::bad_trigger);
+
+    auto empty = trigger_set::compile({{"empty", ""}});
+    EXPECT_EQ(empty.error, smux::error::bad_trigger);
+}
+
+
+TEST(Triggers, FindsPatternsSplitAcrossReads)
+{
+    auto set = compile(smux::default_triggers());
+    auto matcher = trigger_matcher{set};
+
+    EXPECT_TRUE(feed(matcher, *set, "[   12.3] Kernel pa").empty());
+    EXPECT_TRUE(feed(matcher, *set, "nic - not syncing").empty());
+    EXPECT_EQ(feed(matcher, *set, "\r\n"), std::vector<std::string>{"kernel_panic"});
+
+    /* One report per line, whatever the line contains */
+    auto hits = matcher.feed("Call Trace: Call Trace\nok\nKernel panic\n");
+    ASSERT_EQ(hits.size(), 2u);
+    EXPECT_EQ(set->name(hits[0].pattern), "call_trace");
+    EXPECT_EQ(hits[0].line, "Call Trace: Call Trace");
+    EXPECT_EQ(hits[1].line, "Kernel panic");
+
+    /* Not across lines */
+    EXPECT_TRUE(feed(matcher, *set, "Kernel\npanic\n").empty());
+}
+
+
+TEST(Triggers, ConfirmsWithTheRegex)
+{
+    auto set = compile({
+        {"lockup", "^BUG: soft lockup - CPU#[0-9]+"},
+        {"either", "panic|oops"}
+    });
+    auto matcher = trigger_matcher{set};
+
+    /* The literal, but not at the start */
+    EXPECT_TRUE(feed(matcher, *set, "not a BUG: soft lockup - CPU#1\n").empty());
+    EXPECT_EQ(feed(matcher, *set, "BUG: soft lockup - CPU#12 stuck\n"),
+            std::vector<std::string>{"lockup"});
+
+    /* Tried on every line */
+    EXPECT_EQ(feed(matcher, *set, "an oops\n"), std::vector<std::string>{"either"});
+}
+
+
+TEST(Triggers, KeepsRecentEvents)
+{
+    auto set = compile(smux::default_triggers());
+    auto matcher = trigger_matcher{set};
+    auto holder = smux::triggers_holder{};
+    holder.set = set;
+
+    holder.record("/dev/ttyUSB0",
+            matcher.feed("\x1b[31mKernel panic\x1b[0m \xff\n"));
+    for (auto ii = 0u; ii < smux::triggers_holder::max_events; ++ii) {
+        holder.record("/dev/ttyUSB1", matcher.feed("Call Trace:\n"));
+    }
+
+    auto all = holder.since(0);
+    ASSERT_EQ(all.size(), smux::triggers_holder::max_events);
+    EXPECT_EQ(all.front().seq, 2u);
+    EXPECT_EQ(all.back().device, "/dev/ttyUSB1");
+    EXPECT_TRUE(holder.since(all.back().seq).empty());
+    EXPECT_EQ(holder.since(all.back().seq - 1).size(), 1u);
+
+    holder.events.clear();
+    holder.record("/dev/ttyUSB0",
+            matcher.feed("\x1b[31mKernel panic\x1b[0m \xff\n"));
+    auto first = holder.since(0);
+    ASSERT_EQ(first.size(), 1u);
+    EXPECT_EQ(first[0].trigger, "kernel_panic");
+    EXPECT_EQ(first[0].line, "Kernel panic \xef\xbf\xbd");
+}
+
+
+TEST(Triggers, FindsThePromptBeforeTheLineEnds)
+{
+    auto set = compile({{"prompt", "login: $"}});
+    auto matcher = trigger_matcher{set};
+
+    auto none = matcher.find("Welcome\r\nbuildroot log");
+    EXPECT_EQ(none.consumed, 22u);
+    EXPECT_FALSE(none.pattern.has_value());
+
+    auto found = matcher.find("in: ");
+    EXPECT_EQ(found.consumed, 4u);
+    EXPECT_EQ(found.pattern, 0u);
+
+    /* Literal patterns stop on their last byte, leaving the rest */
+    auto plain = compile({{"hash", "# "}});
+    auto literal = trigger_matcher{plain};
+    auto at = literal.find("~ # ls\n");
+    EXPECT_EQ(at.consumed, 4u);
+    EXPECT_EQ(at.pattern, 0u);
+    EXPECT_FALSE(literal.find("ls\n").pattern.has_value());
+}
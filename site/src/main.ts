@@ -104,6 +104,13 @@ terminal.parser.registerDcsHandler({final: 'S'},
             return false;
         });
 
+/* Latency probes from the server, echoed straight back so that it can measure
+   the round trip. Enabled on the server with --trace-latency. */
+terminal.parser.registerDcsHandler({final: 'p'}, (data:string) => {
+    ws.send('\x1b_probe=' + data + '\x1b\\');
+    return true;
+});
+
 const proto = (document.location.protocol == 'https:' ? 'wss://' : 'ws://')
 
 const ws = new WebsocketBuilder(proto + window.location.host) 